@@ -157,6 +157,12 @@
  │▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒▒│
  ╰───────────────────────────────────────────────────────────────────────╯*/
 
+// POSIX interfaces (mmap, fstat, fileno) are used where the platform provides
+// them; request them before the first libc header so -std=c11 still declares them.
+#if !defined(_POSIX_C_SOURCE) && !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
@@ -166,6 +172,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define SPLAT_HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 /* Optional compression backends.
  *
  * The reference codec is self-contained and builds with a bare `gcc 4splat.c`;
@@ -181,6 +193,7 @@
 #define SPLAT_WITH_ZSTD
 #define SPLAT_WITH_LZ4
 #define SPLAT_WITH_LCMS2
+#define SPLAT_WITH_THREADS
 #endif
 
 #ifdef SPLAT_WITH_ZLIB
@@ -206,6 +219,32 @@
 #include <lcms2.h>
 #include <math.h> // OKLab transform (powf/cbrtf)
 #endif
+// Worker threads for chunk (de)compression; without them every parallel loop
+// runs serially on the calling thread.
+#ifdef SPLAT_WITH_THREADS
+#include <pthread.h>
+#include <unistd.h> // sysconf
+#endif
+// CRC-32 kernels picked at run time from what the CPU supports; the portable
+// slicing-by-16 kernel covers everything else.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SPLAT_CRC32_PCLMUL
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__linux__) && (defined(__GNUC__) || defined(__clang__))
+#define SPLAT_CRC32_ARMV8
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#endif
+// Palette gather kernels for the RGB8 decoders: AVX2 when the CPU has it, and
+// NEON, which every AArch64 CPU has.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SPLAT_GATHER_AVX2
+#endif
+#if defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define SPLAT_GATHER_NEON
+#include <arm_neon.h>
+#endif
 
 #define LOG_ERROR(...) fprintf(stderr, __VA_ARGS__)
 #define SAFE_SNPRINTF(...) snprintf(__VA_ARGS__)
@@ -613,8 +652,19 @@ typedef struct {
   Splat4D *palette;
 } Splat4DPalette;
 
+// The index is kept in memory at a per-entry width of 1, 2, 4 or 8 bytes --
+// normally the header's index width, so reading, writing and CRC streaming copy
+// it straight through without widening to 64 bits. `data` aliases whichever
+// typed view matches `width`; use splat4d_index_get/set for width-agnostic code.
 typedef struct {
-  uint64_t *index;
+  union {
+    void *data;
+    uint8_t *u8;
+    uint16_t *u16;
+    uint32_t *u32;
+    uint64_t *u64;
+  };
+  uint8_t width;
 } Splat4DIndex;
 
 typedef struct {
@@ -630,6 +680,74 @@ typedef struct {
   Splat4DFooter footer;
 } Splat4DVideo;
 
+// Writer knobs beyond what the header flags describe.
+typedef struct {
+  // Frames per independently compressed index chunk (the chunked layout, so a
+  // reader can decode one frame without the rest); 0 keeps one index blob.
+  uint32_t chunk_frames;
+  // With chunk_frames == 0, split a compressed index into blocks of about this
+  // many bytes so they can be (de)compressed in parallel; 0 disables. An index
+  // that fits in one block keeps the monolithic layout.
+  size_t chunk_bytes;
+  // Code each frame of a compressed index as its XOR against the previous
+  // frame (slice against slice for a volume). Ignored without compression.
+  bool temporal_delta;
+  // Store each distinct frame index once and record repeats in a frame table,
+  // so static shots cost one frame. Ignored without compression.
+  bool frame_refs;
+} Splat4DWriteOptions;
+
+// When the reader checks the footer checksum against the loaded payload.
+typedef enum {
+  SPLAT_READ_VERIFY_FULL = 0, // before returning (the default)
+  SPLAT_READ_VERIFY_DEFERRED, // not at open; the caller runs splat4d_verify() later
+  SPLAT_READ_VERIFY_NONE,     // never: trusted files, structural checks only
+} Splat4DReadVerify;
+
+// Reader knobs; a NULL options pointer means all defaults.
+typedef struct {
+  Splat4DReadVerify verify;
+} Splat4DReadOptions;
+
+// How an encode that reduces colors (max_colors > 0) picks its palette.
+typedef enum {
+  SPLAT_QUANTIZER_MEDIAN_CUT = 0, // weighted median cut (the default)
+  SPLAT_QUANTIZER_OCTREE,         // fastest: fold the deepest octree leaves
+  SPLAT_QUANTIZER_WU,             // best quality: Wu's variance-minimizing cuts
+} SplatQuantizer;
+
+// How an encode numbers its final palette. Any order other than first-seen
+// renumbers the entries after the statistics pass so that the index
+// compresses better, and sets SPLAT_FLAG_SORTED.
+typedef enum {
+  SPLAT_ORDER_FIRST_SEEN = 0, // first appearance in scan order (the default)
+  SPLAT_ORDER_FREQUENCY,      // most used entry first
+  SPLAT_ORDER_POSITION,       // by the mean scan position of each entry's pixels
+  SPLAT_ORDER_COOCCURRENCE,   // chain the entries whose pixels touch most often
+} SplatPaletteOrder;
+
+// Encoder knobs; a NULL options pointer keeps every distinct color.
+typedef struct {
+  uint32_t max_colors; // 0 = exact (lossless) palette
+  SplatQuantizer quantizer;
+  // Lloyd (k-means) iterations that move a quantized palette toward the
+  // nearest-color optimum; 0 keeps the quantizer's palette as is.
+  uint32_t refine_iterations;
+  SplatPaletteOrder order;
+} Splat4DEncodeOptions;
+
+// What probe_splat4DFile() learns from the header, footer and file size alone,
+// without touching the palette or index.
+typedef struct {
+  Splat4DHeader header;
+  Splat4DFooter footer;
+  uint64_t file_size;
+  uint64_t total_indices;
+  uint64_t palette_bytes; // on disk
+  uint64_t index_offset;  // start of the index section
+  uint64_t index_bytes;   // stored bytes up to the footer (chunk table included)
+} Splat4DProbe;
+
 uint64_t header_total_indices(const Splat4DHeader *h);
 
 // --- fixed on-disk container layout -----------------------------------------
@@ -641,6 +759,22 @@ uint64_t header_total_indices(const Splat4DHeader *h);
 #define SPLAT_HEADER_DISK_BYTES 32
 #define SPLAT_FOOTER_DISK_BYTES 16
 
+// Index section layout, carried in header version[2]. Monolithic is the index
+// as one (possibly compressed) run; chunked splits it into independently
+// compressed chunks followed by a chunk table (see "chunked index layout").
+#define SPLAT_LAYOUT_MONOLITHIC 0
+#define SPLAT_LAYOUT_CHUNKED 1
+#define SPLAT_CHUNK_TABLE_TAG 0x43484E4B // "CHNK"
+// Transforms applied to the index ahead of the codec, a bitmask carried in
+// header version[3] (see "temporal delta index transform" and "frame
+// references").
+#define SPLAT_TRANSFORM_NONE 0
+#define SPLAT_TRANSFORM_DELTA (1u << 0)
+#define SPLAT_TRANSFORM_FRAME_REFS (1u << 1)
+#define SPLAT_FRAME_TABLE_TAG 0x46524D53 // "FRMS"
+#define SPLAT_FRAME_TABLE_FIXED_BYTES 8
+#define SPLAT_CHUNK_TABLE_FIXED_BYTES 24
+
 // Upper bound on the decompressed index size accepted from a compressed file,
 // so a tiny "decompression bomb" header cannot force a huge allocation.
 #define SPLAT_MAX_COMPRESSED_INDEX_BYTES ((uint64_t)1 << 31) // 2 GiB
@@ -664,6 +798,8 @@ static void store_u32be(uint8_t *p, uint32_t v) {
   p[3] = (uint8_t)v;
 }
 
+static uint16_t load_u16le(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
 static uint32_t load_u32le(const uint8_t *p) {
   return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 }
@@ -759,32 +895,217 @@ static const uint32_t crc32_table[256] = {
     0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
 };
 
-// Named splat_crc32 rather than crc32 to avoid colliding with zlib's crc32()
-// when SPLAT_WITH_ZLIB is enabled.
-uint32_t splat_crc32(const void *data, size_t len) {
-  const uint8_t *p = data;
-  uint32_t crc = 0xFFFFFFFF;
-  for (size_t i = 0; i < len; i++) {
+// --- CRC-32 kernels --------------------------------------------------------
+//
+// Every kernel advances the raw CRC register (pre-inverted state, as kept in
+// crc32_t) over a byte range; crc32_update() dispatches to the fastest one this
+// CPU supports, chosen once on first use:
+//   - PCLMULQDQ folding (x86): four 128-bit lanes folded by carry-less
+//     multiplication, after Intel's "Fast CRC Computation for Generic
+//     Polynomials Using PCLMULQDQ" (Gopal et al., 2009);
+//   - the ARMv8 CRC32 instructions, eight bytes per step;
+//   - slicing-by-16 over 16 derived tables, the portable fallback.
+// All of them compute the same CRC as the byte-at-a-time reference loop.
+typedef uint32_t (*Crc32KernelFn)(uint32_t crc, const uint8_t *p, size_t n);
+
+static uint32_t crc32_bytewise(uint32_t crc, const uint8_t *p, size_t n) {
+  for (size_t i = 0; i < n; i++)
     crc = (crc >> 8) ^ crc32_table[(crc ^ p[i]) & 0xFF];
+  return crc;
+}
+
+// crc32_slice[k][b] is the register contribution of byte b followed by k zero
+// bytes; crc32_slice[0] is crc32_table. Filled by crc32_setup().
+static uint32_t crc32_slice[16][256];
+
+static uint32_t crc32_slice16(uint32_t crc, const uint8_t *p, size_t n) {
+  const uint32_t(*t)[256] = (const uint32_t(*)[256])crc32_slice;
+  while (n >= 16) {
+    uint32_t a = load_u32le(p) ^ crc, b = load_u32le(p + 4);
+    uint32_t c = load_u32le(p + 8), d = load_u32le(p + 12);
+    crc = t[15][a & 0xFF] ^ t[14][(a >> 8) & 0xFF] ^ t[13][(a >> 16) & 0xFF] ^ t[12][a >> 24] ^
+          t[11][b & 0xFF] ^ t[10][(b >> 8) & 0xFF] ^ t[9][(b >> 16) & 0xFF] ^ t[8][b >> 24] ^
+          t[7][c & 0xFF] ^ t[6][(c >> 8) & 0xFF] ^ t[5][(c >> 16) & 0xFF] ^ t[4][c >> 24] ^
+          t[3][d & 0xFF] ^ t[2][(d >> 8) & 0xFF] ^ t[1][(d >> 16) & 0xFF] ^ t[0][d >> 24];
+    p += 16;
+    n -= 16;
+  }
+  return crc32_bytewise(crc, p, n);
+}
+
+#ifdef SPLAT_CRC32_PCLMUL
+// Folding constants for the reflected polynomial 0xEDB88320: x^(4*128+32),
+// x^(4*128-32) (fold by four lanes), x^(128+32), x^(128-32) (fold by one),
+// x^64 (128 -> 64 bits), and the Barrett pair P(x) and floor(x^64 / P(x)).
+__attribute__((target("pclmul,sse4.1"))) static uint32_t crc32_pclmul(uint32_t crc,
+                                                                      const uint8_t *p, size_t n) {
+  if (n < 64)
+    return crc32_slice16(crc, p, n);
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+  const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+  size_t tail = n & 15;
+  n -= tail;
+
+  __m128i x1 = _mm_loadu_si128((const __m128i *)(p + 0x00));
+  __m128i x2 = _mm_loadu_si128((const __m128i *)(p + 0x10));
+  __m128i x3 = _mm_loadu_si128((const __m128i *)(p + 0x20));
+  __m128i x4 = _mm_loadu_si128((const __m128i *)(p + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+  p += 64;
+  n -= 64;
+
+  // Fold four lanes 64 bytes at a time.
+  while (n >= 64) {
+    __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(p + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(p + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(p + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(p + 0x30)));
+    p += 64;
+    n -= 64;
+  }
+
+  // Fold the lanes into one, then any remaining 16-byte blocks into it.
+  __m128i lanes[3] = {x2, x3, x4};
+  for (int k = 0; k < 3; ++k) {
+    __m128i lo = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), lanes[k]), lo);
+  }
+  for (; n >= 16; p += 16, n -= 16) {
+    __m128i lo = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11),
+                                     _mm_loadu_si128((const __m128i *)p)),
+                       lo);
+  }
+
+  // 128 -> 64 bits, then Barrett-reduce to 32.
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5k0, 0x00), x2);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), poly, 0x00);
+  crc = (uint32_t)_mm_extract_epi32(_mm_xor_si128(x1, x2), 1);
+  return crc32_slice16(crc, p, tail);
+}
+#endif
+
+#ifdef SPLAT_CRC32_ARMV8
+#ifdef __clang__
+#define SPLAT_TARGET_CRC __attribute__((target("crc")))
+#else
+#define SPLAT_TARGET_CRC __attribute__((target("+crc")))
+#endif
+SPLAT_TARGET_CRC static uint32_t crc32_armv8(uint32_t crc, const uint8_t *p, size_t n) {
+  for (; n > 0 && ((uintptr_t)p & 7); --n)
+    crc = __crc32b(crc, *p++);
+  for (; n >= 8; p += 8, n -= 8) {
+    uint64_t w;
+    memcpy(&w, p, sizeof w);
+    crc = __crc32d(crc, w);
+  }
+  for (; n > 0; --n)
+    crc = __crc32b(crc, *p++);
+  return crc;
+}
+#endif
+
+static Crc32KernelFn crc32_kernel;
+
+// crc32_x2n[k] = x^(2^k) mod P(x), for crc32_combine. Filled by crc32_setup().
+static uint32_t crc32_x2n[32];
+
+// a(x) * b(x) mod P(x) in the reflected bit order of the CRC register.
+static uint32_t crc32_multmodp(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31, p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0)
+        break;
+    }
+    m >>= 1;
+    b = b & 1 ? (b >> 1) ^ 0xEDB88320u : b >> 1;
+  }
+  return p;
+}
+
+static void crc32_setup(void) {
+  for (int b = 0; b < 256; ++b) {
+    uint32_t v = crc32_table[b];
+    crc32_slice[0][b] = v;
+    for (int k = 1; k < 16; ++k) {
+      v = (v >> 8) ^ crc32_table[v & 0xFF];
+      crc32_slice[k][b] = v;
+    }
+  }
+  uint32_t x2n = 1u << 30; // x^1
+  for (int k = 0; k < 32; ++k) {
+    crc32_x2n[k] = x2n;
+    x2n = crc32_multmodp(x2n, x2n);
   }
-  return ~crc;
+  crc32_kernel = crc32_slice16;
+#ifdef SPLAT_CRC32_PCLMUL
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+    crc32_kernel = crc32_pclmul;
+#endif
+#ifdef SPLAT_CRC32_ARMV8
+  if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+    crc32_kernel = crc32_armv8;
+#endif
+}
+
+static Crc32KernelFn crc32_select(void) {
+#ifdef SPLAT_WITH_THREADS
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, crc32_setup);
+#else
+  if (!crc32_kernel)
+    crc32_setup();
+#endif
+  return crc32_kernel;
 }
 
 static inline void crc32_init(crc32_t *c) { c->v = 0xFFFFFFFFu; }
 
 static inline void crc32_update(crc32_t *c, const void *p, size_t n) {
-  const uint8_t *b = p;
-  // ⚡ Bolt Optimization: Extract hash accumulator to avoid defensive
-  // memory reloads in this tight bitwise loop.
-  uint32_t cv = c->v;
-  for (size_t i = 0; i < n; i++) {
-    cv = (cv >> 8) ^ crc32_table[(cv ^ b[i]) & 0xFF];
-  }
-  c->v = cv;
+  c->v = crc32_select()(c->v, p, n);
 }
 
 static inline uint32_t crc32_final(crc32_t *c) { return ~c->v; }
 
+// Named splat_crc32 rather than crc32 to avoid colliding with zlib's crc32()
+// when SPLAT_WITH_ZLIB is enabled.
+uint32_t splat_crc32(const void *data, size_t len) {
+  crc32_t c;
+  crc32_init(&c);
+  crc32_update(&c, data, len);
+  return crc32_final(&c);
+}
+
+// CRC of A followed by B, given crc1 = CRC(A), crc2 = CRC(B) and B's length:
+// shifting crc1 past len2 bytes is a multiplication by x^(8 * len2) mod P(x),
+// built from the precomputed powers x^(2^k). O(log len2), no data access.
+uint32_t splat_crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2) {
+  crc32_select(); // powers table
+  uint32_t xn = 1u << 31; // x^0
+  for (int k = 3; len2; len2 >>= 1, ++k)
+    if (len2 & 1)
+      xn = crc32_multmodp(crc32_x2n[k & 31], xn);
+  return crc32_multmodp(xn, crc1) ^ crc2;
+}
+
 // --- compression backends ---------------------------------------------------
 //
 // The index payload (the packed run of palette references) can be stored using
@@ -1362,1504 +1683,5016 @@ static bool splat4d_stream_block(const uint8_t *data, size_t len, size_t chunk,
   return true;
 }
 
-static bool checked_mul_u64(uint64_t a, uint64_t b, uint64_t *out) {
-  if (!out)
-    return false;
-  if (b != 0 && a > UINT64_MAX / b)
-    return false;
-  *out = a * b;
-  return true;
+// --- streaming codecs -------------------------------------------------------
+//
+// Incremental counterparts of splat_compress() / splat_decompress() for the
+// monolithic index, so neither side holds the whole compressed index (or a
+// worst-case output bound) next to the packed one. An encoder takes input
+// through splat_encoder_consume(), a Splat4DChunkFn, and hands compressed
+// output to its sink SPLAT_CODEC_BUFFER_BYTES at a time; a decoder takes
+// compressed input the same way and inflates straight into the caller's
+// buffer. Both emit and accept exactly the container formats of the
+// whole-buffer backends. LZ4 stores a raw block, which has no streaming form,
+// so it stays on the whole-buffer path.
+#define SPLAT_CODEC_BUFFER_BYTES ((size_t)1 << 15)
+
+static bool splat_codec_streams(uint32_t codec) {
+  return codec != SPLAT_COMPRESSION_NONE && codec != SPLAT_COMPRESSION_LZ4 &&
+         splat_compression_available(codec);
 }
 
-bool header_total_indices_checked(const Splat4DHeader *h, uint64_t *total) {
-  if (!h || !total)
-    return false;
-
-  uint64_t dims[4] = {h->width, h->height, h->depth, h->frames};
-  uint64_t acc = 1;
-  for (size_t i = 0; i < 4; ++i) {
-    if (dims[i] == 0)
+typedef struct {
+  uint32_t codec;
+  Splat4DChunkFn sink;
+  void *sink_ctx;
+  union {
+#ifdef SPLAT_WITH_ZLIB
+    z_stream z;
+#endif
+#ifdef SPLAT_WITH_BZIP2
+    bz_stream bz;
+#endif
+#ifdef SPLAT_WITH_LZMA
+    lzma_stream lz;
+#endif
+#ifdef SPLAT_WITH_BROTLI
+    BrotliEncoderState *br;
+#endif
+#ifdef SPLAT_WITH_ZSTD
+    ZSTD_CCtx *zs;
+#endif
+    struct {
+      uint8_t value;
+      unsigned run; // 0 = no pending run
+    } rle;
+  } u;
+  size_t out_len; // compressed bytes staged in out
+  uint8_t out[SPLAT_CODEC_BUFFER_BYTES];
+} SplatEncoder;
+
+static bool splat_encoder_begin(SplatEncoder *e, uint32_t codec, uint64_t size_hint,
+                                Splat4DChunkFn sink, void *sink_ctx) {
+  e->codec = codec;
+  e->sink = sink;
+  e->sink_ctx = sink_ctx;
+  e->out_len = 0;
+  memset(&e->u, 0, sizeof e->u);
+  switch (codec) {
+  case SPLAT_COMPRESSION_RUN_LENGTH:
+    return true;
+#ifdef SPLAT_WITH_ZLIB
+  case SPLAT_COMPRESSION_DEFLATE:
+  case SPLAT_COMPRESSION_ZLIB:
+    return deflateInit2(&e->u.z, Z_BEST_COMPRESSION, Z_DEFLATED,
+                        codec == SPLAT_COMPRESSION_DEFLATE ? -15 : 15, 8,
+                        Z_DEFAULT_STRATEGY) == Z_OK;
+#endif
+#ifdef SPLAT_WITH_BZIP2
+  case SPLAT_COMPRESSION_BZIP2:
+    return BZ2_bzCompressInit(&e->u.bz, 9, 0, 0) == BZ_OK;
+#endif
+#ifdef SPLAT_WITH_LZMA
+  case SPLAT_COMPRESSION_LZMA: {
+    lzma_options_lzma opt;
+    e->u.lz = (lzma_stream)LZMA_STREAM_INIT;
+    return !lzma_lzma_preset(&opt, LZMA_PRESET_DEFAULT) &&
+           lzma_alone_encoder(&e->u.lz, &opt) == LZMA_OK;
+  }
+  case SPLAT_COMPRESSION_XZ:
+    e->u.lz = (lzma_stream)LZMA_STREAM_INIT;
+    return lzma_easy_encoder(&e->u.lz, LZMA_PRESET_DEFAULT, LZMA_CHECK_CRC64) == LZMA_OK;
+#endif
+#ifdef SPLAT_WITH_BROTLI
+  case SPLAT_COMPRESSION_BROTLI:
+    if (!(e->u.br = BrotliEncoderCreateInstance(NULL, NULL, NULL)))
       return false;
-    if (!checked_mul_u64(acc, dims[i], &acc))
+    BrotliEncoderSetParameter(e->u.br, BROTLI_PARAM_QUALITY, BROTLI_DEFAULT_QUALITY);
+    BrotliEncoderSetParameter(e->u.br, BROTLI_PARAM_LGWIN, BROTLI_DEFAULT_WINDOW);
+    BrotliEncoderSetParameter(e->u.br, BROTLI_PARAM_SIZE_HINT,
+                              size_hint < UINT32_MAX ? (uint32_t)size_hint : UINT32_MAX);
+    return true;
+#endif
+#ifdef SPLAT_WITH_ZSTD
+  case SPLAT_COMPRESSION_ZSTD:
+    // Pledging the size keeps it in the frame header, as ZSTD_compress() does.
+    if (!(e->u.zs = ZSTD_createCCtx()))
       return false;
+    return !ZSTD_isError(
+               ZSTD_CCtx_setParameter(e->u.zs, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT)) &&
+           !ZSTD_isError(ZSTD_CCtx_setPledgedSrcSize(e->u.zs, size_hint));
+#endif
+  default:
+    (void)size_hint;
+    return false;
   }
-
-  *total = acc;
-  return true;
-}
-
-uint64_t header_total_indices(const Splat4DHeader *h) {
-  return (uint64_t)h->width * (uint64_t)h->height * (uint64_t)h->depth * (uint64_t)h->frames;
-}
-
-static uint8_t get_index_width_bytes(uint32_t flags) {
-  uint32_t w = (flags >> 8) & 0x3u;
-  if (w == SPLAT_INDEX_WIDTH_8)
-    return 1;
-  if (w == SPLAT_INDEX_WIDTH_16)
-    return 2;
-  if (w == SPLAT_INDEX_WIDTH_32)
-    return 4;
-  return 8; // SPLAT_INDEX_WIDTH_64
-}
-
-// Largest index value representable in idx_width bytes.
-static uint64_t index_width_max_value(uint8_t idx_width) {
-  if (idx_width >= 8)
-    return UINT64_MAX;
-  return ((uint64_t)1 << (8u * idx_width)) - 1u;
-}
-
-// --- palette precision ---
-//
-// A Splat4D is twelve packed IEEE-754 floats in memory. On disk the palette is
-// stored at the precision selected by the header's precision field: float16
-// (2 bytes/component), float32 (4) or float64 (8). float32 is the in-memory
-// representation, so that path is a byte-for-byte copy; float64 widens exactly;
-// float16 is a lossy narrowing.
-_Static_assert(sizeof(Splat4D) == 15 * sizeof(float), "Splat4D must be 15 packed floats");
-
-// Largest palette entry (full covariance): mu_{x,y,z} + 6 covariance values +
-// mu_t + sigma_t + r,g,b,alpha.
-#define SPLAT_PALETTE_MAX_COMPONENTS 15
-
-static uint32_t splat_precision_bits(uint32_t flags) {
-  return (flags & SPLAT_FLAG_PRECISION_MASK) >> SPLAT_FLAG_PRECISION_SHIFT;
 }
 
-static size_t splat_precision_component_bytes(uint32_t flags) {
-  switch (splat_precision_bits(flags)) {
-  case 0:
-    return 2; // Float16
-  case 2:
-    return 8; // Float64
+// Release the codec state (after finishing, or to abandon the stream).
+static void splat_encoder_end(SplatEncoder *e) {
+  switch (e->codec) {
+#ifdef SPLAT_WITH_ZLIB
+  case SPLAT_COMPRESSION_DEFLATE:
+  case SPLAT_COMPRESSION_ZLIB:
+    deflateEnd(&e->u.z);
+    break;
+#endif
+#ifdef SPLAT_WITH_BZIP2
+  case SPLAT_COMPRESSION_BZIP2:
+    BZ2_bzCompressEnd(&e->u.bz);
+    break;
+#endif
+#ifdef SPLAT_WITH_LZMA
+  case SPLAT_COMPRESSION_LZMA:
+  case SPLAT_COMPRESSION_XZ:
+    lzma_end(&e->u.lz);
+    break;
+#endif
+#ifdef SPLAT_WITH_BROTLI
+  case SPLAT_COMPRESSION_BROTLI:
+    BrotliEncoderDestroyInstance(e->u.br);
+    break;
+#endif
+#ifdef SPLAT_WITH_ZSTD
+  case SPLAT_COMPRESSION_ZSTD:
+    ZSTD_freeCCtx(e->u.zs);
+    break;
+#endif
   default:
-    return 4; // Float32 (the only other value that reaches disk)
+    break;
+  }
+}
+
+// Run the codec over as much of *in / *n as fits in the staging buffer,
+// advancing both. With `finish`, also drain the codec; *done is set once the
+// stream is complete.
+static bool splat_encoder_step(SplatEncoder *e, const uint8_t **in, size_t *n, bool finish,
+                               bool *done) {
+  uint8_t *out = e->out + e->out_len;
+  size_t room = SPLAT_CODEC_BUFFER_BYTES - e->out_len;
+  switch (e->codec) {
+  case SPLAT_COMPRESSION_RUN_LENGTH: {
+    // Same (count, value) pairs as rle_compress(), with runs carried across
+    // calls.
+    size_t o = 0;
+    while (*n > 0) {
+      uint8_t b = **in;
+      if (e->u.rle.run > 0 && b == e->u.rle.value && e->u.rle.run < 255) {
+        e->u.rle.run++;
+      } else {
+        if (e->u.rle.run > 0) {
+          if (room - o < 2)
+            break;
+          out[o++] = (uint8_t)e->u.rle.run;
+          out[o++] = e->u.rle.value;
+        }
+        e->u.rle.value = b;
+        e->u.rle.run = 1;
+      }
+      (*in)++;
+      (*n)--;
+    }
+    if (finish && *n == 0) {
+      if (e->u.rle.run > 0 && room - o >= 2) {
+        out[o++] = (uint8_t)e->u.rle.run;
+        out[o++] = e->u.rle.value;
+        e->u.rle.run = 0;
+      }
+      *done = e->u.rle.run == 0;
+    }
+    e->out_len += o;
+    return true;
   }
-}
-
-static uint32_t splat_shape_bits(uint32_t flags) {
-  return (flags & SPLAT_FLAG_SPLAT_SHAPE_MASK) >> SPLAT_FLAG_SPLAT_SHAPE_SHIFT;
-}
-
-// Number of spatial spread values stored per palette entry for the splat shape:
-// isotropic = 1 (a shared sigma), axis-aligned = 3 (sigma_x/y/z), full
-// covariance = 6 (the symmetric 3x3 upper triangle). The reserved value (3) is
-// rejected by flags_supported() and never reaches here.
-static uint32_t splat_shape_cov_count(uint32_t flags) {
-  switch (splat_shape_bits(flags)) {
-  case 0:
-    return 1; // Isotropic
-  case 2:
-    return 6; // Full covariance
+#ifdef SPLAT_WITH_ZLIB
+  case SPLAT_COMPRESSION_DEFLATE:
+  case SPLAT_COMPRESSION_ZLIB: {
+    z_stream *zs = &e->u.z;
+    zs->next_in = (Bytef *)(uintptr_t)*in;
+    zs->avail_in = (uInt)*n;
+    zs->next_out = out;
+    zs->avail_out = (uInt)room;
+    int r = deflate(zs, finish ? Z_FINISH : Z_NO_FLUSH);
+    *in += *n - zs->avail_in;
+    *n = zs->avail_in;
+    e->out_len += room - zs->avail_out;
+    *done = r == Z_STREAM_END;
+    return r == Z_OK || r == Z_STREAM_END || r == Z_BUF_ERROR;
+  }
+#endif
+#ifdef SPLAT_WITH_BZIP2
+  case SPLAT_COMPRESSION_BZIP2: {
+    bz_stream *bz = &e->u.bz;
+    bz->next_in = (char *)(uintptr_t)*in;
+    bz->avail_in = (unsigned int)*n;
+    bz->next_out = (char *)out;
+    bz->avail_out = (unsigned int)room;
+    int r = BZ2_bzCompress(bz, finish ? BZ_FINISH : BZ_RUN);
+    *in += *n - bz->avail_in;
+    *n = bz->avail_in;
+    e->out_len += room - bz->avail_out;
+    *done = r == BZ_STREAM_END;
+    return r == BZ_RUN_OK || r == BZ_FINISH_OK || r == BZ_STREAM_END;
+  }
+#endif
+#ifdef SPLAT_WITH_LZMA
+  case SPLAT_COMPRESSION_LZMA:
+  case SPLAT_COMPRESSION_XZ: {
+    lzma_stream *lz = &e->u.lz;
+    lz->next_in = *in;
+    lz->avail_in = *n;
+    lz->next_out = out;
+    lz->avail_out = room;
+    lzma_ret r = lzma_code(lz, finish ? LZMA_FINISH : LZMA_RUN);
+    *in = lz->next_in;
+    *n = lz->avail_in;
+    e->out_len += room - lz->avail_out;
+    *done = r == LZMA_STREAM_END;
+    return r == LZMA_OK || r == LZMA_STREAM_END;
+  }
+#endif
+#ifdef SPLAT_WITH_BROTLI
+  case SPLAT_COMPRESSION_BROTLI: {
+    size_t avail_out = room;
+    if (!BrotliEncoderCompressStream(e->u.br,
+                                     finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS,
+                                     n, in, &avail_out, &out, NULL))
+      return false;
+    e->out_len += room - avail_out;
+    *done = finish && BrotliEncoderIsFinished(e->u.br);
+    return true;
+  }
+#endif
+#ifdef SPLAT_WITH_ZSTD
+  case SPLAT_COMPRESSION_ZSTD: {
+    ZSTD_inBuffer ib = {*in, *n, 0};
+    ZSTD_outBuffer ob = {out, room, 0};
+    size_t left = ZSTD_compressStream2(e->u.zs, &ob, &ib, finish ? ZSTD_e_end : ZSTD_e_continue);
+    *in += ib.pos;
+    *n -= ib.pos;
+    e->out_len += ob.pos;
+    *done = finish && left == 0;
+    return !ZSTD_isError(left);
+  }
+#endif
   default:
-    return 3; // Axis-aligned
+    return false;
   }
 }
 
-// Total floats in a palette entry: mu_{x,y,z} (3) + covariance block + mu_t +
-// sigma_t (2) + r,g,b,alpha (4).
-static uint32_t splat_palette_component_count(uint32_t flags) {
-  return 3 + splat_shape_cov_count(flags) + 2 + 4;
+// Feed in[0..n) through the codec; with `finish`, also flush the end of the
+// stream to the sink.
+static bool splat_encoder_run(SplatEncoder *e, const uint8_t *in, size_t n, bool finish) {
+  for (;;) {
+    if (!finish && n == 0)
+      return true;
+    bool done = false;
+    if (!splat_encoder_step(e, &in, &n, finish, &done))
+      return false;
+    if (done || e->out_len == SPLAT_CODEC_BUFFER_BYTES) {
+      if (e->out_len > 0 && !e->sink(e->out, e->out_len, e->sink_ctx))
+        return false;
+      e->out_len = 0;
+    }
+    if (done)
+      return true;
+  }
 }
 
-static size_t palette_entry_disk_bytes(uint32_t flags) {
-  return (size_t)splat_palette_component_count(flags) * splat_precision_component_bytes(flags);
+// Splat4DChunkFn adapter: ctx is the SplatEncoder. Large chunks are fed in
+// staging-sized pieces so the 32-bit stream counters of zlib/bzip2 never
+// overflow.
+static bool splat_encoder_consume(const uint8_t *chunk, size_t n, void *ctx) {
+  while (n > 0) {
+    size_t step = n < SPLAT_CODEC_BUFFER_BYTES ? n : SPLAT_CODEC_BUFFER_BYTES;
+    if (!splat_encoder_run(ctx, chunk, step, false))
+      return false;
+    chunk += step;
+    n -= step;
+  }
+  return true;
 }
 
-// IEEE-754 binary16 <-> binary32 with round-to-nearest-even.
-static uint16_t float_to_half(float value) {
-  uint32_t x;
-  memcpy(&x, &value, sizeof x);
-  uint32_t sign = (x >> 16) & 0x8000u;
-  uint32_t exp = (x >> 23) & 0xFFu;
-  uint32_t mant = x & 0x7FFFFFu;
-
-  if (exp == 0xFF) // Inf / NaN
-    return (uint16_t)(sign | 0x7C00u | (mant ? 0x200u : 0u));
+static bool splat_encoder_finish(SplatEncoder *e) { return splat_encoder_run(e, NULL, 0, true); }
+
+typedef struct {
+  uint32_t codec;
+  uint8_t *dst;
+  size_t cap, len; // dst capacity (the exact expected size) and bytes written
+  bool ended;      // the codec saw the end of its stream
+  union {
+#ifdef SPLAT_WITH_ZLIB
+    z_stream z;
+#endif
+#ifdef SPLAT_WITH_BZIP2
+    bz_stream bz;
+#endif
+#ifdef SPLAT_WITH_LZMA
+    lzma_stream lz;
+#endif
+#ifdef SPLAT_WITH_BROTLI
+    BrotliDecoderState *br;
+#endif
+#ifdef SPLAT_WITH_ZSTD
+    ZSTD_DCtx *zs;
+#endif
+    struct {
+      uint8_t run;
+      bool have_run; // a count byte is waiting for its value byte
+      uint8_t value;
+      uint8_t left; // bytes of the last run still to write
+    } rle;
+  } u;
+} SplatDecoder;
+
+static bool splat_decoder_begin(SplatDecoder *d, uint32_t codec, uint8_t *dst, size_t cap) {
+  d->codec = codec;
+  d->dst = dst;
+  d->cap = cap;
+  d->len = 0;
+  d->ended = false;
+  memset(&d->u, 0, sizeof d->u);
+  switch (codec) {
+  case SPLAT_COMPRESSION_RUN_LENGTH:
+    return true;
+#ifdef SPLAT_WITH_ZLIB
+  case SPLAT_COMPRESSION_DEFLATE:
+  case SPLAT_COMPRESSION_ZLIB:
+    return inflateInit2(&d->u.z, codec == SPLAT_COMPRESSION_DEFLATE ? -15 : 15) == Z_OK;
+#endif
+#ifdef SPLAT_WITH_BZIP2
+  case SPLAT_COMPRESSION_BZIP2:
+    return BZ2_bzDecompressInit(&d->u.bz, 0, 0) == BZ_OK;
+#endif
+#ifdef SPLAT_WITH_LZMA
+  case SPLAT_COMPRESSION_LZMA:
+    d->u.lz = (lzma_stream)LZMA_STREAM_INIT;
+    return lzma_alone_decoder(&d->u.lz, UINT64_MAX) == LZMA_OK;
+  case SPLAT_COMPRESSION_XZ:
+    d->u.lz = (lzma_stream)LZMA_STREAM_INIT;
+    return lzma_stream_decoder(&d->u.lz, UINT64_MAX, 0) == LZMA_OK;
+#endif
+#ifdef SPLAT_WITH_BROTLI
+  case SPLAT_COMPRESSION_BROTLI:
+    return (d->u.br = BrotliDecoderCreateInstance(NULL, NULL, NULL)) != NULL;
+#endif
+#ifdef SPLAT_WITH_ZSTD
+  case SPLAT_COMPRESSION_ZSTD:
+    return (d->u.zs = ZSTD_createDCtx()) != NULL;
+#endif
+  default:
+    return false;
+  }
+}
+
+static void splat_decoder_end(SplatDecoder *d) {
+  switch (d->codec) {
+#ifdef SPLAT_WITH_ZLIB
+  case SPLAT_COMPRESSION_DEFLATE:
+  case SPLAT_COMPRESSION_ZLIB:
+    inflateEnd(&d->u.z);
+    break;
+#endif
+#ifdef SPLAT_WITH_BZIP2
+  case SPLAT_COMPRESSION_BZIP2:
+    BZ2_bzDecompressEnd(&d->u.bz);
+    break;
+#endif
+#ifdef SPLAT_WITH_LZMA
+  case SPLAT_COMPRESSION_LZMA:
+  case SPLAT_COMPRESSION_XZ:
+    lzma_end(&d->u.lz);
+    break;
+#endif
+#ifdef SPLAT_WITH_BROTLI
+  case SPLAT_COMPRESSION_BROTLI:
+    BrotliDecoderDestroyInstance(d->u.br);
+    break;
+#endif
+#ifdef SPLAT_WITH_ZSTD
+  case SPLAT_COMPRESSION_ZSTD:
+    ZSTD_freeDCtx(d->u.zs);
+    break;
+#endif
+  default:
+    break;
+  }
+}
+
+// Decode as much of *in / *n as the codec takes, advancing both, until the
+// output is full. A caller may then move dst to a fresh buffer and continue;
+// splat_decoder_consume() and splat_decoder_finish() treat output past the
+// expected size as an error.
+static bool splat_decoder_step(SplatDecoder *d, const uint8_t **in, size_t *n, bool finish) {
+  uint8_t *out = d->dst + d->len;
+  size_t room = d->cap - d->len;
+  switch (d->codec) {
+  case SPLAT_COMPRESSION_RUN_LENGTH:
+    for (;;) {
+      // A run that did not fit continues once the output has room again.
+      size_t k = d->u.rle.left < room ? d->u.rle.left : room;
+      if (k > 0) {
+        memset(out, d->u.rle.value, k);
+        out += k;
+        room -= k;
+        d->len += k;
+        d->u.rle.left -= (uint8_t)k;
+      }
+      if (d->u.rle.left > 0 || *n == 0)
+        break;
+      if (!d->u.rle.have_run) {
+        d->u.rle.run = **in;
+        d->u.rle.have_run = true;
+        if (d->u.rle.run == 0)
+          return false;
+      } else {
+        d->u.rle.value = **in;
+        d->u.rle.left = d->u.rle.run;
+        d->u.rle.have_run = false;
+      }
+      (*in)++;
+      (*n)--;
+    }
+    // RLE has no end marker: the stream ends where the input does.
+    d->ended = finish && !d->u.rle.have_run && d->u.rle.left == 0;
+    return true;
+#ifdef SPLAT_WITH_ZLIB
+  case SPLAT_COMPRESSION_DEFLATE:
+  case SPLAT_COMPRESSION_ZLIB: {
+    z_stream *zs = &d->u.z;
+    zs->next_in = (Bytef *)(uintptr_t)*in;
+    zs->avail_in = (uInt)*n;
+    zs->next_out = out;
+    zs->avail_out = room > UINT_MAX ? UINT_MAX : (uInt)room;
+    uInt avail_out = zs->avail_out;
+    int r = inflate(zs, Z_NO_FLUSH);
+    *in += *n - zs->avail_in;
+    *n = zs->avail_in;
+    d->len += avail_out - zs->avail_out;
+    d->ended = r == Z_STREAM_END;
+    return r == Z_OK || r == Z_STREAM_END || r == Z_BUF_ERROR;
+  }
+#endif
+#ifdef SPLAT_WITH_BZIP2
+  case SPLAT_COMPRESSION_BZIP2: {
+    bz_stream *bz = &d->u.bz;
+    bz->next_in = (char *)(uintptr_t)*in;
+    bz->avail_in = (unsigned int)*n;
+    bz->next_out = (char *)out;
+    bz->avail_out = room > UINT_MAX ? UINT_MAX : (unsigned int)room;
+    unsigned int avail_out = bz->avail_out;
+    int r = BZ2_bzDecompress(bz);
+    *in += *n - bz->avail_in;
+    *n = bz->avail_in;
+    d->len += avail_out - bz->avail_out;
+    d->ended = r == BZ_STREAM_END;
+    return r == BZ_OK || r == BZ_STREAM_END;
+  }
+#endif
+#ifdef SPLAT_WITH_LZMA
+  case SPLAT_COMPRESSION_LZMA:
+  case SPLAT_COMPRESSION_XZ: {
+    lzma_stream *lz = &d->u.lz;
+    lz->next_in = *in;
+    lz->avail_in = *n;
+    lz->next_out = out;
+    lz->avail_out = room;
+    lzma_ret r = lzma_code(lz, finish ? LZMA_FINISH : LZMA_RUN);
+    *in = lz->next_in;
+    *n = lz->avail_in;
+    d->len += room - lz->avail_out;
+    d->ended = r == LZMA_STREAM_END;
+    return r == LZMA_OK || r == LZMA_STREAM_END || (r == LZMA_BUF_ERROR && !finish);
+  }
+#endif
+#ifdef SPLAT_WITH_BROTLI
+  case SPLAT_COMPRESSION_BROTLI: {
+    size_t avail_out = room;
+    BrotliDecoderResult r = BrotliDecoderDecompressStream(d->u.br, n, in, &avail_out, &out, NULL);
+    d->len += room - avail_out;
+    d->ended = r == BROTLI_DECODER_RESULT_SUCCESS;
+    // A full output buffer only pauses the stream.
+    return r == BROTLI_DECODER_RESULT_SUCCESS || r == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT ||
+           (r == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT && avail_out == 0);
+  }
+#endif
+#ifdef SPLAT_WITH_ZSTD
+  case SPLAT_COMPRESSION_ZSTD: {
+    ZSTD_inBuffer ib = {*in, *n, 0};
+    ZSTD_outBuffer ob = {out, room, 0};
+    size_t r = ZSTD_decompressStream(d->u.zs, &ob, &ib);
+    *in += ib.pos;
+    *n -= ib.pos;
+    d->len += ob.pos;
+    d->ended = r == 0;
+    return !ZSTD_isError(r);
+  }
+#endif
+  default:
+    (void)out;
+    (void)room;
+    (void)finish;
+    return false;
+  }
+}
+
+// Splat4DChunkFn adapter: ctx is the SplatDecoder. Fails on input after the end
+// of the stream and on input the decoder cannot make progress with (it would
+// produce more than the expected size).
+static bool splat_decoder_consume(const uint8_t *chunk, size_t n, void *ctx) {
+  SplatDecoder *d = ctx;
+  while (n > 0) {
+    if (d->ended)
+      return false;
+    size_t step = n < SPLAT_CODEC_BUFFER_BYTES ? n : SPLAT_CODEC_BUFFER_BYTES;
+    size_t left = step, len = d->len;
+    if (!splat_decoder_step(d, &chunk, &left, false) ||
+        (left == step && d->len == len && !d->ended))
+      return false;
+    n -= step - left;
+  }
+  return true;
+}
+
+// Succeeds only if the stream ended cleanly with exactly the expected size.
+static bool splat_decoder_finish(SplatDecoder *d) {
+  const uint8_t *none = NULL;
+  size_t n = 0;
+  if (!d->ended && !splat_decoder_step(d, &none, &n, true))
+    return false;
+  return d->ended && d->len == d->cap;
+}
+
+static bool checked_mul_u64(uint64_t a, uint64_t b, uint64_t *out) {
+  if (!out)
+    return false;
+  if (b != 0 && a > UINT64_MAX / b)
+    return false;
+  *out = a * b;
+  return true;
+}
+
+// --- worker threads ---------------------------------------------------------
+//
+// splat_parallel_for() runs independent tasks 0..ntasks-1 on up to
+// splat4d_thread_count() threads (the caller included), handing out task
+// numbers in order from a shared counter. Callers keep output deterministic by
+// having each task write only its own slot and doing any ordered work (file
+// writes, merges) after the loop. Builds without SPLAT_WITH_THREADS, and
+// single-task loops, run serially on the calling thread.
+typedef bool (*SplatTaskFn)(void *ctx, uint64_t task);
+
+static unsigned g_splat_threads; // 0 = one per online CPU
+
+// Set the worker count for parallel sections; 0 restores the per-CPU default.
+void splat4d_set_threads(unsigned n) { g_splat_threads = n; }
+
+unsigned splat4d_thread_count(void) {
+#ifdef SPLAT_WITH_THREADS
+  if (g_splat_threads)
+    return g_splat_threads;
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (unsigned)n : 1;
+#else
+  return 1;
+#endif
+}
+
+#ifdef SPLAT_WITH_THREADS
+typedef struct {
+  SplatTaskFn fn;
+  void *ctx;
+  uint64_t ntasks;
+  uint64_t next;
+  bool ok;
+  pthread_mutex_t lock;
+} SplatTaskQueue;
+
+static void *splat_task_worker(void *arg) {
+  SplatTaskQueue *q = arg;
+  for (;;) {
+    pthread_mutex_lock(&q->lock);
+    uint64_t task = q->ok && q->next < q->ntasks ? q->next++ : q->ntasks;
+    pthread_mutex_unlock(&q->lock);
+    if (task >= q->ntasks)
+      return NULL;
+    if (!q->fn(q->ctx, task)) {
+      pthread_mutex_lock(&q->lock);
+      q->ok = false; // stop handing out work; running tasks finish
+      pthread_mutex_unlock(&q->lock);
+    }
+  }
+}
+#endif
+
+// Returns false if any task failed (tasks not yet started are then skipped).
+static bool splat_parallel_for(uint64_t ntasks, SplatTaskFn fn, void *ctx) {
+#ifdef SPLAT_WITH_THREADS
+  uint64_t nthreads = splat4d_thread_count();
+  if (nthreads > ntasks)
+    nthreads = ntasks;
+  if (nthreads > 1) {
+    SplatTaskQueue q = {.fn = fn, .ctx = ctx, .ntasks = ntasks, .next = 0, .ok = true};
+    if (pthread_mutex_init(&q.lock, NULL) == 0) {
+      pthread_t *tids = malloc((size_t)(nthreads - 1) * sizeof(pthread_t));
+      uint64_t started = 0;
+      // A thread that cannot be created just leaves its share to the others.
+      while (tids && started < nthreads - 1 &&
+             pthread_create(&tids[started], NULL, splat_task_worker, &q) == 0)
+        started++;
+      splat_task_worker(&q);
+      for (uint64_t i = 0; i < started; ++i)
+        pthread_join(tids[i], NULL);
+      free(tids);
+      pthread_mutex_destroy(&q.lock);
+      return q.ok;
+    }
+  }
+#endif
+  for (uint64_t t = 0; t < ntasks; ++t)
+    if (!fn(ctx, t))
+      return false;
+  return true;
+}
+
+// --- width-tagged index storage -------------------------------------------
+
+uint64_t splat4d_index_get(const Splat4DIndex *ix, uint64_t i) {
+  switch (ix->width) {
+  case 1:
+    return ix->u8[i];
+  case 2:
+    return ix->u16[i];
+  case 4:
+    return ix->u32[i];
+  default:
+    return ix->u64[i];
+  }
+}
+
+// Store `value` at entry i, truncated to the index width (callers pick a width
+// that fits, as the header flags require).
+void splat4d_index_set(Splat4DIndex *ix, uint64_t i, uint64_t value) {
+  switch (ix->width) {
+  case 1:
+    ix->u8[i] = (uint8_t)value;
+    break;
+  case 2:
+    ix->u16[i] = (uint16_t)value;
+    break;
+  case 4:
+    ix->u32[i] = (uint32_t)value;
+    break;
+  default:
+    ix->u64[i] = value;
+    break;
+  }
+}
+
+// Allocate uninitialized storage for `total` entries of `width` bytes.
+bool splat4d_index_alloc(Splat4DIndex *ix, uint64_t total, uint8_t width) {
+  if (!ix || (width != 1 && width != 2 && width != 4 && width != 8))
+    return false;
+  ix->data = NULL;
+  ix->width = width;
+  uint64_t bytes = 0;
+  if (!checked_mul_u64(total, width, &bytes) || bytes > SIZE_MAX)
+    return false;
+  ix->data = malloc(bytes ? (size_t)bytes : 1);
+  return ix->data != NULL;
+}
+
+// Convert entries [start, start + n) of a src_width array into dst, packed at
+// dst_width. Narrowing truncates, matching what the on-disk width stores.
+#define SPLAT_INDEX_CONVERT(ST, DT)                                                              \
+  do {                                                                                           \
+    const ST *restrict s_ = (const ST *)src + start;                                             \
+    DT *restrict d_ = (DT *)dst;                                                                 \
+    for (uint64_t k = 0; k < n; k++)                                                             \
+      d_[k] = (DT)s_[k];                                                                         \
+  } while (0)
+#define SPLAT_INDEX_CONVERT_FROM(ST)                                                             \
+  do {                                                                                           \
+    switch (dst_width) {                                                                         \
+    case 1:                                                                                      \
+      SPLAT_INDEX_CONVERT(ST, uint8_t);                                                          \
+      break;                                                                                     \
+    case 2:                                                                                      \
+      SPLAT_INDEX_CONVERT(ST, uint16_t);                                                         \
+      break;                                                                                     \
+    case 4:                                                                                      \
+      SPLAT_INDEX_CONVERT(ST, uint32_t);                                                         \
+      break;                                                                                     \
+    default:                                                                                     \
+      SPLAT_INDEX_CONVERT(ST, uint64_t);                                                         \
+      break;                                                                                     \
+    }                                                                                            \
+  } while (0)
+
+static void convert_index_range(const void *src, uint8_t src_width, uint64_t start, uint64_t n,
+                                void *dst, uint8_t dst_width) {
+  if (src_width == dst_width) {
+    memcpy(dst, (const uint8_t *)src + start * src_width, (size_t)(n * src_width));
+    return;
+  }
+  switch (src_width) {
+  case 1:
+    SPLAT_INDEX_CONVERT_FROM(uint8_t);
+    break;
+  case 2:
+    SPLAT_INDEX_CONVERT_FROM(uint16_t);
+    break;
+  case 4:
+    SPLAT_INDEX_CONVERT_FROM(uint32_t);
+    break;
+  default:
+    SPLAT_INDEX_CONVERT_FROM(uint64_t);
+    break;
+  }
+}
+#undef SPLAT_INDEX_CONVERT_FROM
+#undef SPLAT_INDEX_CONVERT
+
+// Change the storage width of the first `used` of `total` allocated entries in
+// place. Widening walks backwards and narrowing forwards, so no entry is
+// overwritten before it has been read.
+bool splat4d_index_rewiden(Splat4DIndex *ix, uint64_t total, uint64_t used, uint8_t width) {
+  if (!ix || (width != 1 && width != 2 && width != 4 && width != 8) || used > total)
+    return false;
+  if (ix->width == width)
+    return true;
+  uint64_t bytes = 0;
+  if (!checked_mul_u64(total, width, &bytes) || bytes > SIZE_MAX)
+    return false;
+
+  Splat4DIndex out = {.data = ix->data, .width = width};
+  if (width > ix->width) {
+    void *grown = realloc(ix->data, bytes ? (size_t)bytes : 1);
+    if (!grown)
+      return false;
+    ix->data = grown;
+    out.data = grown;
+    for (uint64_t k = used; k-- > 0;)
+      splat4d_index_set(&out, k, splat4d_index_get(ix, k));
+  } else {
+    for (uint64_t k = 0; k < used; k++)
+      splat4d_index_set(&out, k, splat4d_index_get(ix, k));
+    void *shrunk = realloc(ix->data, bytes ? (size_t)bytes : 1);
+    if (shrunk)
+      out.data = shrunk;
+  }
+  *ix = out;
+  return true;
+}
+
+bool header_total_indices_checked(const Splat4DHeader *h, uint64_t *total) {
+  if (!h || !total)
+    return false;
+
+  uint64_t dims[4] = {h->width, h->height, h->depth, h->frames};
+  uint64_t acc = 1;
+  for (size_t i = 0; i < 4; ++i) {
+    if (dims[i] == 0)
+      return false;
+    if (!checked_mul_u64(acc, dims[i], &acc))
+      return false;
+  }
+
+  *total = acc;
+  return true;
+}
+
+uint64_t header_total_indices(const Splat4DHeader *h) {
+  return (uint64_t)h->width * (uint64_t)h->height * (uint64_t)h->depth * (uint64_t)h->frames;
+}
+
+static uint8_t get_index_width_bytes(uint32_t flags) {
+  uint32_t w = (flags >> 8) & 0x3u;
+  if (w == SPLAT_INDEX_WIDTH_8)
+    return 1;
+  if (w == SPLAT_INDEX_WIDTH_16)
+    return 2;
+  if (w == SPLAT_INDEX_WIDTH_32)
+    return 4;
+  return 8; // SPLAT_INDEX_WIDTH_64
+}
+
+// Largest index value representable in idx_width bytes.
+static uint64_t index_width_max_value(uint8_t idx_width) {
+  if (idx_width >= 8)
+    return UINT64_MAX;
+  return ((uint64_t)1 << (8u * idx_width)) - 1u;
+}
+
+// --- palette precision ---
+//
+// A Splat4D is twelve packed IEEE-754 floats in memory. On disk the palette is
+// stored at the precision selected by the header's precision field: float16
+// (2 bytes/component), float32 (4) or float64 (8). float32 is the in-memory
+// representation, so that path is a byte-for-byte copy; float64 widens exactly;
+// float16 is a lossy narrowing.
+_Static_assert(sizeof(Splat4D) == 15 * sizeof(float), "Splat4D must be 15 packed floats");
+
+// Largest palette entry (full covariance): mu_{x,y,z} + 6 covariance values +
+// mu_t + sigma_t + r,g,b,alpha.
+#define SPLAT_PALETTE_MAX_COMPONENTS 15
+
+static uint32_t splat_precision_bits(uint32_t flags) {
+  return (flags & SPLAT_FLAG_PRECISION_MASK) >> SPLAT_FLAG_PRECISION_SHIFT;
+}
+
+static size_t splat_precision_component_bytes(uint32_t flags) {
+  switch (splat_precision_bits(flags)) {
+  case 0:
+    return 2; // Float16
+  case 2:
+    return 8; // Float64
+  default:
+    return 4; // Float32 (the only other value that reaches disk)
+  }
+}
+
+static uint32_t splat_shape_bits(uint32_t flags) {
+  return (flags & SPLAT_FLAG_SPLAT_SHAPE_MASK) >> SPLAT_FLAG_SPLAT_SHAPE_SHIFT;
+}
+
+// Number of spatial spread values stored per palette entry for the splat shape:
+// isotropic = 1 (a shared sigma), axis-aligned = 3 (sigma_x/y/z), full
+// covariance = 6 (the symmetric 3x3 upper triangle). The reserved value (3) is
+// rejected by flags_supported() and never reaches here.
+static uint32_t splat_shape_cov_count(uint32_t flags) {
+  switch (splat_shape_bits(flags)) {
+  case 0:
+    return 1; // Isotropic
+  case 2:
+    return 6; // Full covariance
+  default:
+    return 3; // Axis-aligned
+  }
+}
+
+// Total floats in a palette entry: mu_{x,y,z} (3) + covariance block + mu_t +
+// sigma_t (2) + r,g,b,alpha (4).
+static uint32_t splat_palette_component_count(uint32_t flags) {
+  return 3 + splat_shape_cov_count(flags) + 2 + 4;
+}
+
+static size_t palette_entry_disk_bytes(uint32_t flags) {
+  return (size_t)splat_palette_component_count(flags) * splat_precision_component_bytes(flags);
+}
+
+// IEEE-754 binary16 <-> binary32 with round-to-nearest-even.
+static uint16_t float_to_half(float value) {
+  uint32_t x;
+  memcpy(&x, &value, sizeof x);
+  uint32_t sign = (x >> 16) & 0x8000u;
+  uint32_t exp = (x >> 23) & 0xFFu;
+  uint32_t mant = x & 0x7FFFFFu;
+
+  if (exp == 0xFF) // Inf / NaN
+    return (uint16_t)(sign | 0x7C00u | (mant ? 0x200u : 0u));
 
   int32_t e = (int32_t)exp - 127 + 15;
   if (e >= 0x1F) // overflow -> Inf
     return (uint16_t)(sign | 0x7C00u);
 
-  if (e <= 0) {
-    if (e < -10) // too small -> signed zero
-      return (uint16_t)sign;
-    mant |= 0x800000u; // restore implicit leading bit
-    uint32_t shift = (uint32_t)(14 - e);
-    uint32_t half_mant = mant >> shift;
-    uint32_t remainder = mant & ((1u << shift) - 1u);
-    uint32_t halfway = 1u << (shift - 1);
-    if (remainder > halfway || (remainder == halfway && (half_mant & 1u)))
-      half_mant++;
-    return (uint16_t)(sign | half_mant);
+  if (e <= 0) {
+    if (e < -10) // too small -> signed zero
+      return (uint16_t)sign;
+    mant |= 0x800000u; // restore implicit leading bit
+    uint32_t shift = (uint32_t)(14 - e);
+    uint32_t half_mant = mant >> shift;
+    uint32_t remainder = mant & ((1u << shift) - 1u);
+    uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half_mant & 1u)))
+      half_mant++;
+    return (uint16_t)(sign | half_mant);
+  }
+
+  uint16_t half = (uint16_t)(sign | ((uint32_t)e << 10) | (mant >> 13));
+  uint32_t remainder = mant & 0x1FFFu;
+  if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+    half++; // carry propagates into the exponent correctly
+  return half;
+}
+
+static float half_to_float(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+  uint32_t exp = (h >> 10) & 0x1Fu;
+  uint32_t mant = h & 0x3FFu;
+  uint32_t f;
+
+  if (exp == 0) {
+    if (mant == 0) {
+      f = sign;
+    } else {
+      exp = 127 - 15 + 1;
+      while (!(mant & 0x400u)) {
+        mant <<= 1;
+        exp--;
+      }
+      mant &= 0x3FFu;
+      f = sign | (exp << 23) | (mant << 13);
+    }
+  } else if (exp == 0x1F) {
+    f = sign | 0x7F800000u | (mant << 13);
+  } else {
+    exp = exp - 15 + 127;
+    f = sign | (exp << 23) | (mant << 13);
+  }
+
+  float out;
+  memcpy(&out, &f, sizeof out);
+  return out;
+}
+
+// Write/read a single float component at the given precision.
+static void store_component(uint8_t *p, float v, uint32_t precision) {
+  if (precision == 0) { // Float16
+    uint16_t h = float_to_half(v);
+    memcpy(p, &h, 2);
+  } else if (precision == 2) { // Float64
+    double d = (double)v;
+    memcpy(p, &d, 8);
+  } else { // Float32
+    memcpy(p, &v, 4);
+  }
+}
+
+static float load_component(const uint8_t *p, uint32_t precision) {
+  if (precision == 0) { // Float16
+    uint16_t h;
+    memcpy(&h, p, 2);
+    return half_to_float(h);
+  }
+  if (precision == 2) { // Float64
+    double d;
+    memcpy(&d, p, 8);
+    return (float)d;
+  }
+  float f; // Float32
+  memcpy(&f, p, 4);
+  return f;
+}
+
+// Serialize a palette entry in the spec's field order (grouped means, then the
+// shape-dependent covariance block, then temporal and color), each component at
+// the selected precision.
+static void serialize_palette_entry(const Splat4D *s, uint32_t flags, uint8_t *out) {
+  uint32_t precision = splat_precision_bits(flags);
+  uint32_t cov = splat_shape_cov_count(flags);
+  size_t cb = splat_precision_component_bytes(flags);
+
+  float comps[SPLAT_PALETTE_MAX_COMPONENTS];
+  int n = 0;
+  comps[n++] = s->mu_x;
+  comps[n++] = s->mu_y;
+  comps[n++] = s->mu_z;
+  comps[n++] = s->sigma_x; // isotropic stores this single shared sigma
+  if (cov >= 3) {
+    comps[n++] = s->sigma_y;
+    comps[n++] = s->sigma_z;
+  }
+  if (cov >= 6) {
+    comps[n++] = s->sigma_xy;
+    comps[n++] = s->sigma_xz;
+    comps[n++] = s->sigma_yz;
+  }
+  comps[n++] = s->mu_t;
+  comps[n++] = s->sigma_t;
+  comps[n++] = s->r;
+  comps[n++] = s->g;
+  comps[n++] = s->b;
+  comps[n++] = s->alpha;
+
+  for (int i = 0; i < n; ++i)
+    store_component(out + (size_t)i * cb, comps[i], precision);
+}
+
+static void deserialize_palette_entry(const uint8_t *in, uint32_t flags, Splat4D *s) {
+  uint32_t precision = splat_precision_bits(flags);
+  uint32_t cov = splat_shape_cov_count(flags);
+  size_t cb = splat_precision_component_bytes(flags);
+  uint32_t n = splat_palette_component_count(flags);
+
+  float comps[SPLAT_PALETTE_MAX_COMPONENTS];
+  for (uint32_t i = 0; i < n; ++i)
+    comps[i] = load_component(in + (size_t)i * cb, precision);
+
+  int k = 0;
+  s->mu_x = comps[k++];
+  s->mu_y = comps[k++];
+  s->mu_z = comps[k++];
+  if (cov == 1) {
+    // Isotropic: one shared spatial sigma expands to all three axes.
+    s->sigma_x = s->sigma_y = s->sigma_z = comps[k++];
+    s->sigma_xy = s->sigma_xz = s->sigma_yz = 0.0f;
+  } else {
+    s->sigma_x = comps[k++];
+    s->sigma_y = comps[k++];
+    s->sigma_z = comps[k++];
+    if (cov == 6) {
+      s->sigma_xy = comps[k++];
+      s->sigma_xz = comps[k++];
+      s->sigma_yz = comps[k++];
+    } else {
+      s->sigma_xy = s->sigma_xz = s->sigma_yz = 0.0f;
+    }
+  }
+  s->mu_t = comps[k++];
+  s->sigma_t = comps[k++];
+  s->r = comps[k++];
+  s->g = comps[k++];
+  s->b = comps[k++];
+  s->alpha = comps[k++];
+}
+
+typedef enum {
+  SPLAT_INDEX_OK = 0,
+  SPLAT_INDEX_OUT_OF_RANGE = 1, // references a palette slot that does not exist
+  SPLAT_INDEX_TOO_WIDE = 2,     // does not fit the selected index width
+} SplatIndexCheck;
+
+// Verify that every entry is a valid palette reference (< pSize) and fits the
+// selected index width, so that packing to that width will not silently
+// truncate the value. On failure *bad_pos (when non-NULL) receives the offset
+// of the first offending entry.
+static SplatIndexCheck check_index_values(const uint64_t *indices, uint64_t count, uint32_t pSize,
+                                          uint8_t idx_width, uint64_t *bad_pos) {
+  if (!indices)
+    return SPLAT_INDEX_OUT_OF_RANGE;
+
+  uint64_t max_repr = index_width_max_value(idx_width);
+  for (uint64_t i = 0; i < count; ++i) {
+    if (indices[i] >= pSize) {
+      if (bad_pos)
+        *bad_pos = i;
+      return SPLAT_INDEX_OUT_OF_RANGE;
+    }
+    if (indices[i] > max_repr) {
+      if (bad_pos)
+        *bad_pos = i;
+      return SPLAT_INDEX_TOO_WIDE;
+    }
+  }
+  return SPLAT_INDEX_OK;
+}
+
+// Stream the header and palette (everything ahead of the index) in their
+// on-disk form.
+static bool splat4d_stream_prefix(const Splat4DVideo *v, size_t chunk, Splat4DChunkFn fn,
+                                  void *ctx) {
+  // Stream the header in its on-disk form so the checksum covers exactly the
+  // bytes written to the file.
+  uint8_t header_bytes[SPLAT_HEADER_DISK_BYTES];
+  serialize_header(&v->header, header_bytes);
+  if (!splat4d_stream_block(header_bytes, sizeof header_bytes, chunk, fn, ctx))
+    return false;
+
+  size_t entry_bytes = palette_entry_disk_bytes(v->header.flags);
+  uint64_t palette_bytes_u64;
+  if (!checked_mul_u64((uint64_t)v->header.pSize, entry_bytes, &palette_bytes_u64))
+    return false;
+  if (palette_bytes_u64 > SIZE_MAX)
+    return false;
+
+  size_t palette_bytes = (size_t)palette_bytes_u64;
+  if (palette_bytes > 0) {
+    if (!v->palette.palette)
+      return false;
+    // The on-disk palette is always serialized (spec field order + per-shape
+    // covariance + precision), so build it into a buffer and stream that.
+    uint8_t *packed = malloc(palette_bytes);
+    if (!packed)
+      return false;
+    for (uint32_t i = 0; i < v->header.pSize; ++i)
+      serialize_palette_entry(&v->palette.palette[i], v->header.flags,
+                              packed + (size_t)i * entry_bytes);
+    bool ok = splat4d_stream_block(packed, palette_bytes, chunk, fn, ctx);
+    free(packed);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+// Stream the index packed at the header's index width.
+static bool splat4d_stream_index(const Splat4DVideo *v, size_t chunk, Splat4DChunkFn fn,
+                                 void *ctx) {
+  uint64_t total = header_total_indices(&v->header);
+  uint8_t idx_width = get_index_width_bytes(v->header.flags);
+  uint64_t index_bytes_u64;
+
+  if (!checked_mul_u64(total, idx_width, &index_bytes_u64))
+    return false;
+  if (index_bytes_u64 > SIZE_MAX)
+    return false;
+
+  size_t index_bytes = (size_t)index_bytes_u64;
+  if (index_bytes > 0) {
+    if (!v->index.data)
+      return false;
+
+    if (v->index.width == idx_width) {
+      if (!splat4d_stream_block(v->index.u8, index_bytes, chunk, fn, ctx))
+        return false;
+    } else {
+      // Storage width differs from the header's (e.g. a caller-built 64-bit
+      // array): convert to the on-disk width in chunks.
+      uint8_t pack_buf[SPLAT4D_STREAM_CHUNK_SIZE];
+      uint64_t items_per_chunk = SPLAT4D_STREAM_CHUNK_SIZE / idx_width;
+      uint64_t items_streamed = 0;
+
+      while (items_streamed < total) {
+        uint64_t to_pack = total - items_streamed;
+        if (to_pack > items_per_chunk)
+          to_pack = items_per_chunk;
+        convert_index_range(v->index.data, v->index.width, items_streamed, to_pack, pack_buf,
+                            idx_width);
+        if (!fn(pack_buf, (size_t)(to_pack * idx_width), ctx))
+          return false;
+        items_streamed += to_pack;
+      }
+    }
+  }
+
+  return true;
+}
+
+static bool splat4d_stream_video_payload(const Splat4DVideo *v, size_t chunk, Splat4DChunkFn fn,
+                                         void *ctx) {
+  if (!v || !fn)
+    return false;
+  return splat4d_stream_prefix(v, chunk, fn, ctx) && splat4d_stream_index(v, chunk, fn, ctx);
+}
+
+bool stream_splat4DVideo(const Splat4DVideo *v, size_t chunk, Splat4DChunkFn fn, void *ctx) {
+  return splat4d_stream_video_payload(v, chunk, fn, ctx);
+}
+
+static bool splat4d_crc32_consumer(const uint8_t *chunk, size_t n, void *ctx) {
+  crc32_t *c = ctx;
+  crc32_update(c, chunk, n);
+  return true;
+}
+
+typedef struct {
+  FILE *fp;
+  crc32_t *crc;
+} Splat4DStreamFileCtx;
+
+static bool splat4d_stream_file_consumer(const uint8_t *chunk, size_t n, void *ctx) {
+  Splat4DStreamFileCtx *state = ctx;
+  if (fwrite(chunk, 1, n, state->fp) != n)
+    return false;
+  if (state->crc)
+    crc32_update(state->crc, chunk, n);
+  return true;
+}
+
+// --- parallel checksum ------------------------------------------------------
+//
+// The CRC of a long range is split into per-task pieces of at least
+// SPLAT_CRC_TASK_BYTES, checksummed on the worker pool and merged in order
+// with splat_crc32_combine(), which gives exactly the serial CRC. Short ranges
+// and single-threaded builds take the serial path.
+#define SPLAT_CRC_TASK_BYTES ((uint64_t)4 << 20)
+
+// Pieces to split `bytes` into; 1 means checksum serially.
+static uint64_t crc_task_count(uint64_t bytes) {
+  uint64_t threads = splat4d_thread_count();
+  uint64_t n = bytes / SPLAT_CRC_TASK_BYTES;
+  if (n > threads * 4)
+    n = threads * 4;
+  return threads > 1 && n > 1 ? n : 1;
+}
+
+// One piece of a parallel index checksum: entries [first, first + count) of
+// `idx`, packed at `width`, or raw bytes when `bytes` is set.
+typedef struct {
+  const Splat4DIndex *idx;
+  const uint8_t *bytes;
+  uint8_t width;
+  uint64_t total, per_task; // entries (or bytes) overall and per task
+  uint32_t *crcs;
+} CrcJob;
+
+static uint32_t crc32_index_range(const Splat4DIndex *idx, uint8_t width, uint64_t first,
+                                  uint64_t count) {
+  crc32_t c;
+  crc32_init(&c);
+  if (idx->width == width) {
+    crc32_update(&c, idx->u8 + (size_t)(first * width), (size_t)(count * width));
+  } else {
+    uint8_t pack[SPLAT4D_STREAM_CHUNK_SIZE];
+    uint64_t step = sizeof pack / width;
+    for (uint64_t at = first; at < first + count; at += step) {
+      uint64_t n = first + count - at < step ? first + count - at : step;
+      convert_index_range(idx->data, idx->width, at, n, pack, width);
+      crc32_update(&c, pack, (size_t)(n * width));
+    }
+  }
+  return crc32_final(&c);
+}
+
+static bool crc_piece_task(void *ctx, uint64_t task) {
+  CrcJob *j = ctx;
+  uint64_t first = task * j->per_task;
+  uint64_t n = j->total - first < j->per_task ? j->total - first : j->per_task;
+  j->crcs[task] = j->bytes ? splat_crc32(j->bytes + (size_t)first, (size_t)n)
+                           : crc32_index_range(j->idx, j->width, first, n);
+  return true;
+}
+
+// Run `j` over `ntasks` pieces and fold them onto `crc` (a final CRC value) in
+// order; unit_bytes converts the job's units to bytes.
+static bool crc_run_pieces(CrcJob *j, uint64_t ntasks, uint8_t unit_bytes, uint32_t *crc) {
+  j->per_task = j->total / ntasks + (j->total % ntasks != 0);
+  ntasks = j->total / j->per_task + (j->total % j->per_task != 0);
+  j->crcs = malloc((size_t)ntasks * sizeof(uint32_t));
+  if (!j->crcs || !splat_parallel_for(ntasks, crc_piece_task, j)) {
+    free(j->crcs);
+    return false;
+  }
+  for (uint64_t k = 0; k < ntasks; ++k) {
+    uint64_t first = k * j->per_task;
+    uint64_t n = j->total - first < j->per_task ? j->total - first : j->per_task;
+    *crc = splat_crc32_combine(*crc, j->crcs[k], n * unit_bytes);
+  }
+  free(j->crcs);
+  return true;
+}
+
+// splat_crc32() over len bytes, split across the worker pool when it pays.
+uint32_t splat_crc32_parallel(const void *data, size_t len) {
+  uint64_t ntasks = crc_task_count(len);
+  uint32_t crc = 0; // CRC of the empty prefix
+  CrcJob j = {.bytes = data, .total = len};
+  if (ntasks > 1 && crc_run_pieces(&j, ntasks, 1, &crc))
+    return crc;
+  return splat_crc32(data, len);
+}
+
+// The footer checksum: header and palette serially, then the packed index,
+// split across the worker pool when it is large.
+uint32_t compute_video_checksum(const Splat4DVideo *v) {
+  if (!v)
+    return 0;
+
+  crc32_t c;
+  crc32_init(&c);
+  uint64_t total = header_total_indices(&v->header), index_bytes = 0;
+  uint8_t idx_width = get_index_width_bytes(v->header.flags);
+  uint64_t ntasks =
+      checked_mul_u64(total, idx_width, &index_bytes) ? crc_task_count(index_bytes) : 1;
+  if (ntasks > 1 && v->index.data) {
+    if (!splat4d_stream_prefix(v, SPLAT4D_STREAM_CHUNK_SIZE, splat4d_crc32_consumer, &c))
+      return 0;
+    uint32_t crc = crc32_final(&c);
+    CrcJob j = {.idx = &v->index, .width = idx_width, .total = total};
+    if (crc_run_pieces(&j, ntasks, idx_width, &crc))
+      return crc;
+    crc32_init(&c);
+  }
+  if (!stream_splat4DVideo(v, SPLAT4D_STREAM_CHUNK_SIZE, splat4d_crc32_consumer, &c))
+    return 0;
+  return crc32_final(&c);
+}
+
+// On-disk size of the frame table that sits between the palette and the index
+// section of a file using frame references (0 otherwise).
+static uint64_t frame_table_disk_bytes(const Splat4DHeader *h) {
+  if (!(h->version[3] & SPLAT_TRANSFORM_FRAME_REFS))
+    return 0;
+  return SPLAT_FRAME_TABLE_FIXED_BYTES + (uint64_t)h->frames * 4;
+}
+
+uint64_t compute_idxoffset_forward(const Splat4DHeader *h) {
+  return (uint64_t)sizeof(Splat4DHeader) +
+         (uint64_t)h->pSize * (uint64_t)palette_entry_disk_bytes(h->flags) +
+         frame_table_disk_bytes(h);
+}
+
+uint64_t compute_idxoffset_reverse(const Splat4DHeader *h) {
+  uint64_t total = header_total_indices(h);
+  uint64_t header_bytes = sizeof(Splat4DHeader);
+  uint64_t palette_bytes = (uint64_t)h->pSize * (uint64_t)palette_entry_disk_bytes(h->flags);
+  uint8_t idx_width = get_index_width_bytes(h->flags);
+  uint64_t index_bytes = total * idx_width;
+  uint64_t footer_bytes = SPLAT_FOOTER_DISK_BYTES;
+  uint64_t filesize = header_bytes + palette_bytes + index_bytes + footer_bytes;
+  uint64_t offset = filesize - (footer_bytes + index_bytes);
+  return offset;
+}
+
+bool sanity_check_idxoffset_file(FILE *fp, const Splat4DHeader *h, const Splat4DFooter *f) {
+  (void)fp;
+  return f->idxoffset == compute_idxoffset_forward(h);
+}
+
+bool check_idxoffset_file(FILE *fp, const Splat4DHeader *h, const Splat4DFooter *f) {
+  (void)fp;
+  return compute_idxoffset_forward(h) == (uint64_t)f->idxoffset;
+}
+
+// splat
+Splat4D create_splat4D(float mu_x, float sigma_x, float mu_y, float sigma_y, float mu_z,
+                       float sigma_z, float mu_t, float sigma_t, float r, float g, float b,
+                       float alpha) {
+  return (Splat4D){.mu_x = mu_x,
+                   .sigma_x = sigma_x,
+                   .mu_y = mu_y,
+                   .sigma_y = sigma_y,
+                   .mu_z = mu_z,
+                   .sigma_z = sigma_z,
+                   .mu_t = mu_t,
+                   .sigma_t = sigma_t,
+                   .r = r,
+                   .g = g,
+                   .b = b,
+                   .alpha = alpha};
+}
+
+void print_splat4D(const Splat4D *s, const uint32_t count) {
+  printf("│ ╭ Splat %010u ──────╮ │\n", count);
+  printf("│ │         mu    sigma    │ │\n");
+  printf("│ │ x %8.2f %8.2f    │ │\n", s->mu_x, s->sigma_x);
+  printf("│ │ y %8.2f %8.2f    │ │\n", s->mu_y, s->sigma_y);
+  printf("│ │ z %8.2f %8.2f    │ │\n", s->mu_z, s->sigma_z);
+  printf("│ │ t %8.2f %8.2f    │ │\n", s->mu_t, s->sigma_t);
+  if (s->sigma_xy != 0.0f || s->sigma_xz != 0.0f || s->sigma_yz != 0.0f)
+    printf("│ │ cov %6.2f %6.2f %6.2f│ │\n", s->sigma_xy, s->sigma_xz, s->sigma_yz);
+  printf("│ │ r %-18.2f   │ │\n", s->r);
+  printf("│ │ g %-18.2f   │ │\n", s->g);
+  printf("│ │ b %-18.2f   │ │\n", s->b);
+  printf("│ │ α %-18.2f   │ │\n", s->alpha);
+  printf("│ ╰────────────────────────╯ │\n");
+}
+
+// header
+Splat4DHeader create_splat4DHeader(uint32_t width, uint32_t height, uint32_t depth, uint32_t frames,
+                                   uint32_t pSize, uint32_t flags) {
+  uint32_t sanitized = sanitize_flags(flags);
+  return (Splat4DHeader){.magic = 0x3453504C,
+                         .version = {1, 1, 0, 0}, // v0.2 palette layout
+                         .width = width,
+                         .height = height,
+                         .depth = depth,
+                         .frames = frames,
+                         .pSize = pSize,
+                         .flags = sanitized};
+}
+
+static const char *precision_name(uint32_t precision) {
+  static const char *names[] = {"Float16", "Float32", "Float64", "Float128"};
+  if (precision < (sizeof names / sizeof names[0]))
+    return names[precision];
+  return "Reserved";
+}
+
+static const char *compression_name(uint32_t compression) {
+  static const char *names[] = {"None",    "Run Length Encoding",
+                                "DEFLATE", "RAR",
+                                "LZO",     "Zlib",
+                                "bzip2",   "LZMA",
+                                "ZPAQ",    "XZ",
+                                "LZ4",     "Snappy",
+                                "LZHAM",   "Brotli",
+                                "LZFSE",   "Zstd"};
+  if (compression < (sizeof names / sizeof names[0]))
+    return names[compression];
+  return "Reserved";
+}
+
+static const char *index_width_name(uint32_t width) {
+  static const char *names[] = {"1 byte", "2 bytes", "4 bytes", "8 bytes"};
+  if (width < (sizeof names / sizeof names[0]))
+    return names[width];
+  return "Reserved";
+}
+
+static const char *splat_shape_label(uint32_t shape) {
+  static const char *names[] = {"Isotropic (1σ)", "Axis-Aligned", "Full Covariance", "Reserved"};
+  if (shape < (sizeof names / sizeof names[0]))
+    return names[shape];
+  return "Reserved";
+}
+
+static const char *color_space_name(uint32_t color_space) {
+  static const char *names[] = {"sRGB",         "Linear sRGB", "OKLab",   "Display P3",
+                                "Rec.709",      "Rec.2020",    "DCI-P3",  "ACES-AP0",
+                                "ProPhoto RGB", "Rec.2100",    "CIE Lab", "CIE XYZ D65",
+                                "ACEScg-AP1",   "Rec.601",     "XYZ D50", "XYZ D65"};
+  if (color_space < (sizeof names / sizeof names[0]))
+    return names[color_space];
+  return "Reserved";
+}
+
+static const char *interpolation_name(uint32_t interpolation) {
+  static const char *names[] = {"None",
+                                "Nearest Neighbor",
+                                "Axis-Aligned",
+                                "Smooth",
+                                "Lanczos",
+                                "Gaussian",
+                                "Catmull-Rom",
+                                "NURBS",
+                                "Radial Basis Fn",
+                                "Optical Flow",
+                                "Neural",
+                                "Akima Splines",
+                                "Inverse Distance",
+                                "Fourier",
+                                "Moving Least Sq",
+                                "Cubic Hermite"};
+  if (interpolation < (sizeof names / sizeof names[0]))
+    return names[interpolation];
+  return "Reserved";
+}
+
+static void print_flag_line(FILE *out, const char *label, const char *value) {
+  if (!out || !label || !value)
+    return;
+
+  char buffer[128];
+  int written = SAFE_SNPRINTF(buffer, sizeof buffer, "  %-12s %s", label, value);
+  if (written < 0)
+    return;
+
+  size_t len = (size_t)written;
+  const size_t width = 27; // width of the content between the │ characters
+
+  fputs("│", out);
+  fputs(buffer, out);
+  if (len < width) {
+    static const char spaces[] = "                           "; // 27 spaces
+    size_t pad = width - len;
+    if (pad <= 27)
+      fputs(spaces + 27 - pad, out);
+    else
+      for (size_t i = len; i < width; ++i)
+        fputc(' ', out);
+  }
+  fputs(" │\n", out);
+}
+
+void print_flags(uint32_t flags) {
+  const char *endian = (flags & 0x1u) ? "Big-Endian" : "Little-Endian";
+  const char *sorted = (flags & 0x2u) ? "Yes" : "No";
+  uint32_t precision_bits = (flags >> 2) & 0x3u;
+  uint32_t compression_bits = (flags >> 4) & 0xFu;
+  uint32_t index_width_bits = (flags >> 8) & 0x3u;
+  uint32_t splat_shape_bits = (flags >> 10) & 0x3u;
+  uint32_t color_space_bits = (flags >> 12) & 0xFu;
+  uint32_t interpolation_bits = (flags >> 16) & 0xFu;
+  uint32_t encryption_bits = (flags >> 20) & 0xFu;
+  uint32_t metadata_bits = (flags >> 24) & 0xFFu;
+
+  char buffer[32];
+
+  print_flag_line(stdout, "endian", endian);
+  print_flag_line(stdout, "sorted", sorted);
+
+  print_flag_line(stdout, "precision", precision_name(precision_bits));
+  print_flag_line(stdout, "compression", compression_name(compression_bits));
+  print_flag_line(stdout, "index width", index_width_name(index_width_bits));
+  print_flag_line(stdout, "splat shape", splat_shape_label(splat_shape_bits));
+  print_flag_line(stdout, "color space", color_space_name(color_space_bits));
+  print_flag_line(stdout, "interp", interpolation_name(interpolation_bits));
+
+  SAFE_SNPRINTF(buffer, sizeof buffer, "0x%X", encryption_bits);
+  print_flag_line(stdout, "encryption", buffer);
+
+  SAFE_SNPRINTF(buffer, sizeof buffer, "0x%02X", metadata_bits);
+  print_flag_line(stdout, "metadata", buffer);
+}
+
+void print_splat4DHeader(const Splat4DHeader *h) {
+  printf("│  magic        0X%-10X │\n", h->magic);
+  printf("│  version      %02d.%02d.%02d-%02d  │\n", h->version[0], h->version[1], h->version[2],
+         h->version[3]);
+  printf("│  width        0X%-10X │\n", h->width);
+  printf("│  height       0X%-10X │\n", h->height);
+  printf("│  depth        0X%-10X │\n", h->depth);
+  printf("│  frames       0X%-10X │\n", h->frames);
+  printf("│  palette size 0X%-10X │\n", h->pSize);
+  printf("│  flags        0X%-10X │\n", h->flags);
+  Splat4DFlags decoded = splat4d_flags_from_raw(h->flags);
+  printf("│    endian     %-14s │\n", splat_endian_name((SplatEndian)decoded.bits.endian));
+  printf("│    sort       %-14s │\n", splat_sort_order_name((SplatSortOrder)decoded.bits.sorted));
+  printf("│    precision  %-14s │\n", splat_precision_name((SplatPrecision)decoded.bits.precision));
+  printf("│    compress   %-14s │\n",
+         splat_compression_name((SplatCompression)decoded.bits.compression));
+  printf("│    index      %-14s │\n",
+         splat_index_width_name((SplatIndexWidth)decoded.bits.index_width));
+  printf("│    shape      %-14s │\n", splat_shape_name((SplatShape)decoded.bits.splat_shape));
+  printf("│    color      %-14s │\n",
+         splat_color_space_name((SplatColorSpace)decoded.bits.color_space));
+  printf("│    interp     %-14s │\n",
+         splat_interpolation_name((SplatInterpolation)decoded.bits.interpolation));
+  print_flags(h->flags);
+  printf("│  idxs %-20" PRIu64 " │\n", header_total_indices(h));
+  printf("│                            │\n");
+}
+
+bool write_splat4DHeader(FILE *fp, const Splat4DHeader *h) {
+  if (!fp || !h)
+    return false;
+  uint8_t buf[SPLAT_HEADER_DISK_BYTES];
+  serialize_header(h, buf);
+  return fwrite(buf, 1, sizeof buf, fp) == sizeof buf;
+}
+
+bool read_splat4DHeader(FILE *fp, Splat4DHeader *h) {
+  if (!fp || !h)
+    return false;
+  uint8_t buf[SPLAT_HEADER_DISK_BYTES];
+  if (fread(buf, 1, sizeof buf, fp) != sizeof buf)
+    return false;
+  deserialize_header(buf, h);
+  return true;
+}
+
+// palette
+Splat4DPalette create_splat4DPalette(Splat4D *p) { return (Splat4DPalette){.palette = p}; }
+
+void print_splat4DPalette(const Splat4DVideo *v) {
+  if (!v->palette.palette)
+    return;
+  printf("├ Palette (%8u) ──      │\n", v->header.pSize);
+  for (uint32_t i = 0; i < v->header.pSize; i++)
+    print_splat4D(&v->palette.palette[i], i);
+}
+
+bool write_splat4DPalette(FILE *fp, const Splat4DPalette *p, uint32_t count, uint32_t flags) {
+  if (!fp || !p || !p->palette || count == 0)
+    return false;
+
+  size_t entry_bytes = palette_entry_disk_bytes(flags);
+  uint64_t bytes64 = 0;
+  if (!checked_mul_u64((uint64_t)count, (uint64_t)entry_bytes, &bytes64) || bytes64 > SIZE_MAX)
+    return false;
+  uint8_t *packed = malloc((size_t)bytes64);
+  if (!packed)
+    return false;
+  for (uint32_t i = 0; i < count; ++i)
+    serialize_palette_entry(&p->palette[i], flags, packed + (size_t)i * entry_bytes);
+  bool ok = fwrite(packed, 1, (size_t)bytes64, fp) == (size_t)bytes64;
+  free(packed);
+  return ok;
+}
+
+bool read_splat4DPalette(FILE *fp, Splat4DPalette *p, uint32_t count, uint32_t flags) {
+  if (!fp || !p || count == 0)
+    return false;
+
+  // The in-memory palette is always full-precision Splat4D; the on-disk entries
+  // may be narrower, so allocate for the former and read/convert the latter.
+  uint64_t mem_bytes = 0;
+  if (!checked_mul_u64((uint64_t)count, (uint64_t)sizeof(Splat4D), &mem_bytes) ||
+      mem_bytes > SIZE_MAX)
+    return false;
+  p->palette = malloc((size_t)mem_bytes);
+  if (!p->palette)
+    return false;
+
+  size_t entry_bytes = palette_entry_disk_bytes(flags);
+  uint64_t disk_bytes = 0;
+  if (!checked_mul_u64((uint64_t)count, (uint64_t)entry_bytes, &disk_bytes) ||
+      disk_bytes > SIZE_MAX) {
+    free(p->palette);
+    p->palette = NULL;
+    return false;
+  }
+  uint8_t *packed = malloc((size_t)disk_bytes);
+  if (!packed) {
+    free(p->palette);
+    p->palette = NULL;
+    return false;
+  }
+  if (fread(packed, 1, (size_t)disk_bytes, fp) != (size_t)disk_bytes) {
+    free(packed);
+    free(p->palette);
+    p->palette = NULL;
+    return false;
+  }
+  for (uint32_t i = 0; i < count; ++i)
+    deserialize_palette_entry(packed + (size_t)i * entry_bytes, flags, &p->palette[i]);
+  free(packed);
+  return true;
+}
+
+// index
+// Wrap a caller-owned 64-bit index array (the width used by the raw CLI index
+// files and by hand-built videos); the writer packs it to the header width.
+Splat4DIndex create_splat4DIndex(uint64_t *i) { return (Splat4DIndex){.u64 = i, .width = 8}; }
+
+void print_splat4DIndex(const Splat4DVideo *v) {
+  if (!v->index.data)
+    return;
+  uint64_t total = header_total_indices(&v->header);
+  printf("├ Index (%8" PRIu64 ") ────      │\n", total);
+  uint64_t n = total < 8 ? total : 8;
+  for (uint64_t i = 0; i < n; i++) {
+    printf("│   [%" PRIu64 "] %-20" PRIu64 " │\n", i, splat4d_index_get(&v->index, i));
+  }
+  if (total > n) {
+    printf("│   ... (%" PRIu64 " more)          │\n", total - n);
+  }
+}
+
+bool write_splat4DIndex(FILE *fp, const Splat4DIndex *i, uint64_t total, uint32_t flags) {
+  if (!fp || !i || !i->data || total == 0)
+    return false;
+
+  uint8_t idx_width = get_index_width_bytes(flags);
+  if (i->width == idx_width)
+    return fwrite(i->data, idx_width, (size_t)total, fp) == (size_t)total;
+
+  uint8_t pack_buf[SPLAT4D_STREAM_CHUNK_SIZE];
+  uint64_t items_per_chunk = SPLAT4D_STREAM_CHUNK_SIZE / idx_width;
+  uint64_t items_written = 0;
+  while (items_written < total) {
+    uint64_t to_pack = total - items_written;
+    if (to_pack > items_per_chunk)
+      to_pack = items_per_chunk;
+    convert_index_range(i->data, i->width, items_written, to_pack, pack_buf, idx_width);
+    if (fwrite(pack_buf, idx_width, (size_t)to_pack, fp) != (size_t)to_pack)
+      return false;
+    items_written += to_pack;
   }
+  return true;
+}
 
-  uint16_t half = (uint16_t)(sign | ((uint32_t)e << 10) | (mant >> 13));
-  uint32_t remainder = mant & 0x1FFFu;
-  if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
-    half++; // carry propagates into the exponent correctly
-  return half;
+// Read `total` entries into freshly allocated storage at the header's index
+// width; the on-disk bytes are the in-memory representation.
+bool read_splat4DIndex(FILE *fp, Splat4DIndex *i, uint64_t total, uint32_t flags) {
+  if (!fp || !i || total == 0)
+    return false;
+
+  uint8_t idx_width = get_index_width_bytes(flags);
+  if (!splat4d_index_alloc(i, total, idx_width)) {
+    free(i->data);
+    i->data = NULL;
+    return false;
+  }
+  if (fread(i->data, idx_width, (size_t)total, fp) != (size_t)total) {
+    free(i->data);
+    i->data = NULL;
+    return false;
+  }
+  return true;
+}
+
+// footer
+Splat4DFooter create_splat4DFooter(const Splat4DHeader *h) {
+  return (Splat4DFooter){
+      .checksum = 0,
+      .idxoffset = (uint64_t)sizeof(Splat4DHeader) +
+                   (uint64_t)h->pSize * (uint64_t)palette_entry_disk_bytes(h->flags),
+      .end = 0x4C505334 // "LPS4"
+  };
+}
+
+void print_splat4DFooter(const Splat4DFooter *f) {
+  printf("├ Footer ──────────────      │\n");
+  printf("│    checksum  0x%08X    │\n", f->checksum);
+  printf("│    idxoffset 0x%08" PRIX64 "   │\n", f->idxoffset);
+  printf("│    end       0x%08X    │\n", f->end);
+}
+
+bool write_splat4DFooter(FILE *fp, const Splat4DFooter *f) {
+  if (!fp || !f)
+    return false;
+  uint8_t buf[SPLAT_FOOTER_DISK_BYTES];
+  serialize_footer(f, buf);
+  return fwrite(buf, 1, sizeof buf, fp) == sizeof buf;
+}
+
+bool read_splat4DFooter(FILE *fp, Splat4DFooter *f) {
+  if (!fp || !f)
+    return false;
+  uint8_t buf[SPLAT_FOOTER_DISK_BYTES];
+  if (fread(buf, 1, sizeof buf, fp) != sizeof buf)
+    return false;
+  deserialize_footer(buf, f);
+  return true;
+}
+
+// video
+// Assemble a video around an index at any storage width (taking ownership as
+// create_splat4DVideo does) and checksum it.
+Splat4DVideo create_splat4DVideoWithIndex(const Splat4DHeader header, Splat4D *splats,
+                                          Splat4DIndex index) {
+  Splat4DVideo v = {.header = header,
+                    .palette = create_splat4DPalette(splats),
+                    .index = index,
+                    .footer = create_splat4DFooter(&header)};
+
+  v.footer.checksum = compute_video_checksum(&v);
+  return v;
+}
+
+Splat4DVideo create_splat4DVideo(const Splat4DHeader header, Splat4D *splats, uint64_t *idxs) {
+  return create_splat4DVideoWithIndex(header, splats, create_splat4DIndex(idxs));
+}
+
+void print_splat4DVideo(const Splat4DVideo *v) {
+  printf("╭─────── 4Splat Video ───────╮\n");
+  print_splat4DHeader(&v->header);
+  print_splat4DPalette(v);
+  print_splat4DIndex(v);
+  print_splat4DFooter(&v->footer);
+  printf("╰────────────────────────────╯\n");
+}
+
+typedef struct {
+  SplatEncoder *enc;
+  crc32_t *crc;
+} SplatEncodeIndexCtx;
+
+static bool splat4d_encode_index_consumer(const uint8_t *chunk, size_t n, void *ctx) {
+  SplatEncodeIndexCtx *state = ctx;
+  if (state->crc)
+    crc32_update(state->crc, chunk, n);
+  return splat_encoder_consume(chunk, n, state->enc);
+}
+
+// Read `len` bytes of `fp` and pass them to fn a staging buffer at a time.
+static bool splat4d_stream_file_range(FILE *fp, uint64_t len, Splat4DChunkFn fn, void *ctx) {
+  uint8_t buf[SPLAT_CODEC_BUFFER_BYTES];
+  while (len > 0) {
+    size_t step = len < sizeof buf ? (size_t)len : sizeof buf;
+    if (fread(buf, 1, step, fp) != step || !fn(buf, step, ctx))
+      return false;
+    len -= step;
+  }
+  return true;
+}
+
+// Where the writer takes the index from when it is not held in v->index (the
+// streaming encoder's spool): fill() supplies the next `n` entries, packed at
+// the header's index width, into dst. A NULL source means v->index.
+typedef struct {
+  bool (*fill)(void *ctx, uint64_t n, uint8_t *dst);
+  void *ctx;
+} SplatIndexSource;
+
+// splat4d_stream_index() for an index that comes from `src`.
+static bool splat4d_stream_index_from(const Splat4DVideo *v, const SplatIndexSource *src,
+                                      Splat4DChunkFn fn, void *ctx) {
+  if (!src)
+    return splat4d_stream_index(v, SPLAT4D_STREAM_CHUNK_SIZE, fn, ctx);
+  uint64_t total = header_total_indices(&v->header);
+  uint8_t idx_width = get_index_width_bytes(v->header.flags);
+  uint8_t pack_buf[SPLAT4D_STREAM_CHUNK_SIZE];
+  uint64_t step = SPLAT4D_STREAM_CHUNK_SIZE / idx_width;
+  for (uint64_t first = 0; first < total; first += step) {
+    uint64_t n = total - first < step ? total - first : step;
+    if (!src->fill(src->ctx, n, pack_buf) || !fn(pack_buf, (size_t)(n * idx_width), ctx))
+      return false;
+  }
+  return true;
+}
+
+// --- temporal delta index transform ----------------------------------------
+//
+// Consecutive frames of real footage mostly repeat the same palette indices.
+// The delta transform (header version[3] bit SPLAT_TRANSFORM_DELTA) XORs every
+// w*h slice of the packed index with a reference slice before the codec sees
+// it: the same slice of the previous frame, or within a run's first frame the
+// previous z-slice (so a volume is coded slice against slice). Unchanged pixels
+// become zero bytes, a skip map the codec collapses, and changed pixels keep a
+// nonzero residue. XOR works byte by byte on the packed little-endian entries,
+// so one kernel covers every index width.
+//
+// References never cross a run boundary. A run is the whole index, except in a
+// chunked file whose chunk table records a key interval: every key_frames
+// frames start a new run, so each chunk still decodes on its own. Files
+// without compression never use the transform, and the checksum covers the
+// logical (untransformed) index, as for every layout.
+#define SPLAT_DELTA_TASK_BYTES ((uint64_t)1 << 16)
+
+typedef struct {
+  uint64_t plane_bytes; // one w*h slice at the index width
+  uint64_t depth;
+  uint64_t run_planes; // planes per independent run; 0 = the whole index
+} SplatDeltaGeom;
+
+static SplatDeltaGeom splat_delta_geom(const Splat4DHeader *h, uint32_t key_frames) {
+  return (SplatDeltaGeom){
+      .plane_bytes = (uint64_t)h->width * h->height * get_index_width_bytes(h->flags),
+      .depth = h->depth,
+      .run_planes = (uint64_t)key_frames * h->depth};
+}
+
+// The plane slice `s` is coded against, if any.
+static bool delta_ref_plane(const SplatDeltaGeom *g, uint64_t s, uint64_t *ref) {
+  uint64_t r = g->run_planes ? s % g->run_planes : s;
+  if (r == 0)
+    return false;
+  *ref = r >= g->depth ? s - g->depth : s - 1;
+  return true;
+}
+
+// Undo the transform over `nplanes` whole planes in buf, the first of which is
+// plane s0 and starts a run. Planes are walked in order, so each reference is
+// decoded before it is used; tasks split the plane into byte columns.
+typedef struct {
+  const SplatDeltaGeom *g;
+  uint8_t *buf;
+  uint64_t s0, nplanes;
+} DeltaDecodeJob;
+
+static bool delta_decode_task(void *ctx, uint64_t task) {
+  const DeltaDecodeJob *j = ctx;
+  uint64_t P = j->g->plane_bytes, c0 = task * SPLAT_DELTA_TASK_BYTES;
+  size_t n = (size_t)(P - c0 < SPLAT_DELTA_TASK_BYTES ? P - c0 : SPLAT_DELTA_TASK_BYTES);
+  for (uint64_t s = 1, ref; s < j->nplanes; ++s) {
+    if (!delta_ref_plane(j->g, j->s0 + s, &ref))
+      continue;
+    uint8_t *cur = j->buf + (size_t)(s * P + c0);
+    const uint8_t *prev = j->buf + (size_t)((ref - j->s0) * P + c0);
+    for (size_t k = 0; k < n; ++k)
+      cur[k] ^= prev[k];
+  }
+  return true;
+}
+
+// Invert the transform of planes [s0, s0 + nplanes) in place when `h` says the
+// index carries it.
+static bool delta_decode_planes(const Splat4DHeader *h, uint32_t key_frames, uint8_t *buf,
+                                uint64_t s0, uint64_t nplanes) {
+  if (!(h->version[3] & SPLAT_TRANSFORM_DELTA))
+    return true;
+  SplatDeltaGeom g = splat_delta_geom(h, key_frames);
+  if (g.plane_bytes == 0)
+    return true;
+  DeltaDecodeJob j = {.g = &g, .buf = buf, .s0 = s0, .nplanes = nplanes};
+  return splat_parallel_for(g.plane_bytes / SPLAT_DELTA_TASK_BYTES +
+                                (g.plane_bytes % SPLAT_DELTA_TASK_BYTES != 0),
+                            delta_decode_task, &j);
+}
+
+// An index source that applies the transform on the way to the writer. It
+// pulls packed entries from `inner` (or v->index), folds them into `crc`
+// before they are transformed, and keeps the raw bytes of the planes that
+// later planes refer to in a ring of one frame (one plane for a volume).
+typedef struct {
+  SplatDeltaGeom g;
+  const Splat4DIndex *index;
+  const SplatIndexSource *inner;
+  uint8_t width;
+  crc32_t *crc;
+  uint8_t *ring;
+  uint64_t ring_planes;
+  uint64_t next; // entries produced so far
+} DeltaSource;
+
+static bool delta_source_init(DeltaSource *d, const Splat4DVideo *v, const SplatIndexSource *inner,
+                              uint32_t key_frames, crc32_t *crc) {
+  *d = (DeltaSource){.g = splat_delta_geom(&v->header, key_frames),
+                     .index = &v->index,
+                     .inner = inner,
+                     .width = get_index_width_bytes(v->header.flags),
+                     .crc = crc,
+                     .ring_planes = v->header.frames > 1 ? v->header.depth : 1};
+  uint64_t ring_bytes = 0;
+  if (!checked_mul_u64(d->g.plane_bytes, d->ring_planes, &ring_bytes) || ring_bytes > SIZE_MAX)
+    return false;
+  d->ring = malloc(ring_bytes ? (size_t)ring_bytes : 1);
+  return d->ring != NULL;
+}
+
+static bool delta_fill(void *ctx, uint64_t n, uint8_t *dst) {
+  DeltaSource *d = ctx;
+  if (d->inner) {
+    if (!d->inner->fill(d->inner->ctx, n, dst))
+      return false;
+  } else {
+    convert_index_range(d->index->data, d->index->width, d->next, n, dst, d->width);
+  }
+  uint64_t len = n * d->width, P = d->g.plane_bytes;
+  if (d->crc)
+    crc32_update(d->crc, dst, (size_t)len);
+  uint64_t pos = d->next * d->width;
+  for (uint64_t i = 0; i < len;) {
+    uint64_t s = (pos + i) / P, o = (pos + i) % P, ref = 0;
+    size_t run = (size_t)(P - o < len - i ? P - o : len - i);
+    uint8_t *p = dst + (size_t)i;
+    uint8_t *keep = d->ring + (size_t)((s % d->ring_planes) * P + o);
+    if (delta_ref_plane(&d->g, s, &ref)) {
+      const uint8_t *prev = d->ring + (size_t)((ref % d->ring_planes) * P + o);
+      for (size_t k = 0; k < run; ++k) {
+        uint8_t raw = p[k];
+        p[k] = raw ^ prev[k];
+        keep[k] = raw;
+      }
+    } else {
+      memcpy(keep, p, run);
+    }
+    i += run;
+  }
+  d->next += n;
+  return true;
+}
+
+// --- frame references -------------------------------------------------------
+//
+// Static shots repeat whole frames byte for byte. With the frame-reference
+// transform (header version[3] bit SPLAT_TRANSFORM_FRAME_REFS) only the first
+// occurrence of each distinct frame index is stored, and a frame table between
+// the palette and the index section maps every frame to its stored slot:
+//
+//   "FRMS" | nstored u32 | slot u32[frames]
+//
+// Slots are numbered in order of first appearance: each frame either repeats
+// an earlier slot or takes the next one. Everything after the table (layout,
+// chunk table, delta runs) describes the index of the nstored stored frames,
+// so a single frame still decodes on its own. The checksum covers the logical
+// index; writer and reader assemble it from per-slot CRCs with
+// splat_crc32_combine(), so a repeat is never checksummed twice. Like the delta
+// transform, frame references are only used with compression.
+//
+// Repeats are found by checksumming every unit (a frame here, a slice in
+// video_to_slices) in parallel, sorting the units by CRC and confirming each
+// candidate with a byte comparison, so a CRC collision never merges two units.
+
+// Compare units a and b; false on an I/O error.
+typedef bool (*SplatUnitsEqualFn)(void *ctx, uint64_t a, uint64_t b, bool *equal);
+
+typedef struct {
+  const Splat4DIndex *idx;
+  uint8_t width;
+  uint64_t unit_entries;
+  uint32_t *crcs;
+} UnitCrcJob;
+
+static bool unit_crc_task(void *ctx, uint64_t u) {
+  const UnitCrcJob *j = ctx;
+  j->crcs[u] = crc32_index_range(j->idx, j->width, u * j->unit_entries, j->unit_entries);
+  return true;
+}
+
+// crcs[u] = CRC of entries [u * unit_entries, (u + 1) * unit_entries) of idx,
+// packed at `width`.
+static bool splat_unit_crcs(const Splat4DIndex *idx, uint8_t width, uint64_t unit_entries,
+                            uint64_t nunits, uint32_t *crcs) {
+  UnitCrcJob j = {.idx = idx, .width = width, .unit_entries = unit_entries, .crcs = crcs};
+  return splat_parallel_for(nunits, unit_crc_task, &j);
+}
+
+typedef struct {
+  uint32_t crc;
+  uint64_t unit;
+} UnitKey;
+
+static int unit_key_cmp(const void *a, const void *b) {
+  const UnitKey *x = a, *y = b;
+  if (x->crc != y->crc)
+    return x->crc < y->crc ? -1 : 1;
+  return (x->unit > y->unit) - (x->unit < y->unit);
+}
+
+// ref[u] = the first unit whose contents equal unit u's (u itself for a unit
+// seen for the first time).
+static bool splat_match_units(const uint32_t *crcs, uint64_t n, SplatUnitsEqualFn same, void *ctx,
+                              uint64_t *ref) {
+  UnitKey *keys =
+      n > SIZE_MAX / sizeof(UnitKey) ? NULL : malloc((size_t)(n ? n : 1) * sizeof *keys);
+  if (!keys)
+    return false;
+  for (uint64_t u = 0; u < n; ++u) {
+    keys[u] = (UnitKey){.crc = crcs[u], .unit = u};
+    ref[u] = u;
+  }
+  qsort(keys, (size_t)n, sizeof *keys, unit_key_cmp);
+  bool ok = true;
+  for (uint64_t g = 0; ok && g < n;) {
+    uint64_t e = g + 1;
+    while (e < n && keys[e].crc == keys[g].crc)
+      ++e;
+    // A group holds the units of one CRC in unit order; each is compared with
+    // the group's earlier first occurrences.
+    for (uint64_t i = g + 1; ok && i < e; ++i) {
+      uint64_t u = keys[i].unit;
+      for (uint64_t k = g; ok && k < i && ref[u] == u; ++k) {
+        uint64_t r = keys[k].unit;
+        bool equal = false;
+        if (ref[r] == r && (ok = same(ctx, r, u, &equal)) && equal)
+          ref[u] = r;
+      }
+    }
+    g = e;
+  }
+  free(keys);
+  return ok;
+}
+
+typedef struct {
+  const Splat4DIndex *idx;
+  uint64_t unit_entries;
+} IndexUnits;
+
+static bool index_units_equal(void *ctx, uint64_t a, uint64_t b, bool *equal) {
+  const IndexUnits *u = ctx;
+  size_t len = (size_t)(u->unit_entries * u->idx->width);
+  *equal = memcmp(u->idx->u8 + (size_t)a * len, u->idx->u8 + (size_t)b * len, len) == 0;
+  return true;
+}
+
+// Find the repeated units of an in-memory index: crcs[u] receives each unit's
+// CRC at `width` and ref[u] its first occurrence.
+static bool splat_find_repeats(const Splat4DIndex *idx, uint8_t width, uint64_t unit_entries,
+                               uint64_t nunits, uint32_t *crcs, uint64_t *ref) {
+  IndexUnits units = {.idx = idx, .unit_entries = unit_entries};
+  return splat_unit_crcs(idx, width, unit_entries, nunits, crcs) &&
+         splat_match_units(crcs, nunits, index_units_equal, &units, ref);
+}
+
+typedef struct {
+  uint32_t *slot; // stored slot of each frame
+  uint32_t *crc;  // CRC of each stored slot's packed index (writer side)
+  uint32_t nstored;
+} SplatFrameTable;
+
+static void frame_table_free(SplatFrameTable *ft) {
+  free(ft->slot);
+  free(ft->crc);
+  ft->slot = ft->crc = NULL;
+}
+
+// Number the first occurrences in `ref` as stored slots. `crcs` holds one CRC
+// per frame; on success it is compacted in place to one per slot and owned by
+// the table as ft->crc.
+static bool frame_table_from_refs(SplatFrameTable *ft, const uint64_t *ref, uint32_t *crcs,
+                                  uint32_t frames) {
+  ft->slot = malloc((size_t)frames * sizeof(uint32_t));
+  if (!ft->slot)
+    return false;
+  ft->crc = crcs;
+  ft->nstored = 0;
+  for (uint32_t t = 0; t < frames; ++t) {
+    if (ref[t] == t) {
+      crcs[ft->nstored] = crcs[t];
+      ft->slot[t] = ft->nstored++;
+    } else {
+      ft->slot[t] = ft->slot[ref[t]];
+    }
+  }
+  return true;
+}
+
+// Frame table of the index held in v->index.
+static bool frame_table_for_video(const Splat4DVideo *v, SplatFrameTable *ft) {
+  const Splat4DHeader *h = &v->header;
+  uint64_t frame_entries = (uint64_t)h->width * h->height * h->depth;
+  uint64_t *ref = malloc((size_t)h->frames * sizeof(uint64_t));
+  uint32_t *crcs = malloc((size_t)h->frames * sizeof(uint32_t));
+  *ft = (SplatFrameTable){.slot = NULL};
+  bool ok = ref && crcs &&
+            splat_find_repeats(&v->index, get_index_width_bytes(h->flags), frame_entries,
+                               h->frames, crcs, ref) &&
+            frame_table_from_refs(ft, ref, crcs, h->frames);
+  free(ref);
+  if (!ok)
+    free(crcs);
+  return ok;
+}
+
+// The header as the index section sees it: with frame references it holds
+// only the stored frames.
+static Splat4DHeader stored_index_header(const Splat4DHeader *h, const SplatFrameTable *ft) {
+  Splat4DHeader sh = *h;
+  if (h->version[3] & SPLAT_TRANSFORM_FRAME_REFS)
+    sh.frames = ft->nstored;
+  return sh;
+}
+
+// Fold the CRC of every frame's packed index onto `crc` (the CRC of everything
+// ahead of the index), given one CRC per stored slot.
+static uint32_t frame_table_fold_crc(uint32_t crc, const SplatFrameTable *ft,
+                                     const uint32_t *slot_crc, uint32_t frames,
+                                     uint64_t frame_bytes) {
+  for (uint32_t t = 0; t < frames; ++t)
+    crc = splat_crc32_combine(crc, slot_crc[ft->slot[t]], frame_bytes);
+  return crc;
+}
+
+static bool write_frame_table(FILE *fp, const SplatFrameTable *ft, uint32_t frames) {
+  uint8_t buf[SPLAT4D_STREAM_CHUNK_SIZE];
+  store_u32be(buf, SPLAT_FRAME_TABLE_TAG);
+  store_u32le(buf + 4, ft->nstored);
+  if (fwrite(buf, 1, SPLAT_FRAME_TABLE_FIXED_BYTES, fp) != SPLAT_FRAME_TABLE_FIXED_BYTES)
+    return false;
+  uint32_t step = sizeof buf / 4;
+  for (uint32_t t0 = 0; t0 < frames; t0 += step) {
+    uint32_t n = frames - t0 < step ? frames - t0 : step;
+    for (uint32_t k = 0; k < n; ++k)
+      store_u32le(buf + k * 4, ft->slot[t0 + k]);
+    if (fwrite(buf, 4, n, fp) != n)
+      return false;
+  }
+  return true;
+}
+
+// Read the frame table of `h` from `offset` and check that it numbers its
+// slots in order of first appearance and stores at least one frame.
+static bool read_frame_table(FILE *fp, const Splat4DHeader *h, uint64_t offset,
+                             uint64_t filesize, SplatFrameTable *ft) {
+  *ft = (SplatFrameTable){.slot = NULL};
+  uint64_t bytes = frame_table_disk_bytes(h);
+  uint8_t buf[SPLAT4D_STREAM_CHUNK_SIZE];
+  if (offset + bytes + SPLAT_FOOTER_DISK_BYTES > filesize ||
+      fseek(fp, (long)offset, SEEK_SET) != 0 ||
+      fread(buf, 1, SPLAT_FRAME_TABLE_FIXED_BYTES, fp) != SPLAT_FRAME_TABLE_FIXED_BYTES ||
+      load_u32be(buf) != SPLAT_FRAME_TABLE_TAG) {
+    LOG_ERROR("❌ Missing frame table\n");
+    return false;
+  }
+  uint32_t nstored = load_u32le(buf + 4), next = 0;
+  ft->slot = malloc((size_t)h->frames * sizeof(uint32_t));
+  if (!ft->slot)
+    return false;
+  uint32_t step = sizeof buf / 4;
+  bool ok = true;
+  for (uint32_t t0 = 0; ok && t0 < h->frames; t0 += step) {
+    uint32_t n = h->frames - t0 < step ? h->frames - t0 : step;
+    ok = fread(buf, 4, n, fp) == n;
+    for (uint32_t k = 0; ok && k < n; ++k) {
+      uint32_t s = load_u32le(buf + k * 4);
+      ok = s <= next;
+      next += s == next;
+      ft->slot[t0 + k] = s;
+    }
+  }
+  if (!ok || nstored != next) {
+    LOG_ERROR("❌ Invalid frame table\n");
+    frame_table_free(ft);
+    return false;
+  }
+  ft->nstored = nstored;
+  return true;
+}
+
+// Spread the stored frames at the front of idx (nstored frames, storage sized
+// for them) over all frames. Every slot lies at or before the frame that uses
+// it, so walking the frames backwards never overwrites a slot still needed.
+static bool expand_frame_refs(Splat4DIndex *idx, const Splat4DHeader *h,
+                              const SplatFrameTable *ft) {
+  uint64_t frame_bytes = (uint64_t)h->width * h->height * h->depth * idx->width;
+  if (frame_bytes == 0)
+    return true;
+  uint8_t *grown = realloc(idx->data, (size_t)(frame_bytes * h->frames));
+  if (!grown)
+    return false;
+  idx->u8 = grown;
+  for (uint32_t t = h->frames; t-- > 0;)
+    if (ft->slot[t] != t)
+      memcpy(grown + (size_t)(t * frame_bytes), grown + (size_t)(ft->slot[t] * frame_bytes),
+             (size_t)frame_bytes);
+  return true;
+}
+
+// An index source that passes on only the stored frames of `inner` (or
+// v->index), skipping every repeat.
+typedef struct {
+  const Splat4DIndex *index;
+  const SplatIndexSource *inner;
+  const SplatFrameTable *ft;
+  uint8_t width;
+  uint64_t frame_entries;
+  uint32_t frames;
+  uint32_t t, seen; // current frame and stored frames reached so far
+  uint64_t pos;     // entries of frame t produced
+} FrameRefSource;
+
+// Drop the next `n` entries of an inner source.
+static bool source_skip(const SplatIndexSource *src, uint8_t width, uint64_t n) {
+  uint8_t scratch[SPLAT4D_STREAM_CHUNK_SIZE];
+  uint64_t step = sizeof scratch / width;
+  for (uint64_t done = 0; done < n; done += step)
+    if (!src->fill(src->ctx, n - done < step ? n - done : step, scratch))
+      return false;
+  return true;
+}
+
+static bool frame_ref_fill(void *ctx, uint64_t n, uint8_t *dst) {
+  FrameRefSource *f = ctx;
+  for (uint64_t done = 0; done < n;) {
+    if (f->pos == 0) {
+      for (; f->t < f->frames && f->ft->slot[f->t] != f->seen; ++f->t)
+        if (f->inner && !source_skip(f->inner, f->width, f->frame_entries))
+          return false;
+      if (f->t >= f->frames)
+        return false;
+      f->seen++;
+    }
+    uint64_t step = f->frame_entries - f->pos < n - done ? f->frame_entries - f->pos : n - done;
+    uint8_t *out = dst + (size_t)(done * f->width);
+    if (f->inner) {
+      if (!f->inner->fill(f->inner->ctx, step, out))
+        return false;
+    } else {
+      convert_index_range(f->index->data, f->index->width,
+                          (uint64_t)f->t * f->frame_entries + f->pos, step, out, f->width);
+    }
+    done += step;
+    f->pos += step;
+    if (f->pos == f->frame_entries) {
+      f->pos = 0;
+      f->t++;
+    }
+  }
+  return true;
+}
+
+// Compress the index at the header's index width and write the compressed
+// bytes, folding the packed bytes into `crc` (when given) on the way. Used for the on-disk
+// index section whenever the compression field is not None. Streaming codecs
+// pack, checksum and compress one stream chunk at a time, so nothing beyond the
+// index storage and the codec's buffers is held. LZ4 compresses the whole
+// packed index at once: storage already at the header width is used in place,
+// otherwise each piece is checksummed right after it is packed.
+static bool write_index_compressed(FILE *fp, const Splat4DVideo *v, const SplatIndexSource *src,
+                                   uint32_t codec, crc32_t *crc) {
+  uint64_t total = header_total_indices(&v->header);
+  uint8_t idx_width = get_index_width_bytes(v->header.flags);
+  uint64_t packed64;
+  if (!checked_mul_u64(total, idx_width, &packed64) || packed64 > SIZE_MAX)
+    return false;
+  size_t packed_len = (size_t)packed64;
+
+  if (splat_codec_streams(codec)) {
+    SplatEncoder enc;
+    Splat4DStreamFileCtx out = {.fp = fp, .crc = NULL};
+    SplatEncodeIndexCtx ctx = {.enc = &enc, .crc = crc};
+    bool ok = splat_encoder_begin(&enc, codec, packed64, splat4d_stream_file_consumer, &out) &&
+              splat4d_stream_index_from(v, src, splat4d_encode_index_consumer, &ctx) &&
+              splat_encoder_finish(&enc);
+    splat_encoder_end(&enc);
+    return ok;
+  }
+
+  const uint8_t *packed = v->index.u8;
+  uint8_t *owned = NULL;
+  if (src) {
+    owned = malloc(packed_len ? packed_len : 1);
+    if (!owned || !src->fill(src->ctx, total, owned)) {
+      free(owned);
+      return false;
+    }
+    if (crc)
+      crc32_update(crc, owned, packed_len);
+    packed = owned;
+  } else if (v->index.width != idx_width) {
+    owned = malloc(packed_len ? packed_len : 1);
+    if (!owned)
+      return false;
+    uint64_t step = SPLAT4D_STREAM_CHUNK_SIZE / idx_width;
+    for (uint64_t first = 0; first < total; first += step) {
+      uint64_t n = total - first < step ? total - first : step;
+      uint8_t *dst = owned + (size_t)(first * idx_width);
+      convert_index_range(v->index.data, v->index.width, first, n, dst, idx_width);
+      crc32_update(crc, dst, (size_t)(n * idx_width));
+    }
+    packed = owned;
+  } else {
+    crc32_update(crc, packed, packed_len);
+  }
+
+  size_t clen = 0;
+  uint8_t *comp = splat_compress(codec, packed, packed_len, &clen);
+  free(owned);
+  if (!comp)
+    return false;
+
+  bool ok = fwrite(comp, 1, clen, fp) == clen;
+  free(comp);
+  return ok;
 }
 
-static float half_to_float(uint16_t h) {
-  uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
-  uint32_t exp = (h >> 10) & 0x1Fu;
-  uint32_t mant = h & 0x3FFu;
-  uint32_t f;
+// Read `comp_len` compressed bytes and decompress them straight into freshly
+// allocated index storage at the header's index width. Streaming codecs read
+// the file a buffer at a time; LZ4 needs the whole compressed block in memory.
+static bool read_index_compressed(FILE *fp, Splat4DIndex *idx, uint64_t total, uint32_t flags,
+                                  size_t comp_len, uint32_t codec) {
+  uint8_t idx_width = get_index_width_bytes(flags);
+  uint64_t packed64;
+  if (!checked_mul_u64(total, idx_width, &packed64) || packed64 > SIZE_MAX)
+    return false;
+  size_t packed_len = (size_t)packed64;
 
-  if (exp == 0) {
-    if (mant == 0) {
-      f = sign;
-    } else {
-      exp = 127 - 15 + 1;
-      while (!(mant & 0x400u)) {
-        mant <<= 1;
-        exp--;
-      }
-      mant &= 0x3FFu;
-      f = sign | (exp << 23) | (mant << 13);
+  bool ok = false;
+  if (splat_codec_streams(codec)) {
+    if (splat4d_index_alloc(idx, total, idx_width)) {
+      SplatDecoder dec;
+      ok = splat_decoder_begin(&dec, codec, idx->u8, packed_len) &&
+           splat4d_stream_file_range(fp, comp_len, splat_decoder_consume, &dec) &&
+           splat_decoder_finish(&dec);
+      splat_decoder_end(&dec);
     }
-  } else if (exp == 0x1F) {
-    f = sign | 0x7F800000u | (mant << 13);
   } else {
-    exp = exp - 15 + 127;
-    f = sign | (exp << 23) | (mant << 13);
+    uint8_t *cbuf = malloc(comp_len ? comp_len : 1);
+    ok = cbuf && fread(cbuf, 1, comp_len, fp) == comp_len &&
+         splat4d_index_alloc(idx, total, idx_width) &&
+         splat_decompress(codec, cbuf, comp_len, idx->u8, packed_len);
+    free(cbuf);
   }
-
-  float out;
-  memcpy(&out, &f, sizeof out);
-  return out;
+  if (!ok) {
+    free(idx->data);
+    idx->data = NULL;
+    return false;
+  }
+  return true;
 }
 
-// Write/read a single float component at the given precision.
-static void store_component(uint8_t *p, float v, uint32_t precision) {
-  if (precision == 0) { // Float16
-    uint16_t h = float_to_half(v);
-    memcpy(p, &h, 2);
-  } else if (precision == 2) { // Float64
-    double d = (double)v;
-    memcpy(p, &d, 8);
-  } else { // Float32
-    memcpy(p, &v, 4);
+// Reject headers this reader cannot interpret before sizing anything from them.
+static bool header_readable(const Splat4DHeader *h) {
+  if (h->magic != 0x3453504C) {
+    LOG_ERROR("❌ Unsupported format\n");
+    return false;
+  }
+  if (h->version[0] != 1) {
+    LOG_ERROR("❌ Unsupported version\n");
+    return false;
+  }
+  if (h->version[2] != SPLAT_LAYOUT_MONOLITHIC && h->version[2] != SPLAT_LAYOUT_CHUNKED) {
+    LOG_ERROR("❌ Unsupported index layout %u\n", (unsigned)h->version[2]);
+    return false;
+  }
+  if ((h->version[3] & ~(SPLAT_TRANSFORM_DELTA | SPLAT_TRANSFORM_FRAME_REFS)) != 0 ||
+      (h->version[3] != SPLAT_TRANSFORM_NONE && (h->flags & SPLAT_FLAG_COMPRESSION_MASK) == 0)) {
+    LOG_ERROR("❌ Unsupported index transform %u\n", (unsigned)h->version[3]);
+    return false;
+  }
+  if (!flags_supported(h->flags))
+    return false;
+  if (h->pSize == 0) {
+    LOG_ERROR("❌ Invalid palette size\n");
+    return false;
   }
+  return true;
 }
 
-static float load_component(const uint8_t *p, uint32_t precision) {
-  if (precision == 0) { // Float16
-    uint16_t h;
-    memcpy(&h, p, 2);
-    return half_to_float(h);
+// Size of the file behind `fp`, leaving the position unchanged.
+static bool splat_file_size(FILE *fp, uint64_t *size) {
+  long pos = ftell(fp);
+  if (pos < 0 || fseek(fp, 0, SEEK_END) != 0)
+    return false;
+  long end = ftell(fp);
+  if (end < 0 || fseek(fp, pos, SEEK_SET) != 0)
+    return false;
+  *size = (uint64_t)end;
+  return true;
+}
+
+// --- chunked index layout ---------------------------------------------------
+//
+// A monolithic compressed index has to be decompressed in full to reach any
+// frame. The chunked layout splits the packed index into runs of
+// entries_per_chunk entries, compresses each one on its own with the header's
+// codec, and follows them with a chunk table:
+//
+//   "CHNK" | key_frames u32 | entries_per_chunk u64 | nchunks u64 |
+//   offsets u64[nchunks + 1]
+//
+// key_frames is the run length of the delta transform in frames (0 = one run);
+// it is written as 0 for an untransformed index.
+// Chunk c occupies [offsets[c], offsets[c + 1]) relative to the start of the
+// index section, and offsets[nchunks] is where the table begins. The footer's
+// idxoffset holds the table's absolute file offset. The checksum still covers
+// the logical payload, so a file's CRC does not depend on its layout.
+typedef struct {
+  uint64_t index_start; // absolute offset of the index section
+  uint64_t table_start; // absolute offset of the chunk table
+  uint64_t entries_per_chunk;
+  uint64_t nchunks;
+  uint32_t key_frames;
+} Splat4DChunkLayout;
+
+static uint64_t chunk_entry_count(const Splat4DChunkLayout *l, uint64_t total, uint64_t c) {
+  uint64_t first = c * l->entries_per_chunk;
+  uint64_t left = total - first;
+  return left < l->entries_per_chunk ? left : l->entries_per_chunk;
+}
+
+// Locate and validate the chunk table of a file whose index section starts at
+// index_start. The table must end exactly at the footer and describe exactly
+// `total` entries, so its size is bounded by the file rather than the header.
+static bool read_chunk_layout(FILE *fp, const Splat4DHeader *h, uint64_t total,
+                              uint64_t index_start, uint64_t filesize, Splat4DChunkLayout *l) {
+  Splat4DFooter f;
+  if (filesize < index_start + SPLAT_FOOTER_DISK_BYTES + SPLAT_CHUNK_TABLE_FIXED_BYTES ||
+      fseek(fp, (long)(filesize - SPLAT_FOOTER_DISK_BYTES), SEEK_SET) != 0 ||
+      !read_splat4DFooter(fp, &f) || f.end != 0x4C505334) {
+    LOG_ERROR("❌ Invalid chunked index footer\n");
+    return false;
   }
-  if (precision == 2) { // Float64
-    double d;
-    memcpy(&d, p, 8);
-    return (float)d;
+  uint64_t table_end = filesize - SPLAT_FOOTER_DISK_BYTES;
+  uint8_t fixed[SPLAT_CHUNK_TABLE_FIXED_BYTES];
+  if (f.idxoffset < index_start || f.idxoffset > table_end - SPLAT_CHUNK_TABLE_FIXED_BYTES ||
+      fseek(fp, (long)f.idxoffset, SEEK_SET) != 0 ||
+      fread(fixed, 1, sizeof fixed, fp) != sizeof fixed ||
+      load_u32be(fixed) != SPLAT_CHUNK_TABLE_TAG) {
+    LOG_ERROR("❌ Missing chunk table\n");
+    return false;
   }
-  float f; // Float32
-  memcpy(&f, p, 4);
-  return f;
+  l->index_start = index_start;
+  l->table_start = f.idxoffset;
+  l->key_frames = load_u32le(fixed + 4);
+  l->entries_per_chunk = load_u64le(fixed + 8);
+  l->nchunks = load_u64le(fixed + 16);
+
+  uint64_t epc = l->entries_per_chunk, chunk_bytes = 0, table_bytes = 0;
+  uint8_t idx_width = get_index_width_bytes(h->flags);
+  if (epc == 0 || l->nchunks != total / epc + (total % epc != 0) ||
+      !checked_mul_u64(epc < total ? epc : total, idx_width, &chunk_bytes) ||
+      chunk_bytes > SPLAT_MAX_COMPRESSED_INDEX_BYTES || l->nchunks >= UINT64_MAX / 8 ||
+      !checked_mul_u64(l->nchunks + 1, 8, &table_bytes) ||
+      table_bytes != table_end - l->table_start - SPLAT_CHUNK_TABLE_FIXED_BYTES) {
+    LOG_ERROR("❌ Invalid chunk table\n");
+    return false;
+  }
+  return true;
 }
 
-// Serialize a palette entry in the spec's field order (grouped means, then the
-// shape-dependent covariance block, then temporal and color), each component at
-// the selected precision.
-static void serialize_palette_entry(const Splat4D *s, uint32_t flags, uint8_t *out) {
-  uint32_t precision = splat_precision_bits(flags);
-  uint32_t cov = splat_shape_cov_count(flags);
-  size_t cb = splat_precision_component_bytes(flags);
+// Read offsets[first .. first + count) of the chunk table, checking that they
+// are ordered and stay inside the chunk area.
+static bool read_chunk_offsets(FILE *fp, const Splat4DChunkLayout *l, uint64_t first,
+                               uint64_t count, uint64_t *out) {
+  uint64_t pos = l->table_start + SPLAT_CHUNK_TABLE_FIXED_BYTES + first * 8;
+  if (fseek(fp, (long)pos, SEEK_SET) != 0)
+    return false;
+  uint64_t limit = l->table_start - l->index_start;
+  uint8_t buf[8];
+  for (uint64_t k = 0; k < count; ++k) {
+    if (fread(buf, 1, sizeof buf, fp) != sizeof buf)
+      return false;
+    out[k] = load_u64le(buf);
+    if (out[k] > limit || (k > 0 && out[k] < out[k - 1])) {
+      LOG_ERROR("❌ Invalid chunk offsets\n");
+      return false;
+    }
+  }
+  return true;
+}
 
-  float comps[SPLAT_PALETTE_MAX_COMPONENTS];
-  int n = 0;
-  comps[n++] = s->mu_x;
-  comps[n++] = s->mu_y;
-  comps[n++] = s->mu_z;
-  comps[n++] = s->sigma_x; // isotropic stores this single shared sigma
-  if (cov >= 3) {
-    comps[n++] = s->sigma_y;
-    comps[n++] = s->sigma_z;
+// Chunks are (de)compressed a window at a time: one window holds this many
+// chunks per worker, which keeps every thread busy while bounding the memory
+// held for compressed bytes.
+#define SPLAT_CHUNK_WINDOW_PER_THREAD 4
+
+static uint64_t chunk_window_size(void) {
+  return (uint64_t)splat4d_thread_count() * SPLAT_CHUNK_WINDOW_PER_THREAD;
+}
+
+// One window of a range decode: chunks c0 .. c0 + n - 1, whose stored bytes
+// (offs[k] .. offs[k + 1] relative to the index section) have been read into
+// comp starting at offs[0].
+typedef struct {
+  const Splat4DChunkLayout *l;
+  uint32_t codec;
+  uint8_t idx_width;
+  uint64_t total, first, count;
+  uint64_t c0;
+  const uint64_t *offs;
+  const uint8_t *comp;
+  uint8_t *dst;
+} ChunkDecodeJob;
+
+// Decode one chunk of the window. Chunks wholly inside the requested range are
+// decoded in place; partial ones go through a scratch buffer of their own.
+static bool decode_index_chunk(void *ctx, uint64_t k) {
+  const ChunkDecodeJob *j = ctx;
+  uint64_t c = j->c0 + k, cfirst = c * j->l->entries_per_chunk;
+  uint64_t cn = chunk_entry_count(j->l, j->total, c);
+  size_t raw_len = (size_t)(cn * j->idx_width);
+  const uint8_t *in = j->comp + (size_t)(j->offs[k] - j->offs[0]);
+  size_t in_len = (size_t)(j->offs[k + 1] - j->offs[k]);
+
+  bool whole = cfirst >= j->first && cfirst + cn <= j->first + j->count;
+  uint8_t *out = whole ? j->dst + (size_t)((cfirst - j->first) * j->idx_width)
+                       : malloc(raw_len ? raw_len : 1);
+  if (!out)
+    return false;
+  bool ok;
+  if (j->codec == SPLAT_COMPRESSION_NONE) {
+    ok = in_len == raw_len;
+    if (ok)
+      memcpy(out, in, raw_len);
+  } else {
+    ok = splat_decompress(j->codec, in, in_len, out, raw_len);
   }
-  if (cov >= 6) {
-    comps[n++] = s->sigma_xy;
-    comps[n++] = s->sigma_xz;
-    comps[n++] = s->sigma_yz;
+  if (ok && !whole) {
+    uint64_t from = j->first > cfirst ? j->first : cfirst;
+    uint64_t to = j->first + j->count < cfirst + cn ? j->first + j->count : cfirst + cn;
+    memcpy(j->dst + (size_t)((from - j->first) * j->idx_width),
+           out + (size_t)((from - cfirst) * j->idx_width), (size_t)((to - from) * j->idx_width));
   }
-  comps[n++] = s->mu_t;
-  comps[n++] = s->sigma_t;
-  comps[n++] = s->r;
-  comps[n++] = s->g;
-  comps[n++] = s->b;
-  comps[n++] = s->alpha;
+  if (!whole)
+    free(out);
+  return ok;
+}
 
-  for (int i = 0; i < n; ++i)
-    store_component(out + (size_t)i * cb, comps[i], precision);
+// Decode entries [first, first + count) of a chunked index into dst, touching
+// only the chunks that overlap the range. Each window's stored bytes come in
+// with one read and its chunks are then decoded in parallel.
+static bool read_chunked_range(FILE *fp, const Splat4DChunkLayout *l, uint32_t codec,
+                               uint8_t idx_width, uint64_t total, uint64_t first, uint64_t count,
+                               uint8_t *dst) {
+  if (count == 0)
+    return true;
+  uint64_t epc = l->entries_per_chunk;
+  uint64_t c0 = first / epc, c1 = (first + count - 1) / epc;
+  uint64_t *offs = malloc((size_t)(c1 - c0 + 2) * sizeof(uint64_t));
+  if (!offs)
+    return false;
+  bool ok = read_chunk_offsets(fp, l, c0, c1 - c0 + 2, offs);
+  if (ok && c0 == 0 && offs[0] != 0) {
+    LOG_ERROR("❌ Invalid chunk offsets\n");
+    ok = false;
+  }
+
+  ChunkDecodeJob job = {.l = l, .codec = codec, .idx_width = idx_width, .total = total,
+                        .first = first, .count = count, .dst = dst};
+  uint64_t window = chunk_window_size();
+  uint8_t *comp = NULL;
+  for (uint64_t w0 = c0; ok && w0 <= c1; w0 += window) {
+    uint64_t n = c1 - w0 + 1 < window ? c1 - w0 + 1 : window;
+    const uint64_t *wo = offs + (w0 - c0);
+    uint64_t span = wo[n] - wo[0];
+    free(comp);
+    comp = span > SIZE_MAX ? NULL : malloc(span ? (size_t)span : 1);
+    if (!comp || fseek(fp, (long)(l->index_start + wo[0]), SEEK_SET) != 0 ||
+        fread(comp, 1, (size_t)span, fp) != (size_t)span) {
+      ok = false;
+      break;
+    }
+    job.c0 = w0;
+    job.offs = wo;
+    job.comp = comp;
+    ok = splat_parallel_for(n, decode_index_chunk, &job);
+  }
+  free(comp);
+  free(offs);
+  return ok;
 }
 
-static void deserialize_palette_entry(const uint8_t *in, uint32_t flags, Splat4D *s) {
-  uint32_t precision = splat_precision_bits(flags);
-  uint32_t cov = splat_shape_cov_count(flags);
-  size_t cb = splat_precision_component_bytes(flags);
-  uint32_t n = splat_palette_component_count(flags);
+// Read a whole chunked index into freshly allocated storage and leave `fp` at
+// the footer.
+static bool read_index_chunked(FILE *fp, Splat4DIndex *idx, const Splat4DHeader *h,
+                               uint64_t total, uint64_t index_start, uint64_t filesize) {
+  uint32_t codec = (h->flags & SPLAT_FLAG_COMPRESSION_MASK) >> SPLAT_FLAG_COMPRESSION_SHIFT;
+  uint8_t idx_width = get_index_width_bytes(h->flags);
+  Splat4DChunkLayout l;
+  if (!read_chunk_layout(fp, h, total, index_start, filesize, &l))
+    return false;
+  if (!splat4d_index_alloc(idx, total, idx_width)) {
+    free(idx->data);
+    idx->data = NULL;
+    return false;
+  }
 
-  float comps[SPLAT_PALETTE_MAX_COMPONENTS];
-  for (uint32_t i = 0; i < n; ++i)
-    comps[i] = load_component(in + (size_t)i * cb, precision);
+  uint64_t last = 0, plane = (uint64_t)h->width * h->height;
+  if (!read_chunk_offsets(fp, &l, l.nchunks, 1, &last) ||
+      last != l.table_start - l.index_start ||
+      !read_chunked_range(fp, &l, codec, idx_width, total, 0, total, idx->u8) ||
+      !delta_decode_planes(h, l.key_frames, idx->u8, 0, plane ? total / plane : 0) ||
+      fseek(fp, (long)(filesize - SPLAT_FOOTER_DISK_BYTES), SEEK_SET) != 0) {
+    free(idx->data);
+    idx->data = NULL;
+    return false;
+  }
+  return true;
+}
 
-  int k = 0;
-  s->mu_x = comps[k++];
-  s->mu_y = comps[k++];
-  s->mu_z = comps[k++];
-  if (cov == 1) {
-    // Isotropic: one shared spatial sigma expands to all three axes.
-    s->sigma_x = s->sigma_y = s->sigma_z = comps[k++];
-    s->sigma_xy = s->sigma_xz = s->sigma_yz = 0.0f;
+// One window of a chunked write: chunk c0 + k is packed to the header width
+// (into packed[k], unless the storage already has that width or the chunk was
+// filled from a source beforehand) and compressed into out[k] / out_len[k].
+typedef struct {
+  const Splat4DVideo *v;
+  uint32_t codec;
+  uint8_t idx_width;
+  uint64_t total, entries_per_chunk;
+  uint64_t c0;
+  uint8_t **packed;
+  uint8_t **out;
+  size_t *out_len;
+} ChunkEncodeJob;
+
+static bool encode_index_chunk(void *ctx, uint64_t k) {
+  const ChunkEncodeJob *j = ctx;
+  const Splat4DIndex *idx = &j->v->index;
+  uint64_t first = (j->c0 + k) * j->entries_per_chunk;
+  uint64_t n = j->total - first < j->entries_per_chunk ? j->total - first : j->entries_per_chunk;
+  size_t raw_len = (size_t)(n * j->idx_width);
+  const uint8_t *raw = j->packed[k] ? j->packed[k] : idx->u8 + (size_t)(first * j->idx_width);
+  if (!j->packed[k] && idx->width != j->idx_width) {
+    if (!(j->packed[k] = malloc(raw_len ? raw_len : 1)))
+      return false;
+    convert_index_range(idx->data, idx->width, first, n, j->packed[k], j->idx_width);
+    raw = j->packed[k];
+  }
+  j->out[k] = splat_compress(j->codec, raw, raw_len, &j->out_len[k]);
+  return j->out[k] != NULL;
+}
+
+// Write the index as independently compressed chunks of entries_per_chunk
+// entries plus the chunk table; *table_offset receives the table's offset
+// relative to the start of the index section. Compressed chunks are produced a
+// window at a time in parallel and written in chunk order, so the bytes do not
+// depend on the thread count. Each chunk's packed bytes are folded into `crc`
+// (when given) in that same order, reusing the packing done for compression.
+// Chunks from a source are filled serially, in order, before each window is
+// compressed. key_frames goes in the table's second word.
+static bool write_index_chunked(FILE *fp, const Splat4DVideo *v, const SplatIndexSource *src,
+                                uint32_t codec, uint64_t entries_per_chunk, uint32_t key_frames,
+                                uint64_t *table_offset, crc32_t *crc) {
+  uint64_t total = header_total_indices(&v->header);
+  uint8_t idx_width = get_index_width_bytes(v->header.flags);
+  uint64_t nchunks = total / entries_per_chunk + (total % entries_per_chunk != 0);
+  uint64_t chunk_bytes = 0, table_bytes = 0;
+  if (!checked_mul_u64(entries_per_chunk < total ? entries_per_chunk : total, idx_width,
+                       &chunk_bytes) ||
+      chunk_bytes > SIZE_MAX || nchunks >= SIZE_MAX / 8 ||
+      !checked_mul_u64(nchunks + 1, 8, &table_bytes) ||
+      table_bytes > SIZE_MAX - SPLAT_CHUNK_TABLE_FIXED_BYTES)
+    return false;
+
+  uint64_t window = codec == SPLAT_COMPRESSION_NONE ? 1 : chunk_window_size();
+  if (window > nchunks)
+    window = nchunks;
+  size_t table_len = SPLAT_CHUNK_TABLE_FIXED_BYTES + (size_t)table_bytes;
+  uint8_t *table = malloc(table_len);
+  bool need_pack = codec == SPLAT_COMPRESSION_NONE && (src || v->index.width != idx_width);
+  uint8_t *pack = need_pack ? malloc((size_t)chunk_bytes) : NULL;
+  uint8_t **packed = calloc(window ? (size_t)window : 1, sizeof(uint8_t *));
+  uint8_t **out = calloc(window ? (size_t)window : 1, sizeof(uint8_t *));
+  size_t *out_len = calloc(window ? (size_t)window : 1, sizeof(size_t));
+  if (!table || (need_pack && !pack) || !packed || !out || !out_len) {
+    free(table);
+    free(pack);
+    free(packed);
+    free(out);
+    free(out_len);
+    return false;
+  }
+  store_u32be(table, SPLAT_CHUNK_TABLE_TAG);
+  store_u32le(table + 4, key_frames);
+  store_u64le(table + 8, entries_per_chunk);
+  store_u64le(table + 16, nchunks);
+
+  uint8_t *offs = table + SPLAT_CHUNK_TABLE_FIXED_BYTES;
+  uint64_t pos = 0;
+  bool ok = true;
+  store_u64le(offs, 0);
+  if (codec == SPLAT_COMPRESSION_NONE) {
+    // Stored chunks are just the packed index; nothing to farm out.
+    for (uint64_t c = 0; ok && c < nchunks; ++c) {
+      uint64_t first = c * entries_per_chunk;
+      uint64_t n = total - first < entries_per_chunk ? total - first : entries_per_chunk;
+      size_t raw_len = (size_t)(n * idx_width);
+      const uint8_t *raw = pack;
+      if (src)
+        ok = src->fill(src->ctx, n, pack);
+      else if (pack)
+        convert_index_range(v->index.data, v->index.width, first, n, pack, idx_width);
+      else
+        raw = v->index.u8 + (size_t)(first * idx_width);
+      if (ok && crc)
+        crc32_update(crc, raw, raw_len);
+      ok = ok && fwrite(raw, 1, raw_len, fp) == raw_len;
+      pos += raw_len;
+      store_u64le(offs + (c + 1) * 8, pos);
+    }
   } else {
-    s->sigma_x = comps[k++];
-    s->sigma_y = comps[k++];
-    s->sigma_z = comps[k++];
-    if (cov == 6) {
-      s->sigma_xy = comps[k++];
-      s->sigma_xz = comps[k++];
-      s->sigma_yz = comps[k++];
-    } else {
-      s->sigma_xy = s->sigma_xz = s->sigma_yz = 0.0f;
+    ChunkEncodeJob job = {.v = v, .codec = codec, .idx_width = idx_width, .total = total,
+                          .entries_per_chunk = entries_per_chunk, .packed = packed,
+                          .out = out, .out_len = out_len};
+    for (uint64_t w0 = 0; ok && w0 < nchunks; w0 += window) {
+      uint64_t n = nchunks - w0 < window ? nchunks - w0 : window;
+      job.c0 = w0;
+      for (uint64_t k = 0; src && ok && k < n; ++k) {
+        uint64_t first = (w0 + k) * entries_per_chunk;
+        uint64_t cn = total - first < entries_per_chunk ? total - first : entries_per_chunk;
+        packed[k] = malloc((size_t)(cn * idx_width));
+        ok = packed[k] && src->fill(src->ctx, cn, packed[k]);
+      }
+      ok = ok && splat_parallel_for(n, encode_index_chunk, &job);
+      for (uint64_t k = 0; k < n; ++k) {
+        if (ok) {
+          uint64_t first = (w0 + k) * entries_per_chunk;
+          uint64_t cn = total - first < entries_per_chunk ? total - first : entries_per_chunk;
+          const uint8_t *raw = packed[k] ? packed[k] : v->index.u8 + (size_t)(first * idx_width);
+          if (crc)
+            crc32_update(crc, raw, (size_t)(cn * idx_width));
+          ok = fwrite(out[k], 1, out_len[k], fp) == out_len[k];
+        }
+        pos += out_len[k];
+        store_u64le(offs + (w0 + k + 1) * 8, pos);
+        free(packed[k]);
+        free(out[k]);
+        packed[k] = out[k] = NULL;
+      }
     }
   }
-  s->mu_t = comps[k++];
-  s->sigma_t = comps[k++];
-  s->r = comps[k++];
-  s->g = comps[k++];
-  s->b = comps[k++];
-  s->alpha = comps[k++];
+  ok = ok && fwrite(table, 1, table_len, fp) == table_len;
+  free(packed);
+  free(out);
+  free(out_len);
+  free(pack);
+  free(table);
+  *table_offset = pos;
+  return ok;
 }
 
-typedef enum {
-  SPLAT_INDEX_OK = 0,
-  SPLAT_INDEX_OUT_OF_RANGE = 1, // references a palette slot that does not exist
-  SPLAT_INDEX_TOO_WIDE = 2,     // does not fit the selected index width
-} SplatIndexCheck;
+// Read entries [first, first + count) of the index section, whatever its
+// layout: uncompressed files seek straight to the range, chunked files decode
+// only the overlapping chunks, and a monolithic compressed index has to be
+// decompressed in full first.
+static bool read_index_range(FILE *fp, const Splat4DHeader *h, uint64_t total,
+                             uint64_t index_start, uint64_t filesize, uint64_t first,
+                             uint64_t count, uint8_t *dst) {
+  uint32_t codec = (h->flags & SPLAT_FLAG_COMPRESSION_MASK) >> SPLAT_FLAG_COMPRESSION_SHIFT;
+  uint8_t idx_width = get_index_width_bytes(h->flags);
 
-// Verify that every entry is a valid palette reference (< pSize) and fits the
-// selected index width, so that packing to that width will not silently
-// truncate the value. On failure *bad_pos (when non-NULL) receives the offset
-// of the first offending entry.
-static SplatIndexCheck check_index_values(const uint64_t *indices, uint64_t count, uint32_t pSize,
-                                          uint8_t idx_width, uint64_t *bad_pos) {
-  if (!indices)
-    return SPLAT_INDEX_OUT_OF_RANGE;
+  // A delta-coded range decodes from the start of its run to the end of its
+  // last plane; only the requested part is copied out.
+  uint64_t plane = (uint64_t)h->width * h->height;
+  bool delta = (h->version[3] & SPLAT_TRANSFORM_DELTA) && plane > 0;
+  uint64_t end_plane = delta ? (first + count + plane - 1) / plane : 0;
 
-  uint64_t max_repr = index_width_max_value(idx_width);
-  for (uint64_t i = 0; i < count; ++i) {
-    if (indices[i] >= pSize) {
-      if (bad_pos)
-        *bad_pos = i;
-      return SPLAT_INDEX_OUT_OF_RANGE;
+  if (h->version[2] == SPLAT_LAYOUT_CHUNKED) {
+    Splat4DChunkLayout l;
+    if (!read_chunk_layout(fp, h, total, index_start, filesize, &l))
+      return false;
+    if (!delta)
+      return read_chunked_range(fp, &l, codec, idx_width, total, first, count, dst);
+    uint64_t run = (uint64_t)l.key_frames * h->depth;
+    uint64_t s0 = run ? first / plane / run * run : 0;
+    uint64_t span = (end_plane - s0) * plane;
+    uint8_t *buf = span * idx_width > SPLAT_MAX_COMPRESSED_INDEX_BYTES
+                       ? NULL
+                       : malloc((size_t)(span * idx_width));
+    bool ok = buf && read_chunked_range(fp, &l, codec, idx_width, total, s0 * plane, span, buf) &&
+              delta_decode_planes(h, l.key_frames, buf, s0, end_plane - s0);
+    if (ok)
+      memcpy(dst, buf + (size_t)((first - s0 * plane) * idx_width), (size_t)(count * idx_width));
+    free(buf);
+    return ok;
+  }
+
+  uint64_t index_bytes = total * idx_width; // fits: checked by the caller
+  if (codec == SPLAT_COMPRESSION_NONE) {
+    if (index_start + index_bytes + SPLAT_FOOTER_DISK_BYTES > filesize) {
+      LOG_ERROR("❌ Index does not fit the file\n");
+      return false;
     }
-    if (indices[i] > max_repr) {
-      if (bad_pos)
-        *bad_pos = i;
-      return SPLAT_INDEX_TOO_WIDE;
+    size_t len = (size_t)(count * idx_width);
+    return fseek(fp, (long)(index_start + first * idx_width), SEEK_SET) == 0 &&
+           fread(dst, 1, len, fp) == len;
+  }
+
+  if (index_bytes > SPLAT_MAX_COMPRESSED_INDEX_BYTES ||
+      filesize < index_start + SPLAT_FOOTER_DISK_BYTES ||
+      fseek(fp, (long)index_start, SEEK_SET) != 0)
+    return false;
+  Splat4DIndex whole = {.data = NULL};
+  size_t comp_len = (size_t)(filesize - index_start - SPLAT_FOOTER_DISK_BYTES);
+  if (!read_index_compressed(fp, &whole, total, h->flags, comp_len, codec))
+    return false;
+  if (delta && !delta_decode_planes(h, 0, whole.u8, 0, end_plane)) {
+    free(whole.data);
+    return false;
+  }
+  memcpy(dst, whole.u8 + (size_t)(first * idx_width), (size_t)(count * idx_width));
+  free(whole.data);
+  return true;
+}
+
+// Decode the index of frame t (width * height * depth entries, at the header's
+// index width) without reading the rest of the index where the layout allows:
+// O(frame) for uncompressed and chunked files. `palette` is optional; pass
+// NULL when scrubbing with a palette already in hand. The footer checksum
+// covers the whole payload, so it is not verified here; use
+// read_splat4DVideo() when integrity matters. On success the caller owns
+// frame->data (and palette->palette when requested).
+bool read_splat4DFrame(FILE *fp, uint32_t t, Splat4DHeader *header, Splat4DPalette *palette,
+                       Splat4DIndex *frame) {
+  if (!fp || !header || !frame)
+    return false;
+  frame->data = NULL;
+  if (palette)
+    palette->palette = NULL;
+
+  if (fseek(fp, 0, SEEK_SET) != 0 || !read_splat4DHeader(fp, header) || !header_readable(header))
+    return false;
+  if (t >= header->frames) {
+    LOG_ERROR("❌ Frame %u out of range (%u frames)\n", t, header->frames);
+    return false;
+  }
+
+  uint8_t idx_width = get_index_width_bytes(header->flags);
+  uint64_t total = 0, frame_entries = 0, frame_bytes = 0, palette_bytes = 0, index_bytes = 0;
+  uint64_t filesize = 0;
+  if (!header_total_indices_checked(header, &total) ||
+      !checked_mul_u64((uint64_t)header->width * header->height, header->depth, &frame_entries) ||
+      !checked_mul_u64(frame_entries, idx_width, &frame_bytes) ||
+      !checked_mul_u64(total, idx_width, &index_bytes) ||
+      !checked_mul_u64(header->pSize, palette_entry_disk_bytes(header->flags), &palette_bytes) ||
+      !splat_file_size(fp, &filesize) ||
+      filesize < SPLAT_HEADER_DISK_BYTES + SPLAT_FOOTER_DISK_BYTES ||
+      palette_bytes > filesize - SPLAT_HEADER_DISK_BYTES - SPLAT_FOOTER_DISK_BYTES ||
+      frame_bytes > SPLAT_MAX_COMPRESSED_INDEX_BYTES) {
+    LOG_ERROR("❌ Invalid header dimensions\n");
+    return false;
+  }
+  uint64_t index_start = SPLAT_HEADER_DISK_BYTES + palette_bytes;
+
+  if (palette && !read_splat4DPalette(fp, palette, header->pSize, header->flags))
+    return false;
+  // A repeated frame is read from the slot the frame table sends it to.
+  SplatFrameTable ft = {.slot = NULL};
+  uint64_t slot = t;
+  bool ok = true;
+  if (header->version[3] & SPLAT_TRANSFORM_FRAME_REFS) {
+    ok = read_frame_table(fp, header, index_start, filesize, &ft);
+    slot = ok ? ft.slot[t] : 0;
+  }
+  Splat4DHeader stored = stored_index_header(header, &ft);
+  index_start += frame_table_disk_bytes(header);
+  frame_table_free(&ft);
+  if (!ok || !splat4d_index_alloc(frame, frame_entries, idx_width) ||
+      !read_index_range(fp, &stored, header_total_indices(&stored), index_start, filesize,
+                        slot * frame_entries, frame_entries, frame->u8)) {
+    free(frame->data);
+    frame->data = NULL;
+    if (palette) {
+      free(palette->palette);
+      palette->palette = NULL;
     }
+    return false;
   }
-  return SPLAT_INDEX_OK;
+  return true;
 }
 
-static bool splat4d_stream_video_payload(const Splat4DVideo *v, size_t chunk, Splat4DChunkFn fn,
-                                         void *ctx) {
-  if (!v || !fn)
+// Describe a file from its 32-byte header and 16-byte footer. The layout is
+// checked against the file size (the footer sits at the end, idxoffset points
+// where the layout says it should, an uncompressed index fills exactly the gap)
+// but nothing between header and footer is read, so probing a large file costs
+// two small reads. Neither the checksum nor the chunk table is verified.
+bool probe_splat4DFile(FILE *fp, Splat4DProbe *out) {
+  if (!fp || !out)
     return false;
-
-  // Stream the header in its on-disk form so the checksum covers exactly the
-  // bytes written to the file.
-  uint8_t header_bytes[SPLAT_HEADER_DISK_BYTES];
-  serialize_header(&v->header, header_bytes);
-  if (!splat4d_stream_block(header_bytes, sizeof header_bytes, chunk, fn, ctx))
+  memset(out, 0, sizeof *out);
+  Splat4DHeader *h = &out->header;
+  if (fseek(fp, 0, SEEK_SET) != 0 || !read_splat4DHeader(fp, h)) {
+    LOG_ERROR("❌ Truncated header\n");
     return false;
-
-  size_t entry_bytes = palette_entry_disk_bytes(v->header.flags);
-  uint64_t palette_bytes_u64;
-  if (!checked_mul_u64((uint64_t)v->header.pSize, entry_bytes, &palette_bytes_u64))
+  }
+  if (!header_readable(h))
     return false;
-  if (palette_bytes_u64 > SIZE_MAX)
+  if (!header_total_indices_checked(h, &out->total_indices) ||
+      !checked_mul_u64(h->pSize, palette_entry_disk_bytes(h->flags), &out->palette_bytes) ||
+      !splat_file_size(fp, &out->file_size) ||
+      out->file_size < SPLAT_HEADER_DISK_BYTES + SPLAT_FOOTER_DISK_BYTES ||
+      out->palette_bytes + frame_table_disk_bytes(h) >
+          out->file_size - SPLAT_HEADER_DISK_BYTES - SPLAT_FOOTER_DISK_BYTES) {
+    LOG_ERROR("❌ Header does not fit the file size\n");
     return false;
-
-  size_t palette_bytes = (size_t)palette_bytes_u64;
-  if (palette_bytes > 0) {
-    if (!v->palette.palette)
-      return false;
-    // The on-disk palette is always serialized (spec field order + per-shape
-    // covariance + precision), so build it into a buffer and stream that.
-    uint8_t *packed = malloc(palette_bytes);
-    if (!packed)
-      return false;
-    for (uint32_t i = 0; i < v->header.pSize; ++i)
-      serialize_palette_entry(&v->palette.palette[i], v->header.flags,
-                              packed + (size_t)i * entry_bytes);
-    bool ok = splat4d_stream_block(packed, palette_bytes, chunk, fn, ctx);
-    free(packed);
-    if (!ok)
-      return false;
   }
+  out->index_offset = compute_idxoffset_forward(h);
+  out->index_bytes = out->file_size - SPLAT_FOOTER_DISK_BYTES - out->index_offset;
 
-  uint64_t total = header_total_indices(&v->header);
-  uint8_t idx_width = get_index_width_bytes(v->header.flags);
-  uint64_t index_bytes_u64;
+  Splat4DFooter *f = &out->footer;
+  if (fseek(fp, (long)(out->file_size - SPLAT_FOOTER_DISK_BYTES), SEEK_SET) != 0 ||
+      !read_splat4DFooter(fp, f) || f->end != 0x4C505334) {
+    LOG_ERROR("❌ Invalid footer\n");
+    return false;
+  }
 
-  if (!checked_mul_u64(total, idx_width, &index_bytes_u64))
+  if (h->version[2] == SPLAT_LAYOUT_CHUNKED) {
+    if (out->index_bytes < SPLAT_CHUNK_TABLE_FIXED_BYTES || f->idxoffset < out->index_offset ||
+        f->idxoffset > out->index_offset + out->index_bytes - SPLAT_CHUNK_TABLE_FIXED_BYTES) {
+      LOG_ERROR("❌ Chunk table offset outside the index section\n");
+      return false;
+    }
+    return true;
+  }
+  if (f->idxoffset != out->index_offset) {
+    LOG_ERROR("❌ Index offset mismatch\n");
     return false;
-  if (index_bytes_u64 > SIZE_MAX)
+  }
+  uint64_t raw_bytes = 0;
+  if (splat4d_flags_from_raw(h->flags).bits.compression == SPLAT_COMPRESSION_NONE &&
+      (!checked_mul_u64(out->total_indices, get_index_width_bytes(h->flags), &raw_bytes) ||
+       raw_bytes != out->index_bytes)) {
+    LOG_ERROR("❌ Index size does not match the file size\n");
     return false;
+  }
+  return true;
+}
 
-  size_t index_bytes = (size_t)index_bytes_u64;
-  if (index_bytes > 0) {
-    if (!v->index.index)
+// Entries per index chunk for writing `h` with `opts` (0 = monolithic).
+static bool splat4d_entries_per_chunk(const Splat4DHeader *h, const Splat4DWriteOptions *opts,
+                                      uint64_t *entries_per_chunk) {
+  uint32_t codec = (h->flags & SPLAT_FLAG_COMPRESSION_MASK) >> SPLAT_FLAG_COMPRESSION_SHIFT;
+  *entries_per_chunk = 0;
+  if (opts && opts->chunk_frames > 0) {
+    uint64_t frame_entries = (uint64_t)h->width * h->height;
+    return checked_mul_u64(frame_entries, h->depth, &frame_entries) &&
+           checked_mul_u64(frame_entries, opts->chunk_frames, entries_per_chunk) &&
+           *entries_per_chunk != 0;
+  }
+  if (opts && opts->chunk_bytes > 0 && codec != SPLAT_COMPRESSION_NONE) {
+    uint64_t total = 0;
+    if (!header_total_indices_checked(h, &total))
       return false;
+    uint64_t epc = opts->chunk_bytes / get_index_width_bytes(h->flags);
+    if (epc == 0)
+      epc = 1;
+    *entries_per_chunk = epc >= total ? 0 : epc;
+  }
+  return true;
+}
 
-    if (idx_width == 8) {
-      if (!splat4d_stream_block((const uint8_t *)v->index.index, index_bytes, chunk, fn, ctx))
-        return false;
-    } else {
-      // Pack the 64-bit array down to the requested width dynamically in chunks
-      uint8_t pack_buf[SPLAT4D_STREAM_CHUNK_SIZE];
-      uint64_t items_per_chunk = SPLAT4D_STREAM_CHUNK_SIZE / idx_width;
-      uint64_t items_streamed = 0;
-
-      while (items_streamed < total) {
-        uint64_t to_pack = total - items_streamed;
-        if (to_pack > items_per_chunk)
-          to_pack = items_per_chunk;
-
-        // ⚡ Bolt Optimization: Use restrict pointers to guarantee no aliasing,
-        // allowing better vectorization of these packing loops.
-        const uint64_t *restrict src = v->index.index + items_streamed;
-        if (idx_width == 1) {
-          uint8_t *restrict p = (uint8_t *)pack_buf;
-          for (uint64_t i = 0; i < to_pack; i++)
-            p[i] = (uint8_t)src[i];
-        } else if (idx_width == 2) {
-          uint16_t *restrict p = (uint16_t *)pack_buf;
-          for (uint64_t i = 0; i < to_pack; i++)
-            p[i] = (uint16_t)src[i];
-        } else if (idx_width == 4) {
-          uint32_t *restrict p = (uint32_t *)pack_buf;
-          for (uint64_t i = 0; i < to_pack; i++)
-            p[i] = (uint32_t)src[i];
-        }
-
-        uint64_t packed_bytes;
-        if (!checked_mul_u64(to_pack, idx_width, &packed_bytes))
-          return false;
-        if (packed_bytes > SIZE_MAX)
-          return false;
-
-        if (!fn(pack_buf, (size_t)packed_bytes, ctx))
-          return false;
-        items_streamed += to_pack;
-      }
-    }
+// write_splat4DVideoWithOptions() with the index taken from `src` (NULL for
+// v->index). A source that may use frame references passes its frame table in
+// `refs`; for v->index the table is built here when the options ask for it.
+// *written, when given, receives the header as it went to the file.
+static bool write_splat4DVideoFrom(FILE *fp, Splat4DVideo *v, const Splat4DWriteOptions *opts,
+                                   const SplatIndexSource *src, const SplatFrameTable *refs,
+                                   Splat4DHeader *written) {
+  if (!fp || !v)
+    return false;
+  // The layout and transform bytes belong to this file only, so they are set on
+  // a copy of the header; the caller gets back the footer that was written.
+  Splat4DVideo w = *v;
+
+  uint32_t codec = (w.header.flags & SPLAT_FLAG_COMPRESSION_MASK) >> SPLAT_FLAG_COMPRESSION_SHIFT;
+  bool have_index = src || w.index.data;
+
+  // Repeated frames are settled first: the table decides how many frames the
+  // index section holds, and with it the layout. Without any repeat the file
+  // is written exactly as without the option.
+  SplatFrameTable own = {.slot = NULL};
+  if (opts && opts->frame_refs && codec != SPLAT_COMPRESSION_NONE && w.header.frames > 1 &&
+      !refs && !src && have_index) {
+    if (!frame_table_for_video(&w, &own))
+      return false;
+    refs = &own;
+  }
+  if (refs && refs->nstored == w.header.frames)
+    refs = NULL;
+
+  // The layout is recorded in the header, so settle it before checksumming.
+  bool delta = opts && opts->temporal_delta && codec != SPLAT_COMPRESSION_NONE;
+  w.header.version[3] = (delta ? SPLAT_TRANSFORM_DELTA : SPLAT_TRANSFORM_NONE) |
+                         (refs ? SPLAT_TRANSFORM_FRAME_REFS : SPLAT_TRANSFORM_NONE);
+  Splat4DVideo stored = w;
+  stored.header = stored_index_header(&w.header, refs);
+  uint64_t entries_per_chunk = 0;
+  if (!splat4d_entries_per_chunk(&stored.header, opts, &entries_per_chunk)) {
+    frame_table_free(&own);
+    return false;
   }
+  w.header.version[2] = entries_per_chunk ? SPLAT_LAYOUT_CHUNKED : SPLAT_LAYOUT_MONOLITHIC;
+  stored.header.version[2] = w.header.version[2];
+  // Chunks of whole frames keep their random access: each starts a delta run.
+  uint32_t key_frames = delta && opts->chunk_frames ? opts->chunk_frames : 0;
+  w.footer.idxoffset = compute_idxoffset_forward(&w.header);
 
+  // Each section is serialized once and the same bytes feed both the checksum
+  // and the file (through the codec for a compressed index). The checksum
+  // covers the logical (uncompressed) payload, so it is independent of the
+  // codec's byte output and of the layout.
+  crc32_t c;
+  crc32_init(&c);
+  Splat4DStreamFileCtx ctx = {.fp = fp, .crc = &c};
+  bool ok = splat4d_stream_prefix(&w, SPLAT4D_STREAM_CHUNK_SIZE, splat4d_stream_file_consumer, &ctx);
+
+  // Stored frames reach the writer through a FrameRefSource, and the delta
+  // transform through a DeltaSource that checksums the logical bytes itself.
+  // With frame references the index checksum comes from the table instead.
+  crc32_t *index_crc = &c;
+  FrameRefSource fs = {.index = &w.index, .inner = src, .ft = refs,
+                       .width = get_index_width_bytes(w.header.flags),
+                       .frame_entries = (uint64_t)w.header.width * w.header.height *
+                                        w.header.depth,
+                       .frames = w.header.frames};
+  SplatIndexSource refs_src = {.fill = frame_ref_fill, .ctx = &fs};
+  if (ok && refs) {
+    ok = write_frame_table(fp, refs, w.header.frames);
+    src = &refs_src;
+    index_crc = NULL;
+  }
+  DeltaSource ds = {.ring = NULL};
+  SplatIndexSource delta_src = {.fill = delta_fill, .ctx = &ds};
+  if (ok && delta) {
+    ok = have_index && delta_source_init(&ds, &stored, src, key_frames, index_crc);
+    src = &delta_src;
+    index_crc = NULL;
+  }
+  if (ok && entries_per_chunk) {
+    uint64_t table_offset = 0;
+    ok = have_index && write_index_chunked(fp, &stored, src, codec, entries_per_chunk, key_frames,
+                                           &table_offset, index_crc);
+    w.footer.idxoffset += table_offset;
+  } else if (ok && codec == SPLAT_COMPRESSION_NONE) {
+    // Uncompressed: the on-disk bytes equal the logical payload.
+    ok = splat4d_stream_index_from(&w, src, splat4d_stream_file_consumer, &ctx);
+  } else if (ok) {
+    ok = have_index && write_index_compressed(fp, &stored, src, codec, index_crc);
+  }
+  free(ds.ring);
+  if (ok) {
+    w.footer.checksum = crc32_final(&c);
+    if (refs)
+      w.footer.checksum =
+          frame_table_fold_crc(w.footer.checksum, refs, refs->crc, w.header.frames,
+                               fs.frame_entries * fs.width);
+  }
+  frame_table_free(&own);
+  if (!ok)
+    return false;
+
+  // Return to end of file and write footer
+  fseek(fp, 0, SEEK_END);
+  if (!write_splat4DFooter(fp, &w.footer))
+    return false;
+  v->footer = w.footer;
+  if (written)
+    *written = w.header;
   return true;
 }
 
-bool stream_splat4DVideo(const Splat4DVideo *v, size_t chunk, Splat4DChunkFn fn, void *ctx) {
-  return splat4d_stream_video_payload(v, chunk, fn, ctx);
+bool write_splat4DVideoWithOptions(FILE *fp, Splat4DVideo *v, const Splat4DWriteOptions *opts) {
+  return write_splat4DVideoFrom(fp, v, opts, NULL, NULL, NULL);
 }
 
-static bool splat4d_crc32_consumer(const uint8_t *chunk, size_t n, void *ctx) {
-  crc32_t *c = ctx;
-  crc32_update(c, chunk, n);
-  return true;
+bool write_splat4DVideo(FILE *fp, Splat4DVideo *v) {
+  return write_splat4DVideoWithOptions(fp, v, NULL);
 }
 
-typedef struct {
-  FILE *fp;
-  crc32_t *crc;
-} Splat4DStreamFileCtx;
-
-static bool splat4d_stream_file_consumer(const uint8_t *chunk, size_t n, void *ctx) {
-  Splat4DStreamFileCtx *state = ctx;
-  if (fwrite(chunk, 1, n, state->fp) != n)
+// Recompute the checksum of a loaded video and compare it with its footer.
+// This is the check a deferred read skips at open.
+bool splat4d_verify(const Splat4DVideo *v) {
+  if (!v)
     return false;
-  if (state->crc)
-    crc32_update(state->crc, chunk, n);
+  uint32_t recomputed = compute_video_checksum(v);
+  if (recomputed != v->footer.checksum) {
+    LOG_ERROR("❌ CRC mismatch: file=0x%08X recomputed=0x%08X\n", v->footer.checksum, recomputed);
+    return false;
+  }
   return true;
 }
 
-uint32_t compute_video_checksum(const Splat4DVideo *v) {
-  if (!v)
-    return 0;
-
+// splat4d_verify() for a video whose index still holds only the stored frames
+// of `ft`: each slot is checksummed once and folded in for every frame using it.
+static bool splat4d_verify_stored(const Splat4DVideo *v, const SplatFrameTable *ft) {
+  const Splat4DHeader *h = &v->header;
+  uint64_t frame_entries = (uint64_t)h->width * h->height * h->depth;
+  uint32_t *slot_crc = malloc((size_t)ft->nstored * sizeof(uint32_t));
   crc32_t c;
   crc32_init(&c);
-  if (!stream_splat4DVideo(v, SPLAT4D_STREAM_CHUNK_SIZE, splat4d_crc32_consumer, &c))
-    return 0;
-  return crc32_final(&c);
+  bool ok = slot_crc &&
+            splat4d_stream_prefix(v, SPLAT4D_STREAM_CHUNK_SIZE, splat4d_crc32_consumer, &c) &&
+            splat_unit_crcs(&v->index, v->index.width, frame_entries, ft->nstored, slot_crc);
+  uint32_t crc = ok ? frame_table_fold_crc(crc32_final(&c), ft, slot_crc, h->frames,
+                                           frame_entries * v->index.width)
+                    : 0;
+  free(slot_crc);
+  if (ok && crc != v->footer.checksum) {
+    LOG_ERROR("❌ CRC mismatch: file=0x%08X recomputed=0x%08X\n", v->footer.checksum, crc);
+    ok = false;
+  }
+  return ok;
 }
 
-uint64_t compute_idxoffset_forward(const Splat4DHeader *h) {
-  return (uint64_t)sizeof(Splat4DHeader) +
-         (uint64_t)h->pSize * (uint64_t)palette_entry_disk_bytes(h->flags);
-}
+// Read a whole file. Structural checks (header, sizes, chunk table, footer
+// offset and marker) always run; opts->verify decides whether the CRC pass over
+// the payload runs here, is left to splat4d_verify(), or is skipped.
+bool read_splat4DVideoWithOptions(FILE *fp, Splat4DVideo *v, const Splat4DReadOptions *opts) {
+  if (!fp || !v)
+    return false;
 
-uint64_t compute_idxoffset_reverse(const Splat4DHeader *h) {
-  uint64_t total = header_total_indices(h);
-  uint64_t header_bytes = sizeof(Splat4DHeader);
-  uint64_t palette_bytes = (uint64_t)h->pSize * (uint64_t)palette_entry_disk_bytes(h->flags);
-  uint8_t idx_width = get_index_width_bytes(h->flags);
-  uint64_t index_bytes = total * idx_width;
-  uint64_t footer_bytes = SPLAT_FOOTER_DISK_BYTES;
-  uint64_t filesize = header_bytes + palette_bytes + index_bytes + footer_bytes;
-  uint64_t offset = filesize - (footer_bytes + index_bytes);
-  return offset;
-}
+  // Null the owned pointers up front so every early-return path leaves the
+  // caller's struct in a consistent (freeable) state.
+  v->palette.palette = NULL;
+  v->index.data = NULL;
 
-bool sanity_check_idxoffset_file(FILE *fp, const Splat4DHeader *h, const Splat4DFooter *f) {
-  (void)fp;
-  uint64_t expect = (uint64_t)sizeof(Splat4DHeader) +
-                    (uint64_t)h->pSize * (uint64_t)palette_entry_disk_bytes(h->flags);
-  return f->idxoffset == expect;
-}
+  // Read header
+  if (!read_splat4DHeader(fp, &v->header))
+    return false;
 
-bool check_idxoffset_file(FILE *fp, const Splat4DHeader *h, const Splat4DFooter *f) {
-  (void)fp;
-  uint64_t after_header = (uint64_t)sizeof(Splat4DHeader) +
-                          (uint64_t)h->pSize * (uint64_t)palette_entry_disk_bytes(h->flags);
-  return after_header == (uint64_t)f->idxoffset;
-}
+  // Reject files that are not 4Splat containers before sizing any allocation
+  // from attacker-controlled header dimensions.
+  if (!header_readable(&v->header))
+    return false;
 
-// splat
-Splat4D create_splat4D(float mu_x, float sigma_x, float mu_y, float sigma_y, float mu_z,
-                       float sigma_z, float mu_t, float sigma_t, float r, float g, float b,
-                       float alpha) {
-  return (Splat4D){.mu_x = mu_x,
-                   .sigma_x = sigma_x,
-                   .mu_y = mu_y,
-                   .sigma_y = sigma_y,
-                   .mu_z = mu_z,
-                   .sigma_z = sigma_z,
-                   .mu_t = mu_t,
-                   .sigma_t = sigma_t,
-                   .r = r,
-                   .g = g,
-                   .b = b,
-                   .alpha = alpha};
-}
+  uint64_t palette_bytes = 0;
+  if (!checked_mul_u64((uint64_t)v->header.pSize,
+                       (uint64_t)palette_entry_disk_bytes(v->header.flags), &palette_bytes) ||
+      palette_bytes > SIZE_MAX) {
+    LOG_ERROR("❌ Invalid palette size\n");
+    return false;
+  }
 
-void print_splat4D(const Splat4D *s, const uint32_t count) {
-  printf("│ ╭ Splat %010u ──────╮ │\n", count);
-  printf("│ │         mu    sigma    │ │\n");
-  printf("│ │ x %8.2f %8.2f    │ │\n", s->mu_x, s->sigma_x);
-  printf("│ │ y %8.2f %8.2f    │ │\n", s->mu_y, s->sigma_y);
-  printf("│ │ z %8.2f %8.2f    │ │\n", s->mu_z, s->sigma_z);
-  printf("│ │ t %8.2f %8.2f    │ │\n", s->mu_t, s->sigma_t);
-  if (s->sigma_xy != 0.0f || s->sigma_xz != 0.0f || s->sigma_yz != 0.0f)
-    printf("│ │ cov %6.2f %6.2f %6.2f│ │\n", s->sigma_xy, s->sigma_xz, s->sigma_yz);
-  printf("│ │ r %-18.2f   │ │\n", s->r);
-  printf("│ │ g %-18.2f   │ │\n", s->g);
-  printf("│ │ b %-18.2f   │ │\n", s->b);
-  printf("│ │ α %-18.2f   │ │\n", s->alpha);
-  printf("│ ╰────────────────────────╯ │\n");
-}
+  uint64_t total = 0;
+  if (!header_total_indices_checked(&v->header, &total)) {
+    LOG_ERROR("❌ Invalid index count\n");
+    return false;
+  }
 
-// header
-Splat4DHeader create_splat4DHeader(uint32_t width, uint32_t height, uint32_t depth, uint32_t frames,
-                                   uint32_t pSize, uint32_t flags) {
-  uint32_t sanitized = sanitize_flags(flags);
-  return (Splat4DHeader){.magic = 0x3453504C,
-                         .version = {1, 1, 0, 0}, // v0.2 palette layout
-                         .width = width,
-                         .height = height,
-                         .depth = depth,
-                         .frames = frames,
-                         .pSize = pSize,
-                         .flags = sanitized};
-}
+  uint64_t index_bytes = 0;
+  if (!checked_mul_u64(total, (uint64_t)get_index_width_bytes(v->header.flags), &index_bytes) ||
+      index_bytes > SIZE_MAX) {
+    LOG_ERROR("❌ Invalid index count\n");
+    return false;
+  }
 
-static const char *precision_name(uint32_t precision) {
-  static const char *names[] = {"Float16", "Float32", "Float64", "Float128"};
-  if (precision < (sizeof names / sizeof names[0]))
-    return names[precision];
-  return "Reserved";
-}
+  uint32_t codec = (v->header.flags & SPLAT_FLAG_COMPRESSION_MASK) >> SPLAT_FLAG_COMPRESSION_SHIFT;
 
-static const char *compression_name(uint32_t compression) {
-  static const char *names[] = {"None",    "Run Length Encoding",
-                                "DEFLATE", "RAR",
-                                "LZO",     "Zlib",
-                                "bzip2",   "LZMA",
-                                "ZPAQ",    "XZ",
-                                "LZ4",     "Snappy",
-                                "LZHAM",   "Brotli",
-                                "LZFSE",   "Zstd"};
-  if (compression < (sizeof names / sizeof names[0]))
-    return names[compression];
-  return "Reserved";
-}
+  // Reject headers whose declared sections cannot fit the actual file, before
+  // allocating anything sized from those (attacker-controlled) dimensions.
+  long after_header = ftell(fp);
+  if (after_header < 0 || fseek(fp, 0, SEEK_END) != 0)
+    return false;
+  long file_end = ftell(fp);
+  if (file_end < 0 || fseek(fp, after_header, SEEK_SET) != 0)
+    return false;
+  uint64_t filesize = (uint64_t)file_end;
+
+  uint64_t base = (uint64_t)SPLAT_HEADER_DISK_BYTES + SPLAT_FOOTER_DISK_BYTES;
+  if (palette_bytes > filesize || filesize - palette_bytes < base) {
+    LOG_ERROR("❌ Palette does not fit the file\n");
+    return false;
+  }
+  uint64_t index_room = filesize - palette_bytes - base; // on-disk bytes for the index
+  uint64_t ondisk_index = 0;
+  if (!checked_mul_u64(total, (uint64_t)get_index_width_bytes(v->header.flags), &ondisk_index)) {
+    LOG_ERROR("❌ Invalid index count\n");
+    return false;
+  }
+  if (codec == SPLAT_COMPRESSION_NONE) {
+    if (ondisk_index > index_room) {
+      LOG_ERROR("❌ Index does not fit the file\n");
+      return false;
+    }
+  } else if (ondisk_index > SPLAT_MAX_COMPRESSED_INDEX_BYTES) {
+    LOG_ERROR("❌ Compressed index would decompress beyond the size limit\n");
+    return false;
+  }
 
-static const char *index_width_name(uint32_t width) {
-  static const char *names[] = {"1 byte", "2 bytes", "4 bytes", "8 bytes"};
-  if (width < (sizeof names / sizeof names[0]))
-    return names[width];
-  return "Reserved";
-}
+  // Read palette
+  if (!read_splat4DPalette(fp, &v->palette, v->header.pSize, v->header.flags))
+    return false;
 
-static const char *splat_shape_label(uint32_t shape) {
-  static const char *names[] = {"Isotropic (1σ)", "Axis-Aligned", "Full Covariance", "Reserved"};
-  if (shape < (sizeof names / sizeof names[0]))
-    return names[shape];
-  return "Reserved";
-}
+  // With frame references the frame table comes next and the index section
+  // holds only the stored frames, which are spread over all frames once the
+  // checksum has been taken over them.
+  SplatFrameTable ft = {.slot = NULL};
+  bool refs = v->header.version[3] & SPLAT_TRANSFORM_FRAME_REFS;
+  uint64_t index_start = SPLAT_HEADER_DISK_BYTES + palette_bytes;
+  if (refs && !read_frame_table(fp, &v->header, index_start, filesize, &ft)) {
+    free(v->palette.palette);
+    v->palette.palette = NULL;
+    return false;
+  }
+  index_start += frame_table_disk_bytes(&v->header);
+  Splat4DHeader stored = stored_index_header(&v->header, &ft);
+  uint64_t stored_total = header_total_indices(&stored);
 
-static const char *color_space_name(uint32_t color_space) {
-  static const char *names[] = {"sRGB",         "Linear sRGB", "OKLab",   "Display P3",
-                                "Rec.709",      "Rec.2020",    "DCI-P3",  "ACES-AP0",
-                                "ProPhoto RGB", "Rec.2100",    "CIE Lab", "CIE XYZ D65",
-                                "ACEScg-AP1",   "Rec.601",     "XYZ D50", "XYZ D65"};
-  if (color_space < (sizeof names / sizeof names[0]))
-    return names[color_space];
-  return "Reserved";
-}
+  // Read index
+  bool chunked = v->header.version[2] == SPLAT_LAYOUT_CHUNKED;
+  bool ok = true;
+  if (chunked) {
+    ok = read_index_chunked(fp, &v->index, &stored, stored_total, index_start, filesize);
+    if (!ok)
+      LOG_ERROR("❌ Failed to read chunked index\n");
+  } else if (codec == SPLAT_COMPRESSION_NONE) {
+    ok = read_splat4DIndex(fp, &v->index, total, v->header.flags);
+  } else if (filesize < index_start + SPLAT_FOOTER_DISK_BYTES) {
+    // The compressed index section runs from the index offset up to the
+    // fixed-size footer at end of file.
+    LOG_ERROR("❌ Truncated compressed index\n");
+    ok = false;
+  } else {
+    size_t comp_len = (size_t)(filesize - index_start - SPLAT_FOOTER_DISK_BYTES);
+    uint64_t plane = (uint64_t)v->header.width * v->header.height;
+    ok = read_index_compressed(fp, &v->index, stored_total, v->header.flags, comp_len, codec) &&
+         delta_decode_planes(&stored, 0, v->index.u8, 0, plane ? stored_total / plane : 0);
+    if (!ok)
+      LOG_ERROR("❌ Failed to decompress index\n");
+  }
 
-static const char *interpolation_name(uint32_t interpolation) {
-  static const char *names[] = {"None",
-                                "Nearest Neighbor",
-                                "Axis-Aligned",
-                                "Smooth",
-                                "Lanczos",
-                                "Gaussian",
-                                "Catmull-Rom",
-                                "NURBS",
-                                "Radial Basis Fn",
-                                "Optical Flow",
-                                "Neural",
-                                "Akima Splines",
-                                "Inverse Distance",
-                                "Fourier",
-                                "Moving Least Sq",
-                                "Cubic Hermite"};
-  if (interpolation < (sizeof names / sizeof names[0]))
-    return names[interpolation];
-  return "Reserved";
-}
+  // Read footer, then
+  // 1. Recompute CRC from in-memory payload, unless the caller deferred it
+  ok = ok && read_splat4DFooter(fp, &v->footer);
+  if (ok && (!opts || opts->verify == SPLAT_READ_VERIFY_FULL))
+    ok = refs ? splat4d_verify_stored(v, &ft) : splat4d_verify(v);
+  if (ok && refs)
+    ok = expand_frame_refs(&v->index, &v->header, &ft);
+  frame_table_free(&ft);
+  if (!ok) {
+    free(v->palette.palette);
+    free(v->index.data);
+    v->palette.palette = NULL;
+    v->index.data = NULL;
+    return false;
+  }
 
-static void print_flag_line(FILE *out, const char *label, const char *value) {
-  if (!out || !label || !value)
-    return;
+  // 2. Validate offset consistency (a chunked footer points at the chunk table,
+  //    which read_index_chunked has already validated)
+  if (!chunked && !sanity_check_idxoffset_file(fp, &v->header, &v->footer)) {
+    LOG_ERROR("❌ Index offset mismatch (footer=%" PRIu64 ", expect=%" PRIu64 ")\n",
+              (uint64_t)v->footer.idxoffset, compute_idxoffset_forward(&v->header));
+    // free allocations before returning
+    free(v->palette.palette);
+    free(v->index.data);
+    v->palette.palette = NULL;
+    v->index.data = NULL;
+    return false;
+  }
 
-  char buffer[128];
-  int written = SAFE_SNPRINTF(buffer, sizeof buffer, "  %-12s %s", label, value);
-  if (written < 0)
-    return;
+  // 3. Validate footer end marker
+  if (v->footer.end != 0x4C505334) {
+    LOG_ERROR("❌ Invalid footer end marker\n");
+    free(v->palette.palette);
+    free(v->index.data);
+    v->palette.palette = NULL;
+    v->index.data = NULL;
+    return false;
+  }
 
-  size_t len = (size_t)written;
-  const size_t width = 27; // width of the content between the │ characters
+  return true;
+}
 
-  fputs("│", out);
-  fputs(buffer, out);
-  if (len < width) {
-    static const char spaces[] = "                           "; // 27 spaces
-    size_t pad = width - len;
-    if (pad <= 27)
-      fputs(spaces + 27 - pad, out);
-    else
-      for (size_t i = len; i < width; ++i)
-        fputc(' ', out);
-  }
-  fputs(" │\n", out);
+bool read_splat4DVideo(FILE *fp, Splat4DVideo *v) {
+  return read_splat4DVideoWithOptions(fp, v, NULL);
 }
 
-void print_flags(uint32_t flags) {
-  const char *endian = (flags & 0x1u) ? "Big-Endian" : "Little-Endian";
-  const char *sorted = (flags & 0x2u) ? "Yes" : "No";
-  uint32_t precision_bits = (flags >> 2) & 0x3u;
-  uint32_t compression_bits = (flags >> 4) & 0xFu;
-  uint32_t index_width_bits = (flags >> 8) & 0x3u;
-  uint32_t splat_shape_bits = (flags >> 10) & 0x3u;
-  uint32_t color_space_bits = (flags >> 12) & 0xFu;
-  uint32_t interpolation_bits = (flags >> 16) & 0xFu;
-  uint32_t encryption_bits = (flags >> 20) & 0xFu;
-  uint32_t metadata_bits = (flags >> 24) & 0xFFu;
+bool validate_splat4DVideo(const Splat4DVideo *v) {
+  if (!v) {
+    LOG_ERROR("❌ Video reference required\n");
+    return false;
+  }
 
-  char buffer[32];
+  if (v->header.magic != 0x3453504C) {
+    LOG_ERROR("❌ Unsupported format\n");
+    return false;
+  }
 
-  print_flag_line(stdout, "endian", endian);
-  print_flag_line(stdout, "sorted", sorted);
+  if (v->header.version[0] != 1) {
+    LOG_ERROR("❌ Unsupported version\n");
+    return false;
+  }
 
-  print_flag_line(stdout, "precision", precision_name(precision_bits));
-  print_flag_line(stdout, "compression", compression_name(compression_bits));
-  print_flag_line(stdout, "index width", index_width_name(index_width_bits));
-  print_flag_line(stdout, "splat shape", splat_shape_label(splat_shape_bits));
-  print_flag_line(stdout, "color space", color_space_name(color_space_bits));
-  print_flag_line(stdout, "interp", interpolation_name(interpolation_bits));
+  if (v->header.height == 0) {
+    LOG_ERROR("❌ Positive height required\n");
+    return false;
+  }
 
-  SAFE_SNPRINTF(buffer, sizeof buffer, "0x%X", encryption_bits);
-  print_flag_line(stdout, "encryption", buffer);
+  if (v->header.width == 0) {
+    LOG_ERROR("❌ Positive width required\n");
+    return false;
+  }
 
-  SAFE_SNPRINTF(buffer, sizeof buffer, "0x%02X", metadata_bits);
-  print_flag_line(stdout, "metadata", buffer);
-}
+  if (v->header.depth == 0) {
+    LOG_ERROR("❌ Positive depth required\n");
+    return false;
+  }
 
-void print_splat4DHeader(const Splat4DHeader *h) {
-  printf("│  magic        0X%-10X │\n", h->magic);
-  printf("│  version      %02d.%02d.%02d-%02d  │\n", h->version[0], h->version[1], h->version[2],
-         h->version[3]);
-  printf("│  width        0X%-10X │\n", h->width);
-  printf("│  height       0X%-10X │\n", h->height);
-  printf("│  depth        0X%-10X │\n", h->depth);
-  printf("│  frames       0X%-10X │\n", h->frames);
-  printf("│  palette size 0X%-10X │\n", h->pSize);
-  printf("│  flags        0X%-10X │\n", h->flags);
-  Splat4DFlags decoded = splat4d_flags_from_raw(h->flags);
-  printf("│    endian     %-14s │\n", splat_endian_name((SplatEndian)decoded.bits.endian));
-  printf("│    sort       %-14s │\n", splat_sort_order_name((SplatSortOrder)decoded.bits.sorted));
-  printf("│    precision  %-14s │\n", splat_precision_name((SplatPrecision)decoded.bits.precision));
-  printf("│    compress   %-14s │\n",
-         splat_compression_name((SplatCompression)decoded.bits.compression));
-  printf("│    index      %-14s │\n",
-         splat_index_width_name((SplatIndexWidth)decoded.bits.index_width));
-  printf("│    shape      %-14s │\n", splat_shape_name((SplatShape)decoded.bits.splat_shape));
-  printf("│    color      %-14s │\n",
-         splat_color_space_name((SplatColorSpace)decoded.bits.color_space));
-  printf("│    interp     %-14s │\n",
-         splat_interpolation_name((SplatInterpolation)decoded.bits.interpolation));
-  print_flags(h->flags);
-  printf("│  idxs %-20" PRIu64 " │\n", header_total_indices(h));
-  printf("│                            │\n");
-}
+  if (v->header.frames == 0) {
+    LOG_ERROR("❌ Positive number of frames required\n");
+    return false;
+  }
 
-bool write_splat4DHeader(FILE *fp, const Splat4DHeader *h) {
-  if (!fp || !h)
+  if (v->header.pSize == 0) {
+    LOG_ERROR("❌ Positive palette size required\n");
     return false;
-  uint8_t buf[SPLAT_HEADER_DISK_BYTES];
-  serialize_header(h, buf);
-  return fwrite(buf, 1, sizeof buf, fp) == sizeof buf;
-}
+  }
 
-bool read_splat4DHeader(FILE *fp, Splat4DHeader *h) {
-  if (!fp || !h)
+  if (!flags_supported(v->header.flags))
     return false;
-  uint8_t buf[SPLAT_HEADER_DISK_BYTES];
-  if (fread(buf, 1, sizeof buf, fp) != sizeof buf)
+
+  if (v->footer.end != 0x4C505334) {
+    LOG_ERROR("❌ Invalid end-of-file marker\n");
     return false;
-  deserialize_header(buf, h);
+  }
+
+  uint32_t expected = compute_video_checksum(v);
+  if (v->footer.checksum != expected) {
+    LOG_ERROR("❌ Checksum mismatch (got 0x%08X expected 0x%08X)\n", v->footer.checksum, expected);
+    return false;
+  }
+
+  printf("✅ 4Splat file validated!\n");
+
   return true;
 }
 
-// palette
-Splat4DPalette create_splat4DPalette(Splat4D *p) { return (Splat4DPalette){.palette = p}; }
-
-void print_splat4DPalette(const Splat4DVideo *v) {
-  if (!v->palette.palette)
+void free_splat4DVideo(Splat4DVideo *v) {
+  if (!v)
     return;
-  printf("├ Palette (%8u) ──      │\n", v->header.pSize);
-  for (uint32_t i = 0; i < v->header.pSize; i++)
-    print_splat4D(&v->palette.palette[i], i);
+  free(v->palette.palette);
+  free(v->index.data);
+  v->palette.palette = NULL;
+  v->index.data = NULL;
 }
 
-bool write_splat4DPalette(FILE *fp, const Splat4DPalette *p, uint32_t count, uint32_t flags) {
-  if (!fp || !p || !p->palette || count == 0)
+// --- memory-mapped reader ---------------------------------------------------
+//
+// An uncompressed file's index section already is the packed index array, so
+// it can be used where it lies: map the file, decode only the header and the
+// palette, and point at the index bytes. Opening costs the same for a 1 KB and
+// a 50 GB volume, and only the index pages actually touched become resident.
+// Compressed files have no in-place form and still go through
+// read_splat4DVideo().
+typedef struct {
+  Splat4DHeader header;
+  Splat4DPalette palette; // deserialized copy (owned)
+  Splat4DFooter footer;
+  const uint8_t *index; // index section in place, idx_width bytes per entry
+  uint8_t idx_width;
+  uint64_t total;
+  const uint8_t *base; // the whole file
+  size_t size;
+  bool mapped; // base is an mmap() region rather than a malloc'd copy
+} Splat4DMappedVideo;
+
+void splat4d_unmap_file(Splat4DMappedVideo *m) {
+  if (!m)
+    return;
+  free(m->palette.palette);
+#ifdef SPLAT_HAVE_MMAP
+  if (m->mapped)
+    munmap((void *)(uintptr_t)m->base, m->size);
+  else
+#endif
+    free((void *)(uintptr_t)m->base);
+  memset(m, 0, sizeof *m);
+}
+
+// Make the whole of `fp` addressable: mmap() when it is a regular file, or a
+// heap copy for streams without a descriptor (pipes, fmemopen, ...).
+static bool splat4d_map_bytes(FILE *fp, Splat4DMappedVideo *m) {
+#ifdef SPLAT_HAVE_MMAP
+  int fd = fileno(fp);
+  struct stat st;
+  fflush(fp); // a stream still open for writing may hold buffered bytes
+  if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+      (uint64_t)st.st_size <= SIZE_MAX) {
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      m->base = p;
+      m->size = (size_t)st.st_size;
+      m->mapped = true;
+      return true;
+    }
+  }
+#endif
+  if (fseek(fp, 0, SEEK_END) != 0)
+    return false;
+  long end = ftell(fp);
+  if (end <= 0 || fseek(fp, 0, SEEK_SET) != 0)
+    return false;
+  uint8_t *copy = malloc((size_t)end);
+  if (!copy)
     return false;
+  if (fread(copy, 1, (size_t)end, fp) != (size_t)end) {
+    free(copy);
+    return false;
+  }
+  m->base = copy;
+  m->size = (size_t)end;
+  m->mapped = false;
+  return true;
+}
 
-  size_t entry_bytes = palette_entry_disk_bytes(flags);
-  uint64_t bytes64 = 0;
-  if (!checked_mul_u64((uint64_t)count, (uint64_t)entry_bytes, &bytes64) || bytes64 > SIZE_MAX)
+// CRC of an uncompressed file is taken over exactly the bytes in front of the
+// footer, so verification is a single pass over the mapping.
+bool splat4d_verify_mapped(const Splat4DMappedVideo *m) {
+  if (!m || !m->base || m->size < SPLAT_FOOTER_DISK_BYTES)
     return false;
-  uint8_t *packed = malloc((size_t)bytes64);
-  if (!packed)
+  uint32_t crc = splat_crc32_parallel(m->base, m->size - SPLAT_FOOTER_DISK_BYTES);
+  if (crc != m->footer.checksum) {
+    LOG_ERROR("❌ CRC mismatch: file=0x%08X recomputed=0x%08X\n", m->footer.checksum, crc);
     return false;
-  for (uint32_t i = 0; i < count; ++i)
-    serialize_palette_entry(&p->palette[i], flags, packed + (size_t)i * entry_bytes);
-  bool ok = fwrite(packed, 1, (size_t)bytes64, fp) == (size_t)bytes64;
-  free(packed);
-  return ok;
+  }
+  return true;
 }
 
-bool read_splat4DPalette(FILE *fp, Splat4DPalette *p, uint32_t count, uint32_t flags) {
-  if (!fp || !p || count == 0)
+// Map the whole file behind `fp` (from offset 0, regardless of the stream
+// position). With `verify` false the CRC pass is skipped so the open does not
+// touch the index; splat4d_verify_mapped() runs it later on demand.
+bool splat4d_map_file(FILE *fp, Splat4DMappedVideo *m, bool verify) {
+  if (!fp || !m)
     return false;
-
-  // The in-memory palette is always full-precision Splat4D; the on-disk entries
-  // may be narrower, so allocate for the former and read/convert the latter.
-  uint64_t mem_bytes = 0;
-  if (!checked_mul_u64((uint64_t)count, (uint64_t)sizeof(Splat4D), &mem_bytes) ||
-      mem_bytes > SIZE_MAX)
+  memset(m, 0, sizeof *m);
+  if (!splat4d_map_bytes(fp, m))
     return false;
-  p->palette = malloc((size_t)mem_bytes);
-  if (!p->palette)
+
+  if (m->size < SPLAT_HEADER_DISK_BYTES + SPLAT_FOOTER_DISK_BYTES) {
+    LOG_ERROR("❌ File too small for a 4Splat container\n");
+    splat4d_unmap_file(m);
     return false;
+  }
+  deserialize_header(m->base, &m->header);
+  deserialize_footer(m->base + m->size - SPLAT_FOOTER_DISK_BYTES, &m->footer);
 
-  size_t entry_bytes = palette_entry_disk_bytes(flags);
-  uint64_t disk_bytes = 0;
-  if (!checked_mul_u64((uint64_t)count, (uint64_t)entry_bytes, &disk_bytes) ||
-      disk_bytes > SIZE_MAX) {
-    free(p->palette);
-    p->palette = NULL;
+  const Splat4DHeader *h = &m->header;
+  if (!header_readable(h)) {
+    splat4d_unmap_file(m);
     return false;
   }
-  uint8_t *packed = malloc((size_t)disk_bytes);
-  if (!packed) {
-    free(p->palette);
-    p->palette = NULL;
+  uint32_t codec = (h->flags & SPLAT_FLAG_COMPRESSION_MASK) >> SPLAT_FLAG_COMPRESSION_SHIFT;
+  if (codec != SPLAT_COMPRESSION_NONE) {
+    LOG_ERROR("❌ Compressed index (%s) cannot be mapped in place\n",
+              splat_compression_display_name(codec));
+    splat4d_unmap_file(m);
     return false;
   }
-  if (fread(packed, 1, (size_t)disk_bytes, fp) != (size_t)disk_bytes) {
-    free(packed);
-    free(p->palette);
-    p->palette = NULL;
+  if (h->version[2] != SPLAT_LAYOUT_MONOLITHIC) {
+    LOG_ERROR("❌ Chunked index layout cannot be mapped in place\n");
+    splat4d_unmap_file(m);
     return false;
   }
-  for (uint32_t i = 0; i < count; ++i)
-    deserialize_palette_entry(packed + (size_t)i * entry_bytes, flags, &p->palette[i]);
-  free(packed);
-  return true;
-}
 
-// index
-Splat4DIndex create_splat4DIndex(uint64_t *i) { return (Splat4DIndex){.index = i}; }
+  size_t entry_bytes = palette_entry_disk_bytes(h->flags);
+  uint64_t palette_bytes = 0, index_bytes = 0, total = 0;
+  m->idx_width = get_index_width_bytes(h->flags);
+  if (!checked_mul_u64(h->pSize, entry_bytes, &palette_bytes) ||
+      !header_total_indices_checked(h, &total) ||
+      !checked_mul_u64(total, m->idx_width, &index_bytes) ||
+      palette_bytes > m->size || index_bytes > m->size ||
+      (uint64_t)m->size != SPLAT_HEADER_DISK_BYTES + palette_bytes + index_bytes +
+                               SPLAT_FOOTER_DISK_BYTES) {
+    LOG_ERROR("❌ File size does not match the header\n");
+    splat4d_unmap_file(m);
+    return false;
+  }
+  m->total = total;
 
-void print_splat4DIndex(const Splat4DVideo *v) {
-  if (!v->index.index)
-    return;
-  uint64_t total = header_total_indices(&v->header);
-  printf("├ Index (%8" PRIu64 ") ────      │\n", total);
-  uint64_t n = total < 8 ? total : 8;
-  for (uint64_t i = 0; i < n; i++) {
-    printf("│   [%" PRIu64 "] %-20" PRIu64 " │\n", i, v->index.index[i]);
+  if (m->footer.end != 0x4C505334) {
+    LOG_ERROR("❌ Invalid footer end marker\n");
+    splat4d_unmap_file(m);
+    return false;
   }
-  if (total > n) {
-    printf("│   ... (%" PRIu64 " more)          │\n", total - n);
+  if (!sanity_check_idxoffset_file(fp, h, &m->footer)) {
+    LOG_ERROR("❌ Index offset mismatch\n");
+    splat4d_unmap_file(m);
+    return false;
+  }
+
+  m->palette.palette = malloc((size_t)h->pSize * sizeof(Splat4D));
+  if (!m->palette.palette) {
+    splat4d_unmap_file(m);
+    return false;
   }
+  const uint8_t *pal = m->base + SPLAT_HEADER_DISK_BYTES;
+  for (uint32_t i = 0; i < h->pSize; ++i)
+    deserialize_palette_entry(pal + (size_t)i * entry_bytes, h->flags, &m->palette.palette[i]);
+  m->index = pal + palette_bytes;
+
+  if (verify && !splat4d_verify_mapped(m)) {
+    splat4d_unmap_file(m);
+    return false;
+  }
+  return true;
 }
 
-// Pack the 64-bit index array down to idx_width bytes/entry into `out`
-// (malloc'd, so suitably aligned for the wider element writes).
-static void pack_index_to_buffer(const uint64_t *src, uint64_t total, uint8_t idx_width,
-                                 uint8_t *out) {
-  if (idx_width == 8) {
-    memcpy(out, src, (size_t)total * 8);
-  } else if (idx_width == 1) {
-    for (uint64_t k = 0; k < total; k++)
-      out[k] = (uint8_t)src[k];
-  } else if (idx_width == 2) {
-    uint16_t *p = (uint16_t *)out;
-    for (uint64_t k = 0; k < total; k++)
-      p[k] = (uint16_t)src[k];
-  } else {
-    uint32_t *p = (uint32_t *)out;
-    for (uint64_t k = 0; k < total; k++)
-      p[k] = (uint32_t)src[k];
-  }
-}
-
-static void unpack_index_from_buffer(const uint8_t *in, uint64_t total, uint8_t idx_width,
-                                     uint64_t *out) {
-  if (idx_width == 8) {
-    memcpy(out, in, (size_t)total * 8);
-  } else if (idx_width == 1) {
-    for (uint64_t k = 0; k < total; k++)
-      out[k] = in[k];
-  } else if (idx_width == 2) {
-    const uint16_t *p = (const uint16_t *)in;
-    for (uint64_t k = 0; k < total; k++)
-      out[k] = p[k];
-  } else {
-    const uint32_t *p = (const uint32_t *)in;
-    for (uint64_t k = 0; k < total; k++)
-      out[k] = p[k];
+// Entry `i` of a mapped index. The section need not be aligned to its width
+// (float16 palettes end on 2-byte boundaries), so entries are assembled
+// byte-wise as little-endian values.
+uint64_t splat4d_mapped_index(const Splat4DMappedVideo *m, uint64_t i) {
+  const uint8_t *p = m->index + i * m->idx_width;
+  switch (m->idx_width) {
+  case 1:
+    return p[0];
+  case 2:
+    return load_u16le(p);
+  case 4:
+    return load_u32le(p);
+  default:
+    return load_u64le(p);
   }
 }
 
-bool write_splat4DIndex(FILE *fp, const Splat4DIndex *i, uint64_t total, uint32_t flags) {
-  if (!fp || !i || !i->index || total == 0)
-    return false;
+// --- lossless image codec ---------------------------------------------------
+//
+// A 2D RGB image maps directly onto the format: each distinct color becomes a
+// palette splat (its r/g/b, with mu/sigma set from the spatial spread of the
+// pixels that use it), and every pixel stores the index of its color. Decoding
+// writes each pixel back from its palette color, so 8-bit RGB round-trips
+// exactly. Self-contained: no math library required.
 
-  uint8_t idx_width = get_index_width_bytes(flags);
-  if (idx_width == 8) {
-    return fwrite(i->index, sizeof(uint64_t), total, fp) == total;
-  } else {
-    uint8_t pack_buf[SPLAT4D_STREAM_CHUNK_SIZE];
-    uint64_t items_per_chunk = SPLAT4D_STREAM_CHUNK_SIZE / idx_width;
-    uint64_t items_written = 0;
-    while (items_written < total) {
-      uint64_t to_pack = total - items_written;
-      if (to_pack > items_per_chunk)
-        to_pack = items_per_chunk;
-
-      // ⚡ Bolt Optimization: Use restrict pointers to guarantee no aliasing,
-      // allowing better vectorization of these packing loops.
-      const uint64_t *restrict src = i->index + items_written;
-      if (idx_width == 1) {
-        uint8_t *restrict p = (uint8_t *)pack_buf;
-        for (uint64_t k = 0; k < to_pack; k++)
-          p[k] = (uint8_t)src[k];
-      } else if (idx_width == 2) {
-        uint16_t *restrict p = (uint16_t *)pack_buf;
-        for (uint64_t k = 0; k < to_pack; k++)
-          p[k] = (uint16_t)src[k];
-      } else if (idx_width == 4) {
-        uint32_t *restrict p = (uint32_t *)pack_buf;
-        for (uint64_t k = 0; k < to_pack; k++)
-          p[k] = (uint32_t)src[k];
-      }
+static double splat_sqrt(double x) {
+  if (x <= 0.0)
+    return 0.0;
+  double g = x > 1.0 ? x : 1.0;
+  for (int i = 0; i < 60; ++i)
+    g = 0.5 * (g + x / g);
+  return g;
+}
 
-      if (fwrite(pack_buf, idx_width, (size_t)to_pack, fp) != (size_t)to_pack)
-        return false;
-      items_written += to_pack;
-    }
-  }
-  return true;
+static size_t splat_next_pow2(size_t n) {
+  size_t p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
 }
 
-bool read_splat4DIndex(FILE *fp, Splat4DIndex *i, uint64_t total, uint32_t flags) {
-  if (!fp || !i || total == 0)
-    return false;
+// Map from a 24-bit 0xRRGGBB color to its palette index. It starts as an
+// open-addressing table that doubles at half load, so a few-color clip never
+// pays for a table sized by its pixel count. Keys and values are interleaved so
+// a probe touches one cache line, and the slot comes from the high bits of a
+// Fibonacci hash, which spreads neighbouring colors apart. Once the table would
+// grow past SPLAT_COLORMAP_HASH_SLOTS it is replaced by a direct 2^24-entry
+// lookup table, which costs at most twice the memory and never probes. A map
+// marked hashed_only keeps doubling instead, so its size follows the colors it
+// holds; owners of many live maps use it to stay within
+// SPLAT_COLORMAP_DIRECT_BUDGET.
+#define SPLAT_COLORMAP_HASH_SLOTS ((size_t)1 << 22)
+#define SPLAT_COLORMAP_DIRECT_SLOTS ((size_t)1 << 24)
+#define SPLAT_COLORMAP_DIRECT_BUDGET ((uint64_t)256 << 20)
 
-  uint64_t bytes64 = 0;
-  if (!checked_mul_u64(total, (uint64_t)sizeof(uint64_t), &bytes64) || bytes64 > SIZE_MAX)
-    return false;
-  size_t bytes = (size_t)bytes64;
-  i->index = malloc(bytes);
-  if (!i->index)
-    return false;
+typedef struct {
+  uint32_t key; // stored as color+1; 0 marks an empty slot
+  uint32_t val;
+} ColorSlot;
 
-  uint8_t idx_width = get_index_width_bytes(flags);
-  if (idx_width == 8) {
-    size_t total_count = (size_t)total;
-    if (fread(i->index, sizeof(uint64_t), total_count, fp) != total_count) {
-      free(i->index);
-      i->index = NULL;
+typedef struct {
+  ColorSlot *slot;  // hashed mode: cap slots
+  uint32_t *direct; // direct mode: value+1 per color, 0 when absent
+  size_t cap;       // power of two
+  unsigned shift;   // 32 - log2(cap)
+  size_t n;
+  bool hashed_only; // never switch to direct mode
+} ColorMap;
+
+static bool colormap_alloc(ColorMap *m, size_t cap, bool hashed_only) {
+  ColorMap fresh = {.hashed_only = hashed_only};
+  if (cap > SPLAT_COLORMAP_HASH_SLOTS && !hashed_only) {
+    fresh.direct = calloc(SPLAT_COLORMAP_DIRECT_SLOTS, sizeof(uint32_t));
+    fresh.cap = SPLAT_COLORMAP_DIRECT_SLOTS;
+    if (!fresh.direct)
       return false;
-    }
   } else {
-    uint8_t pack_buf[SPLAT4D_STREAM_CHUNK_SIZE];
-    uint64_t items_per_chunk = SPLAT4D_STREAM_CHUNK_SIZE / idx_width;
-    uint64_t items_read = 0;
-    while (items_read < total) {
-      uint64_t to_read = total - items_read;
-      if (to_read > items_per_chunk)
-        to_read = items_per_chunk;
-
-      if (fread(pack_buf, idx_width, (size_t)to_read, fp) != (size_t)to_read) {
-        free(i->index);
-        i->index = NULL;
-        return false;
-      }
-
-      // ⚡ Bolt Optimization: Use restrict pointers to guarantee no aliasing,
-      // allowing better vectorization of these unpacking loops.
-      uint64_t *restrict dst = i->index + items_read;
-      if (idx_width == 1) {
-        uint8_t *restrict p = (uint8_t *)pack_buf;
-        for (uint64_t k = 0; k < to_read; k++)
-          dst[k] = p[k];
-      } else if (idx_width == 2) {
-        uint16_t *restrict p = (uint16_t *)pack_buf;
-        for (uint64_t k = 0; k < to_read; k++)
-          dst[k] = p[k];
-      } else if (idx_width == 4) {
-        uint32_t *restrict p = (uint32_t *)pack_buf;
-        for (uint64_t k = 0; k < to_read; k++)
-          dst[k] = p[k];
-      }
-      items_read += to_read;
-    }
+    fresh.slot = calloc(cap, sizeof(ColorSlot));
+    fresh.cap = cap;
+    fresh.shift = 32;
+    for (size_t c = cap; c > 1; c >>= 1)
+      fresh.shift--;
+    if (!fresh.slot)
+      return false;
   }
+  *m = fresh;
   return true;
 }
 
-// footer
-Splat4DFooter create_splat4DFooter(const Splat4DHeader *h) {
-  return (Splat4DFooter){
-      .checksum = 0,
-      .idxoffset = (uint64_t)sizeof(Splat4DHeader) +
-                   (uint64_t)h->pSize * (uint64_t)palette_entry_disk_bytes(h->flags),
-      .end = 0x4C505334 // "LPS4"
-  };
+static bool colormap_init(ColorMap *m, size_t expected) {
+  return colormap_alloc(m, splat_next_pow2(expected < 16 ? 16 : expected * 2), false);
 }
 
-void print_splat4DFooter(const Splat4DFooter *f) {
-  printf("├ Footer ──────────────      │\n");
-  printf("│    checksum  0x%08X    │\n", f->checksum);
-  printf("│    idxoffset 0x%08" PRIX64 "   │\n", f->idxoffset);
-  printf("│    end       0x%08X    │\n", f->end);
+static void colormap_free(ColorMap *m) {
+  free(m->slot);
+  free(m->direct);
+  m->slot = NULL;
+  m->direct = NULL;
 }
 
-bool write_splat4DFooter(FILE *fp, const Splat4DFooter *f) {
-  if (!fp || !f)
-    return false;
-  uint8_t buf[SPLAT_FOOTER_DISK_BYTES];
-  serialize_footer(f, buf);
-  return fwrite(buf, 1, sizeof buf, fp) == sizeof buf;
+static inline size_t colormap_hash(const ColorMap *m, uint32_t color) {
+  return (size_t)((uint32_t)(color * 2654435769u) >> m->shift);
 }
 
-bool read_splat4DFooter(FILE *fp, Splat4DFooter *f) {
-  if (!fp || !f)
-    return false;
-  uint8_t buf[SPLAT_FOOTER_DISK_BYTES];
-  if (fread(buf, 1, sizeof buf, fp) != sizeof buf)
-    return false;
-  deserialize_footer(buf, f);
+// Look up `color`; if present set *out and return true, else return false.
+static bool colormap_get(const ColorMap *m, uint32_t color, uint32_t *out) {
+  if (m->direct) {
+    uint32_t v = m->direct[color & 0xFFFFFFu];
+    if (v == 0)
+      return false;
+    *out = v - 1;
+    return true;
+  }
+  size_t mask = m->cap - 1;
+  for (size_t h = colormap_hash(m, color); m->slot[h].key != 0; h = (h + 1) & mask) {
+    if (m->slot[h].key == color + 1) {
+      *out = m->slot[h].val;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void colormap_insert(ColorMap *m, uint32_t color, uint32_t value) {
+  if (m->direct) {
+    m->direct[color & 0xFFFFFFu] = value + 1;
+  } else {
+    size_t mask = m->cap - 1;
+    size_t h = colormap_hash(m, color);
+    while (m->slot[h].key != 0)
+      h = (h + 1) & mask;
+    m->slot[h].key = color + 1;
+    m->slot[h].val = value;
+  }
+  m->n++;
+}
+
+// Add a color known to be absent, doubling the table (or switching to direct
+// mode) first at half load.
+static bool colormap_put(ColorMap *m, uint32_t color, uint32_t value) {
+  if (!m->direct && (m->n + 1) * 2 > m->cap) {
+    ColorMap grown;
+    if (!colormap_alloc(&grown, m->cap * 2, m->hashed_only))
+      return false;
+    for (size_t h = 0; h < m->cap; ++h)
+      if (m->slot[h].key != 0)
+        colormap_insert(&grown, m->slot[h].key - 1, m->slot[h].val);
+    colormap_free(m);
+    *m = grown;
+  }
+  colormap_insert(m, color, value);
   return true;
 }
 
-// video
-Splat4DVideo create_splat4DVideo(const Splat4DHeader header, Splat4D *splats, uint64_t *idxs) {
-  Splat4DVideo v = {.header = header,
-                    .palette = create_splat4DPalette(splats),
-                    .index = create_splat4DIndex(idxs),
-                    .footer = create_splat4DFooter(&header)};
+// --- median-cut color quantization -----------------------------------------
+//
+// Reduce `nu` distinct colors (with pixel-count weights) to at most max_colors
+// representative colors. Fills quant_of[u] with the representative index for
+// each input color and rep_colors[j] with each representative's packed RGB;
+// returns the number of representatives, or 0 on allocation failure.
+//
+// All state lives in a MedianCut context, so concurrent encodes need no lock.
+// Each box caches its per-channel bounds, and the splittable boxes sit in a
+// max-heap keyed on their widest channel range (ties to the lower box number),
+// so a split costs O(box size) instead of a rescan of every box. The split box
+// is ordered along that channel with a stable 8-bit counting sort.
 
-  v.footer.checksum = compute_video_checksum(&v);
-  return v;
+typedef struct {
+  uint32_t start, end; // range of MedianCut.order
+  uint8_t lo[3], hi[3];
+} MedianCutBox;
+
+typedef struct {
+  const uint32_t *colors;
+  const double *counts;
+  uint32_t *order, *scratch; // nu color indices, grouped by box
+  MedianCutBox *boxes;
+  uint32_t *heap; // numbers of boxes with two or more colors
+  uint32_t nboxes, nheap;
+} MedianCut;
+
+static void mc_bounds(const MedianCut *mc, MedianCutBox *b) {
+  uint8_t lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+  for (uint32_t k = b->start; k < b->end; ++k) {
+    uint32_t c = mc->colors[mc->order[k]];
+    uint8_t ch[3] = {(uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c};
+    for (int d = 0; d < 3; ++d) {
+      if (ch[d] < lo[d])
+        lo[d] = ch[d];
+      if (ch[d] > hi[d])
+        hi[d] = ch[d];
+    }
+  }
+  memcpy(b->lo, lo, sizeof lo);
+  memcpy(b->hi, hi, sizeof hi);
+}
+
+// Widest channel range of box `b`; *channel gets the first channel (r, g, b
+// order) that has it.
+static uint32_t mc_range(const MedianCut *mc, uint32_t b, int *channel) {
+  const MedianCutBox *box = &mc->boxes[b];
+  uint32_t best = 0;
+  int best_d = 0;
+  for (int d = 0; d < 3; ++d) {
+    uint32_t range = (uint32_t)(box->hi[d] - box->lo[d]);
+    if (range > best) {
+      best = range;
+      best_d = d;
+    }
+  }
+  if (channel)
+    *channel = best_d;
+  return best;
 }
 
-void print_splat4DVideo(const Splat4DVideo *v) {
-  printf("╭─────── 4Splat Video ───────╮\n");
-  print_splat4DHeader(&v->header);
-  print_splat4DPalette(v);
-  print_splat4DIndex(v);
-  print_splat4DFooter(&v->footer);
-  printf("╰────────────────────────────╯\n");
+static bool mc_before(const MedianCut *mc, uint32_t a, uint32_t b) {
+  uint32_t ra = mc_range(mc, a, NULL), rb = mc_range(mc, b, NULL);
+  return ra > rb || (ra == rb && a < b);
 }
 
-// Pack the index to the header's index width, compress it with `codec` and
-// write the compressed bytes. Used for the on-disk index section whenever the
-// compression field is not None.
-static bool write_index_compressed(FILE *fp, const Splat4DVideo *v, uint32_t codec) {
-  uint64_t total = header_total_indices(&v->header);
-  uint8_t idx_width = get_index_width_bytes(v->header.flags);
-  uint64_t packed64;
-  if (!checked_mul_u64(total, idx_width, &packed64) || packed64 > SIZE_MAX)
-    return false;
-  size_t packed_len = (size_t)packed64;
+static void mc_heap_push(MedianCut *mc, uint32_t b) {
+  uint32_t i = mc->nheap++;
+  while (i > 0 && mc_before(mc, b, mc->heap[(i - 1) / 2])) {
+    mc->heap[i] = mc->heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  mc->heap[i] = b;
+}
 
-  uint8_t *packed = malloc(packed_len ? packed_len : 1);
-  if (!packed)
-    return false;
-  pack_index_to_buffer(v->index.index, total, idx_width, packed);
+static uint32_t mc_heap_pop(MedianCut *mc) {
+  uint32_t top = mc->heap[0], last = mc->heap[--mc->nheap], i = 0;
+  for (;;) {
+    uint32_t c = 2 * i + 1;
+    if (c >= mc->nheap)
+      break;
+    if (c + 1 < mc->nheap && mc_before(mc, mc->heap[c + 1], mc->heap[c]))
+      c++;
+    if (!mc_before(mc, mc->heap[c], last))
+      break;
+    mc->heap[i] = mc->heap[c];
+    i = c;
+  }
+  if (mc->nheap)
+    mc->heap[i] = last;
+  return top;
+}
+
+// Stable counting sort of order[s, e) by the 8-bit channel at `shift`.
+static void mc_sort_channel(MedianCut *mc, uint32_t s, uint32_t e, int shift) {
+  uint32_t offset[256] = {0};
+  for (uint32_t k = s; k < e; ++k)
+    offset[(mc->colors[mc->order[k]] >> shift) & 0xFF]++;
+  uint32_t pos = s;
+  for (int v = 0; v < 256; ++v) {
+    uint32_t n = offset[v];
+    offset[v] = pos;
+    pos += n;
+  }
+  for (uint32_t k = s; k < e; ++k) {
+    uint32_t u = mc->order[k];
+    mc->scratch[offset[(mc->colors[u] >> shift) & 0xFF]++] = u;
+  }
+  memcpy(mc->order + s, mc->scratch + s, (size_t)(e - s) * sizeof(uint32_t));
+}
+
+// Split the box with the widest channel range at the weighted median of that
+// channel; the upper half becomes a new box.
+static void mc_split(MedianCut *mc) {
+  int channel;
+  uint32_t b = mc_heap_pop(mc);
+  mc_range(mc, b, &channel);
+  uint32_t s = mc->boxes[b].start, e = mc->boxes[b].end;
+  mc_sort_channel(mc, s, e, 16 - 8 * channel);
+
+  double total = 0.0;
+  for (uint32_t k = s; k < e; ++k)
+    total += mc->counts[mc->order[k]];
+  double half = total / 2.0, acc = 0.0;
+  uint32_t m = s + 1;
+  for (uint32_t k = s; k < e; ++k) {
+    acc += mc->counts[mc->order[k]];
+    if (acc >= half) {
+      m = k + 1;
+      break;
+    }
+  }
+  if (m <= s)
+    m = s + 1;
+  if (m >= e)
+    m = e - 1;
+
+  uint32_t nb = mc->nboxes++;
+  mc->boxes[b].end = m;
+  mc->boxes[nb].start = m;
+  mc->boxes[nb].end = e;
+  mc_bounds(mc, &mc->boxes[b]);
+  mc_bounds(mc, &mc->boxes[nb]);
+  // Two distinct colors always differ in some channel, so size >= 2 implies a
+  // nonzero range.
+  if (m - s >= 2)
+    mc_heap_push(mc, b);
+  if (e - m >= 2)
+    mc_heap_push(mc, nb);
+}
 
-  size_t clen = 0;
-  uint8_t *comp = splat_compress(codec, packed, packed_len, &clen);
-  free(packed);
-  if (!comp)
-    return false;
+static uint32_t splat_median_cut(const uint32_t *colors, const double *counts, uint32_t nu,
+                                 uint32_t max_colors, uint32_t *quant_of, uint32_t *rep_colors) {
+  MedianCut mc = {.colors = colors, .counts = counts};
+  mc.order = malloc((size_t)nu * sizeof(uint32_t));
+  mc.scratch = malloc((size_t)nu * sizeof(uint32_t));
+  mc.boxes = malloc((size_t)max_colors * sizeof(MedianCutBox));
+  mc.heap = malloc((size_t)max_colors * sizeof(uint32_t));
+  if (!mc.order || !mc.scratch || !mc.boxes || !mc.heap) {
+    free(mc.order);
+    free(mc.scratch);
+    free(mc.boxes);
+    free(mc.heap);
+    return 0;
+  }
+  for (uint32_t i = 0; i < nu; ++i)
+    mc.order[i] = i;
+
+  mc.boxes[0].start = 0;
+  mc.boxes[0].end = nu;
+  mc_bounds(&mc, &mc.boxes[0]);
+  mc.nboxes = 1;
+  if (nu >= 2)
+    mc_heap_push(&mc, 0);
+  while (mc.nboxes < max_colors && mc.nheap > 0)
+    mc_split(&mc);
+
+  for (uint32_t b = 0; b < mc.nboxes; ++b) {
+    double sr = 0, sg = 0, sb = 0, sc = 0;
+    for (uint32_t k = mc.boxes[b].start; k < mc.boxes[b].end; ++k) {
+      uint32_t c = colors[mc.order[k]];
+      double wgt = counts[mc.order[k]];
+      sr += wgt * ((c >> 16) & 0xFF);
+      sg += wgt * ((c >> 8) & 0xFF);
+      sb += wgt * (c & 0xFF);
+      sc += wgt;
+      quant_of[mc.order[k]] = b;
+    }
+    uint32_t r = (uint32_t)(sr / sc + 0.5), gg = (uint32_t)(sg / sc + 0.5),
+             bb = (uint32_t)(sb / sc + 0.5);
+    rep_colors[b] = (r << 16) | (gg << 8) | bb;
+  }
 
-  bool ok = fwrite(comp, 1, clen, fp) == clen;
-  free(comp);
-  return ok;
+  free(mc.order);
+  free(mc.scratch);
+  free(mc.boxes);
+  free(mc.heap);
+  return mc.nboxes;
 }
 
-// Read `comp_len` compressed bytes, decompress to the exact index-payload size
-// and unpack into a freshly allocated 64-bit index array.
-static bool read_index_compressed(FILE *fp, Splat4DIndex *idx, uint64_t total, uint32_t flags,
-                                  size_t comp_len, uint32_t codec) {
-  uint8_t idx_width = get_index_width_bytes(flags);
-  uint64_t packed64;
-  if (!checked_mul_u64(total, idx_width, &packed64) || packed64 > SIZE_MAX)
-    return false;
-  size_t packed_len = (size_t)packed64;
-
-  uint8_t *cbuf = malloc(comp_len ? comp_len : 1);
-  if (!cbuf)
-    return false;
-  if (fread(cbuf, 1, comp_len, fp) != comp_len) {
-    free(cbuf);
-    return false;
+// --- shared quantizer tail ---------------------------------------------------
+//
+// The octree and Wu quantizers label each input color with a raw cell number
+// below `ncells`. Renumber the cells in first-appearance order and set each
+// representative to the weighted mean of the exact colors mapped to it.
+static uint32_t quantizer_finish(const uint32_t *colors, const double *counts, uint32_t nu,
+                                 uint32_t ncells, uint32_t *quant_of, uint32_t *rep_colors) {
+  uint32_t *remap = malloc((size_t)ncells * sizeof(uint32_t));
+  double *sum = calloc((size_t)(nu < ncells ? nu : ncells) * 4, sizeof(double));
+  if (!remap || !sum) {
+    free(remap);
+    free(sum);
+    return 0;
   }
+  for (uint32_t k = 0; k < ncells; ++k)
+    remap[k] = UINT32_MAX;
+  uint32_t n = 0;
+  for (uint32_t u = 0; u < nu; ++u) {
+    uint32_t *q = &remap[quant_of[u]];
+    if (*q == UINT32_MAX)
+      *q = n++;
+    quant_of[u] = *q;
+    uint32_t c = colors[u];
+    double *d = &sum[(size_t)*q * 4];
+    d[0] += counts[u] * ((c >> 16) & 0xFF);
+    d[1] += counts[u] * ((c >> 8) & 0xFF);
+    d[2] += counts[u] * (c & 0xFF);
+    d[3] += counts[u];
+  }
+  for (uint32_t b = 0; b < n; ++b) {
+    const double *d = &sum[(size_t)b * 4];
+    uint32_t r = (uint32_t)(d[0] / d[3] + 0.5), g = (uint32_t)(d[1] / d[3] + 0.5),
+             bb = (uint32_t)(d[2] / d[3] + 0.5);
+    rep_colors[b] = (r << 16) | (g << 8) | bb;
+  }
+  free(remap);
+  free(sum);
+  return n;
+}
+
+// --- octree color quantization ----------------------------------------------
+//
+// Gervautz-Purgathofer octree: the distinct colors are inserted in order, one
+// bit per channel per level, and whenever the tree holds more than max_colors
+// leaves the most recently added node on the deepest reducible level folds its
+// children into itself. Memory stays at O(max_colors) nodes, since folded
+// children are recycled, and each color costs at most eight steps, so this is
+// the cheapest quantizer on inputs with millions of distinct colors.
 
-  uint8_t *packed = malloc(packed_len ? packed_len : 1);
-  if (!packed) {
-    free(cbuf);
-    return false;
-  }
-  bool ok = splat_decompress(codec, cbuf, comp_len, packed, packed_len);
-  free(cbuf);
-  if (!ok) {
-    free(packed);
-    return false;
-  }
+#define OCTREE_NONE UINT32_MAX
 
-  uint64_t mem64;
-  if (!checked_mul_u64(total, (uint64_t)sizeof(uint64_t), &mem64) || mem64 > SIZE_MAX) {
-    free(packed);
-    return false;
+typedef struct {
+  uint32_t child[8]; // node numbers; 0 = absent (node 0 is the root)
+  uint32_t next;     // next node on its level's reducible list or the free list
+  bool leaf;
+} OctreeNode;
+
+typedef struct {
+  OctreeNode *nodes;
+  uint32_t n, cap, free_list, leaves;
+  uint32_t reducible[8]; // per level, the non-leaf nodes, newest first
+  int leaf_level;        // nodes created at this level start as leaves
+} Octree;
+
+static uint32_t octree_new_node(Octree *t, int level) {
+  uint32_t k = t->free_list;
+  if (k != OCTREE_NONE) {
+    t->free_list = t->nodes[k].next;
+  } else {
+    if (t->n == t->cap) {
+      uint32_t cap = t->cap ? t->cap * 2 : 64;
+      OctreeNode *grown =
+          cap > t->cap ? realloc(t->nodes, (size_t)cap * sizeof(OctreeNode)) : NULL;
+      if (!grown)
+        return OCTREE_NONE;
+      t->nodes = grown;
+      t->cap = cap;
+    }
+    k = t->n++;
   }
-  idx->index = malloc((size_t)mem64);
-  if (!idx->index) {
-    free(packed);
-    return false;
+  OctreeNode *node = &t->nodes[k];
+  memset(node, 0, sizeof *node);
+  node->leaf = level >= t->leaf_level;
+  if (node->leaf) {
+    t->leaves++;
+  } else {
+    node->next = t->reducible[level];
+    t->reducible[level] = k;
+  }
+  return k;
+}
+
+static inline int octree_child_slot(uint32_t color, int level) {
+  int bit = 7 - level;
+  return (int)((((color >> (16 + bit)) & 1) << 2) | (((color >> (8 + bit)) & 1) << 1) |
+               ((color >> bit) & 1));
+}
+
+// Fold the newest node of the deepest non-empty reducible level into a leaf.
+// Every level below it holds only leaves, so its children are all leaves.
+static void octree_reduce(Octree *t) {
+  int level = t->leaf_level - 1;
+  while (t->reducible[level] == OCTREE_NONE)
+    level--;
+  uint32_t k = t->reducible[level];
+  OctreeNode *node = &t->nodes[k];
+  t->reducible[level] = node->next;
+  uint32_t folded = 0;
+  for (int c = 0; c < 8; ++c) {
+    uint32_t child = node->child[c];
+    if (!child)
+      continue;
+    t->nodes[child].next = t->free_list;
+    t->free_list = child;
+    node->child[c] = 0;
+    folded++;
+  }
+  node->leaf = true;
+  t->leaves -= folded - 1;
+  t->leaf_level = level + 1;
+}
+
+static uint32_t octree_leaf(const Octree *t, uint32_t color) {
+  uint32_t k = 0;
+  for (int level = 0; !t->nodes[k].leaf; ++level)
+    k = t->nodes[k].child[octree_child_slot(color, level)];
+  return k;
+}
+
+static uint32_t splat_octree_quantize(const uint32_t *colors, const double *counts, uint32_t nu,
+                                      uint32_t max_colors, uint32_t *quant_of,
+                                      uint32_t *rep_colors) {
+  Octree t = {.free_list = OCTREE_NONE, .leaf_level = 8};
+  for (int level = 0; level < 8; ++level)
+    t.reducible[level] = OCTREE_NONE;
+  bool ok = octree_new_node(&t, 0) == 0;
+  for (uint32_t u = 0; ok && u < nu; ++u) {
+    uint32_t k = 0;
+    for (int level = 0; ok && !t.nodes[k].leaf; ++level) {
+      int slot = octree_child_slot(colors[u], level);
+      uint32_t child = t.nodes[k].child[slot];
+      if (!child) {
+        child = octree_new_node(&t, level + 1);
+        ok = child != OCTREE_NONE;
+        if (ok)
+          t.nodes[k].child[slot] = child;
+      }
+      k = child;
+    }
+    while (ok && t.leaves > max_colors)
+      octree_reduce(&t);
   }
-  unpack_index_from_buffer(packed, total, idx_width, idx->index);
-  free(packed);
-  return true;
+  uint32_t n = 0;
+  if (ok) {
+    for (uint32_t u = 0; u < nu; ++u)
+      quant_of[u] = octree_leaf(&t, colors[u]);
+    n = quantizer_finish(colors, counts, nu, t.n, quant_of, rep_colors);
+  }
+  free(t.nodes);
+  return n;
 }
 
-bool write_splat4DVideo(FILE *fp, Splat4DVideo *v) {
-  if (!fp || !v)
-    return false;
-
-  // Compute header-derived values
-  v->footer.idxoffset =
-      (uint64_t)sizeof(Splat4DHeader) +
-      (uint64_t)v->header.pSize * (uint64_t)palette_entry_disk_bytes(v->header.flags);
+// --- Wu color quantization --------------------------------------------------
+//
+// Xiaolin Wu's quantizer (Graphics Gems II, 1991). The weighted colors are
+// binned into a 32x32x32 histogram of cumulative moments, after which the
+// weight, channel sums and sum of squares of any box come from eight lookups.
+// The box with the largest variance is repeatedly cut at the plane that most
+// reduces the summed squared error. The cost after binning is independent of
+// the number of distinct colors, and the cuts minimize variance rather than
+// splitting at the median, so the palette is better for the same budget.
+
+#define WU_SIDE 33 // 32 bins per channel plus an all-zero plane at index 0
+#define WU_CELLS (WU_SIDE * WU_SIDE * WU_SIDE)
+#define WU_MAX_BOXES (32 * 32 * 32)
 
-  uint32_t codec = (v->header.flags & SPLAT_FLAG_COMPRESSION_MASK) >> SPLAT_FLAG_COMPRESSION_SHIFT;
+typedef struct {
+  double *w, *r, *g, *b, *m2; // cumulative moments, WU_CELLS each
+} WuMoments;
 
-  if (codec == SPLAT_COMPRESSION_NONE) {
-    // Uncompressed: the on-disk bytes equal the logical payload, so stream them
-    // straight to the file while accumulating the checksum.
-    crc32_t c;
-    crc32_init(&c);
-    Splat4DStreamFileCtx ctx = {.fp = fp, .crc = &c};
-    if (!stream_splat4DVideo(v, SPLAT4D_STREAM_CHUNK_SIZE, splat4d_stream_file_consumer, &ctx))
-      return false;
-    v->footer.checksum = crc32_final(&c);
-  } else {
-    // Compressed: the checksum covers the logical (uncompressed) payload so it
-    // is independent of the codec's byte output, while only the index section is
-    // physically compressed on disk.
-    v->footer.checksum = compute_video_checksum(v);
-    if (!write_splat4DHeader(fp, &v->header))
-      return false;
-    if (v->header.pSize > 0 &&
-        !write_splat4DPalette(fp, &v->palette, v->header.pSize, v->header.flags))
-      return false;
-    if (!write_index_compressed(fp, v, codec))
-      return false;
-  }
+typedef struct {
+  int r0, r1, g0, g1, b0, b1; // exclusive lower, inclusive upper bin
+} WuBox;
 
-  // Return to end of file and write footer
-  fseek(fp, 0, SEEK_END);
-  if (!write_splat4DFooter(fp, &v->footer))
-    return false;
+enum { WU_RED, WU_GREEN, WU_BLUE };
 
-  return true;
+static inline size_t wu_cell(int r, int g, int b) {
+  return ((size_t)r * WU_SIDE + (size_t)g) * WU_SIDE + (size_t)b;
 }
 
-bool read_splat4DVideo(FILE *fp, Splat4DVideo *v) {
-  if (!fp || !v)
-    return false;
-
-  // Null the owned pointers up front so every early-return path leaves the
-  // caller's struct in a consistent (freeable) state.
-  v->palette.palette = NULL;
-  v->index.index = NULL;
+// Histogram cell of a 0xRRGGBB color: the top five bits of each channel.
+static inline size_t wu_color_cell(uint32_t c) {
+  return wu_cell((int)((c >> 19) & 31) + 1, (int)((c >> 11) & 31) + 1, (int)((c >> 3) & 31) + 1);
+}
 
-  // Read header
-  if (!read_splat4DHeader(fp, &v->header))
-    return false;
+static double wu_volume(const WuBox *c, const double *m) {
+  return m[wu_cell(c->r1, c->g1, c->b1)] - m[wu_cell(c->r1, c->g1, c->b0)] -
+         m[wu_cell(c->r1, c->g0, c->b1)] + m[wu_cell(c->r1, c->g0, c->b0)] -
+         m[wu_cell(c->r0, c->g1, c->b1)] + m[wu_cell(c->r0, c->g1, c->b0)] +
+         m[wu_cell(c->r0, c->g0, c->b1)] - m[wu_cell(c->r0, c->g0, c->b0)];
+}
 
-  // Reject files that are not 4Splat containers before sizing any allocation
-  // from attacker-controlled header dimensions.
-  if (v->header.magic != 0x3453504C) {
-    LOG_ERROR("❌ Unsupported format\n");
-    return false;
-  }
-  if (v->header.version[0] != 1) {
-    LOG_ERROR("❌ Unsupported version\n");
-    return false;
+// The part of wu_volume() that does not depend on the cut position along `dir`.
+static double wu_bottom(const WuBox *c, int dir, const double *m) {
+  switch (dir) {
+  case WU_RED:
+    return -m[wu_cell(c->r0, c->g1, c->b1)] + m[wu_cell(c->r0, c->g1, c->b0)] +
+           m[wu_cell(c->r0, c->g0, c->b1)] - m[wu_cell(c->r0, c->g0, c->b0)];
+  case WU_GREEN:
+    return -m[wu_cell(c->r1, c->g0, c->b1)] + m[wu_cell(c->r1, c->g0, c->b0)] +
+           m[wu_cell(c->r0, c->g0, c->b1)] - m[wu_cell(c->r0, c->g0, c->b0)];
+  default:
+    return -m[wu_cell(c->r1, c->g1, c->b0)] + m[wu_cell(c->r1, c->g0, c->b0)] +
+           m[wu_cell(c->r0, c->g1, c->b0)] - m[wu_cell(c->r0, c->g0, c->b0)];
   }
+}
 
-  if (!flags_supported(v->header.flags))
-    return false;
-  if (v->header.pSize == 0) {
-    LOG_ERROR("❌ Invalid palette size\n");
-    return false;
+// The part of wu_volume() that does, with the box cut at `pos`.
+static double wu_top(const WuBox *c, int dir, int pos, const double *m) {
+  switch (dir) {
+  case WU_RED:
+    return m[wu_cell(pos, c->g1, c->b1)] - m[wu_cell(pos, c->g1, c->b0)] -
+           m[wu_cell(pos, c->g0, c->b1)] + m[wu_cell(pos, c->g0, c->b0)];
+  case WU_GREEN:
+    return m[wu_cell(c->r1, pos, c->b1)] - m[wu_cell(c->r1, pos, c->b0)] -
+           m[wu_cell(c->r0, pos, c->b1)] + m[wu_cell(c->r0, pos, c->b0)];
+  default:
+    return m[wu_cell(c->r1, c->g1, pos)] - m[wu_cell(c->r1, c->g0, pos)] -
+           m[wu_cell(c->r0, c->g1, pos)] + m[wu_cell(c->r0, c->g0, pos)];
   }
+}
 
-  uint64_t palette_bytes = 0;
-  if (!checked_mul_u64((uint64_t)v->header.pSize,
-                       (uint64_t)palette_entry_disk_bytes(v->header.flags), &palette_bytes) ||
-      palette_bytes > SIZE_MAX) {
-    LOG_ERROR("❌ Invalid palette size\n");
-    return false;
-  }
+static double wu_variance(const WuBox *c, const WuMoments *m) {
+  double dr = wu_volume(c, m->r), dg = wu_volume(c, m->g), db = wu_volume(c, m->b);
+  return wu_volume(c, m->m2) - (dr * dr + dg * dg + db * db) / wu_volume(c, m->w);
+}
 
-  uint64_t total = 0;
-  if (!header_total_indices_checked(&v->header, &total)) {
-    LOG_ERROR("❌ Invalid index count\n");
-    return false;
+// Best cut of `c` along `dir`: the score to maximize (the summed squared
+// channel totals over weight of both halves) and the cut bin in *cut, or -1.
+static double wu_maximize(const WuBox *c, int dir, int first, int last, int *cut,
+                          const double whole[4], const WuMoments *m) {
+  double base_r = wu_bottom(c, dir, m->r), base_g = wu_bottom(c, dir, m->g),
+         base_b = wu_bottom(c, dir, m->b), base_w = wu_bottom(c, dir, m->w);
+  double best = 0.0;
+  *cut = -1;
+  for (int i = first; i < last; ++i) {
+    double hr = base_r + wu_top(c, dir, i, m->r), hg = base_g + wu_top(c, dir, i, m->g),
+           hb = base_b + wu_top(c, dir, i, m->b), hw = base_w + wu_top(c, dir, i, m->w);
+    if (hw <= 0.0 || whole[3] - hw <= 0.0)
+      continue;
+    double score = (hr * hr + hg * hg + hb * hb) / hw;
+    hr = whole[0] - hr;
+    hg = whole[1] - hg;
+    hb = whole[2] - hb;
+    score += (hr * hr + hg * hg + hb * hb) / (whole[3] - hw);
+    if (score > best) {
+      best = score;
+      *cut = i;
+    }
   }
-
-  uint64_t index_bytes = 0;
-  if (!checked_mul_u64(total, (uint64_t)sizeof(uint64_t), &index_bytes) || index_bytes > SIZE_MAX) {
-    LOG_ERROR("❌ Invalid index count\n");
-    return false;
+  return best;
+}
+
+// Split `a` in two, leaving the upper half in `b`; false if it cannot be cut.
+static bool wu_cut(WuBox *a, WuBox *b, const WuMoments *m) {
+  double whole[4] = {wu_volume(a, m->r), wu_volume(a, m->g), wu_volume(a, m->b),
+                     wu_volume(a, m->w)};
+  int cut_r, cut_g, cut_b;
+  double max_r = wu_maximize(a, WU_RED, a->r0 + 1, a->r1, &cut_r, whole, m);
+  double max_g = wu_maximize(a, WU_GREEN, a->g0 + 1, a->g1, &cut_g, whole, m);
+  double max_b = wu_maximize(a, WU_BLUE, a->b0 + 1, a->b1, &cut_b, whole, m);
+  *b = *a;
+  if (max_r >= max_g && max_r >= max_b) {
+    if (cut_r < 0)
+      return false; // no cut along any channel separates weight
+    a->r1 = b->r0 = cut_r;
+  } else if (max_g >= max_r && max_g >= max_b) {
+    a->g1 = b->g0 = cut_g;
+  } else {
+    a->b1 = b->b0 = cut_b;
   }
+  return true;
+}
 
-  uint32_t codec = (v->header.flags & SPLAT_FLAG_COMPRESSION_MASK) >> SPLAT_FLAG_COMPRESSION_SHIFT;
-
-  // Reject headers whose declared sections cannot fit the actual file, before
-  // allocating anything sized from those (attacker-controlled) dimensions.
-  long after_header = ftell(fp);
-  if (after_header < 0 || fseek(fp, 0, SEEK_END) != 0)
-    return false;
-  long file_end = ftell(fp);
-  if (file_end < 0 || fseek(fp, after_header, SEEK_SET) != 0)
-    return false;
-  uint64_t filesize = (uint64_t)file_end;
+static bool wu_splittable(const WuBox *c) {
+  return (c->r1 - c->r0) * (c->g1 - c->g0) * (c->b1 - c->b0) > 1;
+}
 
-  uint64_t base = (uint64_t)SPLAT_HEADER_DISK_BYTES + SPLAT_FOOTER_DISK_BYTES;
-  if (palette_bytes > filesize || filesize - palette_bytes < base) {
-    LOG_ERROR("❌ Palette does not fit the file\n");
-    return false;
-  }
-  uint64_t index_room = filesize - palette_bytes - base; // on-disk bytes for the index
-  uint64_t ondisk_index = 0;
-  if (!checked_mul_u64(total, (uint64_t)get_index_width_bytes(v->header.flags), &ondisk_index)) {
-    LOG_ERROR("❌ Invalid index count\n");
-    return false;
+static uint32_t splat_wu_quantize(const uint32_t *colors, const double *counts, uint32_t nu,
+                                  uint32_t max_colors, uint32_t *quant_of, uint32_t *rep_colors) {
+  WuMoments m;
+  double *block = calloc((size_t)WU_CELLS * 5, sizeof(double));
+  uint32_t nbox_max = max_colors < WU_MAX_BOXES ? max_colors : WU_MAX_BOXES;
+  WuBox *boxes = malloc((size_t)nbox_max * sizeof(WuBox));
+  double *vv = malloc((size_t)nbox_max * sizeof(double));
+  uint32_t *tag = malloc((size_t)WU_CELLS * sizeof(uint32_t));
+  if (!block || !boxes || !vv || !tag) {
+    free(block);
+    free(boxes);
+    free(vv);
+    free(tag);
+    return 0;
   }
-  if (codec == SPLAT_COMPRESSION_NONE) {
-    if (ondisk_index > index_room) {
-      LOG_ERROR("❌ Index does not fit the file\n");
-      return false;
+  m.w = block;
+  m.r = m.w + WU_CELLS;
+  m.g = m.r + WU_CELLS;
+  m.b = m.g + WU_CELLS;
+  m.m2 = m.b + WU_CELLS;
+
+  for (uint32_t u = 0; u < nu; ++u) {
+    uint32_t c = colors[u];
+    double r = (double)((c >> 16) & 0xFF), g = (double)((c >> 8) & 0xFF), b = (double)(c & 0xFF);
+    size_t k = wu_color_cell(c);
+    double wgt = counts[u];
+    m.w[k] += wgt;
+    m.r[k] += wgt * r;
+    m.g[k] += wgt * g;
+    m.b[k] += wgt * b;
+    m.m2[k] += wgt * (r * r + g * g + b * b);
+  }
+
+  // Turn the histogram into cumulative moments over [1, r] x [1, g] x [1, b].
+  double *mom[5] = {m.w, m.r, m.g, m.b, m.m2};
+  for (int q = 0; q < 5; ++q) {
+    double *a = mom[q];
+    for (int r = 1; r < WU_SIDE; ++r) {
+      double area[WU_SIDE] = {0};
+      for (int g = 1; g < WU_SIDE; ++g) {
+        double line = 0.0;
+        for (int b = 1; b < WU_SIDE; ++b) {
+          line += a[wu_cell(r, g, b)];
+          area[b] += line;
+          a[wu_cell(r, g, b)] = a[wu_cell(r - 1, g, b)] + area[b];
+        }
+      }
     }
-  } else if (ondisk_index > SPLAT_MAX_COMPRESSED_INDEX_BYTES) {
-    LOG_ERROR("❌ Compressed index would decompress beyond the size limit\n");
-    return false;
   }
 
-  // Read palette
-  if (!read_splat4DPalette(fp, &v->palette, v->header.pSize, v->header.flags))
-    return false;
-
-  // Read index
-  if (codec == SPLAT_COMPRESSION_NONE) {
-    if (!read_splat4DIndex(fp, &v->index, total, v->header.flags)) {
-      free(v->palette.palette);
-      v->palette.palette = NULL;
-      return false;
-    }
-  } else {
-    // The compressed index section runs from the current position (the index
-    // offset) up to the fixed-size footer at end of file.
-    long index_start = ftell(fp);
-    if (index_start < 0 || fseek(fp, 0, SEEK_END) != 0) {
-      free(v->palette.palette);
-      v->palette.palette = NULL;
-      return false;
-    }
-    long file_end = ftell(fp);
-    if (file_end < 0 || fseek(fp, index_start, SEEK_SET) != 0 ||
-        file_end < index_start + (long)SPLAT_FOOTER_DISK_BYTES) {
-      LOG_ERROR("❌ Truncated compressed index\n");
-      free(v->palette.palette);
-      v->palette.palette = NULL;
-      return false;
-    }
-    size_t comp_len = (size_t)(file_end - index_start) - SPLAT_FOOTER_DISK_BYTES;
-    if (!read_index_compressed(fp, &v->index, total, v->header.flags, comp_len, codec)) {
-      LOG_ERROR("❌ Failed to decompress index\n");
-      free(v->palette.palette);
-      v->palette.palette = NULL;
-      return false;
+  boxes[0] = (WuBox){0, 32, 0, 32, 0, 32};
+  uint32_t nboxes = 1, next = 0;
+  vv[0] = wu_splittable(&boxes[0]) ? wu_variance(&boxes[0], &m) : 0.0;
+  while (nboxes < nbox_max) {
+    if (wu_cut(&boxes[next], &boxes[nboxes], &m)) {
+      vv[next] = wu_splittable(&boxes[next]) ? wu_variance(&boxes[next], &m) : 0.0;
+      vv[nboxes] = wu_splittable(&boxes[nboxes]) ? wu_variance(&boxes[nboxes], &m) : 0.0;
+      nboxes++;
+    } else {
+      vv[next] = 0.0;
     }
+    next = 0;
+    for (uint32_t k = 1; k < nboxes; ++k)
+      if (vv[k] > vv[next])
+        next = k;
+    if (vv[next] <= 0.0)
+      break;
   }
 
-  // Read footer
-  if (!read_splat4DFooter(fp, &v->footer)) {
-    free(v->palette.palette);
-    free(v->index.index);
-    v->palette.palette = NULL;
-    v->index.index = NULL;
-    return false;
+  for (uint32_t k = 0; k < nboxes; ++k) {
+    const WuBox *c = &boxes[k];
+    for (int r = c->r0 + 1; r <= c->r1; ++r)
+      for (int g = c->g0 + 1; g <= c->g1; ++g)
+        for (int b = c->b0 + 1; b <= c->b1; ++b)
+          tag[wu_cell(r, g, b)] = k;
   }
-
-  // ---- Validate footer ----
-  // 1. Recompute CRC from in-memory payload
-  uint32_t recomputed = compute_video_checksum(v);
-  if (recomputed != v->footer.checksum) {
-    LOG_ERROR("❌ CRC mismatch: file=0x%08X recomputed=0x%08X\n", v->footer.checksum, recomputed);
-    free(v->palette.palette);
-    free(v->index.index);
-    v->palette.palette = NULL;
-    v->index.index = NULL;
-    return false;
+  for (uint32_t u = 0; u < nu; ++u) {
+    quant_of[u] = tag[wu_color_cell(colors[u])];
   }
+  free(block);
+  free(boxes);
+  free(vv);
+  free(tag);
+  return quantizer_finish(colors, counts, nu, nboxes, quant_of, rep_colors);
+}
 
-  // 2. Validate offset consistency
-  if (!sanity_check_idxoffset_file(fp, &v->header, &v->footer)) {
-    LOG_ERROR("❌ Index offset mismatch (footer=%" PRIu64 ", expect=%" PRIu64 ")\n",
-              (uint64_t)v->footer.idxoffset,
-              (uint64_t)sizeof(Splat4DHeader) +
-                  (uint64_t)v->header.pSize * (uint64_t)palette_entry_disk_bytes(v->header.flags));
-    // free allocations before returning
-    free(v->palette.palette);
-    free(v->index.index);
-    v->palette.palette = NULL;
-    v->index.index = NULL;
-    return false;
+static uint32_t splat_quantize(SplatQuantizer q, const uint32_t *colors, const double *counts,
+                               uint32_t nu, uint32_t max_colors, uint32_t *quant_of,
+                               uint32_t *rep_colors) {
+  switch (q) {
+  case SPLAT_QUANTIZER_OCTREE:
+    return splat_octree_quantize(colors, counts, nu, max_colors, quant_of, rep_colors);
+  case SPLAT_QUANTIZER_WU:
+    return splat_wu_quantize(colors, counts, nu, max_colors, quant_of, rep_colors);
+  default:
+    return splat_median_cut(colors, counts, nu, max_colors, quant_of, rep_colors);
   }
+}
 
-  // 3. Validate footer end marker
-  if (v->footer.end != 0x4C505334) {
-    LOG_ERROR("❌ Invalid footer end marker\n");
-    free(v->palette.palette);
-    free(v->index.index);
-    v->palette.palette = NULL;
-    v->index.index = NULL;
-    return false;
-  }
+// --- k-means palette refinement ---------------------------------------------
+//
+// A quantizer maps each distinct color to the box or cell it falls in, which is
+// not always the nearest representative. Lloyd iterations fix that: assign each
+// distinct color to its nearest centroid, then move every centroid to the
+// weighted mean of its colors. The assignment runs in parallel over fixed
+// ranges of colors. Each search starts from the color's previous centroid, so
+// the bound is tight from the first comparison. Ties go to the lower centroid
+// number. The centroid update is a serial pass in color order, so the palette
+// does not depend on the thread count. Palettes above KMEANS_LINEAR_MAX
+// centroids are searched through a k-d tree rebuilt each iteration; smaller
+// ones are scanned from channel arrays the compiler can vectorize.
+#define KMEANS_TASK_COLORS ((uint32_t)1 << 14)
+#define KMEANS_LINEAR_MAX 32
 
-  return true;
-}
+typedef struct {
+  const uint32_t *colors;
+  uint32_t nu, k;
+  float *c[3];       // centroid r, g, b
+  uint32_t *perm;    // k-d tree: centroid numbers, each range's median in its middle
+  uint8_t *axis;     // k-d tree: split channel of the node at each position
+  uint32_t *assign;  // nearest centroid per color
+  uint64_t *changed; // per task: colors whose centroid moved
+} KMeans;
 
-bool validate_splat4DVideo(const Splat4DVideo *v) {
-  if (!v) {
-    LOG_ERROR("❌ Video reference required\n");
-    return false;
+typedef struct {
+  float q[3];
+  float d; // squared distance to idx
+  uint32_t idx;
+} KMeansQuery;
+
+static inline float kmeans_dist(const KMeans *km, const float q[3], uint32_t c) {
+  float dr = q[0] - km->c[0][c], dg = q[1] - km->c[1][c], db = q[2] - km->c[2][c];
+  return dr * dr + dg * dg + db * db;
+}
+
+static inline void kmeans_offer(KMeansQuery *s, float d, uint32_t c) {
+  if (d < s->d || (d == s->d && c < s->idx)) {
+    s->d = d;
+    s->idx = c;
+  }
+}
+
+// Partially sort perm[lo, hi) on channel `a` so perm[nth] holds the median.
+static void kd_select(KMeans *km, uint32_t lo, uint32_t hi, uint32_t nth, int a) {
+  const float *key = km->c[a];
+  uint32_t *p = km->perm;
+  while (hi - lo > 1) {
+    float pivot = key[p[lo + (hi - lo) / 2]];
+    uint32_t lt = lo, gt = hi, k = lo;
+    while (k < gt) { // three-way partition: < pivot, == pivot, > pivot
+      uint32_t v = p[k];
+      if (key[v] < pivot) {
+        p[k++] = p[lt];
+        p[lt++] = v;
+      } else if (key[v] > pivot) {
+        p[k] = p[--gt];
+        p[gt] = v;
+      } else {
+        k++;
+      }
+    }
+    if (nth < lt)
+      hi = lt;
+    else if (nth >= gt)
+      lo = gt;
+    else
+      return;
   }
+}
 
-  if (v->header.magic != 0x3453504C) {
-    LOG_ERROR("❌ Unsupported format\n");
-    return false;
+static void kd_build(KMeans *km, uint32_t lo, uint32_t hi) {
+  while (hi - lo > 1) {
+    float lo_v[3] = {255.0f, 255.0f, 255.0f}, hi_v[3] = {0.0f, 0.0f, 0.0f};
+    for (uint32_t i = lo; i < hi; ++i)
+      for (int a = 0; a < 3; ++a) {
+        float v = km->c[a][km->perm[i]];
+        lo_v[a] = v < lo_v[a] ? v : lo_v[a];
+        hi_v[a] = v > hi_v[a] ? v : hi_v[a];
+      }
+    int a = 0;
+    for (int d = 1; d < 3; ++d)
+      if (hi_v[d] - lo_v[d] > hi_v[a] - lo_v[a])
+        a = d;
+    uint32_t mid = lo + (hi - lo) / 2;
+    kd_select(km, lo, hi, mid, a);
+    km->axis[mid] = (uint8_t)a;
+    kd_build(km, lo, mid);
+    lo = mid + 1;
+  }
+  if (hi - lo == 1)
+    km->axis[lo] = 0;
+}
+
+static void kd_search(const KMeans *km, KMeansQuery *s, uint32_t lo, uint32_t hi) {
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2, c = km->perm[mid];
+    kmeans_offer(s, kmeans_dist(km, s->q, c), c);
+    int a = km->axis[mid];
+    float diff = s->q[a] - km->c[a][c];
+    if (diff < 0.0f) {
+      kd_search(km, s, lo, mid);
+      lo = mid + 1;
+    } else {
+      kd_search(km, s, mid + 1, hi);
+      hi = mid;
+    }
+    if (diff * diff > s->d)
+      return; // the far side is farther away than the best so far
+  }
+}
+
+static bool kmeans_assign_task(void *ctx, uint64_t task) {
+  KMeans *km = ctx;
+  uint32_t first = (uint32_t)task * KMEANS_TASK_COLORS;
+  uint32_t end = km->nu - first < KMEANS_TASK_COLORS ? km->nu : first + KMEANS_TASK_COLORS;
+  uint64_t changed = 0;
+  for (uint32_t u = first; u < end; ++u) {
+    uint32_t color = km->colors[u];
+    KMeansQuery s = {.q = {(float)((color >> 16) & 0xFF), (float)((color >> 8) & 0xFF),
+                           (float)(color & 0xFF)},
+                     .idx = km->assign[u]};
+    s.d = kmeans_dist(km, s.q, s.idx);
+    if (km->perm) {
+      kd_search(km, &s, 0, km->k);
+    } else {
+      for (uint32_t c = 0; c < km->k; ++c)
+        kmeans_offer(&s, kmeans_dist(km, s.q, c), c);
+    }
+    changed += s.idx != km->assign[u];
+    km->assign[u] = s.idx;
   }
+  km->changed[task] = changed;
+  return true;
+}
 
-  if (v->header.version[0] != 1) {
-    LOG_ERROR("❌ Unsupported version\n");
-    return false;
+// Refine a quantization of `nu` weighted colors into `k` representatives with
+// up to `iterations` Lloyd steps. quant_of/rep_colors hold the starting point
+// and receive the result; returns the final (nonzero) count, or 0 on failure.
+static uint32_t splat_kmeans_refine(const uint32_t *colors, const double *counts, uint32_t nu,
+                                    uint32_t k, uint32_t iterations, uint32_t *quant_of,
+                                    uint32_t *rep_colors) {
+  uint64_t ntasks = nu / KMEANS_TASK_COLORS + (nu % KMEANS_TASK_COLORS != 0);
+  KMeans km = {.colors = colors, .nu = nu, .k = k, .assign = quant_of};
+  float *cent = malloc((size_t)k * 3 * sizeof(float));
+  double *sum = malloc((size_t)k * 4 * sizeof(double));
+  km.changed = malloc((size_t)ntasks * sizeof(uint64_t));
+  if (k > KMEANS_LINEAR_MAX) {
+    km.perm = malloc((size_t)k * sizeof(uint32_t));
+    km.axis = malloc(k);
+  }
+  bool ok = cent && sum && km.changed && (k <= KMEANS_LINEAR_MAX || (km.perm && km.axis));
+  if (ok) {
+    km.c[0] = cent;
+    km.c[1] = cent + k;
+    km.c[2] = cent + 2 * (size_t)k;
+    for (uint32_t c = 0; c < k; ++c) {
+      km.c[0][c] = (float)((rep_colors[c] >> 16) & 0xFF);
+      km.c[1][c] = (float)((rep_colors[c] >> 8) & 0xFF);
+      km.c[2][c] = (float)(rep_colors[c] & 0xFF);
+    }
   }
-
-  if (v->header.height == 0) {
-    LOG_ERROR("❌ Positive height required\n");
-    return false;
+  for (uint32_t it = 0; ok && it < iterations; ++it) {
+    if (it > 0) { // move each centroid to the mean of its colors; empty ones stay
+      memset(sum, 0, (size_t)k * 4 * sizeof(double));
+      for (uint32_t u = 0; u < nu; ++u) {
+        double *d = &sum[(size_t)quant_of[u] * 4];
+        uint32_t c = colors[u];
+        d[0] += counts[u] * ((c >> 16) & 0xFF);
+        d[1] += counts[u] * ((c >> 8) & 0xFF);
+        d[2] += counts[u] * (c & 0xFF);
+        d[3] += counts[u];
+      }
+      for (uint32_t c = 0; c < k; ++c)
+        if (sum[(size_t)c * 4 + 3] > 0.0)
+          for (int a = 0; a < 3; ++a)
+            km.c[a][c] = (float)(sum[(size_t)c * 4 + a] / sum[(size_t)c * 4 + 3]);
+    }
+    if (km.perm) {
+      for (uint32_t c = 0; c < k; ++c)
+        km.perm[c] = c;
+      kd_build(&km, 0, k);
+    }
+    ok = splat_parallel_for(ntasks, kmeans_assign_task, &km);
+    uint64_t changed = 0;
+    for (uint64_t t = 0; ok && t < ntasks; ++t)
+      changed += km.changed[t];
+    if (changed == 0)
+      break;
   }
+  free(cent);
+  free(sum);
+  free(km.changed);
+  free(km.perm);
+  free(km.axis);
+  return ok ? quantizer_finish(colors, counts, nu, k, quant_of, rep_colors) : 0;
+}
 
-  if (v->header.width == 0) {
-    LOG_ERROR("❌ Positive width required\n");
-    return false;
-  }
+// --- parallel color histogram ----------------------------------------------
+//
+// The encoder's first pass finds every distinct color, its pixel count and the
+// palette index of each pixel. The pixels of all slices are split into
+// contiguous ranges (pixel k is pixel k % npix of slice k / npix). Each task
+// builds a private color table in first-appearance order. Merging the tables
+// in task order then reproduces the serial first-appearance palette exactly.
+// A second parallel pass writes each pixel's final index, through the median-cut
+// mapping when quantizing, at the width the final palette needs. Every task
+// table is live until the merge, so task tables only take the direct 2^24 mode
+// when all of them, plus the merged map, fit SPLAT_COLORMAP_DIRECT_BUDGET.
+#define SPLAT_HISTOGRAM_TASK_PIXELS ((uint64_t)1 << 18)
 
-  if (v->header.depth == 0) {
-    LOG_ERROR("❌ Positive depth required\n");
-    return false;
-  }
+typedef struct {
+  ColorMap map; // color -> slot in colors/counts
+  uint32_t *colors;
+  uint64_t *counts;
+  size_t n, cap;
+} ColorTable;
 
-  if (v->header.frames == 0) {
-    LOG_ERROR("❌ Positive number of frames required\n");
+typedef struct {
+  const uint8_t *const *slices;
+  uint64_t npix, total, per_task;
+  ColorTable *tables;      // histogram pass: one per task
+  bool hashed_tables;      // histogram pass: task maps stay hashed
+  const ColorMap *palette; // remap pass: color -> exact palette index
+  const uint32_t *quant_of; // remap pass: exact -> final index, or NULL
+  Splat4DIndex *index;
+} HistogramJob;
+
+static void color_table_free(ColorTable *t) {
+  colormap_free(&t->map);
+  free(t->colors);
+  free(t->counts);
+}
+
+// Slot of `color` in `t`, appending it with a zero count if new; UINT32_MAX
+// when out of memory or slots.
+static uint32_t color_table_slot(ColorTable *t, uint32_t color) {
+  uint32_t slot;
+  if (colormap_get(&t->map, color, &slot))
+    return slot;
+  if (t->n == UINT32_MAX - 1)
+    return UINT32_MAX;
+  if (t->n == t->cap) {
+    size_t new_cap = t->cap ? t->cap * 2 : 256;
+    uint32_t *gc = realloc(t->colors, new_cap * sizeof(uint32_t));
+    if (gc)
+      t->colors = gc;
+    uint64_t *gn = gc ? realloc(t->counts, new_cap * sizeof(uint64_t)) : NULL;
+    if (!gn)
+      return UINT32_MAX;
+    t->counts = gn;
+    t->cap = new_cap;
+  }
+  slot = (uint32_t)t->n;
+  if (!colormap_put(&t->map, color, slot))
+    return UINT32_MAX;
+  t->colors[slot] = color;
+  t->counts[slot] = 0;
+  t->n++;
+  return slot;
+}
+
+static inline uint32_t rgb8_color(const uint8_t *p) {
+  return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | (uint32_t)p[2];
+}
+
+static bool histogram_task(void *ctx, uint64_t task) {
+  HistogramJob *j = ctx;
+  ColorTable *t = &j->tables[task];
+  if (!colormap_alloc(&t->map, 512, j->hashed_tables))
     return false;
+  uint64_t first = task * j->per_task;
+  uint64_t end = j->total - first < j->per_task ? j->total : first + j->per_task;
+  uint32_t last_color = 0, last_slot = UINT32_MAX;
+  for (uint64_t k = first; k < end;) {
+    uint64_t i = k % j->npix;
+    uint64_t run = j->npix - i < end - k ? j->npix - i : end - k;
+    const uint8_t *rgb = j->slices[k / j->npix] + i * 3;
+    for (uint64_t p = 0; p < run; ++p, rgb += 3) {
+      uint32_t color = rgb8_color(rgb);
+      // Neighbouring pixels usually share a color; skip the probe for runs.
+      if (color != last_color || last_slot == UINT32_MAX) {
+        last_slot = color_table_slot(t, color);
+        if (last_slot == UINT32_MAX)
+          return false;
+        last_color = color;
+      }
+      t->counts[last_slot]++;
+    }
+    k += run;
   }
+  return true;
+}
 
-  if (v->header.pSize == 0) {
-    LOG_ERROR("❌ Positive palette size required\n");
-    return false;
+static bool remap_task(void *ctx, uint64_t task) {
+  HistogramJob *j = ctx;
+  uint64_t first = task * j->per_task;
+  uint64_t end = j->total - first < j->per_task ? j->total : first + j->per_task;
+  uint32_t last_color = 0, last_idx = 0;
+  bool have_last = false;
+  for (uint64_t k = first; k < end;) {
+    uint64_t i = k % j->npix;
+    uint64_t run = j->npix - i < end - k ? j->npix - i : end - k;
+    const uint8_t *rgb = j->slices[k / j->npix] + i * 3;
+    for (uint64_t p = 0; p < run; ++p, rgb += 3) {
+      uint32_t color = rgb8_color(rgb);
+      if (!have_last || color != last_color) {
+        if (!colormap_get(j->palette, color, &last_idx))
+          return false; // every color was seen by the histogram pass
+        if (j->quant_of)
+          last_idx = j->quant_of[last_idx];
+        last_color = color;
+        have_last = true;
+      }
+      splat4d_index_set(j->index, k + p, last_idx);
+    }
+    k += run;
   }
+  return true;
+}
 
-  if (!flags_supported(v->header.flags))
-    return false;
-
-  if (v->footer.end != 0x4C505334) {
-    LOG_ERROR("❌ Invalid end-of-file marker\n");
-    return false;
+// Histogram pass: the distinct colors of all slices in first-appearance order
+// (*colors, with their pixel counts in *counts) and the map from each color to
+// its position. On success the caller frees the arrays and the map.
+static bool build_color_histogram(HistogramJob *j, ColorMap *map, uint32_t **colors,
+                                  double **counts, size_t *ncolors) {
+  uint64_t ntasks = j->total / SPLAT_HISTOGRAM_TASK_PIXELS + 1;
+  if (ntasks > splat4d_thread_count())
+    ntasks = splat4d_thread_count();
+  j->per_task = j->total / ntasks + (j->total % ntasks != 0);
+  ntasks = j->total / j->per_task + (j->total % j->per_task != 0);
+  j->hashed_tables = (ntasks + 1) * SPLAT_COLORMAP_DIRECT_SLOTS * sizeof(uint32_t) >
+                     SPLAT_COLORMAP_DIRECT_BUDGET;
+  j->tables = calloc((size_t)ntasks, sizeof(ColorTable));
+  bool ok = j->tables && splat_parallel_for(ntasks, histogram_task, j);
+
+  size_t hint = 0;
+  for (uint64_t t = 0; ok && t < ntasks; ++t)
+    hint = j->tables[t].n > hint ? j->tables[t].n : hint;
+  ColorTable merged = {0};
+  ok = ok && colormap_init(&merged.map, hint);
+  for (uint64_t t = 0; ok && t < ntasks; ++t) {
+    const ColorTable *part = &j->tables[t];
+    for (size_t u = 0; ok && u < part->n; ++u) {
+      uint32_t slot = color_table_slot(&merged, part->colors[u]);
+      ok = slot != UINT32_MAX;
+      if (ok)
+        merged.counts[slot] += part->counts[u];
+    }
   }
+  for (uint64_t t = 0; j->tables && t < ntasks; ++t)
+    color_table_free(&j->tables[t]);
+  free(j->tables);
+  j->tables = NULL;
 
-  uint32_t expected = compute_video_checksum(v);
-  if (v->footer.checksum != expected) {
-    LOG_ERROR("❌ Checksum mismatch (got 0x%08X expected 0x%08X)\n", v->footer.checksum, expected);
+  double *weights = ok ? malloc((merged.n ? merged.n : 1) * sizeof(double)) : NULL;
+  if (!weights) {
+    color_table_free(&merged);
     return false;
   }
-
-  printf("✅ 4Splat file validated!\n");
-
+  for (size_t u = 0; u < merged.n; ++u)
+    weights[u] = (double)merged.counts[u];
+  free(merged.counts);
+  *map = merged.map;
+  *colors = merged.colors;
+  *counts = weights;
+  *ncolors = merged.n;
   return true;
 }
 
-void free_splat4DVideo(Splat4DVideo *v) {
-  if (!v)
-    return;
-  free(v->palette.palette);
-  free(v->index.index);
-  v->palette.palette = NULL;
-  v->index.index = NULL;
-}
-
-// --- lossless image codec ---------------------------------------------------
+// --- parallel splat statistics ---------------------------------------------
 //
-// A 2D RGB image maps directly onto the format: each distinct color becomes a
-// palette splat (its r/g/b, with mu/sigma set from the spatial spread of the
-// pixels that use it), and every pixel stores the index of its color. Decoding
-// writes each pixel back from its palette color, so 8-bit RGB round-trips
-// exactly. Self-contained: no math library required.
+// Each final palette entry becomes a splat whose mu/sigma come from the mean
+// and variance of the (x, y, z, t) positions of its pixels. The index is walked
+// a row at a time, since y, z and t are constant along a row and x is the loop
+// counter, so no pixel needs a division. Rows are split into fixed-size tasks.
+// Each task sums exact u64 moments into its own accumulators. Tasks run in
+// batches sized by thread count and memory, and each batch is folded into
+// double totals in task order. The task split depends only on the clip, so the
+// result is the same for every thread count and batch size.
+#define SPLAT_STATS_TASK_PIXELS ((uint64_t)1 << 20)
+#define SPLAT_STATS_BATCH_BYTES ((uint64_t)64 << 20)
 
-static double splat_sqrt(double x) {
-  if (x <= 0.0)
-    return 0.0;
-  double g = x > 1.0 ? x : 1.0;
-  for (int i = 0; i < 60; ++i)
-    g = 0.5 * (g + x / g);
-  return g;
-}
+typedef struct {
+  uint64_t n, sx, sxx, sy, syy, sz, szz, st, stt;
+} SplatMoments;
 
-static size_t splat_next_pow2(size_t n) {
-  size_t p = 1;
-  while (p < n)
-    p <<= 1;
-  return p;
-}
+typedef struct {
+  double n, sx, sxx, sy, syy, sz, szz, st, stt;
+} SplatMomentSums;
+
+// Make rows [row0, row0 + nrows) of the final index readable: *view receives
+// an index that holds them, starting with row *view_row0.
+typedef bool (*SplatRowLoader)(void *ctx, uint64_t row0, uint64_t nrows,
+                               const Splat4DIndex **view, uint64_t *view_row0);
 
-// Open-addressing map from a 24-bit 0xRRGGBB color to its palette index.
 typedef struct {
-  uint32_t *key; // stored as color+1; 0 marks an empty slot
-  uint32_t *val;
-  size_t cap; // power of two
-} ColorMap;
+  const Splat4DIndex *index; // rows of the running batch, from row0 on
+  uint64_t row0;
+  uint32_t w, h, depth, palette_n;
+  uint64_t rows, rows_per_task, task0;
+  SplatMoments *acc; // palette_n entries per task of the running batch
+} StatsJob;
+
+static inline void moments_add(SplatMoments *m, uint64_t x, uint64_t y, uint64_t yy, uint64_t z,
+                               uint64_t zz, uint64_t t, uint64_t tt) {
+  m->n++;
+  m->sx += x;
+  m->sxx += x * x;
+  m->sy += y;
+  m->syy += yy;
+  m->sz += z;
+  m->szz += zz;
+  m->st += t;
+  m->stt += tt;
+}
+
+#define SPLAT_STATS_ROW(ptr)                                                                       \
+  for (uint64_t x = 0; x < j->w; ++x)                                                              \
+    moments_add(&acc[(ptr)[x]], x, y, y * y, z, z * z, t, t * t);
+
+static bool stats_task(void *ctx, uint64_t slot) {
+  StatsJob *j = ctx;
+  SplatMoments *acc = j->acc + slot * j->palette_n;
+  memset(acc, 0, (size_t)j->palette_n * sizeof(SplatMoments));
+  uint64_t first = (j->task0 + slot) * j->rows_per_task;
+  uint64_t end = j->rows - first < j->rows_per_task ? j->rows : first + j->rows_per_task;
+  uint64_t s = first / j->h, y = first % j->h;
+  for (uint64_t r = first; r < end; ++r) {
+    uint64_t z = s % j->depth, t = s / j->depth, base = (r - j->row0) * j->w;
+    switch (j->index->width) {
+    case 1:
+      SPLAT_STATS_ROW(j->index->u8 + base)
+      break;
+    case 2:
+      SPLAT_STATS_ROW(j->index->u16 + base)
+      break;
+    case 4:
+      SPLAT_STATS_ROW(j->index->u32 + base)
+      break;
+    default:
+      return false;
+    }
+    if (++y == j->h) {
+      y = 0;
+      ++s;
+    }
+  }
+  return true;
+}
 
-static bool colormap_init(ColorMap *m, size_t expected) {
-  size_t cap = splat_next_pow2(expected < 16 ? 16 : expected * 2);
-  m->key = calloc(cap, sizeof(uint32_t));
-  m->val = malloc(cap * sizeof(uint32_t));
-  if (!m->key || !m->val) {
-    free(m->key);
-    free(m->val);
+#undef SPLAT_STATS_ROW
+
+// Position moments per palette entry of a w x h x depth x frames index whose
+// entries are all below palette_n, with rows supplied by `load`. A loader that
+// copies rows (`copies`) also bounds the batch by SPLAT_STATS_BATCH_BYTES of
+// 4-byte entries. On success the caller frees *out.
+static bool splat_moments_from_rows(uint32_t w, uint32_t h, uint32_t depth, uint32_t frames,
+                                    uint32_t palette_n, SplatRowLoader load, void *load_ctx,
+                                    bool copies, SplatMomentSums **out) {
+  uint64_t rows = (uint64_t)h * depth * frames;
+  uint64_t maxc = w > h ? w : h;
+  maxc = depth > maxc ? depth : maxc;
+  maxc = (frames > maxc ? frames : maxc) - 1;
+  // Bound rows per task so a task's sum of squared coordinates fits in u64.
+  uint64_t rows_cap = maxc ? UINT64_MAX / (maxc * maxc) / w : rows;
+  if (rows_cap == 0) {
+    LOG_ERROR("❌ Dimensions too large for splat statistics\n");
     return false;
   }
-  m->cap = cap;
+  uint64_t target = (uint64_t)palette_n * 16 > SPLAT_STATS_TASK_PIXELS
+                        ? (uint64_t)palette_n * 16
+                        : SPLAT_STATS_TASK_PIXELS;
+  StatsJob j = {.w = w, .h = h, .depth = depth, .palette_n = palette_n, .rows = rows};
+  j.rows_per_task = target / w ? target / w : 1;
+  if (j.rows_per_task > rows_cap)
+    j.rows_per_task = rows_cap;
+  uint64_t ntasks = rows / j.rows_per_task + (rows % j.rows_per_task != 0);
+  uint64_t entry_bytes = (uint64_t)palette_n * sizeof(SplatMoments);
+  uint64_t batch = SPLAT_STATS_BATCH_BYTES / entry_bytes;
+  if (copies && batch > SPLAT_STATS_BATCH_BYTES / (j.rows_per_task * w * 4))
+    batch = SPLAT_STATS_BATCH_BYTES / (j.rows_per_task * w * 4);
+  if (batch > splat4d_thread_count())
+    batch = splat4d_thread_count();
+  if (batch > ntasks)
+    batch = ntasks;
+  if (batch == 0)
+    batch = 1;
+
+  SplatMomentSums *sums = calloc(palette_n, sizeof(SplatMomentSums));
+  j.acc = malloc((size_t)(batch * entry_bytes));
+  bool ok = sums && j.acc;
+  for (j.task0 = 0; ok && j.task0 < ntasks; j.task0 += batch) {
+    uint64_t n = ntasks - j.task0 < batch ? ntasks - j.task0 : batch;
+    uint64_t row0 = j.task0 * j.rows_per_task;
+    uint64_t nrows = rows - row0 < n * j.rows_per_task ? rows - row0 : n * j.rows_per_task;
+    ok = load(load_ctx, row0, nrows, &j.index, &j.row0) &&
+         splat_parallel_for(n, stats_task, &j);
+    for (uint64_t k = 0; ok && k < n; ++k) {
+      const SplatMoments *m = j.acc + k * palette_n;
+      for (uint32_t e = 0; e < palette_n; ++e) {
+        SplatMomentSums *d = &sums[e];
+        d->n += (double)m[e].n;
+        d->sx += (double)m[e].sx;
+        d->sxx += (double)m[e].sxx;
+        d->sy += (double)m[e].sy;
+        d->syy += (double)m[e].syy;
+        d->sz += (double)m[e].sz;
+        d->szz += (double)m[e].szz;
+        d->st += (double)m[e].st;
+        d->stt += (double)m[e].stt;
+      }
+    }
+  }
+  free(j.acc);
+  if (!ok) {
+    free(sums);
+    return false;
+  }
+  *out = sums;
   return true;
 }
 
-static void colormap_free(ColorMap *m) {
-  free(m->key);
-  free(m->val);
-  m->key = m->val = NULL;
+static bool whole_index_rows(void *ctx, uint64_t row0, uint64_t nrows, const Splat4DIndex **view,
+                             uint64_t *view_row0) {
+  (void)row0;
+  (void)nrows;
+  *view = ctx;
+  *view_row0 = 0;
+  return true;
 }
 
-// Look up `color`; if present set *out and return true, else return false.
-static bool colormap_get(const ColorMap *m, uint32_t color, uint32_t *out) {
-  size_t mask = m->cap - 1;
-  size_t h = ((size_t)color * 2654435761u) & mask;
-  while (m->key[h] != 0) {
-    if (m->key[h] == color + 1) {
-      *out = m->val[h];
-      return true;
-    }
-    h = (h + 1) & mask;
+// splat_moments_from_rows() over an index held in memory.
+static bool splat_palette_moments(const Splat4DIndex *index, uint32_t w, uint32_t h,
+                                  uint32_t depth, uint32_t frames, uint32_t palette_n,
+                                  SplatMomentSums **out) {
+  return splat_moments_from_rows(w, h, depth, frames, palette_n, whole_index_rows,
+                                 (void *)index, false, out);
+}
+
+// Decide the final palette for `pal_n` distinct colors: the colors themselves
+// (*quant_of = NULL, *rep = colors) when they fit opts->max_colors, otherwise
+// the quantizer's representatives (optionally k-means refined) with the map
+// from each distinct color to its representative in *quant_of. Returns the
+// final entry count, or 0 on failure with nothing left to free.
+static uint32_t splat_choose_palette(uint32_t *colors, const double *counts, size_t pal_n,
+                                     const Splat4DEncodeOptions *opts, uint32_t **quant_of,
+                                     uint32_t **rep) {
+  uint32_t max_colors = opts ? opts->max_colors : 0;
+  *quant_of = NULL;
+  *rep = colors; // exact: representatives are the colors themselves
+  if (max_colors == 0 || (uint64_t)max_colors >= pal_n)
+    return (uint32_t)pal_n;
+  uint32_t *q = malloc(pal_n * sizeof(uint32_t));
+  uint32_t *r = malloc((size_t)max_colors * sizeof(uint32_t));
+  uint32_t final_n =
+      q && r ? splat_quantize(opts->quantizer, colors, counts, (uint32_t)pal_n, max_colors, q, r)
+             : 0;
+  if (final_n > 1 && opts->refine_iterations > 0)
+    final_n = splat_kmeans_refine(colors, counts, (uint32_t)pal_n, final_n,
+                                  opts->refine_iterations, q, r);
+  if (final_n == 0) {
+    free(q);
+    free(r);
+    return 0;
+  }
+  *quant_of = q;
+  *rep = r;
+  return final_n;
+}
+
+// The splat for each final palette entry: its moments give mu/sigma and its
+// representative color gives r/g/b.
+static void splat_palette_from_moments(const SplatMomentSums *sums, const uint32_t *rep,
+                                       uint32_t n, Splat4D *palette) {
+  for (uint32_t j = 0; j < n; ++j) {
+    const SplatMomentSums *m = &sums[j];
+    double cnt = m->n > 0 ? m->n : 1.0;
+    double mx = m->sx / cnt, my = m->sy / cnt, mz = m->sz / cnt, mt = m->st / cnt;
+    double vx = m->sxx / cnt - mx * mx;
+    double vy = m->syy / cnt - my * my;
+    double vz = m->szz / cnt - mz * mz;
+    double vt = m->stt / cnt - mt * mt;
+    uint32_t c = rep[j];
+    palette[j] = create_splat4D(
+        (float)mx, (float)splat_sqrt(vx), (float)my, (float)splat_sqrt(vy), (float)mz,
+        (float)splat_sqrt(vz), (float)mt, (float)splat_sqrt(vt), (float)((c >> 16) & 0xFF) / 255.0f,
+        (float)((c >> 8) & 0xFF) / 255.0f, (float)(c & 0xFF) / 255.0f, 1.0f);
   }
-  return false;
-}
-
-static void colormap_put(ColorMap *m, uint32_t color, uint32_t value) {
-  size_t mask = m->cap - 1;
-  size_t h = ((size_t)color * 2654435761u) & mask;
-  while (m->key[h] != 0)
-    h = (h + 1) & mask;
-  m->key[h] = color + 1;
-  m->val[h] = value;
 }
 
-// --- median-cut color quantization -----------------------------------------
+// --- palette order -----------------------------------------------------------
 //
-// Reduce `nu` distinct colors (with pixel-count weights) to at most max_colors
-// representative colors. Fills quant_of[u] with the representative index for
-// each input color and rep_colors[j] with each representative's packed RGB;
-// returns the number of representatives, or 0 on allocation failure.
-
-static const uint32_t *g_mc_colors; // sort context (single-threaded CLI/codec)
-static int g_mc_shift;
-
-static int mc_channel_cmp(const void *a, const void *b) {
-  int va = (int)((g_mc_colors[*(const uint32_t *)a] >> g_mc_shift) & 0xFF);
-  int vb = (int)((g_mc_colors[*(const uint32_t *)b] >> g_mc_shift) & 0xFF);
-  return va - vb;
-}
-
-static uint32_t splat_median_cut(const uint32_t *colors, const double *counts, uint32_t nu,
-                                 uint32_t max_colors, uint32_t *quant_of, uint32_t *rep_colors) {
-  uint32_t *order = malloc((size_t)nu * sizeof(uint32_t));
-  uint32_t *bstart = malloc((size_t)max_colors * sizeof(uint32_t));
-  uint32_t *bend = malloc((size_t)max_colors * sizeof(uint32_t));
-  if (!order || !bstart || !bend) {
-    free(order);
-    free(bstart);
-    free(bend);
-    return 0;
-  }
-  for (uint32_t i = 0; i < nu; ++i)
-    order[i] = i;
-
-  bstart[0] = 0;
-  bend[0] = nu;
-  uint32_t nboxes = 1;
-
-  while (nboxes < max_colors) {
-    // Pick the splittable box with the widest single-channel range.
-    int best = -1;
-    uint32_t best_range = 0, best_shift = 16;
-    for (uint32_t b = 0; b < nboxes; ++b) {
-      if (bend[b] - bstart[b] < 2)
-        continue;
-      int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
-      for (uint32_t k = bstart[b]; k < bend[b]; ++k) {
-        uint32_t c = colors[order[k]];
-        int ch[3] = {(int)((c >> 16) & 0xFF), (int)((c >> 8) & 0xFF), (int)(c & 0xFF)};
-        for (int d = 0; d < 3; ++d) {
-          if (ch[d] < lo[d])
-            lo[d] = ch[d];
-          if (ch[d] > hi[d])
-            hi[d] = ch[d];
-        }
+// The histogram numbers colors by first appearance, which says nothing about
+// how the index compresses. A palette order renumbers the final entries once
+// their statistics are known: frequent entries get small numbers, or entries
+// used in the same region of the clip get nearby numbers. RLE, the delta
+// transform and the entropy coders all see fewer distinct byte values and
+// longer matches. The co-occurrence order counts adjacent pixel pairs in an
+// n x n matrix, so palettes above SPLAT_COOCCURRENCE_MAX_COLORS use frequency
+// order instead.
+#define SPLAT_COOCCURRENCE_MAX_COLORS 1024u
+
+// Pixels loaded per co-occurrence batch, in whole rows.
+#define SPLAT_COOCCURRENCE_BATCH_PIXELS ((uint64_t)1 << 20)
+
+// Count every horizontally or vertically adjacent pair of pixels with entries
+// a != b into pairs[a * n + b] and pairs[b * n + a]. Rows come from `load` in
+// order, one batch at a time.
+static bool splat_palette_cooccurrence(uint32_t w, uint32_t h, uint64_t rows, uint32_t n,
+                                       SplatRowLoader load, void *load_ctx, uint64_t *pairs) {
+  uint64_t batch = SPLAT_COOCCURRENCE_BATCH_PIXELS / w ? SPLAT_COOCCURRENCE_BATCH_PIXELS / w : 1;
+  uint32_t *prev = malloc((size_t)w * sizeof(uint32_t));
+  uint32_t *cur = malloc((size_t)w * sizeof(uint32_t));
+  bool ok = prev && cur;
+  for (uint64_t row0 = 0; ok && row0 < rows; row0 += batch) {
+    uint64_t nrows = rows - row0 < batch ? rows - row0 : batch;
+    const Splat4DIndex *view = NULL;
+    uint64_t view_row0 = 0;
+    ok = load(load_ctx, row0, nrows, &view, &view_row0);
+    for (uint64_t y = row0; ok && y < row0 + nrows; ++y) {
+      uint64_t base = (y - view_row0) * w;
+      for (uint32_t x = 0; ok && x < w; ++x) {
+        uint64_t e = splat4d_index_get(view, base + x);
+        ok = e < n;
+        cur[x] = (uint32_t)e;
       }
-      for (int d = 0; d < 3; ++d) {
-        uint32_t range = (uint32_t)(hi[d] - lo[d]);
-        if (best < 0 || range > best_range) {
-          best_range = range;
-          best = (int)b;
-          best_shift = (uint32_t)(16 - 8 * d);
+      for (uint32_t x = 0; ok && x < w; ++x) {
+        uint32_t a = cur[x];
+        uint32_t b = x + 1 < w ? cur[x + 1] : a;
+        if (a != b) {
+          pairs[(uint64_t)a * n + b]++;
+          pairs[(uint64_t)b * n + a]++;
+        }
+        b = y % h ? prev[x] : a; // the row above, within the same slice
+        if (a != b) {
+          pairs[(uint64_t)a * n + b]++;
+          pairs[(uint64_t)b * n + a]++;
         }
       }
+      uint32_t *swap = prev;
+      prev = cur;
+      cur = swap;
     }
-    if (best < 0 || best_range == 0)
-      break; // nothing left to split
-
-    uint32_t s = bstart[best], e = bend[best];
-    g_mc_colors = colors;
-    g_mc_shift = (int)best_shift;
-    qsort(order + s, e - s, sizeof(uint32_t), mc_channel_cmp);
-
-    double total = 0.0;
-    for (uint32_t k = s; k < e; ++k)
-      total += counts[order[k]];
-    double half = total / 2.0, acc = 0.0;
-    uint32_t m = s + 1;
-    for (uint32_t k = s; k < e; ++k) {
-      acc += counts[order[k]];
-      if (acc >= half) {
-        m = k + 1;
-        break;
+  }
+  free(prev);
+  free(cur);
+  return ok;
+}
+
+typedef struct {
+  double key;
+  uint32_t entry;
+} PaletteKey;
+
+static int palette_key_cmp(const void *a, const void *b) {
+  const PaletteKey *x = a, *y = b;
+  if (x->key != y->key)
+    return x->key < y->key ? -1 : 1;
+  return x->entry < y->entry ? -1 : x->entry > y->entry;
+}
+
+// Greedy chain through the co-occurrence matrix: start from the most used
+// entry and always append the unplaced entry that touches the last one most
+// often (then the most used one, then the lowest). *chain lists the entries in
+// their new order.
+static bool splat_cooccurrence_chain(const uint64_t *pairs, const SplatMomentSums *sums,
+                                     uint32_t n, uint32_t *chain) {
+  bool *placed = calloc(n, sizeof(bool));
+  if (!placed)
+    return false;
+  uint32_t last = UINT32_MAX;
+  for (uint32_t k = 0; k < n; ++k) {
+    uint32_t best = UINT32_MAX;
+    uint64_t best_pairs = 0;
+    for (uint32_t j = 0; j < n; ++j) {
+      if (placed[j])
+        continue;
+      uint64_t p = last == UINT32_MAX ? 0 : pairs[(uint64_t)last * n + j];
+      if (best == UINT32_MAX || p > best_pairs || (p == best_pairs && sums[j].n > sums[best].n)) {
+        best = j;
+        best_pairs = p;
       }
     }
-    if (m <= s)
-      m = s + 1;
-    if (m >= e)
-      m = e - 1;
-
-    bend[best] = m;
-    bstart[nboxes] = m;
-    bend[nboxes] = e;
-    nboxes++;
+    placed[best] = true;
+    chain[k] = last = best;
   }
+  free(placed);
+  return true;
+}
 
-  for (uint32_t b = 0; b < nboxes; ++b) {
-    double sr = 0, sg = 0, sb = 0, sc = 0;
-    for (uint32_t k = bstart[b]; k < bend[b]; ++k) {
-      uint32_t c = colors[order[k]];
-      double wgt = counts[order[k]];
-      sr += wgt * ((c >> 16) & 0xFF);
-      sg += wgt * ((c >> 8) & 0xFF);
-      sb += wgt * (c & 0xFF);
-      sc += wgt;
-      quant_of[order[k]] = b;
+// The renumbering that `order` gives the n final entries of a w x h x depth x
+// frames clip, as new_of[entry]. The co-occurrence order reads the index rows
+// again through `load`.
+static bool splat_palette_order(SplatPaletteOrder order, const SplatMomentSums *sums, uint32_t n,
+                                uint32_t w, uint32_t h, uint32_t depth, uint32_t frames,
+                                SplatRowLoader load, void *load_ctx, uint32_t *new_of) {
+  uint32_t *chain = malloc((size_t)n * sizeof(uint32_t));
+  if (!chain)
+    return false;
+  bool ok = true;
+  if (order == SPLAT_ORDER_COOCCURRENCE && n <= SPLAT_COOCCURRENCE_MAX_COLORS) {
+    uint64_t *pairs = calloc((size_t)n * n, sizeof(uint64_t));
+    ok = pairs &&
+         splat_palette_cooccurrence(w, h, (uint64_t)h * depth * frames, n, load, load_ctx,
+                                    pairs) &&
+         splat_cooccurrence_chain(pairs, sums, n, chain);
+    free(pairs);
+  } else {
+    PaletteKey *keys = malloc((size_t)n * sizeof(PaletteKey));
+    ok = keys != NULL;
+    for (uint32_t j = 0; ok && j < n; ++j) {
+      const SplatMomentSums *m = &sums[j];
+      double cnt = m->n > 0 ? m->n : 1.0;
+      // The mean scan offset of the entry's pixels, t -> z -> y -> x.
+      double pos = ((m->st / cnt * depth + m->sz / cnt) * h + m->sy / cnt) * w + m->sx / cnt;
+      keys[j] = (PaletteKey){.key = order == SPLAT_ORDER_POSITION ? pos : -m->n, .entry = j};
     }
-    uint32_t r = (uint32_t)(sr / sc + 0.5), gg = (uint32_t)(sg / sc + 0.5),
-             bb = (uint32_t)(sb / sc + 0.5);
-    rep_colors[b] = (r << 16) | (gg << 8) | bb;
+    if (ok) {
+      qsort(keys, n, sizeof(PaletteKey), palette_key_cmp);
+      for (uint32_t j = 0; j < n; ++j)
+        chain[j] = keys[j].entry;
+    }
+    free(keys);
   }
+  for (uint32_t k = 0; ok && k < n; ++k)
+    new_of[chain[k]] = k;
+  free(chain);
+  return ok;
+}
+
+// Move every palette entry to its new number.
+static bool splat_permute_palette(Splat4D *palette, uint32_t n, const uint32_t *new_of) {
+  Splat4D *old = malloc((size_t)n * sizeof(Splat4D));
+  if (!old)
+    return false;
+  memcpy(old, palette, (size_t)n * sizeof(Splat4D));
+  for (uint32_t j = 0; j < n; ++j)
+    palette[new_of[j]] = old[j];
+  free(old);
+  return true;
+}
+
+typedef struct {
+  Splat4DIndex *index;
+  const uint32_t *new_of;
+  uint64_t total, per_task;
+} IndexRenumberJob;
+
+#define SPLAT_INDEX_RENUMBER_BODY(ptr, type)                                                       \
+  for (uint64_t k = first; k < end; ++k)                                                           \
+    (ptr)[k] = (type)j->new_of[(ptr)[k]];
+
+static bool index_renumber_task(void *ctx, uint64_t task) {
+  IndexRenumberJob *j = ctx;
+  uint64_t first = task * j->per_task;
+  uint64_t end = j->total - first < j->per_task ? j->total : first + j->per_task;
+  switch (j->index->width) {
+  case 1:
+    SPLAT_INDEX_RENUMBER_BODY(j->index->u8, uint8_t)
+    break;
+  case 2:
+    SPLAT_INDEX_RENUMBER_BODY(j->index->u16, uint16_t)
+    break;
+  case 4:
+    SPLAT_INDEX_RENUMBER_BODY(j->index->u32, uint32_t)
+    break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+#undef SPLAT_INDEX_RENUMBER_BODY
+
+// Renumber the `total` entries of an index in place, in parallel.
+static bool splat_renumber_index(Splat4DIndex *index, uint64_t total, const uint32_t *new_of) {
+  IndexRenumberJob j = {.index = index, .new_of = new_of, .total = total,
+                        .per_task = SPLAT_HISTOGRAM_TASK_PIXELS};
+  return total == 0 || splat_parallel_for(total / j.per_task + (total % j.per_task != 0),
+                                           index_renumber_task, &j);
+}
 
-  free(order);
-  free(bstart);
-  free(bend);
-  return nboxes;
+// Header flags of an encoded clip with `n` palette entries.
+static uint32_t splat_encoded_flags(uint32_t n, const Splat4DEncodeOptions *opts) {
+  uint32_t iw = (n <= 256)     ? SPLAT_INDEX_WIDTH_8
+                : (n <= 65536) ? SPLAT_INDEX_WIDTH_16
+                               : SPLAT_INDEX_WIDTH_32;
+  uint32_t sorted = opts && opts->order != SPLAT_ORDER_FIRST_SEEN ? SPLAT_FLAG_SORTED : 0;
+  return SPLAT_FLAG_PRECISION_FLOAT32 | (iw << SPLAT_FLAG_INDEX_WIDTH_SHIFT) |
+         (SPLAT_SHAPE_AXIS_ALIGNED << SPLAT_FLAG_SPLAT_SHAPE_SHIFT) | sorted;
 }
 
 // Build a video from `depth * frames` tightly packed w*h RGB8 slices that share
@@ -2868,11 +6701,12 @@ static uint32_t splat_median_cut(const uint32_t *colors, const double *counts, u
 // index order t -> z -> y -> x. Each palette color becomes a splat whose spatial
 // mu/sigma come from the (x, y) spread of its pixels, and whose mu_z/sigma_t and
 // mu_t/sigma_t come from the z (depth) and t (frame) positions it occupies. With
-// max_colors == 0 the palette is exact (lossless); a positive max_colors
-// quantizes to at most that many colors via median cut (lossy). On success *out
-// owns freshly allocated palette/index.
-bool stack_to_video_quantized(const uint8_t *const *slices, uint32_t depth, uint32_t frames,
-                              uint32_t w, uint32_t h, uint32_t max_colors, Splat4DVideo *out) {
+// opts->max_colors == 0 (or NULL opts) the palette is exact (lossless); a
+// positive max_colors quantizes to at most that many colors with
+// opts->quantizer (lossy). On success *out owns freshly allocated palette/index.
+bool stack_to_video_with_options(const uint8_t *const *slices, uint32_t depth, uint32_t frames,
+                                 uint32_t w, uint32_t h, const Splat4DEncodeOptions *opts,
+                                 Splat4DVideo *out) {
   if (!slices || !out || depth == 0 || frames == 0 || w == 0 || h == 0)
     return false;
   uint64_t nslices = (uint64_t)depth * (uint64_t)frames;
@@ -2882,192 +6716,83 @@ bool stack_to_video_quantized(const uint8_t *const *slices, uint32_t depth, uint
 
   uint64_t npix = (uint64_t)w * (uint64_t)h;
   uint64_t total = 0;
-  if (!checked_mul_u64(npix, nslices, &total) || total > SIZE_MAX / sizeof(uint64_t))
-    return false;
-
-  uint64_t *index = malloc((size_t)total * sizeof(uint64_t));
-  if (!index)
+  if (!checked_mul_u64(npix, nslices, &total))
     return false;
 
-  size_t map_hint = total < (1u << 24) ? (size_t)total : (1u << 24);
+  // Pass 1: distinct colors and their pixel counts.
+  HistogramJob job = {.slices = slices, .npix = npix, .total = total};
   ColorMap map;
-  if (!colormap_init(&map, map_hint)) {
-    free(index);
-    return false;
-  }
-
-  // Pass 1: distinct colors, their pixel counts, and each pixel's color index.
   uint32_t *colors = NULL;
   double *counts = NULL;
-  size_t pal_cap = 0, pal_n = 0;
-  bool ok = true;
-
-  for (uint64_t s = 0; s < nslices && ok; ++s) {
-    const uint8_t *rgb = slices[s];
-    for (uint64_t i = 0; i < npix && ok; ++i) {
-      uint32_t color =
-          ((uint32_t)rgb[i * 3] << 16) | ((uint32_t)rgb[i * 3 + 1] << 8) | (uint32_t)rgb[i * 3 + 2];
-      uint32_t idx;
-      if (!colormap_get(&map, color, &idx)) {
-        if (pal_n == UINT32_MAX) {
-          ok = false;
-          break;
-        }
-        if (pal_n == pal_cap) {
-          size_t new_cap = pal_cap ? pal_cap * 2 : 256;
-          uint32_t *gc = realloc(colors, new_cap * sizeof(uint32_t));
-          double *gn = realloc(counts, new_cap * sizeof(double));
-          if (!gc || !gn) {
-            free(gc ? gc : colors);
-            free(gn ? gn : counts);
-            colors = NULL;
-            counts = NULL;
-            ok = false;
-            break;
-          }
-          colors = gc;
-          counts = gn;
-          pal_cap = new_cap;
-        }
-        idx = (uint32_t)pal_n;
-        colors[pal_n] = color;
-        counts[pal_n] = 0.0;
-        pal_n++;
-        colormap_put(&map, color, idx);
-      }
-      counts[idx] += 1.0;
-      index[s * npix + i] = idx;
-    }
-  }
-  colormap_free(&map);
-
-  if (!ok || pal_n == 0) {
-    free(colors);
-    free(counts);
-    free(index);
+  size_t pal_n = 0;
+  if (!build_color_histogram(&job, &map, &colors, &counts, &pal_n))
     return false;
-  }
 
-  // Decide the final palette: exact, or median-cut down to max_colors.
+  // Decide the final palette: exact, or quantized down to max_colors.
   uint32_t *quant_of = NULL;
   uint32_t *rep = NULL;
-  uint32_t final_n;
-  if (max_colors == 0 || (uint64_t)max_colors >= pal_n) {
-    final_n = (uint32_t)pal_n; // already <= max_colors, keep exact colors
-    rep = colors;              // representatives are the colors themselves
-  } else {
-    quant_of = malloc(pal_n * sizeof(uint32_t));
-    rep = malloc((size_t)max_colors * sizeof(uint32_t));
-    if (!quant_of || !rep) {
-      free(quant_of);
-      free(rep);
-      free(colors);
-      free(counts);
-      free(index);
-      return false;
-    }
-    final_n = splat_median_cut(colors, counts, (uint32_t)pal_n, max_colors, quant_of, rep);
-    if (final_n == 0) {
-      free(quant_of);
-      free(rep);
-      free(colors);
-      free(counts);
-      free(index);
-      return false;
-    }
-    // Remap each pixel from its exact color index to the representative index.
-    for (uint64_t k = 0; k < total; ++k)
-      index[k] = quant_of[index[k]];
-  }
+  uint32_t final_n = pal_n ? splat_choose_palette(colors, counts, pal_n, opts, &quant_of, &rep) : 0;
   free(counts);
-
-  // Accumulate spatial/depth/temporal statistics per final palette entry.
-  double *cnt = calloc(final_n, sizeof(double));
-  double *sx = calloc(final_n, sizeof(double));
-  double *sy = calloc(final_n, sizeof(double));
-  double *sxx = calloc(final_n, sizeof(double));
-  double *syy = calloc(final_n, sizeof(double));
-  double *sz = calloc(final_n, sizeof(double));
-  double *szz = calloc(final_n, sizeof(double));
-  double *st = calloc(final_n, sizeof(double));
-  double *stt = calloc(final_n, sizeof(double));
-  Splat4D *palette = malloc((size_t)final_n * sizeof(Splat4D));
-  if (!cnt || !sx || !sy || !sxx || !syy || !sz || !szz || !st || !stt || !palette) {
-    free(cnt);
-    free(sx);
-    free(sy);
-    free(sxx);
-    free(syy);
-    free(sz);
-    free(szz);
-    free(st);
-    free(stt);
-    free(palette);
-    if (quant_of) {
-      free(rep);
-      free(quant_of);
-    }
+  if (final_n == 0) {
     free(colors);
-    free(index);
-    return false;
-  }
-
-  for (uint64_t s = 0; s < nslices; ++s) {
-    double zz = (double)(s % depth), tt = (double)(s / depth);
-    for (uint64_t i = 0; i < npix; ++i) {
-      uint64_t j = index[s * npix + i];
-      double x = (double)(i % w), y = (double)(i / w);
-      cnt[j] += 1.0;
-      sx[j] += x;
-      sy[j] += y;
-      sxx[j] += x * x;
-      syy[j] += y * y;
-      sz[j] += zz;
-      szz[j] += zz * zz;
-      st[j] += tt;
-      stt[j] += tt * tt;
-    }
+    colormap_free(&map);
+    return false;
   }
 
-  for (uint32_t j = 0; j < final_n; ++j) {
-    double n = cnt[j] > 0 ? cnt[j] : 1.0;
-    double mx = sx[j] / n, my = sy[j] / n, mz = sz[j] / n, mt = st[j] / n;
-    double vx = sxx[j] / n - mx * mx;
-    double vy = syy[j] / n - my * my;
-    double vz = szz[j] / n - mz * mz;
-    double vt = stt[j] / n - mt * mt;
-    uint32_t c = rep[j];
-    palette[j] = create_splat4D(
-        (float)mx, (float)splat_sqrt(vx), (float)my, (float)splat_sqrt(vy), (float)mz,
-        (float)splat_sqrt(vz), (float)mt, (float)splat_sqrt(vt), (float)((c >> 16) & 0xFF) / 255.0f,
-        (float)((c >> 8) & 0xFF) / 255.0f, (float)(c & 0xFF) / 255.0f, 1.0f);
-  }
+  // Pass 2: each pixel's final palette index, at the narrowest width that holds
+  // final_n entries.
+  Splat4DIndex index;
+  uint8_t final_width = final_n <= 256 ? 1 : final_n <= 65536 ? 2 : 4;
+  job.palette = &map;
+  job.quant_of = quant_of;
+  job.index = &index;
+  bool ok = splat4d_index_alloc(&index, total, final_width) &&
+            splat_parallel_for(job.total / job.per_task + (job.total % job.per_task != 0),
+                               remap_task, &job);
+  colormap_free(&map);
 
-  free(cnt);
-  free(sx);
-  free(sy);
-  free(sxx);
-  free(syy);
-  free(sz);
-  free(szz);
-  free(st);
-  free(stt);
+  // Spatial/depth/temporal statistics per final palette entry.
+  SplatMomentSums *sums = NULL;
+  Splat4D *palette = ok ? malloc((size_t)final_n * sizeof(Splat4D)) : NULL;
+  ok = palette && splat_palette_moments(&index, w, h, depth, frames, final_n, &sums);
+  if (ok)
+    splat_palette_from_moments(sums, rep, final_n, palette);
+
+  // Renumber the palette and the index it now describes.
+  if (ok && opts && opts->order != SPLAT_ORDER_FIRST_SEEN) {
+    uint32_t *new_of = malloc((size_t)final_n * sizeof(uint32_t));
+    ok = new_of &&
+         splat_palette_order(opts->order, sums, final_n, w, h, depth, frames, whole_index_rows,
+                             &index, new_of) &&
+         splat_permute_palette(palette, final_n, new_of) &&
+         splat_renumber_index(&index, total, new_of);
+    free(new_of);
+  }
+  free(sums);
   if (quant_of) {
     free(rep);
     free(quant_of);
   }
   free(colors);
+  if (!ok) {
+    free(palette);
+    free(index.data);
+    return false;
+  }
 
-  uint32_t iw = (final_n <= 256)     ? SPLAT_INDEX_WIDTH_8
-                : (final_n <= 65536) ? SPLAT_INDEX_WIDTH_16
-                                     : SPLAT_INDEX_WIDTH_32;
-  uint32_t flags = SPLAT_FLAG_PRECISION_FLOAT32 | (iw << SPLAT_FLAG_INDEX_WIDTH_SHIFT) |
-                   (SPLAT_SHAPE_AXIS_ALIGNED << SPLAT_FLAG_SPLAT_SHAPE_SHIFT);
-  Splat4DHeader header = create_splat4DHeader(w, h, depth, frames, final_n, flags);
-  *out = create_splat4DVideo(header, palette, index);
+  Splat4DHeader header = create_splat4DHeader(w, h, depth, frames, final_n,
+                                              splat_encoded_flags(final_n, opts));
+  *out = create_splat4DVideoWithIndex(header, palette, index);
   return true;
 }
 
+// stack_to_video_with_options() with median cut down to max_colors (0 = exact).
+bool stack_to_video_quantized(const uint8_t *const *slices, uint32_t depth, uint32_t frames,
+                              uint32_t w, uint32_t h, uint32_t max_colors, Splat4DVideo *out) {
+  Splat4DEncodeOptions opts = {.max_colors = max_colors};
+  return stack_to_video_with_options(slices, depth, frames, w, h, &opts, out);
+}
+
 // A stack of frames (depth == 1) is the video case of the general codec.
 bool frames_to_video_quantized(const uint8_t *const *frames, uint32_t nframes, uint32_t w,
                                uint32_t h, uint32_t max_colors, Splat4DVideo *out) {
@@ -3085,6 +6810,398 @@ bool image_to_video(const uint8_t *rgb, uint32_t w, uint32_t h, Splat4DVideo *ou
   return frames_to_video(&rgb, 1, w, h, out);
 }
 
+// --- streaming encoder -------------------------------------------------------
+//
+// The batch encoder needs every slice in memory at once. The streaming encoder
+// takes one slice at a time: each slice's colors are merged into a running
+// first-appearance color table and its pixels are spooled to a temporary file
+// as exact color slots, at the narrowest width that holds the table so far.
+// Only the table and one slice are held in memory. finish() picks the palette
+// from the table (exactly as the batch encoder does, since the merged table is
+// the batch histogram), takes the splat statistics in one pass over the spool,
+// then writes the file in a second pass that maps each slot to its final index
+// on the way. The output is byte-identical to stack_to_video_with_options()
+// followed by write_splat4DVideoWithOptions().
+typedef struct {
+  FILE *out;
+  uint32_t w, h, depth;
+  uint32_t codec;
+  Splat4DEncodeOptions encode;
+  Splat4DWriteOptions write;
+  FILE *spool;        // exact color slot of every pushed pixel
+  uint8_t *widths;    // spool entry width of each pushed slice
+  uint64_t nslices, cap;
+  ColorTable colors;  // distinct colors so far, in first-appearance order
+} Splat4DStreamEncoder;
+
+// Release everything an encoder holds without writing anything more.
+void splat4d_encoder_abort(Splat4DStreamEncoder *e) {
+  if (!e)
+    return;
+  if (e->spool)
+    fclose(e->spool);
+  free(e->widths);
+  color_table_free(&e->colors);
+  memset(e, 0, sizeof *e);
+}
+
+// Start a streaming encode of w x h slices, `depth` slices per frame, to `out`
+// with index compression `codec`. NULL option pointers mean the defaults.
+bool splat4d_encoder_open(Splat4DStreamEncoder *e, FILE *out, uint32_t w, uint32_t h,
+                          uint32_t depth, uint32_t codec, const Splat4DEncodeOptions *eopts,
+                          const Splat4DWriteOptions *wopts) {
+  if (!e)
+    return false;
+  memset(e, 0, sizeof *e);
+  uint64_t npix = (uint64_t)w * (uint64_t)h;
+  if (!out || w == 0 || h == 0 || depth == 0 || npix > SIZE_MAX / 4 ||
+      !splat_compression_available(codec))
+    return false;
+  *e = (Splat4DStreamEncoder){.out = out, .w = w, .h = h, .depth = depth, .codec = codec};
+  if (eopts)
+    e->encode = *eopts;
+  if (wopts)
+    e->write = *wopts;
+  e->spool = tmpfile();
+  if (!e->spool || !colormap_init(&e->colors.map, 256)) {
+    LOG_ERROR("❌ Unable to create the encoder spool\n");
+    splat4d_encoder_abort(e);
+    return false;
+  }
+  return true;
+}
+
+// Add the next w*h RGB8 slice (slices arrive t-major, z-minor). After a
+// failure only splat4d_encoder_abort() is valid.
+bool splat4d_encoder_push_slice(Splat4DStreamEncoder *e, const uint8_t *rgb) {
+  if (!e || !e->spool || !rgb)
+    return false;
+  if (e->nslices == e->cap) {
+    uint64_t cap = e->cap ? e->cap * 2 : 64;
+    uint8_t *grown = cap > SIZE_MAX ? NULL : realloc(e->widths, (size_t)cap);
+    if (!grown)
+      return false;
+    e->widths = grown;
+    e->cap = cap;
+  }
+
+  uint64_t npix = (uint64_t)e->w * (uint64_t)e->h;
+  HistogramJob job = {.slices = &rgb, .npix = npix, .total = npix};
+  ColorMap map;
+  uint32_t *colors = NULL;
+  double *counts = NULL;
+  size_t n = 0;
+  if (!build_color_histogram(&job, &map, &colors, &counts, &n))
+    return false;
+
+  // Fold the slice's colors into the running table; slot_of maps the slice's
+  // color positions to table slots.
+  uint32_t *slot_of = malloc((n ? n : 1) * sizeof(uint32_t));
+  bool ok = slot_of != NULL;
+  for (size_t u = 0; ok && u < n; ++u) {
+    slot_of[u] = color_table_slot(&e->colors, colors[u]);
+    ok = slot_of[u] != UINT32_MAX;
+    if (ok)
+      e->colors.counts[slot_of[u]] += (uint64_t)counts[u];
+  }
+  free(colors);
+  free(counts);
+
+  Splat4DIndex index = {0};
+  uint8_t width = e->colors.n <= 256 ? 1 : e->colors.n <= 65536 ? 2 : 4;
+  job.palette = &map;
+  job.quant_of = slot_of;
+  job.index = &index;
+  ok = ok && splat4d_index_alloc(&index, npix, width) &&
+       splat_parallel_for(job.total / job.per_task + (job.total % job.per_task != 0), remap_task,
+                          &job) &&
+       fwrite(index.u8, width, (size_t)npix, e->spool) == (size_t)npix;
+  colormap_free(&map);
+  free(slot_of);
+  free(index.data);
+  if (!ok) {
+    LOG_ERROR("❌ Failed to spool slice %" PRIu64 "\n", e->nslices);
+    return false;
+  }
+  e->widths[e->nslices++] = width;
+  return true;
+}
+
+// Add the next frame: its `depth` slices in z order.
+bool splat4d_encoder_push_frame(Splat4DStreamEncoder *e, const uint8_t *const *slices) {
+  if (!e || !slices)
+    return false;
+  for (uint32_t z = 0; z < e->depth; ++z)
+    if (!splat4d_encoder_push_slice(e, slices[z]))
+      return false;
+  return true;
+}
+
+// Reads the spool back in order as final palette indices packed at `width`.
+typedef struct {
+  const Splat4DStreamEncoder *e;
+  const uint32_t *quant_of; // exact slot -> final index, or NULL
+  uint8_t width;
+  uint64_t slice, pos; // next entry: pos within spooled slice `slice`
+  Splat4DIndex rows;   // row loader buffer
+  uint64_t rows_cap;
+  uint32_t *frame_crc;  // when set, receives each frame's CRC as it is read
+  crc32_t crc;          // running CRC of the frame being read
+  uint64_t crc_entries; // entries folded into frame_crc so far
+  uint8_t buf[SPLAT4D_STREAM_CHUNK_SIZE];
+} SpoolReader;
+
+// Fold `n` entries just read into the per-frame CRCs.
+static void spool_track_crcs(SpoolReader *r, const uint8_t *p, uint64_t n) {
+  uint64_t frame_entries = (uint64_t)r->e->w * r->e->h * r->e->depth;
+  while (n > 0) {
+    uint64_t at = r->crc_entries % frame_entries;
+    uint64_t step = frame_entries - at < n ? frame_entries - at : n;
+    if (at == 0)
+      crc32_init(&r->crc);
+    crc32_update(&r->crc, p, (size_t)(step * r->width));
+    if (at + step == frame_entries)
+      r->frame_crc[r->crc_entries / frame_entries] = crc32_final(&r->crc);
+    r->crc_entries += step;
+    p += step * r->width;
+    n -= step;
+  }
+}
+
+static bool spool_reader_rewind(SpoolReader *r) {
+  r->slice = r->pos = 0;
+  return fflush(r->e->spool) == 0 && fseek(r->e->spool, 0, SEEK_SET) == 0;
+}
+
+static bool spool_fill(void *ctx, uint64_t n, uint8_t *dst) {
+  SpoolReader *r = ctx;
+  uint64_t npix = (uint64_t)r->e->w * (uint64_t)r->e->h;
+  Splat4DIndex out = {.u8 = dst, .width = r->width};
+  for (uint64_t done = 0; done < n;) {
+    if (r->pos == npix) {
+      r->slice++;
+      r->pos = 0;
+    }
+    if (r->slice >= r->e->nslices)
+      return false;
+    Splat4DIndex in = {.u8 = r->buf, .width = r->e->widths[r->slice]};
+    uint64_t step = sizeof r->buf / in.width;
+    step = npix - r->pos < step ? npix - r->pos : step;
+    step = n - done < step ? n - done : step;
+    if (fread(r->buf, in.width, (size_t)step, r->e->spool) != (size_t)step)
+      return false;
+    for (uint64_t k = 0; k < step; ++k) {
+      uint64_t slot = splat4d_index_get(&in, k);
+      splat4d_index_set(&out, done + k, r->quant_of ? r->quant_of[slot] : slot);
+    }
+    done += step;
+    r->pos += step;
+  }
+  if (r->frame_crc)
+    spool_track_crcs(r, dst, n);
+  return true;
+}
+
+// SplatRowLoader over the spool; rows are requested in order.
+static bool spool_rows(void *ctx, uint64_t row0, uint64_t nrows, const Splat4DIndex **view,
+                       uint64_t *view_row0) {
+  SpoolReader *r = ctx;
+  uint64_t n = nrows * r->e->w;
+  if (n > r->rows_cap) {
+    free(r->rows.data);
+    r->rows.data = NULL;
+    if (!splat4d_index_alloc(&r->rows, n, r->width))
+      return false;
+    r->rows_cap = n;
+  }
+  *view = &r->rows;
+  *view_row0 = row0;
+  return spool_fill(r, n, r->rows.u8);
+}
+
+// Random access to whole frames of the spool, for confirming repeats. The
+// frame last read into `held` is kept, since candidates are mostly compared
+// with the same first occurrence.
+typedef struct {
+  SpoolReader *r;
+  uint64_t *offset; // spool byte offset of each slice
+  uint8_t *held, *other;
+  uint64_t held_frame;
+} SpoolFrames;
+
+static bool spool_read_frame(SpoolFrames *f, uint64_t t, uint8_t *dst) {
+  const Splat4DStreamEncoder *e = f->r->e;
+  f->r->slice = t * e->depth;
+  f->r->pos = 0;
+  return fseek(e->spool, (long)f->offset[f->r->slice], SEEK_SET) == 0 &&
+         spool_fill(f->r, (uint64_t)e->w * e->h * e->depth, dst);
+}
+
+static bool spool_frames_equal(void *ctx, uint64_t a, uint64_t b, bool *equal) {
+  SpoolFrames *f = ctx;
+  const Splat4DStreamEncoder *e = f->r->e;
+  if (f->held_frame != a) {
+    f->held_frame = UINT64_MAX;
+    if (!spool_read_frame(f, a, f->held))
+      return false;
+    f->held_frame = a;
+  }
+  if (!spool_read_frame(f, b, f->other))
+    return false;
+  *equal = memcmp(f->held, f->other, (size_t)((uint64_t)e->w * e->h * e->depth * f->r->width)) ==
+           0;
+  return true;
+}
+
+// Take every frame's CRC in a pass of its own, for when the statistics pass
+// read the spool under a numbering that has since changed.
+static bool spool_frame_crcs(SpoolReader *r, uint32_t *crcs) {
+  uint64_t total = r->e->nslices * r->e->w * r->e->h;
+  uint64_t step = sizeof r->buf / r->width;
+  uint8_t *dst = malloc(sizeof r->buf);
+  r->frame_crc = crcs;
+  r->crc_entries = 0;
+  bool ok = dst && spool_reader_rewind(r);
+  for (uint64_t done = 0; ok && done < total; done += step)
+    ok = spool_fill(r, total - done < step ? total - done : step, dst);
+  r->frame_crc = NULL;
+  free(dst);
+  return ok;
+}
+
+// Frame table of the spooled clip from the frame CRCs taken while it was read
+// (`crcs`, owned by the table on success).
+static bool spool_frame_table(SpoolReader *r, uint32_t frames, uint32_t *crcs,
+                              SplatFrameTable *ft) {
+  const Splat4DStreamEncoder *e = r->e;
+  uint64_t frame_bytes = (uint64_t)e->w * e->h * e->depth * r->width;
+  SpoolFrames f = {.r = r, .held_frame = UINT64_MAX};
+  uint64_t *ref = malloc((size_t)frames * sizeof(uint64_t));
+  f.offset = malloc((size_t)(e->nslices + 1) * sizeof(uint64_t));
+  f.held = frame_bytes > SIZE_MAX ? NULL : malloc((size_t)frame_bytes);
+  f.other = f.held ? malloc((size_t)frame_bytes) : NULL;
+  bool ok = ref && f.offset && f.other;
+  if (ok) {
+    f.offset[0] = 0;
+    for (uint64_t s = 0; s < e->nslices; ++s)
+      f.offset[s + 1] = f.offset[s] + (uint64_t)e->w * e->h * e->widths[s];
+    ok = fflush(e->spool) == 0 && splat_match_units(crcs, frames, spool_frames_equal, &f, ref) &&
+         frame_table_from_refs(ft, ref, crcs, frames);
+  }
+  free(ref);
+  free(f.offset);
+  free(f.held);
+  free(f.other);
+  return ok;
+}
+
+// Choose the palette, write the whole file and release the encoder (also on
+// failure). *header_out, when given, receives the written header.
+bool splat4d_encoder_finish(Splat4DStreamEncoder *e, Splat4DHeader *header_out) {
+  if (!e || !e->spool)
+    return false;
+  uint64_t frames = e->nslices / e->depth;
+  if (e->nslices == 0 || e->nslices % e->depth != 0 || frames > UINT32_MAX) {
+    LOG_ERROR("❌ %" PRIu64 " slice(s) do not make whole frames of depth %u\n", e->nslices,
+              e->depth);
+    splat4d_encoder_abort(e);
+    return false;
+  }
+
+  size_t n = e->colors.n;
+  double *counts = malloc(n * sizeof(double));
+  if (!counts) {
+    splat4d_encoder_abort(e);
+    return false;
+  }
+  for (size_t u = 0; u < n; ++u)
+    counts[u] = (double)e->colors.counts[u];
+  uint32_t *quant_of = NULL;
+  uint32_t *rep = NULL;
+  uint32_t final_n = splat_choose_palette(e->colors.colors, counts, n, &e->encode, &quant_of,
+                                          &rep);
+  free(counts);
+
+  SpoolReader *r = final_n ? calloc(1, sizeof *r) : NULL;
+  Splat4D *palette = r ? malloc((size_t)final_n * sizeof(Splat4D)) : NULL;
+  SplatMomentSums *sums = NULL;
+  bool ok = palette != NULL;
+  // Frame references need each frame's CRC, which the statistics pass takes
+  // on its way through the spool.
+  bool refs = e->write.frame_refs && e->codec != SPLAT_COMPRESSION_NONE && frames > 1;
+  bool reorder = e->encode.order != SPLAT_ORDER_FIRST_SEEN;
+  uint32_t *frame_crc = ok && refs ? malloc((size_t)frames * sizeof(uint32_t)) : NULL;
+  uint32_t *new_of = ok && reorder ? malloc((size_t)final_n * sizeof(uint32_t)) : NULL;
+  uint32_t *renumbered = ok && reorder ? malloc((n ? n : 1) * sizeof(uint32_t)) : NULL;
+  SplatFrameTable ft = {.slot = NULL};
+  if (ok && refs)
+    ok = frame_crc != NULL;
+  if (ok && reorder)
+    ok = new_of && renumbered;
+  if (ok) {
+    r->e = e;
+    r->quant_of = quant_of;
+    r->width = final_n <= 256 ? 1 : final_n <= 65536 ? 2 : 4;
+    r->frame_crc = reorder ? NULL : frame_crc;
+    ok = spool_reader_rewind(r) &&
+         splat_moments_from_rows(e->w, e->h, e->depth, (uint32_t)frames, final_n, spool_rows, r,
+                                 true, &sums);
+    r->frame_crc = NULL;
+  }
+  if (ok)
+    splat_palette_from_moments(sums, rep, final_n, palette);
+  // Renumber the palette, and read the spool from here on through the
+  // renumbered slot map.
+  if (ok && reorder) {
+    ok = spool_reader_rewind(r) &&
+         splat_palette_order(e->encode.order, sums, final_n, e->w, e->h, e->depth,
+                             (uint32_t)frames, spool_rows, r, new_of) &&
+         splat_permute_palette(palette, final_n, new_of);
+    for (size_t u = 0; ok && u < n; ++u)
+      renumbered[u] = new_of[quant_of ? quant_of[u] : u];
+    r->quant_of = renumbered;
+    ok = ok && (!refs || spool_frame_crcs(r, frame_crc));
+  }
+  free(sums);
+  free(new_of);
+  if (ok && refs) {
+    ok = spool_frame_table(r, (uint32_t)frames, frame_crc, &ft);
+    if (ok)
+      frame_crc = NULL;
+  }
+  free(frame_crc);
+
+  if (ok) {
+    free(r->rows.data);
+    r->rows.data = NULL;
+    uint32_t flags = splat_encoded_flags(final_n, &e->encode) |
+                     ((e->codec << SPLAT_FLAG_COMPRESSION_SHIFT) & SPLAT_FLAG_COMPRESSION_MASK);
+    Splat4DHeader header =
+        create_splat4DHeader(e->w, e->h, e->depth, (uint32_t)frames, final_n, flags);
+    Splat4DVideo v = {.header = header,
+                      .palette = create_splat4DPalette(palette),
+                      .index = {.data = NULL, .width = r->width},
+                      .footer = create_splat4DFooter(&header)};
+    SplatIndexSource src = {.fill = spool_fill, .ctx = r};
+    ok = spool_reader_rewind(r) &&
+         write_splat4DVideoFrom(e->out, &v, &e->write, &src, refs ? &ft : NULL, header_out);
+  }
+  frame_table_free(&ft);
+  if (r)
+    free(r->rows.data);
+  free(r);
+  free(palette);
+  free(renumbered);
+  if (quant_of) {
+    free(rep);
+    free(quant_of);
+  }
+  splat4d_encoder_abort(e);
+  if (!ok)
+    LOG_ERROR("❌ Failed to finish the streaming encode\n");
+  return ok;
+}
+
 static uint8_t splat_channel_to_u8(float v) {
   float s = v * 255.0f + 0.5f;
   if (s < 0.0f)
@@ -3094,10 +7211,256 @@ static uint8_t splat_channel_to_u8(float v) {
   return (uint8_t)s;
 }
 
+// --- palette gather ----------------------------------------------------------
+//
+// The RGB8 decoders convert each palette entry to bytes once, into a packed
+// lookup table (r | g << 8 | b << 16 | 0xFF << 24), and check the index range
+// once up front. That leaves a gather per pixel: AVX2 fetches eight entries
+// with one gather and packs them with a byte shuffle, and NEON deinterleaves
+// sixteen entries with vld4 and stores them with vst3. The portable kernel
+// handles everything else and every tail.
+
+// Pixels per decode task: the index range check takes four times as many, and
+// a slice decode task takes whole rows of one slice.
+#define SPLAT_DECODE_TASK_PIXELS ((uint64_t)1 << 18)
+
+// Expand entries [first, first + n) of `index`, all known to be below the
+// table's size, to n RGB8 pixels at `rgb`.
+typedef void (*SplatRgbGatherFn)(const Splat4DIndex *index, uint64_t first, size_t n,
+                                 const uint32_t *lut, uint8_t *rgb);
+
+#define SPLAT_GATHER_SCALAR(ptr)                                                                   \
+  for (size_t i = 0; i < n; ++i) {                                                                 \
+    uint32_t c = lut[(ptr)[first + i]];                                                            \
+    rgb[i * 3] = (uint8_t)c;                                                                       \
+    rgb[i * 3 + 1] = (uint8_t)(c >> 8);                                                            \
+    rgb[i * 3 + 2] = (uint8_t)(c >> 16);                                                           \
+  }
+
+static void rgb_gather_scalar(const Splat4DIndex *index, uint64_t first, size_t n,
+                              const uint32_t *lut, uint8_t *rgb) {
+  switch (index->width) {
+  case 1:
+    SPLAT_GATHER_SCALAR(index->u8)
+    break;
+  case 2:
+    SPLAT_GATHER_SCALAR(index->u16)
+    break;
+  case 4:
+    SPLAT_GATHER_SCALAR(index->u32)
+    break;
+  default:
+    SPLAT_GATHER_SCALAR(index->u64)
+    break;
+  }
+}
+
+#undef SPLAT_GATHER_SCALAR
+
+#ifdef SPLAT_GATHER_AVX2
+// Each step writes 16 bytes at pixel i + 4, four bytes past its own 24, so the
+// loop stops while at least two more pixels follow and overwrite them.
+#define SPLAT_GATHER_AVX2_LOOP(load)                                                               \
+  for (; i + 10 <= n; i += 8) {                                                                    \
+    __m256i c = _mm256_i32gather_epi32((const int *)lut, (load), 4);                               \
+    c = _mm256_shuffle_epi8(c, pack);                                                              \
+    _mm_storeu_si128((__m128i *)(rgb + i * 3), _mm256_castsi256_si128(c));                         \
+    _mm_storeu_si128((__m128i *)(rgb + i * 3 + 12), _mm256_extracti128_si256(c, 1));               \
+  }
+
+// Indices must also fit the gather's signed 32-bit lanes.
+__attribute__((target("avx2"))) static void rgb_gather_avx2(const Splat4DIndex *index,
+                                                            uint64_t first, size_t n,
+                                                            const uint32_t *lut, uint8_t *rgb) {
+  // Drop the alpha byte of each entry, packing four pixels into 12 bytes per lane.
+  const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0,
+                                        1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  size_t i = 0;
+  switch (index->width) {
+  case 1:
+    SPLAT_GATHER_AVX2_LOOP(
+        _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(index->u8 + first + i))))
+    break;
+  case 2:
+    SPLAT_GATHER_AVX2_LOOP(
+        _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(index->u16 + first + i))))
+    break;
+  case 4:
+    SPLAT_GATHER_AVX2_LOOP(_mm256_loadu_si256((const __m256i *)(index->u32 + first + i)))
+    break;
+  default: // 64-bit entries take the scalar loop
+    break;
+  }
+  rgb_gather_scalar(index, first + i, n - i, lut, rgb + i * 3);
+}
+
+#undef SPLAT_GATHER_AVX2_LOOP
+#endif
+
+#ifdef SPLAT_GATHER_NEON
+#define SPLAT_GATHER_NEON_LOOP(ptr)                                                                \
+  for (; i + 16 <= n; i += 16) {                                                                   \
+    for (int k = 0; k < 16; ++k)                                                                   \
+      px[k] = lut[(ptr)[first + i + k]];                                                           \
+    uint8x16x4_t c = vld4q_u8((const uint8_t *)px);                                                \
+    uint8x16x3_t out = {{c.val[0], c.val[1], c.val[2]}};                                           \
+    vst3q_u8(rgb + i * 3, out);                                                                    \
+  }
+
+static void rgb_gather_neon(const Splat4DIndex *index, uint64_t first, size_t n,
+                            const uint32_t *lut, uint8_t *rgb) {
+  uint32_t px[16];
+  size_t i = 0;
+  switch (index->width) {
+  case 1:
+    SPLAT_GATHER_NEON_LOOP(index->u8)
+    break;
+  case 2:
+    SPLAT_GATHER_NEON_LOOP(index->u16)
+    break;
+  case 4:
+    SPLAT_GATHER_NEON_LOOP(index->u32)
+    break;
+  default:
+    SPLAT_GATHER_NEON_LOOP(index->u64)
+    break;
+  }
+  rgb_gather_scalar(index, first + i, n - i, lut, rgb + i * 3);
+}
+
+#undef SPLAT_GATHER_NEON_LOOP
+#endif
+
+static SplatRgbGatherFn rgb_gather_kernel;
+
+static void rgb_gather_setup(void) {
+  rgb_gather_kernel = rgb_gather_scalar;
+#ifdef SPLAT_GATHER_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    rgb_gather_kernel = rgb_gather_avx2;
+#endif
+#ifdef SPLAT_GATHER_NEON
+  rgb_gather_kernel = rgb_gather_neon;
+#endif
+}
+
+// The gather kernel for a table of `entries` entries.
+static SplatRgbGatherFn rgb_gather_select(uint64_t entries) {
+#ifdef SPLAT_WITH_THREADS
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, rgb_gather_setup);
+#else
+  if (!rgb_gather_kernel)
+    rgb_gather_setup();
+#endif
+#ifdef SPLAT_GATHER_AVX2
+  if (rgb_gather_kernel == rgb_gather_avx2 && entries > INT32_MAX)
+    return rgb_gather_scalar;
+#else
+  (void)entries;
+#endif
+  return rgb_gather_kernel;
+}
+
+#define SPLAT_INDEX_MAX(ptr)                                                                       \
+  for (uint64_t k = first; k < end; ++k)                                                           \
+    top = (ptr)[k] > top ? (ptr)[k] : top;
+
+typedef struct {
+  const Splat4DIndex *index;
+  uint64_t n, per_task, limit;
+} IndexRangeJob;
+
+static bool index_range_task(void *ctx, uint64_t task) {
+  IndexRangeJob *j = ctx;
+  uint64_t first = task * j->per_task;
+  uint64_t end = j->n - first < j->per_task ? j->n : first + j->per_task;
+  uint64_t top = 0;
+  switch (j->index->width) {
+  case 1:
+    SPLAT_INDEX_MAX(j->index->u8)
+    break;
+  case 2:
+    SPLAT_INDEX_MAX(j->index->u16)
+    break;
+  case 4:
+    SPLAT_INDEX_MAX(j->index->u32)
+    break;
+  case 8:
+    SPLAT_INDEX_MAX(j->index->u64)
+    break;
+  default:
+    return false;
+  }
+  return top < j->limit;
+}
+
+#undef SPLAT_INDEX_MAX
+
+// Whether the first n entries of `index` are all below `limit`, checked in
+// parallel.
+static bool splat_index_below(const Splat4DIndex *index, uint64_t n, uint64_t limit) {
+  IndexRangeJob j = {.index = index, .n = n, .per_task = SPLAT_DECODE_TASK_PIXELS * 4,
+                     .limit = limit};
+  return n == 0 || splat_parallel_for(n / j.per_task + (n % j.per_task != 0), index_range_task, &j);
+}
+
+// The packed RGB8 table of a video's palette, after checking that its first
+// `n` index entries stay inside the palette. The caller frees the table.
+static uint32_t *splat_palette_rgb_lut(const Splat4DVideo *v, uint64_t n) {
+  uint32_t entries = v->header.pSize;
+  if (!splat_index_below(&v->index, n, entries))
+    return NULL;
+  uint32_t *lut = malloc((entries ? entries : 1) * sizeof(uint32_t));
+  for (uint32_t j = 0; lut && j < entries; ++j) {
+    const Splat4D *sp = &v->palette.palette[j];
+    lut[j] = (uint32_t)splat_channel_to_u8(sp->r) | (uint32_t)splat_channel_to_u8(sp->g) << 8 |
+             (uint32_t)splat_channel_to_u8(sp->b) << 16 | 0xFFu << 24;
+  }
+  return lut;
+}
+
+typedef struct {
+  const Splat4DIndex *index;
+  const uint32_t *lut;
+  SplatRgbGatherFn gather;
+  const uint64_t *src;  // index slice of each output slice, or NULL for k
+  uint8_t *const *out;  // output slices
+  uint64_t npix, tile_pixels, tiles_per_slice;
+} SliceDecodeJob;
+
+static bool slice_decode_task(void *ctx, uint64_t task) {
+  SliceDecodeJob *j = ctx;
+  uint64_t k = task / j->tiles_per_slice, first = task % j->tiles_per_slice * j->tile_pixels;
+  uint64_t n = j->npix - first < j->tile_pixels ? j->npix - first : j->tile_pixels;
+  uint64_t s = j->src ? j->src[k] : k;
+  j->gather(j->index, s * j->npix + first, (size_t)n, j->lut, j->out[k] + (size_t)(first * 3));
+  return true;
+}
+
+// Decode `nout` w*h slices, output slice out[k] from index slice src[k] (slice
+// k when src is NULL), through a table from splat_palette_rgb_lut(). Slices are
+// spread over the workers, and a large slice is split into tiles of whole rows.
+static bool splat_decode_slices(const Splat4DVideo *v, const uint32_t *lut, const uint64_t *src,
+                                uint64_t nout, uint8_t *const *out) {
+  uint64_t w = v->header.width, npix = w * v->header.height;
+  uint64_t rows = SPLAT_DECODE_TASK_PIXELS / w ? SPLAT_DECODE_TASK_PIXELS / w : 1;
+  SliceDecodeJob j = {.index = &v->index,
+                      .lut = lut,
+                      .gather = rgb_gather_select(v->header.pSize),
+                      .src = src,
+                      .out = out,
+                      .npix = npix,
+                      .tile_pixels = rows * w < npix ? rows * w : npix};
+  j.tiles_per_slice = npix / j.tile_pixels + (npix % j.tile_pixels != 0);
+  return splat_parallel_for(nout * j.tiles_per_slice, slice_decode_task, &j);
+}
+
 // Reconstruct a tightly packed w*h RGB8 buffer from a 2D video. *rgb_out owns a
 // freshly allocated buffer on success (caller frees).
 bool video_to_image(const Splat4DVideo *v, uint8_t **rgb_out, uint32_t *w_out, uint32_t *h_out) {
-  if (!v || !rgb_out || !v->palette.palette || !v->index.index)
+  if (!v || !rgb_out || !v->palette.palette || !v->index.data)
     return false;
   if (v->header.depth != 1 || v->header.frames != 1) {
     LOG_ERROR("❌ Image decode requires a 2D video (depth=frames=1)\n");
@@ -3108,20 +7471,17 @@ bool video_to_image(const Splat4DVideo *v, uint8_t **rgb_out, uint32_t *w_out, u
   if (npix == 0 || npix > SIZE_MAX / 3)
     return false;
 
-  uint8_t *rgb = malloc((size_t)npix * 3);
-  if (!rgb)
+  uint32_t *lut = splat_palette_rgb_lut(v, npix);
+  uint8_t *rgb = lut ? malloc((size_t)npix * 3) : NULL;
+  if (!rgb) {
+    free(lut);
+    return false;
+  }
+  bool ok = splat_decode_slices(v, lut, NULL, 1, &rgb);
+  free(lut);
+  if (!ok) {
+    free(rgb);
     return false;
-
-  for (uint64_t i = 0; i < npix; ++i) {
-    uint64_t idx = v->index.index[i];
-    if (idx >= v->header.pSize) {
-      free(rgb);
-      return false;
-    }
-    const Splat4D *s = &v->palette.palette[idx];
-    rgb[i * 3] = splat_channel_to_u8(s->r);
-    rgb[i * 3 + 1] = splat_channel_to_u8(s->g);
-    rgb[i * 3 + 2] = splat_channel_to_u8(s->b);
   }
 
   *rgb_out = rgb;
@@ -3132,47 +7492,148 @@ bool video_to_image(const Splat4DVideo *v, uint8_t **rgb_out, uint32_t *w_out, u
   return true;
 }
 
+// Free the n slices of video_to_slices() or video_to_frames() and the array.
+void free_video_slices(uint8_t **slices, uint32_t n) {
+  if (!slices)
+    return;
+  for (uint32_t s = 0; s < n; ++s)
+    free(slices[s]);
+  free(slices);
+}
+
 // Reconstruct every slice of a video/volume. On success *slices_out is an array
 // of depth*frames freshly allocated w*h*3 RGB8 buffers in t-major, z-minor order;
-// the caller frees each buffer and then the array.
+// the caller frees each buffer and then the array (or calls free_video_slices).
 bool video_to_slices(const Splat4DVideo *v, uint8_t ***slices_out, uint32_t *nslices_out,
                      uint32_t *w_out, uint32_t *h_out) {
-  if (!v || !slices_out || !v->palette.palette || !v->index.index)
+  if (!v || !slices_out || !v->palette.palette || !v->index.data)
     return false;
   uint32_t w = v->header.width, h = v->header.height;
   uint64_t nslices = (uint64_t)v->header.depth * (uint64_t)v->header.frames;
   uint64_t npix = (uint64_t)w * (uint64_t)h;
-  if (npix == 0 || npix > SIZE_MAX / 3 || nslices == 0 || nslices > SIZE_MAX / sizeof(uint8_t *))
+  if (npix == 0 || npix > SIZE_MAX / 3 || nslices == 0 || nslices > UINT32_MAX)
     return false;
 
   uint8_t **slices = calloc((size_t)nslices, sizeof(uint8_t *));
+  bool ok = slices != NULL;
+  for (uint64_t s = 0; ok && s < nslices; ++s)
+    ok = (slices[s] = malloc((size_t)npix * 3)) != NULL;
+  uint32_t *lut = ok ? splat_palette_rgb_lut(v, nslices * npix) : NULL;
+  ok = lut && splat_decode_slices(v, lut, NULL, nslices, slices);
+  free(lut);
+
+  if (!ok) {
+    if (slices)
+      free_video_slices(slices, (uint32_t)nslices);
+    return false;
+  }
+
+  *slices_out = slices;
+  if (nslices_out)
+    *nslices_out = (uint32_t)nslices;
+  if (w_out)
+    *w_out = w;
+  if (h_out)
+    *h_out = h;
+  return true;
+}
+
+// Like video_to_slices(), but every slice is decoded in parallel into one
+// depth*frames*w*h*3 block, with no search for repeats: slice s starts at
+// slices[0] + s*w*h*3. Release it with free_video_slice_block().
+bool video_to_slice_block(const Splat4DVideo *v, uint8_t ***slices_out, uint32_t *nslices_out,
+                          uint32_t *w_out, uint32_t *h_out) {
+  if (!v || !slices_out || !v->palette.palette || !v->index.data)
+    return false;
+  uint32_t w = v->header.width, h = v->header.height;
+  uint64_t nslices = (uint64_t)v->header.depth * (uint64_t)v->header.frames;
+  uint64_t npix = (uint64_t)w * (uint64_t)h;
+  if (npix == 0 || npix > SIZE_MAX / 3 || nslices == 0 || nslices > UINT32_MAX ||
+      nslices > SIZE_MAX / 3 / npix)
+    return false;
+
+  uint8_t **slices = malloc((size_t)nslices * sizeof(uint8_t *));
+  uint8_t *block = slices ? malloc((size_t)(nslices * npix * 3)) : NULL;
+  for (uint64_t s = 0; block && s < nslices; ++s)
+    slices[s] = block + (size_t)(s * npix * 3);
+  uint32_t *lut = block ? splat_palette_rgb_lut(v, nslices * npix) : NULL;
+  bool ok = lut && splat_decode_slices(v, lut, NULL, nslices, slices);
+  free(lut);
+
+  if (!ok) {
+    free(block);
+    free(slices);
+    return false;
+  }
+
+  *slices_out = slices;
+  if (nslices_out)
+    *nslices_out = (uint32_t)nslices;
+  if (w_out)
+    *w_out = w;
+  if (h_out)
+    *h_out = h;
+  return true;
+}
+
+// Release the slices of video_to_slice_block(): the block, then the array.
+void free_video_slice_block(uint8_t **slices) {
   if (!slices)
+    return;
+  free(slices[0]);
+  free(slices);
+}
+
+// Like video_to_slices(), but a slice whose index repeats an earlier one (a
+// held frame, an empty slab) is decoded once and every repeat points at the
+// same pixels. Finding the repeats costs a CRC pass over the index, a sort and
+// a byte comparison per candidate, so this is for clips known to hold still.
+// Treat the slices as read-only and release them with free_shared_video_slices().
+bool video_to_shared_slices(const Splat4DVideo *v, uint8_t ***slices_out, uint32_t *nslices_out,
+                            uint32_t *w_out, uint32_t *h_out) {
+  if (!v || !slices_out || !v->palette.palette || !v->index.data)
+    return false;
+  uint32_t w = v->header.width, h = v->header.height;
+  uint64_t nslices = (uint64_t)v->header.depth * (uint64_t)v->header.frames;
+  uint64_t npix = (uint64_t)w * (uint64_t)h;
+  if (npix == 0 || npix > SIZE_MAX / 3 || nslices == 0 || nslices > UINT32_MAX)
     return false;
 
-  bool ok = true;
-  for (uint64_t s = 0; s < nslices && ok; ++s) {
-    uint8_t *rgb = malloc((size_t)npix * 3);
-    if (!rgb) {
-      ok = false;
-      break;
-    }
-    slices[s] = rgb;
-    for (uint64_t i = 0; i < npix; ++i) {
-      uint64_t idx = v->index.index[s * npix + i];
-      if (idx >= v->header.pSize) {
-        ok = false;
-        break;
-      }
-      const Splat4D *sp = &v->palette.palette[idx];
-      rgb[i * 3] = splat_channel_to_u8(sp->r);
-      rgb[i * 3 + 1] = splat_channel_to_u8(sp->g);
-      rgb[i * 3 + 2] = splat_channel_to_u8(sp->b);
+  uint8_t **slices = calloc((size_t)nslices, sizeof(uint8_t *));
+  uint64_t *ref = malloc((size_t)nslices * sizeof(uint64_t));
+  uint32_t *crcs = malloc((size_t)nslices * sizeof(uint32_t));
+  bool ok = slices && ref && crcs &&
+            splat_find_repeats(&v->index, v->index.width, npix, nslices, crcs, ref);
+  uint64_t unique = 0;
+  for (uint64_t s = 0; ok && s < nslices; ++s)
+    unique += ref[s] == s;
+  uint8_t *block = ok && unique <= SIZE_MAX / 3 / npix ? malloc((size_t)(unique * npix * 3)) : NULL;
+  uint32_t *lut = block ? splat_palette_rgb_lut(v, nslices * npix) : NULL;
+  ok = ok && lut;
+
+  // Distinct slices are decoded back to back in parallel; a repeat points at
+  // its first occurrence.
+  uint64_t *src = ok ? malloc((size_t)unique * sizeof(uint64_t)) : NULL;
+  uint8_t **out = src ? malloc((size_t)unique * sizeof(uint8_t *)) : NULL;
+  ok = ok && out;
+  for (uint64_t s = 0, k = 0; ok && s < nslices; ++s) {
+    if (ref[s] != s) {
+      slices[s] = slices[ref[s]];
+      continue;
     }
+    src[k] = s;
+    out[k] = slices[s] = block + (size_t)(k * npix * 3);
+    ++k;
   }
+  ok = ok && splat_decode_slices(v, lut, src, unique, out);
+  free(out);
+  free(src);
+  free(lut);
+  free(ref);
+  free(crcs);
 
   if (!ok) {
-    for (uint64_t s = 0; s < nslices; ++s)
-      free(slices[s]);
+    free(block);
     free(slices);
     return false;
   }
@@ -3187,6 +7648,15 @@ bool video_to_slices(const Splat4DVideo *v, uint8_t ***slices_out, uint32_t *nsl
   return true;
 }
 
+// Release the slices of video_to_shared_slices(). Slice 0 heads the one block
+// that holds every distinct slice.
+void free_shared_video_slices(uint8_t **slices) {
+  if (!slices)
+    return;
+  free(slices[0]);
+  free(slices);
+}
+
 // Reconstruct every frame of a video (depth must be 1).
 bool video_to_frames(const Splat4DVideo *v, uint8_t ***frames_out, uint32_t *nframes_out,
                      uint32_t *w_out, uint32_t *h_out) {
@@ -3194,7 +7664,781 @@ bool video_to_frames(const Splat4DVideo *v, uint8_t ***frames_out, uint32_t *nfr
     LOG_ERROR("❌ Video decode requires depth = 1\n");
     return false;
   }
-  return video_to_slices(v, frames_out, nframes_out, w_out, h_out);
+  return video_to_slices(v, frames_out, nframes_out, w_out, h_out);
+}
+
+// --- streaming decode --------------------------------------------------------
+//
+// splat4d_decode_each_slice() hands a file's slices to a callback in order and
+// holds only one frame of index and RGB at a time. Memory does not grow with
+// the clip. A SplatFrameReader walks the stored index section frame by frame,
+// whatever its layout:
+// - uncompressed frames are read straight from the file;
+// - a chunked index keeps a window of decoded chunks of up to
+//   SPLAT_DECODE_CACHE_BYTES;
+// - a monolithic compressed index runs one codec stream across all frames;
+// - the delta transform keeps the previous frame.
+// LZ4 has no streaming decoder here, so a monolithic LZ4 index is decoded
+// whole first.
+#define SPLAT_DECODE_CACHE_BYTES ((uint64_t)64 << 20)
+
+typedef struct {
+  FILE *fp;
+  Splat4DHeader h; // the stored header: frames counts stored frames
+  uint32_t codec;
+  uint8_t idx_width;
+  uint64_t total, frame_entries, frame_bytes;
+  uint64_t next;        // next stored frame
+  SplatDeltaGeom delta; // plane_bytes is 0 without the transform
+  uint8_t *prev;        // the previous stored frame, for the delta transform
+  bool chunked;
+  Splat4DChunkLayout l;
+  uint8_t *cache; // entries [cache_first, cache_first + cache_count)
+  uint64_t cache_first, cache_count, cache_cap;
+  bool streaming;
+  SplatDecoder dec;
+  uint64_t comp_left; // compressed bytes not yet read
+  const uint8_t *in;
+  size_t in_n;
+  uint8_t inbuf[SPLAT_CODEC_BUFFER_BYTES];
+  Splat4DIndex whole; // a monolithic LZ4 index
+} SplatFrameReader;
+
+static void frame_reader_close(SplatFrameReader *r) {
+  if (r->streaming)
+    splat_decoder_end(&r->dec);
+  free(r->prev);
+  free(r->cache);
+  free(r->whole.data);
+}
+
+// Start reading the stored index of `stored`, whose section starts at
+// index_start. On failure everything is released.
+static bool frame_reader_open(SplatFrameReader *r, FILE *fp, const Splat4DHeader *stored,
+                              uint64_t index_start, uint64_t filesize) {
+  memset(r, 0, sizeof *r);
+  r->fp = fp;
+  r->h = *stored;
+  r->codec = (stored->flags & SPLAT_FLAG_COMPRESSION_MASK) >> SPLAT_FLAG_COMPRESSION_SHIFT;
+  r->idx_width = get_index_width_bytes(stored->flags);
+  r->total = header_total_indices(stored);
+  r->frame_entries = (uint64_t)stored->width * stored->height * stored->depth;
+  r->frame_bytes = r->frame_entries * r->idx_width;
+  uint32_t key_frames = 0;
+  bool ok = true;
+  if (stored->version[2] == SPLAT_LAYOUT_CHUNKED) {
+    r->chunked = true;
+    ok = read_chunk_layout(fp, stored, r->total, index_start, filesize, &r->l);
+    key_frames = r->l.key_frames;
+    uint64_t epc = r->l.entries_per_chunk;
+    uint64_t chunks = ok ? SPLAT_DECODE_CACHE_BYTES / (epc * r->idx_width) : 0;
+    r->cache_cap = (chunks ? chunks : 1) * epc;
+    r->cache_cap = r->cache_cap < r->total ? r->cache_cap : r->total;
+    r->cache = ok ? malloc((size_t)(r->cache_cap * r->idx_width)) : NULL;
+    ok = r->cache != NULL;
+  } else if (r->codec == SPLAT_COMPRESSION_NONE) {
+    ok = index_start + r->total * r->idx_width + SPLAT_FOOTER_DISK_BYTES <= filesize &&
+         fseek(fp, (long)index_start, SEEK_SET) == 0;
+  } else {
+    ok = filesize >= index_start + SPLAT_FOOTER_DISK_BYTES &&
+         fseek(fp, (long)index_start, SEEK_SET) == 0;
+    r->comp_left = ok ? filesize - index_start - SPLAT_FOOTER_DISK_BYTES : 0;
+    if (ok && splat_codec_streams(r->codec)) {
+      ok = splat_decoder_begin(&r->dec, r->codec, NULL, 0);
+      r->streaming = true;
+    } else if (ok) {
+      ok = r->total * r->idx_width <= SPLAT_MAX_COMPRESSED_INDEX_BYTES &&
+           read_index_compressed(fp, &r->whole, r->total, stored->flags, (size_t)r->comp_left,
+                                 r->codec);
+    }
+  }
+  if (ok && (stored->version[3] & SPLAT_TRANSFORM_DELTA)) {
+    r->delta = splat_delta_geom(stored, key_frames);
+    r->prev = malloc((size_t)(r->frame_bytes ? r->frame_bytes : 1));
+    ok = r->prev != NULL;
+  }
+  if (!ok)
+    frame_reader_close(r);
+  return ok;
+}
+
+// Run the codec stream until `len` more bytes are in dst.
+static bool frame_reader_inflate(SplatFrameReader *r, uint8_t *dst, size_t len) {
+  SplatDecoder *d = &r->dec;
+  d->dst = dst;
+  d->cap = len;
+  d->len = 0;
+  while (d->len < d->cap) {
+    if (r->in_n == 0 && r->comp_left > 0) {
+      size_t want = r->comp_left < sizeof r->inbuf ? (size_t)r->comp_left : sizeof r->inbuf;
+      if (fread(r->inbuf, 1, want, r->fp) != want)
+        return false;
+      r->in = r->inbuf;
+      r->in_n = want;
+      r->comp_left -= want;
+    }
+    bool last = r->in_n == 0 && r->comp_left == 0;
+    size_t n = r->in_n, got = d->len;
+    if (!splat_decoder_step(d, &r->in, &r->in_n, last) ||
+        (r->in_n == n && d->len == got && (last || d->ended)))
+      return false; // the stream ended or stalled short of the frame
+  }
+  return true;
+}
+
+// Undo the delta transform on stored frame t in `cur`, given frame t - 1.
+static void delta_decode_frame(const SplatDeltaGeom *g, uint64_t t, const uint8_t *prev,
+                               uint8_t *cur) {
+  uint64_t P = g->plane_bytes, s0 = t * g->depth;
+  for (uint64_t z = 0, ref; z < g->depth; ++z) {
+    if (!delta_ref_plane(g, s0 + z, &ref))
+      continue;
+    const uint8_t *src = ref >= s0 ? cur + (ref - s0) * P : prev + (ref + g->depth - s0) * P;
+    uint8_t *p = cur + z * P;
+    for (uint64_t k = 0; k < P; ++k)
+      p[k] ^= src[k];
+  }
+}
+
+// The next stored frame, packed at the header width.
+static bool frame_reader_next(SplatFrameReader *r, uint8_t *dst) {
+  if (r->next >= r->h.frames)
+    return false;
+  uint64_t first = r->next * r->frame_entries;
+  bool ok = true;
+  if (r->chunked) {
+    for (uint64_t done = 0; ok && done < r->frame_entries;) {
+      uint64_t pos = first + done;
+      if (pos < r->cache_first || pos >= r->cache_first + r->cache_count) {
+        r->cache_first = pos / r->l.entries_per_chunk * r->l.entries_per_chunk;
+        r->cache_count = r->total - r->cache_first < r->cache_cap ? r->total - r->cache_first
+                                                                  : r->cache_cap;
+        ok = read_chunked_range(r->fp, &r->l, r->codec, r->idx_width, r->total, r->cache_first,
+                                r->cache_count, r->cache);
+        if (!ok)
+          r->cache_count = 0;
+      }
+      uint64_t n = r->cache_first + r->cache_count - pos;
+      n = n < r->frame_entries - done ? n : r->frame_entries - done;
+      if (ok)
+        memcpy(dst + done * r->idx_width, r->cache + (pos - r->cache_first) * r->idx_width,
+               (size_t)(n * r->idx_width));
+      done += n;
+    }
+  } else if (r->streaming) {
+    ok = frame_reader_inflate(r, dst, (size_t)r->frame_bytes);
+  } else if (r->whole.data) {
+    memcpy(dst, r->whole.u8 + first * r->idx_width, (size_t)r->frame_bytes);
+  } else {
+    ok = fread(dst, 1, (size_t)r->frame_bytes, r->fp) == r->frame_bytes;
+  }
+  if (ok && r->prev) {
+    if (r->delta.plane_bytes)
+      delta_decode_frame(&r->delta, r->next, r->prev, dst);
+    memcpy(r->prev, dst, (size_t)r->frame_bytes);
+  }
+  r->next++;
+  return ok;
+}
+
+// After the last frame: a codec stream must end exactly there.
+static bool frame_reader_finish(SplatFrameReader *r) {
+  if (!r->streaming)
+    return true;
+  uint8_t extra;
+  SplatDecoder *d = &r->dec;
+  d->dst = &extra;
+  d->cap = 1;
+  d->len = 0;
+  while (!d->ended) {
+    if (r->in_n == 0 && r->comp_left > 0) {
+      size_t want = r->comp_left < sizeof r->inbuf ? (size_t)r->comp_left : sizeof r->inbuf;
+      if (fread(r->inbuf, 1, want, r->fp) != want)
+        return false;
+      r->in = r->inbuf;
+      r->in_n = want;
+      r->comp_left -= want;
+    }
+    bool last = r->in_n == 0 && r->comp_left == 0;
+    size_t n = r->in_n;
+    if (!splat_decoder_step(d, &r->in, &r->in_n, last) || d->len != 0 ||
+        (r->in_n == n && !d->ended && last))
+      return false;
+  }
+  return r->in_n == 0 && r->comp_left == 0;
+}
+
+// Receives slice z of frame t as w*h RGB8 pixels (w and h from `header`).
+// The pixels are only valid during the call. Return false to stop the decode.
+typedef bool (*Splat4DSliceFn)(void *ctx, uint32_t t, uint32_t z, const uint8_t *rgb,
+                               const Splat4DHeader *header);
+
+// Decode every slice of a file in t-major, z-minor order. Each slice goes to
+// `fn` as soon as its frame is decoded, so memory stays at about one frame of
+// index and RGB. Frames that repeat an earlier frame through the frame table
+// keep that frame's index until its last use. With opts->verify FULL (the
+// default), the checksum is compared once the last slice has been handed
+// out. A mismatch then fails the call, but the slices were already
+// delivered. The other modes skip the check. *header_out, when given,
+// receives the header.
+bool splat4d_decode_each_slice(FILE *fp, const Splat4DReadOptions *opts, Splat4DSliceFn fn,
+                               void *ctx, Splat4DHeader *header_out) {
+  if (!fp || !fn)
+    return false;
+  Splat4DVideo v = {.palette = {.palette = NULL}};
+  Splat4DHeader *h = &v.header;
+  if (fseek(fp, 0, SEEK_SET) != 0 || !read_splat4DHeader(fp, h) || !header_readable(h))
+    return false;
+  uint8_t idx_width = get_index_width_bytes(h->flags);
+  uint64_t total = 0, frame_entries = 0, frame_bytes = 0, palette_bytes = 0, filesize = 0;
+  uint64_t npix = (uint64_t)h->width * h->height;
+  if (!header_total_indices_checked(h, &total) ||
+      !checked_mul_u64(npix, h->depth, &frame_entries) ||
+      !checked_mul_u64(frame_entries, idx_width, &frame_bytes) ||
+      !checked_mul_u64(h->pSize, palette_entry_disk_bytes(h->flags), &palette_bytes) ||
+      !splat_file_size(fp, &filesize) ||
+      filesize < SPLAT_HEADER_DISK_BYTES + SPLAT_FOOTER_DISK_BYTES ||
+      palette_bytes > filesize - SPLAT_HEADER_DISK_BYTES - SPLAT_FOOTER_DISK_BYTES ||
+      frame_bytes > SPLAT_MAX_COMPRESSED_INDEX_BYTES || npix > SIZE_MAX / 3 / h->depth) {
+    LOG_ERROR("❌ Invalid header dimensions\n");
+    return false;
+  }
+  if (header_out)
+    *header_out = *h;
+  uint64_t index_start = SPLAT_HEADER_DISK_BYTES + palette_bytes;
+  Splat4DFooter footer;
+  if (fseek(fp, (long)(filesize - SPLAT_FOOTER_DISK_BYTES), SEEK_SET) != 0 ||
+      !read_splat4DFooter(fp, &footer) || footer.end != 0x4C505334) {
+    LOG_ERROR("❌ Invalid footer end marker\n");
+    return false;
+  }
+  // A chunked footer points at the chunk table, which the reader checks.
+  if (h->version[2] != SPLAT_LAYOUT_CHUNKED && !sanity_check_idxoffset_file(fp, h, &footer)) {
+    LOG_ERROR("❌ Index offset mismatch (footer=%" PRIu64 ", expect=%" PRIu64 ")\n",
+              (uint64_t)footer.idxoffset, compute_idxoffset_forward(h));
+    return false;
+  }
+  if (fseek(fp, SPLAT_HEADER_DISK_BYTES, SEEK_SET) != 0 ||
+      !read_splat4DPalette(fp, &v.palette, h->pSize, h->flags))
+    return false;
+
+  SplatFrameTable ft = {.slot = NULL};
+  bool refs = h->version[3] & SPLAT_TRANSFORM_FRAME_REFS;
+  bool ok = !refs || read_frame_table(fp, h, index_start, filesize, &ft);
+  Splat4DHeader stored = stored_index_header(h, &ft);
+  SplatFrameReader *r = ok ? malloc(sizeof *r) : NULL;
+  ok = r && frame_reader_open(r, fp, &stored, index_start + frame_table_disk_bytes(h), filesize);
+  if (!ok) {
+    free(r);
+    r = NULL;
+  }
+
+  // A stored frame that shows again later is held until its last use.
+  uint32_t *last_use = ok && refs ? malloc((size_t)ft.nstored * sizeof(uint32_t)) : NULL;
+  uint8_t **held = ok && refs ? calloc(ft.nstored, sizeof(uint8_t *)) : NULL;
+  ok = ok && (!refs || (last_use && held));
+  for (uint32_t t = 0; ok && refs && t < h->frames; ++t)
+    last_use[ft.slot[t]] = t;
+
+  uint8_t *frame = ok ? malloc((size_t)(frame_bytes ? frame_bytes : 1)) : NULL;
+  uint8_t *rgb = frame ? malloc((size_t)(npix * 3 * h->depth)) : NULL;
+  uint8_t **zs = rgb ? malloc((size_t)h->depth * sizeof(uint8_t *)) : NULL;
+  uint32_t *lut = zs ? splat_palette_rgb_lut(&v, 0) : NULL;
+  ok = ok && lut;
+  for (uint32_t z = 0; ok && z < h->depth; ++z)
+    zs[z] = rgb + (size_t)(z * npix * 3);
+  bool verify = !opts || opts->verify == SPLAT_READ_VERIFY_FULL;
+  crc32_t crc;
+  crc32_init(&crc);
+  ok = ok && (!verify || splat4d_stream_prefix(&v, SPLAT4D_STREAM_CHUNK_SIZE,
+                                               splat4d_crc32_consumer, &crc));
+
+  Splat4DVideo view = v;
+  view.header.frames = 1;
+  for (uint32_t t = 0; ok && t < h->frames; ++t) {
+    uint64_t slot = refs ? ft.slot[t] : t;
+    const uint8_t *cur = frame;
+    if (slot < r->next) {
+      cur = held[slot];
+    } else {
+      ok = frame_reader_next(r, frame);
+      if (ok && refs && last_use[slot] > t) {
+        held[slot] = malloc((size_t)frame_bytes);
+        ok = held[slot] != NULL;
+        if (ok)
+          memcpy(held[slot], frame, (size_t)frame_bytes);
+      }
+    }
+    view.index = (Splat4DIndex){.u8 = (uint8_t *)cur, .width = idx_width};
+    ok = ok && splat_index_below(&view.index, frame_entries, h->pSize) &&
+         splat_decode_slices(&view, lut, NULL, h->depth, zs);
+    if (ok && verify)
+      crc32_update(&crc, cur, (size_t)frame_bytes);
+    for (uint32_t z = 0; ok && z < h->depth; ++z)
+      ok = fn(ctx, t, z, zs[z], h);
+    if (refs && last_use[slot] == t && held[slot]) {
+      free(held[slot]);
+      held[slot] = NULL;
+    }
+  }
+  ok = ok && frame_reader_finish(r);
+  if (ok && verify && crc32_final(&crc) != footer.checksum) {
+    LOG_ERROR("❌ CRC mismatch: file=0x%08X recomputed=0x%08X\n", footer.checksum,
+              crc32_final(&crc));
+    ok = false;
+  }
+
+  for (uint32_t k = 0; held && k < ft.nstored; ++k)
+    free(held[k]);
+  free(held);
+  free(last_use);
+  free(lut);
+  free(zs);
+  free(rgb);
+  free(frame);
+  if (r)
+    frame_reader_close(r);
+  free(r);
+  frame_table_free(&ft);
+  free(v.palette.palette);
+  return ok;
+}
+
+static bool parse_u32(const char *arg, uint32_t *out) {
+  if (!arg || !out)
+    return false;
+  errno = 0;
+  char *end = NULL;
+  unsigned long value = strtoul(arg, &end, 10);
+  if (errno != 0 || !end || *end != '\0' || value > UINT32_MAX)
+    return false;
+  *out = (uint32_t)value;
+  return true;
+}
+
+// --- PNM input ---------------------------------------------------------------
+//
+// Frames come in as binary PPM (P6), PGM (P5) or PAM (P7). The header is
+// parsed from one buffered read of the file's first bytes instead of
+// character-level stdio calls. The stream itself is unbuffered, so the pixel
+// data goes straight from the file into the caller's frame: an 8-bit RGB frame
+// needs no copy at all. Other layouts pass through a scratch buffer that the
+// reader reuses from frame to frame. Gray is expanded to RGB and alpha is
+// dropped. Maxvals other than 255, including 16-bit ones, are rescaled to
+// 8 bits with rounding. A header that does not end inside the first read (a
+// long comment) is read on into a larger buffer, up to PNM_HEADER_MAX_BYTES.
+#define PNM_HEADER_BUFFER_BYTES 4096
+#define PNM_HEADER_MAX_BYTES ((size_t)1 << 20)
+
+typedef struct {
+  uint32_t w, h;
+  uint32_t channels; // 1 gray, 2 gray + alpha, 3 RGB, 4 RGB + alpha
+  uint32_t maxval;
+  size_t header_bytes; // offset of the pixel data
+} PnmHeader;
+
+typedef struct {
+  uint8_t *head; // the first bytes of the current file, reused
+  size_t head_len, head_cap;
+  uint8_t *scratch; // raw samples of the current frame, reused
+  size_t scratch_cap;
+} PnmReader;
+
+static bool pnm_is_space(uint8_t c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Skip whitespace and #-comments from *pos. False when the buffer runs out.
+static bool pnm_skip_space(const uint8_t *buf, size_t n, size_t *pos) {
+  while (*pos < n) {
+    if (buf[*pos] == '#') {
+      while (*pos < n && buf[*pos] != '\n')
+        (*pos)++;
+    } else if (pnm_is_space(buf[*pos])) {
+      (*pos)++;
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool pnm_parse_u32(const uint8_t *buf, size_t n, size_t *pos, uint32_t *out) {
+  if (!pnm_skip_space(buf, n, pos) || buf[*pos] < '0' || buf[*pos] > '9')
+    return false;
+  uint64_t v = 0;
+  while (*pos < n && buf[*pos] >= '0' && buf[*pos] <= '9') {
+    v = v * 10 + (uint64_t)(buf[*pos] - '0');
+    if (v > UINT32_MAX)
+      return false;
+    (*pos)++;
+  }
+  *out = (uint32_t)v;
+  return *pos < n; // a separator must follow
+}
+
+// Parse a PAM header ("P7" already consumed): KEY value lines up to ENDHDR.
+static bool pam_parse_header(const uint8_t *buf, size_t n, size_t *pos, PnmHeader *hd) {
+  uint32_t depth = 0;
+  char tupltype[32] = "";
+  for (;;) {
+    if (!pnm_skip_space(buf, n, pos))
+      return false;
+    char key[16];
+    size_t k = 0;
+    while (*pos < n && !pnm_is_space(buf[*pos]) && k + 1 < sizeof key)
+      key[k++] = (char)buf[(*pos)++];
+    key[k] = '\0';
+    if (strcmp(key, "ENDHDR") == 0) {
+      while (*pos < n && buf[*pos] != '\n')
+        (*pos)++;
+      if (*pos >= n)
+        return false;
+      (*pos)++;
+      break;
+    }
+    if (strcmp(key, "TUPLTYPE") == 0) {
+      while (*pos < n && (buf[*pos] == ' ' || buf[*pos] == '\t'))
+        (*pos)++;
+      size_t t = 0;
+      while (*pos < n && !pnm_is_space(buf[*pos]) && t + 1 < sizeof tupltype)
+        tupltype[t++] = (char)buf[(*pos)++];
+      tupltype[t] = '\0';
+      continue;
+    }
+    uint32_t *field = strcmp(key, "WIDTH") == 0    ? &hd->w
+                      : strcmp(key, "HEIGHT") == 0 ? &hd->h
+                      : strcmp(key, "DEPTH") == 0  ? &depth
+                      : strcmp(key, "MAXVAL") == 0 ? &hd->maxval
+                                                   : NULL;
+    if (!field || !pnm_parse_u32(buf, n, pos, field))
+      return false;
+  }
+  bool gray = strncmp(tupltype, "GRAYSCALE", 9) == 0 || strcmp(tupltype, "BLACKANDWHITE") == 0;
+  bool rgb = strncmp(tupltype, "RGB", 3) == 0;
+  if (tupltype[0] && !gray && !rgb)
+    return false;
+  hd->channels = depth;
+  return depth >= 1 && depth <= 4 && (!gray || depth <= 2) && (!rgb || depth >= 3);
+}
+
+// Parse a P5/P6/P7 header from the first n bytes of a file.
+static bool pnm_parse_header(const uint8_t *buf, size_t n, PnmHeader *hd) {
+  *hd = (PnmHeader){0};
+  if (n < 3 || buf[0] != 'P' || buf[1] < '5' || buf[1] > '7' || !pnm_is_space(buf[2]))
+    return false;
+  size_t pos = 2;
+  if (buf[1] == '7') {
+    if (!pam_parse_header(buf, n, &pos, hd))
+      return false;
+  } else {
+    hd->channels = buf[1] == '6' ? 3 : 1;
+    if (!pnm_parse_u32(buf, n, &pos, &hd->w) || !pnm_parse_u32(buf, n, &pos, &hd->h) ||
+        !pnm_parse_u32(buf, n, &pos, &hd->maxval) || !pnm_is_space(buf[pos]))
+      return false;
+    pos++; // the single whitespace byte after maxval
+  }
+  hd->header_bytes = pos;
+  return hd->w > 0 && hd->h > 0 && hd->maxval > 0 && hd->maxval <= 65535;
+}
+
+// Read and parse the header of an unbuffered stream into r->head, leaving the
+// stream positioned after the bytes read. The buffer only grows while it comes
+// back full without a complete header.
+static bool pnm_read_header(PnmReader *r, FILE *fp, const char *path, PnmHeader *hd) {
+  r->head_len = 0;
+  for (;;) {
+    if (r->head_len == r->head_cap) {
+      size_t cap = r->head_cap ? r->head_cap * 2 : PNM_HEADER_BUFFER_BYTES;
+      uint8_t *grown = cap <= PNM_HEADER_MAX_BYTES ? realloc(r->head, cap) : NULL;
+      if (!grown)
+        break;
+      r->head = grown;
+      r->head_cap = cap;
+    }
+    size_t want = r->head_cap - r->head_len;
+    size_t got = fread(r->head + r->head_len, 1, want, fp);
+    r->head_len += got;
+    if (pnm_parse_header(r->head, r->head_len, hd)) {
+      if ((uint64_t)hd->w * hd->h > SIZE_MAX / 8) {
+        LOG_ERROR("❌ '%s' is too large (%ux%u)\n", path, hd->w, hd->h);
+        return false;
+      }
+      return true;
+    }
+    if (got < want)
+      break; // the file ended inside the header
+  }
+  LOG_ERROR("❌ '%s' is not a binary PPM, PGM or PAM with maxval up to 65535\n", path);
+  return false;
+}
+
+// Read the pixels of an opened file into rgb (w*h*3 bytes) and close it.
+static bool pnm_read_rgb(PnmReader *r, FILE *fp, const char *path, const PnmHeader *hd,
+                         uint8_t *rgb) {
+  size_t npix = (size_t)hd->w * hd->h, bps = hd->maxval > 255 ? 2 : 1;
+  size_t raw_len = npix * hd->channels * bps;
+  bool direct = hd->channels == 3 && hd->maxval == 255;
+  uint8_t *raw = rgb;
+  if (!direct && r->scratch_cap < raw_len) {
+    uint8_t *grown = realloc(r->scratch, raw_len);
+    if (!grown) {
+      fclose(fp);
+      return false;
+    }
+    r->scratch = grown;
+    r->scratch_cap = raw_len;
+  }
+  if (!direct)
+    raw = r->scratch;
+  size_t have = r->head_len - hd->header_bytes;
+  have = have < raw_len ? have : raw_len;
+  memcpy(raw, r->head + hd->header_bytes, have);
+  bool ok = have == raw_len || fread(raw + have, 1, raw_len - have, fp) == raw_len - have;
+  fclose(fp);
+  if (!ok) {
+    LOG_ERROR("❌ Truncated pixel data in '%s'\n", path);
+    return false;
+  }
+  if (direct)
+    return true;
+  uint32_t maxval = hd->maxval, ch = hd->channels, color = ch >= 3 ? 3 : 1;
+  for (size_t k = 0; k < npix; ++k) {
+    const uint8_t *px = raw + k * ch * bps;
+    for (uint32_t c = 0; c < 3; ++c) {
+      const uint8_t *s = px + (color == 3 ? c : 0) * bps;
+      uint32_t v = bps == 2 ? (uint32_t)s[0] << 8 | s[1] : s[0];
+      v = v > maxval ? maxval : v;
+      rgb[k * 3 + c] = (uint8_t)(maxval == 255 ? v : (v * 255 + maxval / 2) / maxval);
+    }
+  }
+  return true;
+}
+
+static void pnm_reader_free(PnmReader *r) {
+  free(r->head);
+  free(r->scratch);
+}
+
+// --- raw RGB24 / Y4M pipes ---------------------------------------------------
+//
+// encode-video and decode-video accept "-" for stdin or stdout. Those streams
+// hold frames back to back: packed RGB24, or YUV4MPEG2 (Y4M). Y4M is
+// recognized by its signature, and raw input needs --size. Both sides use a
+// large stdio buffer and move one frame per fread/fwrite call, so a pipe from
+// or to ffmpeg costs a few syscalls per frame. Y4M carries YCbCr, converted
+// here with BT.601 limited-range coefficients (ffmpeg's default for yuv4mpegpipe).
+// Chroma planes are upsampled by repeating samples, so only raw RGB24
+// round-trips exactly.
+#define SPLAT_PIPE_BUFFER_BYTES (1 << 22)
+#define Y4M_SIGNATURE "YUV4MPEG2"
+#define Y4M_SIGNATURE_BYTES 9
+#define Y4M_MAX_LINE 256
+
+typedef struct {
+  FILE *fp;
+  bool y4m;
+  uint32_t w, h;
+  uint32_t sx, sy; // log2 chroma subsampling
+  bool mono;
+  uint8_t *planes; // one Y4M frame: Y, then Cb and Cr
+  size_t frame_bytes;
+  uint8_t peek[Y4M_SIGNATURE_BYTES]; // bytes read while sniffing raw input
+  size_t npeek;
+} PipeReader;
+
+static uint8_t clamp_u8(int v) { return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v); }
+
+// Read a '\n'-terminated line of at most Y4M_MAX_LINE - 1 bytes. Returns 0 at
+// a clean EOF, -1 on error.
+static int read_y4m_line(FILE *fp, char *line) {
+  size_t n = 0;
+  for (int c; (c = fgetc(fp)) != '\n';) {
+    if (c == EOF)
+      return n == 0 && !ferror(fp) ? 0 : -1;
+    if (n + 1 >= Y4M_MAX_LINE)
+      return -1;
+    line[n++] = (char)c;
+  }
+  line[n] = '\0';
+  return 1;
+}
+
+// Parse the Y4M stream header parameters after the signature. Width, height
+// and 8-bit chroma layouts are used; frame rate, interlacing and aspect are
+// ignored.
+static bool parse_y4m_header(const char *params, PipeReader *p) {
+  p->sx = p->sy = 1; // the spec's default, 420jpeg
+  for (const char *s = params; *s;) {
+    while (*s == ' ')
+      s++;
+    const char *end = s + strcspn(s, " ");
+    char tok[Y4M_MAX_LINE];
+    size_t len = (size_t)(end - s);
+    memcpy(tok, s, len);
+    tok[len] = '\0';
+    if (tok[0] == 'W' && !parse_u32(tok + 1, &p->w)) {
+      return false;
+    } else if (tok[0] == 'H' && !parse_u32(tok + 1, &p->h)) {
+      return false;
+    } else if (tok[0] == 'C') {
+      p->mono = strcmp(tok, "Cmono") == 0;
+      if (strncmp(tok, "C420", 4) == 0 && (!tok[4] || strcmp(tok + 4, "jpeg") == 0 ||
+                                           strcmp(tok + 4, "paldv") == 0 ||
+                                           strcmp(tok + 4, "mpeg2") == 0)) {
+        p->sx = p->sy = 1;
+      } else if (strcmp(tok, "C422") == 0) {
+        p->sx = 1, p->sy = 0;
+      } else if (strcmp(tok, "C411") == 0) {
+        p->sx = 2, p->sy = 0;
+      } else if (strcmp(tok, "C444") == 0 || p->mono) {
+        p->sx = p->sy = 0;
+      } else {
+        LOG_ERROR("❌ Unsupported Y4M color space '%s' (8-bit 420, 422, 411, 444 or mono)\n",
+                  tok + 1);
+        return false;
+      }
+    }
+    s = end;
+  }
+  return p->w > 0 && p->h > 0;
+}
+
+// Sniff `fp` for a Y4M header; anything else is raw RGB24 of raw_w x raw_h
+// (0 when --size was not given).
+static bool pipe_reader_open(PipeReader *p, FILE *fp, uint32_t raw_w, uint32_t raw_h) {
+  *p = (PipeReader){.fp = fp};
+  setvbuf(fp, NULL, _IOFBF, SPLAT_PIPE_BUFFER_BYTES);
+  p->npeek = fread(p->peek, 1, Y4M_SIGNATURE_BYTES, fp);
+  if (p->npeek == Y4M_SIGNATURE_BYTES && memcmp(p->peek, Y4M_SIGNATURE, p->npeek) == 0) {
+    char line[Y4M_MAX_LINE];
+    p->npeek = 0;
+    p->y4m = true;
+    if (read_y4m_line(fp, line) != 1 || !parse_y4m_header(line, p)) {
+      LOG_ERROR("❌ Malformed Y4M stream header\n");
+      return false;
+    }
+    uint64_t cw = ((uint64_t)p->w + (1u << p->sx) - 1) >> p->sx;
+    uint64_t ch = ((uint64_t)p->h + (1u << p->sy) - 1) >> p->sy;
+    uint64_t bytes = (uint64_t)p->w * p->h + (p->mono ? 0 : 2 * cw * ch); // Cmono: Y only
+    p->frame_bytes = bytes <= SIZE_MAX / 2 ? (size_t)bytes : 0;
+    p->planes = p->frame_bytes ? malloc(p->frame_bytes) : NULL;
+    return p->planes != NULL;
+  }
+  if (raw_w == 0 || raw_h == 0) {
+    LOG_ERROR("❌ Raw RGB24 input needs --size <w>x<h> (or a Y4M stream)\n");
+    return false;
+  }
+  p->w = raw_w;
+  p->h = raw_h;
+  return true;
+}
+
+static void pipe_reader_close(PipeReader *p) { free(p->planes); }
+
+// Convert one Y4M frame in p->planes to RGB8.
+static void y4m_frame_to_rgb(const PipeReader *p, uint8_t *rgb) {
+  uint32_t cw = (p->w + (1u << p->sx) - 1) >> p->sx;
+  uint32_t ch = (p->h + (1u << p->sy) - 1) >> p->sy;
+  const uint8_t *Y = p->planes, *U = Y + (size_t)p->w * p->h, *V = U + (size_t)cw * ch;
+  for (uint32_t y = 0; y < p->h; ++y) {
+    const uint8_t *yr = Y + (size_t)y * p->w;
+    const uint8_t *ur = U + (size_t)(y >> p->sy) * cw, *vr = V + (size_t)(y >> p->sy) * cw;
+    uint8_t *out = rgb + (size_t)y * p->w * 3;
+    for (uint32_t x = 0; x < p->w; ++x) {
+      int c = 298 * (yr[x] - 16) + 128;
+      int d = p->mono ? 0 : ur[x >> p->sx] - 128, e = p->mono ? 0 : vr[x >> p->sx] - 128;
+      out[3 * x + 0] = clamp_u8((c + 409 * e) >> 8);
+      out[3 * x + 1] = clamp_u8((c - 100 * d - 208 * e) >> 8);
+      out[3 * x + 2] = clamp_u8((c + 516 * d) >> 8);
+    }
+  }
+}
+
+// Read the next frame into rgb (w*h*3 bytes). Returns 1 for a frame, 0 at the
+// end of the stream and -1 on a truncated or malformed frame.
+static int pipe_reader_next(PipeReader *p, uint8_t *rgb) {
+  size_t n = (size_t)p->w * p->h * 3;
+  if (!p->y4m) {
+    // A frame smaller than the sniffed bytes leaves the rest for the next one.
+    size_t take = p->npeek < n ? p->npeek : n;
+    memcpy(rgb, p->peek, take);
+    p->npeek -= take;
+    memmove(p->peek, p->peek + take, p->npeek);
+    size_t got = take + fread(rgb + take, 1, n - take, p->fp);
+    if (got == n)
+      return 1;
+    if (got == 0 && !ferror(p->fp))
+      return 0;
+    LOG_ERROR("❌ Truncated RGB24 frame (%zu of %zu bytes)\n", got, n);
+    return -1;
+  }
+  char line[Y4M_MAX_LINE];
+  int r = read_y4m_line(p->fp, line);
+  if (r == 0)
+    return 0;
+  if (r < 0 || strncmp(line, "FRAME", 5) != 0 || (line[5] && line[5] != ' ')) {
+    LOG_ERROR("❌ Malformed Y4M frame header\n");
+    return -1;
+  }
+  if (fread(p->planes, 1, p->frame_bytes, p->fp) != p->frame_bytes) {
+    LOG_ERROR("❌ Truncated Y4M frame\n");
+    return -1;
+  }
+  y4m_frame_to_rgb(p, rgb);
+  return 1;
+}
+
+// Writes decoded frames to a stream as RGB24 or as Y4M 4:4:4.
+typedef struct {
+  FILE *fp;
+  bool y4m;
+  bool failed; // a header or write error, already reported
+  uint8_t *planes;
+  uint32_t written;
+} PipeWriter;
+
+static bool write_pipe_frame(void *ctx, uint32_t t, uint32_t z, const uint8_t *rgb,
+                             const Splat4DHeader *header) {
+  (void)t;
+  (void)z;
+  PipeWriter *pw = ctx;
+  if (header->depth != 1) {
+    LOG_ERROR("❌ Video decode requires depth = 1\n");
+    pw->failed = true;
+    return false;
+  }
+  size_t npix = (size_t)header->width * header->height;
+  bool ok;
+  if (!pw->y4m) {
+    ok = fwrite(rgb, 1, npix * 3, pw->fp) == npix * 3;
+  } else {
+    if (!pw->planes) {
+      pw->planes = malloc(npix * 3);
+      if (!pw->planes) {
+        pw->failed = true;
+        return false;
+      }
+      // The format stores no frame rate, so 25 fps stands in.
+      fprintf(pw->fp, Y4M_SIGNATURE " W%u H%u F25:1 Ip A1:1 C444\n", header->width,
+              header->height);
+    }
+    uint8_t *Y = pw->planes, *U = Y + npix, *V = U + npix;
+    for (size_t k = 0; k < npix; ++k) {
+      int r = rgb[3 * k], g = rgb[3 * k + 1], b = rgb[3 * k + 2];
+      Y[k] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+      U[k] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+      V[k] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+    ok = fputs("FRAME\n", pw->fp) >= 0 && fwrite(pw->planes, 1, npix * 3, pw->fp) == npix * 3;
+  }
+  if (!ok) {
+    LOG_ERROR("❌ Failed to write frame %u to stdout\n", pw->written);
+    pw->failed = true;
+    return false;
+  }
+  pw->written++;
+  return true;
 }
 
 #ifndef UNIT_TEST
@@ -3220,25 +8464,47 @@ typedef struct {
   MetadataOptions meta;
   bool precision_set;       // an explicit --precision was given
   uint32_t precision_value; // 0=float16, 1=float32, 2=float64
+  Splat4DWriteOptions write;
 } EncodeOptions;
 
+// Options shared by the image, video and volume encoders.
+typedef struct {
+  uint32_t codec;
+  Splat4DEncodeOptions encode;
+  Splat4DWriteOptions write;
+  uint32_t raw_w, raw_h; // --size, for raw RGB24 on stdin
+} ImageEncodeOptions;
+
 static void print_usage(FILE *stream) {
   fprintf(stream,
-          "Usage:\n"
+          "Usage: 4splat [--threads <n>] <command> ...\n"
           "  4splat encode --palette <palette.bin> --index <index.bin> --output <file.4spl> "
           "--width <w> --height <h> --depth <d> --frames <f> [--palette-size <n>] [--flags <n>]\n"
           "      [--precision float16|float32|float64] [--compression <scheme>] "
           "[--index-width 1|2|4|8]\n"
           "      [--splat-shape <shape>] [--color-space <space>] [--interpolation <mode>] "
-          "[--sorted] [--metadata <0-255>]\n"
+          "[--sorted] [--metadata <0-255>] [--chunk-frames <n>] [--chunk-bytes <n>] [--delta] "
+          "[--dedupe]\n"
           "  4splat decode --input <file.4spl> [--palette <palette.bin>] [--index <index.bin>] "
           "[--output <file.4spl>] [--to-color <space>] [--print] [--validate]\n"
-          "  4splat encode-image [--compress <scheme>] [--colors <N>] <in.ppm> <out.4spl>\n"
+          "      [--verify full|deferred|none]\n"
+          "  4splat encode-image [<encode options>] <in.ppm> <out.4spl>\n"
           "  4splat decode-image <in.4spl> <out.ppm>\n"
-          "  4splat encode-video [--compress <scheme>] [--colors <N>] <out.4spl> <frame.ppm>...\n"
+          "  4splat encode-video [<encode options>] [--size <w>x<h>] <out.4spl> "
+          "<frame.ppm>...|-   ('-' reads Y4M or raw RGB24 from stdin)\n"
           "  4splat decode-video <in.4spl> <out-prefix>   (writes <prefix>NNNN.ppm)\n"
-          "  4splat encode-volume [--compress <scheme>] [--colors <N>] <out.4spl> <slice.ppm>...\n"
-          "  4splat decode-volume <in.4spl> <out-prefix>   (writes <prefix>NNNN.ppm)\n");
+          "  4splat decode-video [--y4m] <in.4spl> -   (RGB24 or Y4M on stdout)\n"
+          "  4splat decode-frame <in.4spl> <t> <out.ppm|out-prefix>   (one frame; volumes "
+          "write <prefix>NNNN.ppm per z)\n"
+          "  4splat encode-volume [<encode options>] <out.4spl> <slice.ppm>...\n"
+          "  4splat decode-volume <in.4spl> <out-prefix>   (writes <prefix>NNNN.ppm)\n"
+          "  4splat info <in.4spl>...   (one JSON object per file, header and footer only)\n"
+          "Encode options: [--compress <scheme>] [--colors <N>] "
+          "[--quantizer median-cut|octree|wu] [--refine <n>] [--chunk-frames <n>] "
+          "[--chunk-bytes <n>] [--delta]\n"
+          "      [--dedupe] [--reorder first-seen|frequency|position|cooccurrence]\n"
+          "--threads sets the worker count for index (de)compression (default: one per "
+          "CPU).\n");
 }
 
 // Parse a color-space name (as used on the command line) into its flag value.
@@ -3314,10 +8580,23 @@ static bool parse_splat_shape_name(const char *name, uint32_t *out) {
   return lookup_named_value(name, out, names, sizeof(names) / sizeof(names[0]));
 }
 
+// Command-line names of the compression schemes, indexed by flag value.
+static const char *const splat_compression_tokens[] = {
+    "none", "rle",  "deflate", "rar",    "lzo",   "zlib",   "bzip2", "lzma",
+    "zpaq", "xz",   "lz4",     "snappy", "lzham", "brotli", "lzfse", "zstd"};
+
 static bool parse_compression_name(const char *name, uint32_t *out) {
-  static const char *const names[] = {"none",  "rle",    "deflate", "rar", "lzo", "zlib",
-                                      "bzip2", "lzma",   "zpaq",    "xz",  "lz4", "snappy",
-                                      "lzham", "brotli", "lzfse",   "zstd"};
+  return lookup_named_value(name, out, splat_compression_tokens,
+                            sizeof(splat_compression_tokens) / sizeof(splat_compression_tokens[0]));
+}
+
+static bool parse_quantizer_name(const char *name, uint32_t *out) {
+  static const char *const names[] = {"median-cut", "octree", "wu"};
+  return lookup_named_value(name, out, names, sizeof(names) / sizeof(names[0]));
+}
+
+static bool parse_palette_order_name(const char *name, uint32_t *out) {
+  static const char *const names[] = {"first-seen", "frequency", "position", "cooccurrence"};
   return lookup_named_value(name, out, names, sizeof(names) / sizeof(names[0]));
 }
 
@@ -3345,16 +8624,15 @@ static void set_flag_field(uint32_t *flags, uint32_t mask, uint32_t shift, uint3
   *flags = (*flags & ~mask) | ((value << shift) & mask);
 }
 
-static bool parse_u32(const char *arg, uint32_t *out) {
-  if (!arg || !out)
+// Parse "<w>x<h>" with both sides positive.
+static bool parse_size(const char *arg, uint32_t *w, uint32_t *h) {
+  char buf[32];
+  const char *x = arg ? strchr(arg, 'x') : NULL;
+  if (!x || (size_t)(x - arg) >= sizeof buf)
     return false;
-  errno = 0;
-  char *end = NULL;
-  unsigned long value = strtoul(arg, &end, 10);
-  if (errno != 0 || !end || *end != '\0' || value > UINT32_MAX)
-    return false;
-  *out = (uint32_t)value;
-  return true;
+  memcpy(buf, arg, (size_t)(x - arg));
+  buf[x - arg] = '\0';
+  return parse_u32(buf, w) && parse_u32(x + 1, h) && *w > 0 && *h > 0;
 }
 
 static bool load_file_into_buffer(const char *path, size_t element_size, void **buffer,
@@ -3467,9 +8745,21 @@ static bool save_palette_to_file(const char *path, const Splat4DVideo *video) {
   return save_buffer_to_file(path, video->palette.palette, sizeof(Splat4D), video->header.pSize);
 }
 
+// The raw index file is always an array of 64-bit entries, whatever width the
+// video keeps in memory.
 static bool save_index_to_file(const char *path, const Splat4DVideo *video) {
-  return save_buffer_to_file(path, video->index.index, sizeof(uint64_t),
-                             header_total_indices(&video->header));
+  uint64_t total = header_total_indices(&video->header);
+  if (video->index.width == 8)
+    return save_buffer_to_file(path, video->index.data, sizeof(uint64_t), total);
+  if (!video->index.data || total > SIZE_MAX / sizeof(uint64_t))
+    return false;
+  uint64_t *wide = malloc((size_t)total * sizeof(uint64_t));
+  if (!wide)
+    return false;
+  convert_index_range(video->index.data, video->index.width, 0, total, wide, 8);
+  bool ok = save_buffer_to_file(path, wide, sizeof(uint64_t), total);
+  free(wide);
+  return ok;
 }
 
 static bool parse_metadata_option(const char *name, const char *value, MetadataOptions *meta) {
@@ -3575,7 +8865,16 @@ static int execute_encode(EncodeOptions *opts) {
     return EXIT_FAILURE;
   }
 
-  Splat4DVideo video = create_splat4DVideo(header, palette, indices);
+  // The values were checked to fit the header width, so keep them at that width
+  // from here on rather than carrying the 64-bit file layout.
+  Splat4DIndex narrow = create_splat4DIndex(indices);
+  if (!splat4d_index_rewiden(&narrow, index_count, index_count, idx_width)) {
+    LOG_ERROR("❌ Out of memory\n");
+    free(palette);
+    free(indices);
+    return EXIT_FAILURE;
+  }
+  Splat4DVideo video = create_splat4DVideoWithIndex(header, palette, narrow);
 
   FILE *fp = fopen(opts->output_path, "wb");
   if (!fp) {
@@ -3584,7 +8883,7 @@ static int execute_encode(EncodeOptions *opts) {
     return EXIT_FAILURE;
   }
 
-  bool wrote = write_splat4DVideo(fp, &video);
+  bool wrote = write_splat4DVideoWithOptions(fp, &video, &opts->write);
   fclose(fp);
   free_splat4DVideo(&video);
 
@@ -3682,6 +8981,22 @@ static int command_encode(int argc, char **argv) {
     } else if (strcmp(arg, "--sorted") == 0) {
       opts.meta.flags |= SPLAT_FLAG_SORTED;
       opts.meta.flags_set = true;
+    } else if (strcmp(arg, "--chunk-frames") == 0 && i + 1 < argc) {
+      if (!parse_u32(argv[++i], &opts.write.chunk_frames)) {
+        fprintf(stderr, "❌ Invalid --chunk-frames value '%s'\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(arg, "--chunk-bytes") == 0 && i + 1 < argc) {
+      uint32_t bytes = 0;
+      if (!parse_u32(argv[++i], &bytes)) {
+        fprintf(stderr, "❌ Invalid --chunk-bytes value '%s'\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+      opts.write.chunk_bytes = bytes;
+    } else if (strcmp(arg, "--delta") == 0) {
+      opts.write.temporal_delta = true;
+    } else if (strcmp(arg, "--dedupe") == 0) {
+      opts.write.frame_refs = true;
     } else {
       fprintf(stderr, "❌ Unknown or incomplete option '%s'\n", arg);
       return EXIT_FAILURE;
@@ -3706,11 +9021,24 @@ static int command_decode(int argc, char **argv) {
   const char *to_color = NULL;
   bool print_summary = false;
   bool do_validate = false;
+  Splat4DReadOptions read_opts = {.verify = SPLAT_READ_VERIFY_FULL};
 
   for (int i = 0; i < argc; i++) {
     const char *arg = argv[i];
     if (strcmp(arg, "--input") == 0 && i + 1 < argc) {
       input_path = argv[++i];
+    } else if (strcmp(arg, "--verify") == 0 && i + 1 < argc) {
+      const char *mode = argv[++i];
+      if (strcmp(mode, "full") == 0) {
+        read_opts.verify = SPLAT_READ_VERIFY_FULL;
+      } else if (strcmp(mode, "deferred") == 0) {
+        read_opts.verify = SPLAT_READ_VERIFY_DEFERRED;
+      } else if (strcmp(mode, "none") == 0) {
+        read_opts.verify = SPLAT_READ_VERIFY_NONE;
+      } else {
+        LOG_ERROR("❌ Unknown --verify mode '%s' (full, deferred or none)\n", mode);
+        return EXIT_FAILURE;
+      }
     } else if (strcmp(arg, "--palette") == 0 && i + 1 < argc) {
       palette_out = argv[++i];
     } else if (strcmp(arg, "--index") == 0 && i + 1 < argc) {
@@ -3740,8 +9068,14 @@ static int command_decode(int argc, char **argv) {
     return EXIT_FAILURE;
   }
 
+  // --validate recomputes the checksum itself, so one pass is enough. A deferred
+  // check runs once the summary is printed, and always before the palette is
+  // rewritten or anything is written out.
+  bool verify_pending = read_opts.verify == SPLAT_READ_VERIFY_DEFERRED;
+  if (do_validate)
+    read_opts.verify = SPLAT_READ_VERIFY_NONE;
   Splat4DVideo video;
-  bool read_ok = read_splat4DVideo(fp, &video);
+  bool read_ok = read_splat4DVideoWithOptions(fp, &video, &read_opts);
   fclose(fp);
 
   if (!read_ok) {
@@ -3753,6 +9087,16 @@ static int command_decode(int argc, char **argv) {
     free_splat4DVideo(&video);
     return EXIT_FAILURE;
   }
+  if (do_validate)
+    verify_pending = false;
+
+  if (print_summary && !to_color)
+    print_splat4DVideo(&video);
+
+  if (verify_pending && !splat4d_verify(&video)) {
+    free_splat4DVideo(&video);
+    return EXIT_FAILURE;
+  }
 
   if (to_color) {
     uint32_t target = 0;
@@ -3779,7 +9123,7 @@ static int command_decode(int argc, char **argv) {
 #endif
   }
 
-  if (print_summary)
+  if (print_summary && to_color)
     print_splat4DVideo(&video);
 
   if (output_path) {
@@ -3813,69 +9157,40 @@ static int command_decode(int argc, char **argv) {
   return EXIT_SUCCESS;
 }
 
-// Read a binary PPM (P6). On success returns an RGB8 buffer (caller frees) and
-// its dimensions. Supports comments and 8-bit maxval only.
-static uint8_t *read_ppm(const char *path, uint32_t *w_out, uint32_t *h_out) {
+// Open `path` for the PNM reader: unbuffered, with its header parsed.
+static FILE *pnm_open(PnmReader *r, const char *path, PnmHeader *hd) {
   FILE *fp = fopen(path, "rb");
   if (!fp) {
     LOG_ERROR("❌ Unable to open '%s': %s\n", path, strerror(errno));
     return NULL;
   }
-  char magic[3] = {0};
-  if (fscanf(fp, "%2s", magic) != 1 || strcmp(magic, "P6") != 0) {
-    LOG_ERROR("❌ '%s' is not a binary PPM (P6)\n", path);
-    fclose(fp);
-    return NULL;
-  }
-
-  // Read width, height, maxval, skipping whitespace and #-comments.
-  long vals[3];
-  int got = 0;
-  while (got < 3) {
-    int c = fgetc(fp);
-    if (c == EOF) {
-      LOG_ERROR("❌ Truncated PPM header in '%s'\n", path);
-      fclose(fp);
-      return NULL;
-    }
-    if (c == '#') {
-      while ((c = fgetc(fp)) != EOF && c != '\n')
-        ;
-      continue;
-    }
-    if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
-      continue;
-    ungetc(c, fp);
-    if (fscanf(fp, "%ld", &vals[got]) != 1) {
-      LOG_ERROR("❌ Malformed PPM header in '%s'\n", path);
-      fclose(fp);
-      return NULL;
-    }
-    got++;
-  }
-  if (vals[0] <= 0 || vals[1] <= 0 || vals[2] != 255) {
-    LOG_ERROR("❌ Unsupported PPM (need positive dimensions and maxval 255)\n");
+  setvbuf(fp, NULL, _IONBF, 0);
+  if (!pnm_read_header(r, fp, path, hd)) {
     fclose(fp);
     return NULL;
   }
-  fgetc(fp); // single whitespace byte after maxval
+  return fp;
+}
 
-  uint32_t w = (uint32_t)vals[0], h = (uint32_t)vals[1];
-  size_t n = (size_t)w * (size_t)h * 3;
-  uint8_t *rgb = malloc(n);
-  if (!rgb) {
+// Read a binary PPM, PGM or PAM into a new RGB8 buffer (caller frees).
+static uint8_t *read_ppm(const char *path, uint32_t *w_out, uint32_t *h_out) {
+  PnmReader *r = calloc(1, sizeof *r);
+  PnmHeader hd;
+  FILE *fp = r ? pnm_open(r, path, &hd) : NULL;
+  uint8_t *rgb = fp ? malloc((size_t)hd.w * hd.h * 3) : NULL;
+  if (fp && !rgb)
     fclose(fp);
-    return NULL;
-  }
-  if (fread(rgb, 1, n, fp) != n) {
-    LOG_ERROR("❌ Truncated pixel data in '%s'\n", path);
+  if (rgb && !pnm_read_rgb(r, fp, path, &hd, rgb)) {
     free(rgb);
-    fclose(fp);
-    return NULL;
+    rgb = NULL;
+  }
+  if (r)
+    pnm_reader_free(r);
+  free(r);
+  if (rgb) {
+    *w_out = hd.w;
+    *h_out = hd.h;
   }
-  fclose(fp);
-  *w_out = w;
-  *h_out = h;
   return rgb;
 }
 
@@ -3892,31 +9207,82 @@ static bool write_ppm(const char *path, const uint8_t *rgb, uint32_t w, uint32_t
   return ok;
 }
 
-// Parse leading --compress <scheme> / --colors <N> options for the image and
-// video encoders. Sets *codec and *max_colors and returns the index of the
-// first positional argument, or -1 on error.
-static int parse_encode_options(int argc, char **argv, uint32_t *codec, uint32_t *max_colors) {
-  *codec = SPLAT_COMPRESSION_NONE;
-  *max_colors = 0;
+// Parse leading --compress <scheme> / --colors <N> / --quantizer <name> /
+// --refine <n> / --reorder <order> / --delta / --dedupe / --chunk-frames <n> /
+// --chunk-bytes <n> /
+// --size <w>x<h> options for the image and video encoders. Fills *o and
+// returns the index of the first positional argument, or -1 on error.
+static int parse_encode_options(int argc, char **argv, ImageEncodeOptions *o) {
+  *o = (ImageEncodeOptions){.codec = SPLAT_COMPRESSION_NONE};
   int i = 0;
   while (i < argc && argv[i][0] == '-' && argv[i][1] == '-') {
     if (strcmp(argv[i], "--compress") == 0 && i + 1 < argc) {
-      if (!parse_compression_name(argv[i + 1], codec)) {
+      if (!parse_compression_name(argv[i + 1], &o->codec)) {
         LOG_ERROR("❌ Unknown compression scheme '%s'\n", argv[i + 1]);
         return -1;
       }
-      if (!splat_compression_available(*codec)) {
+      if (!splat_compression_available(o->codec)) {
         LOG_ERROR("❌ Compression scheme not available in this build: %s\n",
-                  splat_compression_display_name(*codec));
+                  splat_compression_display_name(o->codec));
         return -1;
       }
       i += 2;
     } else if (strcmp(argv[i], "--colors") == 0 && i + 1 < argc) {
-      if (!parse_u32(argv[i + 1], max_colors) || *max_colors == 0) {
+      if (!parse_u32(argv[i + 1], &o->encode.max_colors) || o->encode.max_colors == 0) {
         LOG_ERROR("❌ Invalid --colors value '%s' (positive integer)\n", argv[i + 1]);
         return -1;
       }
       i += 2;
+    } else if (strcmp(argv[i], "--quantizer") == 0 && i + 1 < argc) {
+      uint32_t q;
+      if (!parse_quantizer_name(argv[i + 1], &q)) {
+        LOG_ERROR("❌ Unknown quantizer '%s' (median-cut, octree or wu)\n", argv[i + 1]);
+        return -1;
+      }
+      o->encode.quantizer = (SplatQuantizer)q;
+      i += 2;
+    } else if (strcmp(argv[i], "--refine") == 0 && i + 1 < argc) {
+      if (!parse_u32(argv[i + 1], &o->encode.refine_iterations)) {
+        LOG_ERROR("❌ Invalid --refine value '%s'\n", argv[i + 1]);
+        return -1;
+      }
+      i += 2;
+    } else if (strcmp(argv[i], "--reorder") == 0 && i + 1 < argc) {
+      uint32_t order;
+      if (!parse_palette_order_name(argv[i + 1], &order)) {
+        LOG_ERROR("❌ Unknown palette order '%s' (first-seen, frequency, position or "
+                  "cooccurrence)\n",
+                  argv[i + 1]);
+        return -1;
+      }
+      o->encode.order = (SplatPaletteOrder)order;
+      i += 2;
+    } else if (strcmp(argv[i], "--delta") == 0) {
+      o->write.temporal_delta = true;
+      i += 1;
+    } else if (strcmp(argv[i], "--dedupe") == 0) {
+      o->write.frame_refs = true;
+      i += 1;
+    } else if (strcmp(argv[i], "--chunk-frames") == 0 && i + 1 < argc) {
+      if (!parse_u32(argv[i + 1], &o->write.chunk_frames)) {
+        LOG_ERROR("❌ Invalid --chunk-frames value '%s'\n", argv[i + 1]);
+        return -1;
+      }
+      i += 2;
+    } else if (strcmp(argv[i], "--chunk-bytes") == 0 && i + 1 < argc) {
+      uint32_t bytes = 0;
+      if (!parse_u32(argv[i + 1], &bytes)) {
+        LOG_ERROR("❌ Invalid --chunk-bytes value '%s'\n", argv[i + 1]);
+        return -1;
+      }
+      o->write.chunk_bytes = bytes;
+      i += 2;
+    } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      if (!parse_size(argv[i + 1], &o->raw_w, &o->raw_h)) {
+        LOG_ERROR("❌ Invalid --size value '%s' (<w>x<h>)\n", argv[i + 1]);
+        return -1;
+      }
+      i += 2;
     } else {
       LOG_ERROR("❌ Unknown or incomplete option '%s'\n", argv[i]);
       return -1;
@@ -3926,13 +9292,16 @@ static int parse_encode_options(int argc, char **argv, uint32_t *codec, uint32_t
 }
 
 static int command_encode_image(int argc, char **argv) {
-  uint32_t codec = 0, max_colors = 0;
-  int p = parse_encode_options(argc, argv, &codec, &max_colors);
+  ImageEncodeOptions opts;
+  int p = parse_encode_options(argc, argv, &opts);
   if (p < 0)
     return EXIT_FAILURE;
   if (argc - p != 2) {
-    LOG_ERROR("❌ Usage: 4splat encode-image [--compress <scheme>] [--colors <N>] "
-              "<in.ppm> <out.4spl>\n");
+    LOG_ERROR("❌ Usage: 4splat encode-image [<encode options>] <in.ppm> <out.4spl>\n");
+    return EXIT_FAILURE;
+  }
+  if (opts.raw_w) {
+    LOG_ERROR("❌ --size only applies to encode-video reading stdin\n");
     return EXIT_FAILURE;
   }
   const char *in_path = argv[p], *out_path = argv[p + 1];
@@ -3944,15 +9313,15 @@ static int command_encode_image(int argc, char **argv) {
 
   Splat4DVideo video;
   const uint8_t *one_frame = rgb;
-  bool built = frames_to_video_quantized(&one_frame, 1, w, h, max_colors, &video);
+  bool built = stack_to_video_with_options(&one_frame, 1, 1, w, h, &opts.encode, &video);
   free(rgb);
   if (!built) {
     LOG_ERROR("❌ Failed to build 4Splat video from image\n");
     return EXIT_FAILURE;
   }
-  if (codec != SPLAT_COMPRESSION_NONE)
+  if (opts.codec != SPLAT_COMPRESSION_NONE)
     set_flag_field(&video.header.flags, SPLAT_FLAG_COMPRESSION_MASK, SPLAT_FLAG_COMPRESSION_SHIFT,
-                   codec);
+                   opts.codec);
 
   FILE *fp = fopen(out_path, "wb");
   if (!fp) {
@@ -3960,7 +9329,7 @@ static int command_encode_image(int argc, char **argv) {
     free_splat4DVideo(&video);
     return EXIT_FAILURE;
   }
-  bool wrote = write_splat4DVideo(fp, &video);
+  bool wrote = write_splat4DVideoWithOptions(fp, &video, &opts.write);
   fclose(fp);
   printf("✅ Encoded %ux%u image (%u colors) to '%s'\n", w, h, video.header.pSize, out_path);
   free_splat4DVideo(&video);
@@ -4002,74 +9371,234 @@ static int command_decode_image(int argc, char **argv) {
   return EXIT_SUCCESS;
 }
 
+// Stream-encode the PPMs paths[0..n) as slices, `depth` per frame, to
+// out_path: each file is read, pushed and freed before the next, so only one
+// slice is held in memory. `what` names a slice in messages.
+static bool encode_ppm_stream(const ImageEncodeOptions *opts, const char *out_path,
+                              char *const *paths, uint32_t n, uint32_t depth, const char *what,
+                              uint32_t *w, uint32_t *h, Splat4DHeader *header) {
+  FILE *fp = fopen(out_path, "wb");
+  if (!fp) {
+    LOG_ERROR("❌ Unable to create '%s': %s\n", out_path, strerror(errno));
+    return false;
+  }
+  // One reader and one frame slot serve every file.
+  PnmReader *r = calloc(1, sizeof *r);
+  uint8_t *rgb = NULL;
+  Splat4DStreamEncoder enc = {0};
+  bool ok = r != NULL, opened = false;
+  for (uint32_t s = 0; ok && s < n; ++s) {
+    PnmHeader hd;
+    FILE *in = pnm_open(r, paths[s], &hd);
+    if (!in) {
+      ok = false;
+      break;
+    }
+    if (s == 0) {
+      *w = hd.w;
+      *h = hd.h;
+      rgb = malloc((size_t)hd.w * hd.h * 3);
+      ok = opened = rgb && splat4d_encoder_open(&enc, fp, hd.w, hd.h, depth, opts->codec,
+                                                &opts->encode, &opts->write);
+    } else if (hd.w != *w || hd.h != *h) {
+      LOG_ERROR("❌ %s '%s' is %ux%u; expected %ux%u\n", what, paths[s], hd.w, hd.h, *w, *h);
+      ok = false;
+    }
+    if (ok)
+      ok = pnm_read_rgb(r, in, paths[s], &hd, rgb);
+    else
+      fclose(in);
+    ok = ok && splat4d_encoder_push_slice(&enc, rgb);
+  }
+  free(rgb);
+  if (r)
+    pnm_reader_free(r);
+  free(r);
+  if (ok)
+    ok = splat4d_encoder_finish(&enc, header);
+  else if (opened)
+    splat4d_encoder_abort(&enc);
+  ok = fclose(fp) == 0 && ok;
+  if (!ok)
+    remove(out_path);
+  return ok;
+}
+
+// Encode frames read from stdin (raw RGB24 or Y4M) with the streaming encoder.
+static bool encode_pipe_stream(const ImageEncodeOptions *opts, const char *out_path, FILE *in,
+                               uint32_t *nframes, uint32_t *w, uint32_t *h,
+                               Splat4DHeader *header) {
+  PipeReader p;
+  if (!pipe_reader_open(&p, in, opts->raw_w, opts->raw_h)) {
+    pipe_reader_close(&p);
+    return false;
+  }
+  *w = p.w;
+  *h = p.h;
+  FILE *fp = fopen(out_path, "wb");
+  uint8_t *rgb = fp ? malloc((size_t)p.w * p.h * 3) : NULL;
+  if (!fp)
+    LOG_ERROR("❌ Unable to create '%s': %s\n", out_path, strerror(errno));
+  Splat4DStreamEncoder enc = {0};
+  bool ok = rgb && splat4d_encoder_open(&enc, fp, p.w, p.h, 1, opts->codec, &opts->encode,
+                                        &opts->write);
+  bool opened = ok;
+  int r = 0;
+  for (*nframes = 0; ok && (r = pipe_reader_next(&p, rgb)) > 0; ++*nframes)
+    ok = splat4d_encoder_push_slice(&enc, rgb);
+  if (ok && r == 0 && *nframes == 0)
+    LOG_ERROR("❌ No frames on stdin\n");
+  ok = ok && r == 0 && *nframes > 0;
+  if (ok)
+    ok = splat4d_encoder_finish(&enc, header);
+  else if (opened)
+    splat4d_encoder_abort(&enc);
+  free(rgb);
+  pipe_reader_close(&p);
+  if (fp) {
+    ok = fclose(fp) == 0 && ok;
+    if (!ok)
+      remove(out_path);
+  }
+  return ok;
+}
+
 static int command_encode_video(int argc, char **argv) {
-  uint32_t codec = 0, max_colors = 0;
-  int a = parse_encode_options(argc, argv, &codec, &max_colors);
+  ImageEncodeOptions opts;
+  int a = parse_encode_options(argc, argv, &opts);
   if (a < 0)
     return EXIT_FAILURE;
   if (argc - a < 2) {
-    LOG_ERROR("❌ Usage: 4splat encode-video [--compress <scheme>] [--colors <N>] "
-              "<out.4spl> <frame.ppm>...\n");
+    LOG_ERROR("❌ Usage: 4splat encode-video [<encode options>] <out.4spl> <frame.ppm>...|-\n");
     return EXIT_FAILURE;
   }
   const char *out_path = argv[a++];
   uint32_t nframes = (uint32_t)(argc - a);
-
-  uint8_t **frames = calloc(nframes, sizeof(uint8_t *));
-  if (!frames)
+  bool piped = nframes == 1 && strcmp(argv[a], "-") == 0;
+  if (opts.raw_w && !piped) {
+    LOG_ERROR("❌ --size only applies to encode-video reading stdin\n");
     return EXIT_FAILURE;
+  }
 
   uint32_t w = 0, h = 0;
-  bool ok = true;
-  for (uint32_t t = 0; t < nframes; ++t) {
-    uint32_t fw = 0, fh = 0;
-    frames[t] = read_ppm(argv[a + t], &fw, &fh);
-    if (!frames[t]) {
-      ok = false;
-      break;
-    }
-    if (t == 0) {
-      w = fw;
-      h = fh;
-    } else if (fw != w || fh != h) {
-      LOG_ERROR("❌ Frame '%s' is %ux%u; expected %ux%u\n", argv[a + t], fw, fh, w, h);
-      ok = false;
-      break;
-    }
+  Splat4DHeader header;
+  bool ok = piped ? encode_pipe_stream(&opts, out_path, stdin, &nframes, &w, &h, &header)
+                  : encode_ppm_stream(&opts, out_path, argv + a, nframes, 1, "Frame", &w, &h,
+                                      &header);
+  if (!ok) {
+    LOG_ERROR("❌ Failed to encode 4Splat video from frames\n");
+    return EXIT_FAILURE;
   }
+  printf("✅ Encoded %u frame(s) %ux%u (%u colors) to '%s'\n", nframes, w, h, header.pSize,
+         out_path);
+  return EXIT_SUCCESS;
+}
 
-  Splat4DVideo video;
-  bool built = ok && frames_to_video_quantized((const uint8_t *const *)frames, nframes, w, h,
-                                               max_colors, &video);
-  for (uint32_t t = 0; t < nframes; ++t)
-    free(frames[t]);
-  free(frames);
-  if (!built) {
-    if (ok)
-      LOG_ERROR("❌ Failed to build 4Splat video from frames\n");
-    return EXIT_FAILURE;
+// Writes each decoded slice to <prefix>NNNN.ppm, numbered by frame for a video
+// and by slice for a volume.
+typedef struct {
+  const char *prefix;
+  bool video;
+  bool failed; // a header or write error, already reported
+  uint32_t written;
+} PpmSliceWriter;
+
+static bool write_ppm_slice(void *ctx, uint32_t t, uint32_t z, const uint8_t *rgb,
+                            const Splat4DHeader *header) {
+  PpmSliceWriter *wr = ctx;
+  if (wr->video && header->depth != 1) {
+    LOG_ERROR("❌ Video decode requires depth = 1\n");
+    wr->failed = true;
+    return false;
   }
-  if (codec != SPLAT_COMPRESSION_NONE)
-    set_flag_field(&video.header.flags, SPLAT_FLAG_COMPRESSION_MASK, SPLAT_FLAG_COMPRESSION_SHIFT,
-                   codec);
+  char path[4096];
+  SAFE_SNPRINTF(path, sizeof path, "%s%04u.ppm", wr->prefix,
+                (unsigned)((uint64_t)t * header->depth + z));
+  if (!write_ppm(path, rgb, header->width, header->height)) {
+    remove(path);
+    LOG_ERROR("❌ Failed to write '%s'\n", path);
+    wr->failed = true;
+    return false;
+  }
+  wr->written++;
+  return true;
+}
 
-  FILE *fp = fopen(out_path, "wb");
+// Stream every slice of argv[0] to PPM files, one frame in memory at a time.
+// The checksum is only known once the last frame is read, so a failed decode
+// removes the files it already wrote.
+static bool decode_to_ppm_files(char **argv, bool video, Splat4DHeader *header) {
+  FILE *fp = fopen(argv[0], "rb");
   if (!fp) {
-    LOG_ERROR("❌ Unable to create '%s': %s\n", out_path, strerror(errno));
-    free_splat4DVideo(&video);
-    return EXIT_FAILURE;
+    LOG_ERROR("❌ Unable to open '%s': %s\n", argv[0], strerror(errno));
+    return false;
   }
-  bool wrote = write_splat4DVideo(fp, &video);
+  PpmSliceWriter wr = {.prefix = argv[1], .video = video};
+  bool ok = splat4d_decode_each_slice(fp, NULL, write_ppm_slice, &wr, header);
   fclose(fp);
-  printf("✅ Encoded %u frame(s) %ux%u (%u colors) to '%s'\n", nframes, w, h, video.header.pSize,
-         out_path);
-  free_splat4DVideo(&video);
-  return wrote ? EXIT_SUCCESS : EXIT_FAILURE;
+  if (!ok && !wr.failed)
+    LOG_ERROR("❌ Failed to read '%s'\n", argv[0]);
+  for (uint32_t s = 0; !ok && s < wr.written; ++s) {
+    char path[4096];
+    SAFE_SNPRINTF(path, sizeof path, "%s%04u.ppm", wr.prefix, s);
+    remove(path);
+  }
+  return ok;
+}
+
+// Stream every frame of in_path to stdout as RGB24 or Y4M.
+static bool decode_to_pipe(const char *in_path, bool y4m, Splat4DHeader *header) {
+  FILE *fp = fopen(in_path, "rb");
+  if (!fp) {
+    LOG_ERROR("❌ Unable to open '%s': %s\n", in_path, strerror(errno));
+    return false;
+  }
+  setvbuf(stdout, NULL, _IOFBF, SPLAT_PIPE_BUFFER_BYTES);
+  PipeWriter pw = {.fp = stdout, .y4m = y4m};
+  bool ok = splat4d_decode_each_slice(fp, NULL, write_pipe_frame, &pw, header);
+  fclose(fp);
+  if (!ok && !pw.failed)
+    LOG_ERROR("❌ Failed to read '%s'\n", in_path);
+  free(pw.planes);
+  if (fflush(stdout) != 0 && ok) {
+    LOG_ERROR("❌ Failed to write to stdout: %s\n", strerror(errno));
+    ok = false;
+  }
+  return ok;
 }
 
 static int command_decode_video(int argc, char **argv) {
-  if (argc != 2) {
-    LOG_ERROR("❌ Usage: 4splat decode-video <in.4spl> <out-prefix>\n");
+  bool y4m = argc > 0 && strcmp(argv[0], "--y4m") == 0;
+  argc -= y4m;
+  argv += y4m;
+  bool piped = argc == 2 && strcmp(argv[1], "-") == 0;
+  if (argc != 2 || (y4m && !piped)) {
+    LOG_ERROR("❌ Usage: 4splat decode-video <in.4spl> <out-prefix> | "
+              "4splat decode-video [--y4m] <in.4spl> -\n");
+    return EXIT_FAILURE;
+  }
+  Splat4DHeader h;
+  if (piped) {
+    if (!decode_to_pipe(argv[0], y4m, &h))
+      return EXIT_FAILURE;
+    // stdout carries the frames, so the summary goes to stderr.
+    fprintf(stderr, "✅ Decoded '%s' to %u frame(s) %ux%u (%s on stdout)\n", argv[0], h.frames,
+            h.width, h.height, y4m ? "Y4M" : "RGB24");
+    return EXIT_SUCCESS;
+  }
+  if (!decode_to_ppm_files(argv, true, &h))
+    return EXIT_FAILURE;
+  printf("✅ Decoded '%s' to %u frame(s) %ux%u ('%s0000.ppm'...)\n", argv[0], h.frames, h.width,
+         h.height, argv[1]);
+  return EXIT_SUCCESS;
+}
+
+// Decode a single frame, reading only the part of the index it needs when the
+// file's layout allows it (uncompressed or chunked).
+static int command_decode_frame(int argc, char **argv) {
+  uint32_t t = 0;
+  if (argc != 3 || !parse_u32(argv[1], &t)) {
+    LOG_ERROR("❌ Usage: 4splat decode-frame <in.4spl> <t> <out.ppm|out-prefix>\n");
     return EXIT_FAILURE;
   }
   FILE *fp = fopen(argv[0], "rb");
@@ -4077,103 +9606,67 @@ static int command_decode_video(int argc, char **argv) {
     LOG_ERROR("❌ Unable to open '%s': %s\n", argv[0], strerror(errno));
     return EXIT_FAILURE;
   }
-  Splat4DVideo video;
-  bool read_ok = read_splat4DVideo(fp, &video);
+  Splat4DVideo frame;
+  bool read_ok = read_splat4DFrame(fp, t, &frame.header, &frame.palette, &frame.index);
   fclose(fp);
   if (!read_ok) {
-    LOG_ERROR("❌ Failed to read '%s'\n", argv[0]);
+    LOG_ERROR("❌ Failed to read frame %u of '%s'\n", t, argv[0]);
     return EXIT_FAILURE;
   }
 
-  uint8_t **frames = NULL;
-  uint32_t nframes = 0, w = 0, h = 0;
-  bool ok = video_to_frames(&video, &frames, &nframes, &w, &h);
-  free_splat4DVideo(&video);
+  // One frame's index is exactly the index of a frames == 1 video.
+  frame.header.frames = 1;
+  uint8_t **slices = NULL;
+  uint32_t nslices = 0, w = 0, h = 0;
+  bool ok = video_to_slices(&frame, &slices, &nslices, &w, &h);
+  free_splat4DVideo(&frame);
   if (!ok)
     return EXIT_FAILURE;
 
   bool wrote = true;
-  for (uint32_t t = 0; t < nframes && wrote; ++t) {
+  for (uint32_t z = 0; z < nslices && wrote; ++z) {
     char path[4096];
-    SAFE_SNPRINTF(path, sizeof path, "%s%04u.ppm", argv[1], t);
-    wrote = write_ppm(path, frames[t], w, h);
+    if (nslices == 1)
+      SAFE_SNPRINTF(path, sizeof path, "%s", argv[2]);
+    else
+      SAFE_SNPRINTF(path, sizeof path, "%s%04u.ppm", argv[2], z);
+    wrote = write_ppm(path, slices[z], w, h);
     if (!wrote)
       LOG_ERROR("❌ Failed to write '%s'\n", path);
   }
-  for (uint32_t t = 0; t < nframes; ++t)
-    free(frames[t]);
-  free(frames);
+  free_video_slices(slices, nslices);
   if (!wrote)
     return EXIT_FAILURE;
 
-  printf("✅ Decoded '%s' to %u frame(s) %ux%u ('%s0000.ppm'...)\n", argv[0], nframes, w, h,
-         argv[1]);
+  printf("✅ Decoded frame %u of '%s' (%u slice(s) %ux%u)\n", t, argv[0], nslices, w, h);
   return EXIT_SUCCESS;
 }
 
 static int command_encode_volume(int argc, char **argv) {
-  uint32_t codec = 0, max_colors = 0;
-  int a = parse_encode_options(argc, argv, &codec, &max_colors);
+  ImageEncodeOptions opts;
+  int a = parse_encode_options(argc, argv, &opts);
   if (a < 0)
     return EXIT_FAILURE;
   if (argc - a < 2) {
-    LOG_ERROR("❌ Usage: 4splat encode-volume [--compress <scheme>] [--colors <N>] "
-              "<out.4spl> <slice.ppm>...\n");
+    LOG_ERROR("❌ Usage: 4splat encode-volume [<encode options>] <out.4spl> <slice.ppm>...\n");
+    return EXIT_FAILURE;
+  }
+  if (opts.raw_w) {
+    LOG_ERROR("❌ --size only applies to encode-video reading stdin\n");
     return EXIT_FAILURE;
   }
   const char *out_path = argv[a++];
   uint32_t depth = (uint32_t)(argc - a);
 
-  uint8_t **slices = calloc(depth, sizeof(uint8_t *));
-  if (!slices)
-    return EXIT_FAILURE;
-
   uint32_t w = 0, h = 0;
-  bool ok = true;
-  for (uint32_t z = 0; z < depth; ++z) {
-    uint32_t fw = 0, fh = 0;
-    slices[z] = read_ppm(argv[a + z], &fw, &fh);
-    if (!slices[z]) {
-      ok = false;
-      break;
-    }
-    if (z == 0) {
-      w = fw;
-      h = fh;
-    } else if (fw != w || fh != h) {
-      LOG_ERROR("❌ Slice '%s' is %ux%u; expected %ux%u\n", argv[a + z], fw, fh, w, h);
-      ok = false;
-      break;
-    }
-  }
-
-  Splat4DVideo video;
-  bool built = ok && stack_to_video_quantized((const uint8_t *const *)slices, depth, 1, w, h,
-                                              max_colors, &video);
-  for (uint32_t z = 0; z < depth; ++z)
-    free(slices[z]);
-  free(slices);
-  if (!built) {
-    if (ok)
-      LOG_ERROR("❌ Failed to build 4Splat volume from slices\n");
-    return EXIT_FAILURE;
-  }
-  if (codec != SPLAT_COMPRESSION_NONE)
-    set_flag_field(&video.header.flags, SPLAT_FLAG_COMPRESSION_MASK, SPLAT_FLAG_COMPRESSION_SHIFT,
-                   codec);
-
-  FILE *fp = fopen(out_path, "wb");
-  if (!fp) {
-    LOG_ERROR("❌ Unable to create '%s': %s\n", out_path, strerror(errno));
-    free_splat4DVideo(&video);
+  Splat4DHeader header;
+  if (!encode_ppm_stream(&opts, out_path, argv + a, depth, depth, "Slice", &w, &h, &header)) {
+    LOG_ERROR("❌ Failed to encode 4Splat volume from slices\n");
     return EXIT_FAILURE;
   }
-  bool wrote = write_splat4DVideo(fp, &video);
-  fclose(fp);
-  printf("✅ Encoded %u slice(s) %ux%u (%u colors) to '%s'\n", depth, w, h, video.header.pSize,
+  printf("✅ Encoded %u slice(s) %ux%u (%u colors) to '%s'\n", depth, w, h, header.pSize,
          out_path);
-  free_splat4DVideo(&video);
-  return wrote ? EXIT_SUCCESS : EXIT_FAILURE;
+  return EXIT_SUCCESS;
 }
 
 static int command_decode_volume(int argc, char **argv) {
@@ -4181,46 +9674,92 @@ static int command_decode_volume(int argc, char **argv) {
     LOG_ERROR("❌ Usage: 4splat decode-volume <in.4spl> <out-prefix>\n");
     return EXIT_FAILURE;
   }
-  FILE *fp = fopen(argv[0], "rb");
-  if (!fp) {
-    LOG_ERROR("❌ Unable to open '%s': %s\n", argv[0], strerror(errno));
-    return EXIT_FAILURE;
-  }
-  Splat4DVideo video;
-  bool read_ok = read_splat4DVideo(fp, &video);
-  fclose(fp);
-  if (!read_ok) {
-    LOG_ERROR("❌ Failed to read '%s'\n", argv[0]);
+  Splat4DHeader h;
+  if (!decode_to_ppm_files(argv, false, &h))
     return EXIT_FAILURE;
+  printf("✅ Decoded '%s' to %llu slice(s) %ux%u ('%s0000.ppm'...)\n", argv[0],
+         (unsigned long long)h.frames * h.depth, h.width, h.height, argv[1]);
+  return EXIT_SUCCESS;
+}
+
+// Write `str` as a JSON string literal.
+static void print_json_string(FILE *out, const char *str) {
+  fputc('"', out);
+  for (const unsigned char *c = (const unsigned char *)str; *c; ++c) {
+    if (*c == '"' || *c == '\\')
+      fprintf(out, "\\%c", *c);
+    else if (*c < 0x20)
+      fprintf(out, "\\u%04x", *c);
+    else
+      fputc(*c, out);
   }
+  fputc('"', out);
+}
 
-  uint8_t **slices = NULL;
-  uint32_t nslices = 0, w = 0, h = 0;
-  bool ok = video_to_slices(&video, &slices, &nslices, &w, &h);
-  free_splat4DVideo(&video);
-  if (!ok)
+// One JSON object per file, one per line, from the header and footer alone.
+// Files that fail to probe are reported on stderr and make the exit status
+// nonzero, but the remaining files are still listed.
+static int command_info(int argc, char **argv) {
+  if (argc < 1) {
+    LOG_ERROR("❌ Usage: 4splat info <in.4spl>...\n");
     return EXIT_FAILURE;
-
-  bool wrote = true;
-  for (uint32_t s = 0; s < nslices && wrote; ++s) {
-    char path[4096];
-    SAFE_SNPRINTF(path, sizeof path, "%s%04u.ppm", argv[1], s);
-    wrote = write_ppm(path, slices[s], w, h);
-    if (!wrote)
-      LOG_ERROR("❌ Failed to write '%s'\n", path);
   }
-  for (uint32_t s = 0; s < nslices; ++s)
-    free(slices[s]);
-  free(slices);
-  if (!wrote)
-    return EXIT_FAILURE;
-
-  printf("✅ Decoded '%s' to %u slice(s) %ux%u ('%s0000.ppm'...)\n", argv[0], nslices, w, h,
-         argv[1]);
-  return EXIT_SUCCESS;
+  int status = EXIT_SUCCESS;
+  for (int i = 0; i < argc; ++i) {
+    FILE *fp = fopen(argv[i], "rb");
+    if (!fp) {
+      LOG_ERROR("❌ Unable to open '%s': %s\n", argv[i], strerror(errno));
+      status = EXIT_FAILURE;
+      continue;
+    }
+    Splat4DProbe p;
+    bool ok = probe_splat4DFile(fp, &p);
+    fclose(fp);
+    if (!ok) {
+      LOG_ERROR("❌ Failed to probe '%s'\n", argv[i]);
+      status = EXIT_FAILURE;
+      continue;
+    }
+    const Splat4DHeader *h = &p.header;
+    Splat4DFlags flags = splat4d_flags_from_raw(h->flags);
+    printf("{\"file\":");
+    print_json_string(stdout, argv[i]);
+    printf(",\"file_size\":%" PRIu64 ",\"version\":\"%u.%u\",\"layout\":\"%s\"", p.file_size,
+           h->version[0], h->version[1],
+           h->version[2] == SPLAT_LAYOUT_CHUNKED ? "chunked" : "monolithic");
+    printf(",\"index_transform\":\"%s\",\"frame_refs\":%s",
+           h->version[3] & SPLAT_TRANSFORM_DELTA ? "delta" : "none",
+           h->version[3] & SPLAT_TRANSFORM_FRAME_REFS ? "true" : "false");
+    printf(",\"width\":%u,\"height\":%u,\"depth\":%u,\"frames\":%u,\"palette_size\":%u", h->width,
+           h->height, h->depth, h->frames, h->pSize);
+    printf(",\"flags\":%u,\"precision\":\"float%u\",\"compression\":\"%s\",\"index_width\":%u",
+           h->flags, 16u << flags.bits.precision,
+           splat_compression_tokens[flags.bits.compression],
+           (unsigned)get_index_width_bytes(h->flags));
+    printf(",\"splat_shape\":\"%s\",\"color_space\":\"%s\",\"interpolation\":\"%s\"",
+           splat_shape_name((SplatShape)flags.bits.splat_shape),
+           splat_color_space_name((SplatColorSpace)flags.bits.color_space),
+           splat_interpolation_name((SplatInterpolation)flags.bits.interpolation));
+    printf(",\"sorted\":%s,\"metadata\":%u", flags.bits.sorted ? "true" : "false",
+           (unsigned)(h->flags >> 24));
+    printf(",\"total_indices\":%" PRIu64 ",\"palette_bytes\":%" PRIu64
+           ",\"index_offset\":%" PRIu64 ",\"index_bytes\":%" PRIu64 ",\"checksum\":\"%08x\"}\n",
+           p.total_indices, p.palette_bytes, p.index_offset, p.index_bytes, p.footer.checksum);
+  }
+  return status;
 }
 
 int main(int argc, char **argv) {
+  if (argc >= 3 && strcmp(argv[1], "--threads") == 0) {
+    uint32_t n = 0;
+    if (!parse_u32(argv[2], &n) || n == 0) {
+      fprintf(stderr, "❌ Invalid --threads value '%s'\n", argv[2]);
+      return EXIT_FAILURE;
+    }
+    splat4d_set_threads(n);
+    argc -= 2;
+    argv += 2;
+  }
   if (argc < 2) {
     print_usage(stderr);
     return EXIT_FAILURE;
@@ -4245,12 +9784,18 @@ int main(int argc, char **argv) {
   if (strcmp(command, "decode-video") == 0) {
     return command_decode_video(argc - 2, argv + 2);
   }
+  if (strcmp(command, "decode-frame") == 0) {
+    return command_decode_frame(argc - 2, argv + 2);
+  }
   if (strcmp(command, "encode-volume") == 0) {
     return command_encode_volume(argc - 2, argv + 2);
   }
   if (strcmp(command, "decode-volume") == 0) {
     return command_decode_volume(argc - 2, argv + 2);
   }
+  if (strcmp(command, "info") == 0) {
+    return command_info(argc - 2, argv + 2);
+  }
 
   print_usage(stderr);
   return EXIT_FAILURE;
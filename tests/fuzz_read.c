@@ -40,6 +40,26 @@ int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     (void)compute_video_checksum(&v);
     free_splat4DVideo(&v);
   }
+  // Single-frame reads walk the chunk table (or the monolithic index) directly.
+  Splat4DHeader h;
+  Splat4DPalette pal;
+  Splat4DIndex frame;
+  if (read_splat4DFrame(fp, 0, &h, &pal, &frame)) {
+    free(pal.palette);
+    free(frame.data);
+  }
+  // The mapped reader parses the same bytes without copying the index; an
+  // fmemopen stream has no descriptor, so this takes the heap-copy fallback.
+  Splat4DMappedVideo m;
+  rewind(fp);
+  if (splat4d_map_file(fp, &m, true)) {
+    if (m.total)
+      (void)splat4d_mapped_index(&m, m.total - 1);
+    splat4d_unmap_file(&m);
+  }
+  // Probing trusts only the header, the footer and the stream size.
+  Splat4DProbe probe;
+  (void)probe_splat4DFile(fp, &probe);
   fclose(fp);
   return 0;
 }
@@ -36,6 +36,15 @@ static void make_indices(uint64_t indices[4]) {
   indices[3] = 1;
 }
 
+// Compare two indices entry by entry; they may be stored at different widths
+// (a caller-built 64-bit array against one read back at the header width).
+static bool indices_equal(const Splat4DIndex *a, const Splat4DIndex *b, uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i)
+    if (splat4d_index_get(a, i) != splat4d_index_get(b, i))
+      return false;
+  return true;
+}
+
 static bool test_create_splat4D(void) {
   float mu_x = 1.0f, sigma_x = 0.1f;
   float mu_y = 2.0f, sigma_y = 0.2f;
@@ -68,6 +77,77 @@ static bool test_crc32_known_value(void) {
   return actual == 0xCBF43926u;
 }
 
+// Every CRC kernel must match the byte-at-a-time loop for any length and
+// alignment, including the PCLMUL/ARMv8 tails and the slicing-by-16 remainder.
+static bool test_crc32_kernels_agree(void) {
+  enum { N = 70000 };
+  uint8_t *buf = malloc(N + 8);
+  if (!buf)
+    return false;
+  uint32_t x = 1;
+  for (size_t k = 0; k < N + 8; ++k) {
+    x = x * 1664525u + 1013904223u;
+    buf[k] = (uint8_t)(x >> 24);
+  }
+  Crc32KernelFn best = crc32_select();
+  bool ok = true;
+  for (size_t len = 0; ok && len <= N; len = len < 300 ? len + 1 : len * 3 + 7) {
+    for (size_t off = 0; ok && off < 8; ++off) {
+      uint32_t ref = crc32_bytewise(0xFFFFFFFFu ^ (uint32_t)len, buf + off, len);
+      ok = crc32_slice16(0xFFFFFFFFu ^ (uint32_t)len, buf + off, len) == ref &&
+           best(0xFFFFFFFFu ^ (uint32_t)len, buf + off, len) == ref;
+    }
+  }
+  free(buf);
+  return ok;
+}
+
+static bool test_crc32_combine_matches_concatenation(void) {
+  uint8_t buf[1000];
+  for (size_t k = 0; k < sizeof buf; ++k)
+    buf[k] = (uint8_t)(k * 7 + k / 13);
+  const size_t splits[] = {0, 1, 15, 16, 333, 999, 1000};
+  bool ok = true;
+  for (size_t s = 0; ok && s < sizeof splits / sizeof splits[0]; ++s) {
+    size_t a = splits[s];
+    ok = splat_crc32_combine(splat_crc32(buf, a), splat_crc32(buf + a, sizeof buf - a),
+                             sizeof buf - a) == splat_crc32(buf, sizeof buf);
+  }
+  return ok;
+}
+
+// A 9M-entry index spans several 4 MiB checksum pieces; the parallel result
+// must equal the serial one, both when the storage is checksummed in place and
+// when it has to be packed to a wider header width.
+static bool test_parallel_checksum_matches_serial(void) {
+  const uint32_t w = 3000, h = 1000, frames = 3;
+  const uint64_t total = (uint64_t)w * h * frames;
+  Splat4D palette[2];
+  make_palette(palette);
+  Splat4DIndex idx;
+  if (!splat4d_index_alloc(&idx, total, 1))
+    return false;
+  for (uint64_t k = 0; k < total; ++k)
+    idx.u8[k] = (uint8_t)((k * 2654435761u) >> 31);
+  bool ok = true;
+  for (uint32_t width_flag = 0; ok && width_flag < 2; ++width_flag) {
+    uint32_t flags = SPLAT_FLAG_PRECISION_FLOAT32 | (width_flag << SPLAT_FLAG_INDEX_WIDTH_SHIFT);
+    Splat4DVideo v = {.header = create_splat4DHeader(w, h, 1, frames, 2, flags),
+                      .palette = create_splat4DPalette(palette),
+                      .index = idx};
+    splat4d_set_threads(1);
+    uint32_t serial = compute_video_checksum(&v);
+    splat4d_set_threads(4);
+    ok = serial != 0 && compute_video_checksum(&v) == serial;
+    splat4d_set_threads(0);
+  }
+  splat4d_set_threads(4);
+  ok = ok && splat_crc32_parallel(idx.u8, (size_t)total) == splat_crc32(idx.u8, (size_t)total);
+  splat4d_set_threads(0);
+  free(idx.data);
+  return ok;
+}
+
 static bool test_compute_video_checksum_matches_footer(void) {
   Splat4D palette[2];
   uint64_t indices[4];
@@ -267,7 +347,7 @@ static bool test_validate_detects_corrupted_index(void) {
   make_indices(indices);
   Splat4DVideo video = create_splat4DVideo(make_header(), palette, indices);
   // Mutate index data without updating the footer checksum to simulate corruption.
-  video.index.index[0] ^= 1u;
+  video.index.u64[0] ^= 1u;
   return !validate_splat4DVideo(&video);
 }
 
@@ -341,8 +421,8 @@ static bool test_write_and_read_round_trip(void) {
   bool headers_match = memcmp(&original.header, &loaded.header, sizeof(Splat4DHeader)) == 0;
   bool palette_match = memcmp(original.palette.palette, loaded.palette.palette,
                               original.header.pSize * sizeof(Splat4D)) == 0;
-  bool index_match = memcmp(original.index.index, loaded.index.index,
-                            header_total_indices(&original.header) * sizeof(uint64_t)) == 0;
+  bool index_match =
+      indices_equal(&original.index, &loaded.index, header_total_indices(&original.header));
   bool footer_match = original.footer.idxoffset == loaded.footer.idxoffset &&
                       original.footer.checksum == loaded.footer.checksum &&
                       original.footer.end == loaded.footer.end;
@@ -479,8 +559,8 @@ static bool test_read_index_fails_on_short_file(void) {
   uint8_t partial = 0x2A;
   fwrite(&partial, sizeof(uint8_t), 1, fp);
   rewind(fp);
-  Splat4DIndex index = {.index = NULL};
-  bool ok = !read_splat4DIndex(fp, &index, 4, SPLAT_FLAG_PRECISION_FLOAT32) && index.index == NULL;
+  Splat4DIndex index = {.data = NULL};
+  bool ok = !read_splat4DIndex(fp, &index, 4, SPLAT_FLAG_PRECISION_FLOAT32) && index.data == NULL;
   fclose(fp);
   return ok;
 }
@@ -565,9 +645,9 @@ static bool test_read_video_fails_on_truncated_index(void) {
 
   Splat4DVideo loaded;
   loaded.palette.palette = (Splat4D *)0x1;
-  loaded.index.index = (uint64_t *)0x1;
+  loaded.index.data = (void *)0x1;
   bool ok = !read_splat4DVideo(fp, &loaded) && loaded.palette.palette == NULL &&
-            loaded.index.index == NULL;
+            loaded.index.data == NULL;
   fclose(fp);
   return ok;
 }
@@ -828,8 +908,8 @@ static bool round_trip_with_flags(uint32_t flags, bool *headers_match, bool *ind
     return false;
 
   *headers_match = memcmp(&original.header, &loaded.header, sizeof(Splat4DHeader)) == 0;
-  *index_match = memcmp(original.index.index, loaded.index.index,
-                        header_total_indices(&original.header) * sizeof(uint64_t)) == 0;
+  *index_match =
+      indices_equal(&original.index, &loaded.index, header_total_indices(&original.header));
   free_splat4DVideo(&loaded);
   return true;
 }
@@ -1040,7 +1120,8 @@ static bool test_round_trip_all_available_codecs(void) {
       Splat4DVideo loaded;
       ok = read_splat4DVideo(fp, &loaded);
       if (ok) {
-        ok = memcmp(indices, loaded.index.index, (size_t)total * sizeof(uint64_t)) == 0;
+        Splat4DIndex expect = create_splat4DIndex(indices);
+        ok = indices_equal(&expect, &loaded.index, total);
         free_splat4DVideo(&loaded);
       }
     }
@@ -1236,6 +1317,196 @@ static bool test_image_decode_rejects_non_2d(void) {
   return rejected;
 }
 
+// The selected gather kernel matches the portable one at every index width,
+// offset and tail length.
+static bool test_rgb_gather_matches_scalar(void) {
+  enum { N = 1200, ENTRIES = 300 };
+  static uint32_t lut[ENTRIES], raw[N];
+  static uint8_t want[N * 3], got[N * 3];
+  for (uint32_t j = 0; j < ENTRIES; ++j)
+    lut[j] = (j * 2654435761u) | 0xFF000000u;
+  static const size_t lens[] = {0, 1, 7, 9, 10, 11, 17, 33, 1001};
+  for (uint8_t width = 1; width <= 8; width *= 2) {
+    Splat4DIndex index;
+    if (!splat4d_index_alloc(&index, N, width))
+      return false;
+    for (uint32_t k = 0; k < N; ++k) {
+      raw[k] = (k * 7919u) % (width == 1 ? 256 : ENTRIES);
+      splat4d_index_set(&index, k, raw[k]);
+    }
+    SplatRgbGatherFn gather = rgb_gather_select(ENTRIES);
+    bool ok = true;
+    for (size_t l = 0; ok && l < ARRAY_SIZE(lens); ++l) {
+      for (uint64_t first = 0; ok && first < 5; ++first) {
+        memset(want, 0xAB, sizeof want);
+        memset(got, 0xAB, sizeof got);
+        rgb_gather_scalar(&index, first, lens[l], lut, want);
+        gather(&index, first, lens[l], lut, got);
+        uint32_t last = lens[l] ? lut[raw[first + lens[l] - 1]] : 0;
+        ok = memcmp(want, got, sizeof want) == 0 &&
+             (lens[l] == 0 || (want[0] == (uint8_t)lut[raw[first]] &&
+                               want[lens[l] * 3 - 1] == (uint8_t)(last >> 16)));
+      }
+    }
+    free(index.data);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+// The parallel range check reads entries at every index width, 64-bit ones
+// included.
+static bool test_index_below_checks_every_width(void) {
+  enum { N = 1000 };
+  bool ok = true;
+  for (uint8_t width = 1; ok && width <= 8; width *= 2) {
+    Splat4DIndex index;
+    if (!splat4d_index_alloc(&index, N, width))
+      return false;
+    for (uint32_t k = 0; k < N; ++k)
+      splat4d_index_set(&index, k, k % 200);
+    ok = splat_index_below(&index, N, 200) && !splat_index_below(&index, N, 199);
+    splat4d_index_set(&index, N - 1, 250);
+    ok = ok && splat_index_below(&index, N - 1, 200) && !splat_index_below(&index, N, 200);
+    free(index.data);
+  }
+  return ok;
+}
+
+// Decoding with four workers gives the same slices as with one, with slices
+// large enough to be split into row tiles, and a bad entry in the last slice
+// still fails the decode.
+static bool test_parallel_slice_decode_matches_serial(void) {
+  enum { W = 700, H = 400, FRAMES = 3, COLORS = 1000 };
+  const uint64_t npix = (uint64_t)W * H;
+  Splat4D *palette = calloc(COLORS, sizeof(Splat4D));
+  Splat4DIndex idx;
+  if (!palette || !splat4d_index_alloc(&idx, npix * FRAMES, 2)) {
+    free(palette);
+    return false;
+  }
+  for (uint32_t j = 0; j < COLORS; ++j)
+    palette[j] = create_splat4D(0, 1, 0, 1, 0, 1, 0, 1, (float)(j % 10) / 9.0f,
+                                (float)(j / 10 % 10) / 9.0f, (float)(j / 100) / 9.0f, 1);
+  for (uint64_t k = 0; k < npix * FRAMES; ++k)
+    splat4d_index_set(&idx, k, (k % npix * 31 + (k / npix == 1 ? 0 : k / npix) * 7) % COLORS);
+  uint32_t flags = SPLAT_FLAG_PRECISION_FLOAT32 |
+                   (SPLAT_INDEX_WIDTH_16 << SPLAT_FLAG_INDEX_WIDTH_SHIFT);
+  Splat4DVideo video = create_splat4DVideoWithIndex(
+      create_splat4DHeader(W, H, 1, FRAMES, COLORS, flags), palette, idx);
+  uint8_t **one = NULL, **four = NULL;
+  splat4d_set_threads(1);
+  bool ok = video_to_slices(&video, &one, NULL, NULL, NULL);
+  splat4d_set_threads(4);
+  ok = ok && video_to_slices(&video, &four, NULL, NULL, NULL);
+  for (uint32_t t = 0; ok && t < FRAMES; ++t)
+    ok = memcmp(one[t], four[t], (size_t)npix * 3) == 0;
+  free_video_slices(one, FRAMES);
+  free_video_slices(four, FRAMES);
+  uint8_t **bad = NULL;
+  splat4d_index_set(&video.index, npix * FRAMES - 1, COLORS);
+  ok = ok && !video_to_slices(&video, &bad, NULL, NULL, NULL);
+  splat4d_set_threads(0);
+  free(palette);
+  free(idx.data);
+  return ok;
+}
+
+// A W x H x frames clip with a 64-bit index: pixel k of frame t takes color
+// (k * 5 + t) % 7 of a gray ramp.
+#define WIDE_TEST_COLORS 7
+static Splat4DVideo make_wide_index_video(uint32_t w, uint32_t h, uint32_t frames) {
+  Splat4D *palette = calloc(WIDE_TEST_COLORS, sizeof(Splat4D));
+  Splat4DIndex idx = {.data = NULL};
+  uint64_t total = (uint64_t)w * h * frames;
+  if (!palette || !splat4d_index_alloc(&idx, total, 8)) {
+    free(palette);
+    return (Splat4DVideo){.palette = {NULL}};
+  }
+  for (uint32_t j = 0; j < WIDE_TEST_COLORS; ++j) {
+    float g = (float)j / (WIDE_TEST_COLORS - 1);
+    palette[j] = create_splat4D(0, 1, 0, 1, 0, 1, 0, 1, g, g, g, 1);
+  }
+  for (uint64_t k = 0; k < total; ++k)
+    splat4d_index_set(&idx, k, (k % ((uint64_t)w * h) * 5 + k / ((uint64_t)w * h)) %
+                                   WIDE_TEST_COLORS);
+  uint32_t flags = SPLAT_FLAG_PRECISION_FLOAT32 |
+                   (SPLAT_INDEX_WIDTH_64 << SPLAT_FLAG_INDEX_WIDTH_SHIFT);
+  Splat4DHeader header = create_splat4DHeader(w, h, 1, frames, WIDE_TEST_COLORS, flags);
+  return create_splat4DVideoWithIndex(header, palette, idx);
+}
+
+// Whether `rgb` holds frame t of make_wide_index_video().
+static bool wide_index_frame_matches(const uint8_t *rgb, uint64_t npix, uint32_t t) {
+  for (uint64_t k = 0; k < npix; ++k) {
+    uint32_t j = (uint32_t)((k * 5 + t) % WIDE_TEST_COLORS);
+    uint8_t g = splat_channel_to_u8((float)j / (WIDE_TEST_COLORS - 1));
+    if (rgb[k * 3] != g || rgb[k * 3 + 1] != g || rgb[k * 3 + 2] != g)
+      return false;
+  }
+  return true;
+}
+
+// 64-bit index entries decode through the palette table like narrow ones.
+static bool test_wide_index_decodes(void) {
+  enum { W = 37, H = 11, FRAMES = 3 };
+  Splat4DVideo image = make_wide_index_video(W, H, 1);
+  Splat4DVideo clip = make_wide_index_video(W, H, FRAMES);
+  uint8_t *rgb = NULL, **slices = NULL;
+  uint32_t ns = 0;
+  bool ok = image.palette.palette && clip.palette.palette && image.index.width == 8 &&
+            video_to_image(&image, &rgb, NULL, NULL) && wide_index_frame_matches(rgb, W * H, 0) &&
+            video_to_slices(&clip, &slices, &ns, NULL, NULL) && ns == FRAMES;
+  for (uint32_t t = 0; ok && t < FRAMES; ++t)
+    ok = wide_index_frame_matches(slices[t], W * H, t);
+  free(rgb);
+  free_video_slices(slices, ns);
+  free_splat4DVideo(&image);
+  free_splat4DVideo(&clip);
+  return ok;
+}
+
+// video_to_slice_block() decodes every slice, row tiles included, into one
+// block in slice order, with the same pixels as video_to_slices().
+static bool test_slice_block_is_contiguous(void) {
+  enum { W = 700, H = 400, FRAMES = 3 };
+  const size_t slice_bytes = (size_t)W * H * 3;
+  Splat4DVideo v = make_wide_index_video(W, H, FRAMES);
+  uint8_t **block = NULL, **each = NULL;
+  uint32_t nb = 0, ne = 0, w = 0, h = 0;
+  splat4d_set_threads(4);
+  bool ok = v.palette.palette && video_to_slice_block(&v, &block, &nb, &w, &h) &&
+            nb == FRAMES && w == W && h == H && video_to_slices(&v, &each, &ne, NULL, NULL);
+  for (uint32_t t = 0; ok && t < FRAMES; ++t)
+    ok = block[t] == block[0] + t * slice_bytes && memcmp(block[t], each[t], slice_bytes) == 0;
+  free_video_slice_block(block);
+  free_video_slices(each, ne);
+  uint8_t **bad = NULL;
+  if (v.palette.palette)
+    splat4d_index_set(&v.index, (uint64_t)W * H * FRAMES - 1, WIDE_TEST_COLORS);
+  ok = ok && !video_to_slice_block(&v, &bad, NULL, NULL, NULL);
+  splat4d_set_threads(0);
+  free_splat4DVideo(&v);
+  return ok;
+}
+
+// An index entry past the palette fails the decode instead of reading out of
+// bounds.
+static bool test_rgb_decode_rejects_out_of_range_index(void) {
+  uint8_t rgb[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  Splat4DVideo v;
+  if (!image_to_video(rgb, 2, 2, &v))
+    return false;
+  splat4d_index_set(&v.index, 3, v.header.pSize);
+  uint8_t *out = NULL, **slices = NULL;
+  bool rejected = !video_to_image(&v, &out, NULL, NULL) &&
+                  !video_to_slices(&v, &slices, NULL, NULL, NULL);
+  free(out);
+  free_splat4DVideo(&v);
+  return rejected;
+}
+
 static bool test_palette_entry_disk_bytes_by_shape(void) {
   uint32_t f32 = SPLAT_FLAG_PRECISION_FLOAT32;
   return palette_entry_disk_bytes(f32 | (SPLAT_SHAPE_ISOTROPIC << SPLAT_FLAG_SPLAT_SHAPE_SHIFT)) ==
@@ -1453,7 +1724,7 @@ static bool test_golden_vector_reads_back(void) {
   const Splat4D *s = &v.palette.palette[0];
   ok = v.header.width == 2 && v.header.pSize == 2 && v.header.version[1] == 1 && s->mu_x == 1.0f &&
        s->mu_y == 3.0f && s->sigma_x == 2.0f && s->sigma_z == 6.0f && s->r == 0.5f &&
-       s->alpha == 1.0f && v.index.index[1] == 1;
+       s->alpha == 1.0f && splat4d_index_get(&v.index, 1) == 1;
   free_splat4DVideo(&v);
   return ok;
 }
@@ -1541,11 +1812,1638 @@ static bool test_volume_populates_mu_z(void) {
   return ok;
 }
 
+static bool test_splat_statistics_from_pixel_positions(void) {
+  // 4x2 frames, 2 of them: red at (1,0) and (3,1) in both, black elsewhere.
+  uint8_t f[4 * 2 * 3] = {0};
+  f[1 * 3] = 255;
+  f[(4 + 3) * 3] = 255;
+  const uint8_t *frames[2] = {f, f};
+  Splat4DVideo v;
+  if (!frames_to_video_quantized(frames, 2, 4, 2, 0, &v))
+    return false;
+  const Splat4D *red = &v.palette.palette[1];
+  bool ok = v.header.pSize == 2 && red->r == 1.0f && red->mu_x == 2.0f &&
+            red->sigma_x == 1.0f && red->mu_y == 0.5f && red->sigma_y == 0.5f &&
+            red->mu_t == 0.5f && red->sigma_t == 0.5f && red->mu_z == 0.0f;
+  free_splat4DVideo(&v);
+  return ok;
+}
+
+// Write make_palette()/make_indices() with `flags` to a fresh temporary file.
+static FILE *write_temp_video(uint32_t flags) {
+  Splat4D palette[2];
+  uint64_t indices[4];
+  make_palette(palette);
+  make_indices(indices);
+  Splat4DHeader header = create_splat4DHeader(2, 2, 1, 1, 2, flags);
+  Splat4DVideo video = create_splat4DVideo(header, palette, indices);
+  FILE *fp = tmpfile();
+  if (fp && !write_splat4DVideo(fp, &video)) {
+    fclose(fp);
+    return NULL;
+  }
+  return fp;
+}
+
+static bool test_read_verify_modes(void) {
+  FILE *fp = write_temp_video(SPLAT_FLAG_PRECISION_FLOAT32);
+  if (!fp)
+    return false;
+  // Flip the last index entry (index 1 -> 0, still in range), just ahead of the
+  // footer, so only the checksum can tell.
+  bool ok = fseek(fp, -(long)SPLAT_FOOTER_DISK_BYTES - 1, SEEK_END) == 0 && fputc(0, fp) != EOF &&
+            fflush(fp) == 0;
+  Splat4DVideo v;
+  Splat4DReadOptions full = {.verify = SPLAT_READ_VERIFY_FULL};
+  Splat4DReadOptions deferred = {.verify = SPLAT_READ_VERIFY_DEFERRED};
+  Splat4DReadOptions none = {.verify = SPLAT_READ_VERIFY_NONE};
+  ok = ok && fseek(fp, 0, SEEK_SET) == 0 && !read_splat4DVideoWithOptions(fp, &v, &full) &&
+       v.index.data == NULL;
+  ok = ok && fseek(fp, 0, SEEK_SET) == 0 && read_splat4DVideoWithOptions(fp, &v, &deferred);
+  if (ok) {
+    ok = !splat4d_verify(&v);
+    free_splat4DVideo(&v);
+  }
+  ok = ok && fseek(fp, 0, SEEK_SET) == 0 && read_splat4DVideoWithOptions(fp, &v, &none);
+  if (ok) {
+    ok = splat4d_index_get(&v.index, 3) == 0;
+    free_splat4DVideo(&v);
+  }
+  fclose(fp);
+  return ok;
+}
+
+static bool test_deferred_read_verifies_intact_file(void) {
+  FILE *fp = write_temp_video(SPLAT_FLAG_PRECISION_FLOAT32);
+  if (!fp)
+    return false;
+  Splat4DVideo v;
+  Splat4DReadOptions deferred = {.verify = SPLAT_READ_VERIFY_DEFERRED};
+  bool ok = fseek(fp, 0, SEEK_SET) == 0 && read_splat4DVideoWithOptions(fp, &v, &deferred);
+  fclose(fp);
+  if (!ok)
+    return false;
+  ok = splat4d_verify(&v) && !splat4d_verify(NULL);
+  free_splat4DVideo(&v);
+  return ok;
+}
+
+static bool test_probe_reads_header_and_footer(void) {
+  FILE *fp = write_temp_video(SPLAT_FLAG_PRECISION_FLOAT32);
+  if (!fp)
+    return false;
+  Splat4DProbe p;
+  uint64_t palette_bytes = 2 * (uint64_t)palette_entry_disk_bytes(SPLAT_FLAG_PRECISION_FLOAT32);
+  bool ok = probe_splat4DFile(fp, &p) && p.header.width == 2 && p.header.frames == 1 &&
+            p.header.pSize == 2 && p.total_indices == 4 && p.palette_bytes == palette_bytes &&
+            p.index_offset == SPLAT_HEADER_DISK_BYTES + palette_bytes && p.index_bytes == 4 &&
+            p.footer.idxoffset == p.index_offset &&
+            p.file_size == p.index_offset + 4 + SPLAT_FOOTER_DISK_BYTES;
+  // A damaged footer tag is caught without reading the payload.
+  ok = ok && fseek(fp, -1, SEEK_END) == 0 && fputc('X', fp) != EOF && fflush(fp) == 0 &&
+       !probe_splat4DFile(fp, &p);
+  fclose(fp);
+  return ok;
+}
+
+static bool test_mapped_file_exposes_index_in_place(void) {
+  uint32_t flags = SPLAT_FLAG_PRECISION_FLOAT32 |
+                   (SPLAT_SHAPE_AXIS_ALIGNED << SPLAT_FLAG_SPLAT_SHAPE_SHIFT) |
+                   (SPLAT_INDEX_WIDTH_16 << SPLAT_FLAG_INDEX_WIDTH_SHIFT);
+  FILE *fp = write_temp_video(flags);
+  if (!fp)
+    return false;
+  Splat4DMappedVideo m;
+  bool ok = splat4d_map_file(fp, &m, /*verify=*/true);
+  fclose(fp);
+  if (!ok)
+    return false;
+
+  Splat4D palette[2];
+  uint64_t indices[4];
+  make_palette(palette);
+  make_indices(indices);
+  ok = m.total == 4 && m.idx_width == 2 && m.header.pSize == 2 &&
+       m.index == m.base + m.footer.idxoffset &&
+       memcmp(m.palette.palette, palette, sizeof palette) == 0;
+  for (uint64_t i = 0; i < 4 && ok; ++i)
+    ok = splat4d_mapped_index(&m, i) == indices[i];
+  splat4d_unmap_file(&m);
+  return ok && m.base == NULL;
+}
+
+static bool test_mapped_file_deferred_verify_detects_corruption(void) {
+  FILE *fp = write_temp_video(make_header().flags);
+  if (!fp)
+    return false;
+  // Flip the last index byte (just in front of the 16-byte footer).
+  bool ok = fseek(fp, -(long)SPLAT_FOOTER_DISK_BYTES - 1, SEEK_END) == 0 &&
+            fputc(0x7F, fp) != EOF && fflush(fp) == 0;
+  Splat4DMappedVideo m;
+  ok = ok && !splat4d_map_file(fp, &m, /*verify=*/true);
+  ok = ok && splat4d_map_file(fp, &m, /*verify=*/false);
+  fclose(fp);
+  if (!ok)
+    return false;
+  ok = !splat4d_verify_mapped(&m);
+  splat4d_unmap_file(&m);
+  return ok;
+}
+
+static bool test_mapped_file_rejects_compressed_index(void) {
+  FILE *fp = write_temp_video(make_header().flags |
+                              (SPLAT_COMPRESSION_RUN_LENGTH << SPLAT_FLAG_COMPRESSION_SHIFT));
+  if (!fp)
+    return false;
+  Splat4DMappedVideo m;
+  bool ok = !splat4d_map_file(fp, &m, /*verify=*/true) && m.base == NULL;
+  fclose(fp);
+  return ok;
+}
+
+static bool test_index_rewiden_preserves_values(void) {
+  Splat4DIndex ix;
+  if (!splat4d_index_alloc(&ix, 5, 1))
+    return false;
+  for (uint64_t i = 0; i < 5; ++i)
+    splat4d_index_set(&ix, i, 250 + i);
+  // Widen with only the first four entries in use, then narrow back down.
+  bool ok = splat4d_index_rewiden(&ix, 5, 4, 8) && ix.width == 8 && ix.u64[3] == 253;
+  ok = ok && splat4d_index_rewiden(&ix, 5, 4, 2) && ix.width == 2;
+  for (uint64_t i = 0; ok && i < 4; ++i)
+    ok = splat4d_index_get(&ix, i) == 250 + i;
+  ok = ok && !splat4d_index_rewiden(&ix, 5, 4, 3);
+  free(ix.data);
+  return ok;
+}
+
+static bool test_reader_keeps_header_index_width(void) {
+  // make_header() leaves the index width at its 1-byte default.
+  FILE *fp = write_temp_video(make_header().flags);
+  if (!fp)
+    return false;
+  rewind(fp);
+  Splat4DVideo v;
+  bool ok = read_splat4DVideo(fp, &v);
+  fclose(fp);
+  if (!ok)
+    return false;
+  ok = v.index.width == 1 && v.index.u8[0] == 0 && v.index.u8[1] == 1 && v.index.u8[3] == 1;
+  free_splat4DVideo(&v);
+  return ok;
+}
+
+static bool test_encoder_widens_index_with_palette(void) {
+  // 300 distinct colors need a 2-byte index; median cut to 16 drops back to 1.
+  enum { N = 300 };
+  uint8_t rgb[N * 3];
+  for (int i = 0; i < N; ++i) {
+    rgb[i * 3] = (uint8_t)i;
+    rgb[i * 3 + 1] = (uint8_t)(i >> 8);
+    rgb[i * 3 + 2] = 7;
+  }
+  const uint8_t *fr[1] = {rgb};
+  Splat4DVideo v;
+  if (!frames_to_video_quantized(fr, 1, N, 1, 0, &v))
+    return false;
+  bool ok = v.header.pSize == N && v.index.width == 2 &&
+            get_index_width_bytes(v.header.flags) == 2 && splat4d_index_get(&v.index, 299) == 299;
+  uint8_t **rec = NULL;
+  uint32_t nf = 0, w = 0, h = 0;
+  if (ok)
+    ok = video_to_frames(&v, &rec, &nf, &w, &h) && nf == 1 && memcmp(rec[0], rgb, sizeof rgb) == 0;
+  free_video_slices(rec, nf);
+  free_splat4DVideo(&v);
+  if (!ok)
+    return false;
+
+  if (!frames_to_video_quantized(fr, 1, N, 1, 16, &v))
+    return false;
+  ok = v.header.pSize <= 16 && v.index.width == 1 && get_index_width_bytes(v.header.flags) == 1;
+  free_splat4DVideo(&v);
+  return ok;
+}
+
+static bool test_colormap_grows_from_small_hint(void) {
+  ColorMap m;
+  if (!colormap_init(&m, 1))
+    return false;
+  bool ok = true;
+  for (uint32_t c = 0; ok && c < 100000; ++c)
+    ok = colormap_put(&m, c * 167u & 0xFFFFFFu, c);
+  uint32_t v = 0;
+  for (uint32_t c = 0; ok && c < 100000; ++c)
+    ok = colormap_get(&m, c * 167u & 0xFFFFFFu, &v) && v == c;
+  ok = ok && m.n == 100000 && m.cap >= 200000 && !colormap_get(&m, 0xFFFFFFu, &v);
+  colormap_free(&m);
+  return ok;
+}
+
+// Past SPLAT_COLORMAP_HASH_SLOTS / 2 colors the map turns into a direct table
+// and keeps every entry it held while hashed.
+static bool test_colormap_switches_to_direct_table(void) {
+  ColorMap m;
+  if (!colormap_init(&m, 1))
+    return false;
+  const uint32_t n = (uint32_t)(SPLAT_COLORMAP_HASH_SLOTS / 2) + 1000;
+  bool ok = true;
+  for (uint32_t c = 0; ok && c < n; ++c)
+    ok = colormap_put(&m, c * 167u & 0xFFFFFFu, c);
+  uint32_t v = 0;
+  for (uint32_t c = 0; ok && c < n; ++c)
+    ok = colormap_get(&m, c * 167u & 0xFFFFFFu, &v) && v == c;
+  ok = ok && m.direct && !m.slot && m.n == n && !colormap_get(&m, 0xFFFFFFu, &v);
+  colormap_free(&m);
+  return ok;
+}
+
+// A hashed_only map (a histogram task table over the direct budget) keeps
+// doubling past SPLAT_COLORMAP_HASH_SLOTS instead of taking 64 MiB at once.
+static bool test_colormap_hashed_only_stays_hashed(void) {
+  ColorMap m;
+  if (!colormap_alloc(&m, 16, true))
+    return false;
+  const uint32_t n = (uint32_t)(SPLAT_COLORMAP_HASH_SLOTS / 2) + 1000;
+  bool ok = true;
+  for (uint32_t c = 0; ok && c < n; ++c)
+    ok = colormap_put(&m, c * 167u & 0xFFFFFFu, c);
+  uint32_t v = 0;
+  for (uint32_t c = 0; ok && c < n; ++c)
+    ok = colormap_get(&m, c * 167u & 0xFFFFFFu, &v) && v == c;
+  ok = ok && !m.direct && m.slot && m.cap == 2 * SPLAT_COLORMAP_HASH_SLOTS && m.n == n;
+  colormap_free(&m);
+  return ok;
+}
+
+// Median-cut runs share no state, so several can quantize at once.
+#define MEDIAN_CUT_TEST_COLORS 256
+
+typedef struct {
+  uint32_t colors[MEDIAN_CUT_TEST_COLORS];
+  double counts[MEDIAN_CUT_TEST_COLORS];
+  uint32_t quant_of[4][MEDIAN_CUT_TEST_COLORS];
+  uint32_t rep[4][4];
+  uint32_t n[4];
+} MedianCutTest;
+
+static bool median_cut_test_task(void *ctx, uint64_t task) {
+  MedianCutTest *t = ctx;
+  t->n[task] = splat_median_cut(t->colors, t->counts, MEDIAN_CUT_TEST_COLORS, 4, t->quant_of[task],
+                                t->rep[task]);
+  return t->n[task] != 0;
+}
+
+static bool test_median_cut_is_reentrant(void) {
+  static MedianCutTest t;
+  // A red ramp with a slight green wobble: red is always the widest channel,
+  // so four equal-weight boxes are the four quarters of the ramp.
+  for (uint32_t u = 0; u < MEDIAN_CUT_TEST_COLORS; ++u) {
+    uint32_t r = (u * 97u) % MEDIAN_CUT_TEST_COLORS;
+    t.colors[u] = (r << 16) | ((r & 3u) << 8);
+    t.counts[u] = 1.0;
+  }
+  splat4d_set_threads(4);
+  bool ok = splat_parallel_for(4, median_cut_test_task, &t);
+  splat4d_set_threads(0);
+  for (uint32_t task = 0; ok && task < 4; ++task) {
+    ok = t.n[task] == 4 && memcmp(t.rep[task], t.rep[0], sizeof t.rep[0]) == 0;
+    for (uint32_t u = 0; ok && u < MEDIAN_CUT_TEST_COLORS; ++u) {
+      uint32_t q = t.quant_of[task][u], r = t.colors[u] >> 16;
+      uint32_t rep_r = t.rep[task][q] >> 16;
+      ok = rep_r / 64 == r / 64 && t.quant_of[task][u] == t.quant_of[0][u];
+    }
+  }
+  return ok;
+}
+
+// Eight tight clusters near the RGB cube corners: every quantizer should give
+// each cluster its own representative at a budget of eight.
+static bool test_quantizers_separate_clusters(void) {
+  enum { PER = 27, NU = 8 * PER };
+  uint32_t colors[NU], quant_of[NU], rep[8];
+  double counts[NU];
+  for (uint32_t u = 0; u < NU; ++u) {
+    uint32_t corner = u / PER, j = u % PER;
+    uint32_t r = (corner & 4 ? 230 : 10) + j % 3, g = (corner & 2 ? 230 : 10) + j / 3 % 3,
+             b = (corner & 1 ? 230 : 10) + j / 9;
+    colors[u] = (r << 16) | (g << 8) | b;
+    counts[u] = 1.0 + j;
+  }
+  const SplatQuantizer qs[3] = {SPLAT_QUANTIZER_MEDIAN_CUT, SPLAT_QUANTIZER_OCTREE,
+                                SPLAT_QUANTIZER_WU};
+  for (int q = 0; q < 3; ++q) {
+    uint32_t n = splat_quantize(qs[q], colors, counts, NU, 8, quant_of, rep);
+    if (n != 8)
+      return false;
+    for (uint32_t u = 0; u < NU; ++u) {
+      if (quant_of[u] >= n || quant_of[u] != quant_of[u - u % PER])
+        return false;
+      for (int sh = 0; sh <= 16; sh += 8) {
+        int d = (int)((colors[u] >> sh) & 0xFF) - (int)((rep[quant_of[u]] >> sh) & 0xFF);
+        if (d < -2 || d > 2)
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Every quantizer reaches the encoder and stays within the color budget.
+static bool test_encode_options_select_quantizer(void) {
+  enum { W = 64, H = 64 };
+  static uint8_t rgb[W * H * 3];
+  for (uint32_t k = 0; k < W * H; ++k) {
+    rgb[k * 3] = (uint8_t)(k % W * 4);
+    rgb[k * 3 + 1] = (uint8_t)(k / W * 4);
+    rgb[k * 3 + 2] = (uint8_t)(k * 37);
+  }
+  const uint8_t *fr[1] = {rgb};
+  for (uint32_t q = SPLAT_QUANTIZER_MEDIAN_CUT; q <= SPLAT_QUANTIZER_WU; ++q) {
+    Splat4DEncodeOptions opts = {.max_colors = 32, .quantizer = (SplatQuantizer)q};
+    Splat4DVideo v;
+    if (!stack_to_video_with_options(fr, 1, 1, W, H, &opts, &v))
+      return false;
+    bool ok = v.header.pSize > 1 && v.header.pSize <= 32 && v.index.width == 1;
+    free_splat4DVideo(&v);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+// The k-d tree search must find the same centroid as a full scan, ties
+// included (duplicate centroids resolve to the lower number).
+static bool test_kmeans_tree_matches_linear_scan(void) {
+  enum { K = 200, NU = 4096 };
+  static uint32_t colors[NU], tree_of[NU], scan_of[NU];
+  static float cent[3 * K];
+  uint64_t changed[1];
+  uint32_t x = 12345;
+  for (uint32_t c = 0; c < 3 * K; ++c) {
+    x = x * 1103515245u + 12345u;
+    cent[c] = (float)((x >> 16) % 64 * 4); // coarse grid: many ties
+  }
+  for (uint32_t u = 0; u < NU; ++u) {
+    x = x * 1103515245u + 12345u;
+    colors[u] = x & 0xFFFFFFu;
+    tree_of[u] = scan_of[u] = u % K;
+  }
+  uint32_t perm[K];
+  uint8_t axis[K];
+  KMeans km = {.colors = colors, .nu = NU, .k = K, .c = {cent, cent + K, cent + 2 * K},
+               .assign = scan_of, .changed = changed};
+  if (!kmeans_assign_task(&km, 0))
+    return false;
+  for (uint32_t c = 0; c < K; ++c)
+    perm[c] = c;
+  km.perm = perm;
+  km.axis = axis;
+  km.assign = tree_of;
+  kd_build(&km, 0, K);
+  if (!kmeans_assign_task(&km, 0))
+    return false;
+  return memcmp(tree_of, scan_of, sizeof tree_of) == 0;
+}
+
+// Refinement never raises the weighted squared error of a median-cut palette,
+// and the result is the same for one worker and four.
+static double quantized_error(const uint32_t *colors, const double *counts, uint32_t nu,
+                              const uint32_t *quant_of, const uint32_t *rep) {
+  double err = 0.0;
+  for (uint32_t u = 0; u < nu; ++u)
+    for (int sh = 0; sh <= 16; sh += 8) {
+      double d = (double)((colors[u] >> sh) & 0xFF) - (double)((rep[quant_of[u]] >> sh) & 0xFF);
+      err += counts[u] * d * d;
+    }
+  return err;
+}
+
+static bool test_kmeans_refine_lowers_error(void) {
+  enum { NU = 40000, K = 48 };
+  static uint32_t colors[NU], q0[NU], q1[NU], q4[NU], rep0[K], rep1[K], rep4[K];
+  static double counts[NU];
+  for (uint32_t u = 0; u < NU; ++u) {
+    colors[u] = (u * 2654435761u) & 0xFFFFFFu;
+    counts[u] = 1.0 + u % 7;
+  }
+  uint32_t n = splat_median_cut(colors, counts, NU, K, q0, rep0);
+  if (n != K)
+    return false;
+  memcpy(q1, q0, sizeof q0);
+  memcpy(rep1, rep0, sizeof rep0);
+  memcpy(q4, q0, sizeof q0);
+  memcpy(rep4, rep0, sizeof rep0);
+  splat4d_set_threads(1);
+  uint32_t n1 = splat_kmeans_refine(colors, counts, NU, n, 5, q1, rep1);
+  splat4d_set_threads(4);
+  uint32_t n4 = splat_kmeans_refine(colors, counts, NU, n, 5, q4, rep4);
+  splat4d_set_threads(0);
+  return n1 > 0 && n1 <= K && n1 == n4 && memcmp(q1, q4, sizeof q1) == 0 &&
+         memcmp(rep1, rep4, n1 * sizeof(uint32_t)) == 0 &&
+         quantized_error(colors, counts, NU, q1, rep1) <
+             quantized_error(colors, counts, NU, q0, rep0);
+}
+
+// Everything in `fp` from the start; the caller frees the buffer.
+static uint8_t *slurp_file(FILE *fp, size_t *len) {
+  long end = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+  uint8_t *buf = end >= 0 ? malloc((size_t)end + 1) : NULL;
+  if (buf && (fseek(fp, 0, SEEK_SET) != 0 || fread(buf, 1, (size_t)end, fp) != (size_t)end)) {
+    free(buf);
+    return NULL;
+  }
+  *len = (size_t)end;
+  return buf;
+}
+
+// Pushing slices one at a time writes the same bytes as the batch encoder and
+// writer, for every codec and layout, exact or quantized. The color count
+// passes 256 and then 65536 along the way, so the spool width changes.
+static bool test_stream_encoder_matches_batch(void) {
+  enum { W = 256, H = 64, DEPTH = 2, FRAMES = 3, NSLICES = DEPTH * FRAMES };
+  uint8_t *rgb[NSLICES] = {0};
+  bool ok = true;
+  for (uint32_t s = 0; s < NSLICES; ++s) {
+    rgb[s] = malloc((size_t)W * H * 3);
+    ok = ok && rgb[s];
+    for (uint32_t k = 0; ok && k < W * H; ++k) {
+      uint32_t c = s == 0 ? k % 200 : s == 1 ? k % 1000 : (k + s * 16384u) * 7919u % 70001u;
+      rgb[s][k * 3] = (uint8_t)(c >> 16);
+      rgb[s][k * 3 + 1] = (uint8_t)(c >> 8);
+      rgb[s][k * 3 + 2] = (uint8_t)c;
+    }
+  }
+  Splat4DEncodeOptions encodes[2] = {
+      {0}, {.max_colors = 64, .quantizer = SPLAT_QUANTIZER_WU, .refine_iterations = 2}};
+  Splat4DWriteOptions writes[3] = {{0}, {.chunk_frames = 1}, {.chunk_bytes = 10000}};
+  for (uint32_t codec = 0; ok && codec < 16; codec++) {
+    if (!splat_compression_available(codec))
+      continue;
+    for (int e = 0; ok && e < 2; ++e) {
+      for (int wr = 0; ok && wr < 3; ++wr) {
+        Splat4DVideo video;
+        FILE *batch = tmpfile(), *streamed = tmpfile();
+        ok = batch && streamed &&
+             stack_to_video_with_options((const uint8_t *const *)rgb, DEPTH, FRAMES, W, H,
+                                         &encodes[e], &video);
+        if (ok) {
+          video.header.flags |= codec << SPLAT_FLAG_COMPRESSION_SHIFT;
+          ok = write_splat4DVideoWithOptions(batch, &video, &writes[wr]);
+          free_splat4DVideo(&video);
+        }
+        Splat4DStreamEncoder enc;
+        Splat4DHeader header;
+        ok = ok && splat4d_encoder_open(&enc, streamed, W, H, DEPTH, codec, &encodes[e],
+                                        &writes[wr]);
+        for (uint32_t t = 0; ok && t < FRAMES; ++t)
+          ok = splat4d_encoder_push_frame(&enc, (const uint8_t *const *)rgb + t * DEPTH);
+        ok = ok && splat4d_encoder_finish(&enc, &header) && header.frames == FRAMES;
+        size_t blen = 0, slen = 0;
+        uint8_t *b = ok ? slurp_file(batch, &blen) : NULL;
+        uint8_t *st = b ? slurp_file(streamed, &slen) : NULL;
+        ok = st && blen == slen && memcmp(b, st, blen) == 0;
+        free(b);
+        free(st);
+        if (batch)
+          fclose(batch);
+        if (streamed)
+          fclose(streamed);
+      }
+    }
+  }
+  for (uint32_t s = 0; s < NSLICES; ++s)
+    free(rgb[s]);
+  return ok;
+}
+
+// Every palette order keeps the clip lossless and sets the sorted flag;
+// frequency order puts the most used entry first, and the streaming encoder
+// (with frame references, which take their CRCs after renumbering) writes the
+// same bytes as the batch writer.
+static bool test_palette_order_round_trips(void) {
+  enum { W = 64, H = 32, FRAMES = 3 };
+  static uint8_t rgb[FRAMES][W * H * 3];
+  const uint8_t *slices[FRAMES];
+  for (uint32_t t = 0; t < FRAMES; ++t) {
+    for (uint32_t k = 0; k < W * H; ++k) {
+      uint32_t x = k % W, y = k / W, shot = t == 2 ? 0 : t; // frame 2 repeats frame 0
+      uint32_t c = (x / 4 + y / 2 * 16 + shot * 7) % 300;   // 300 colors, two-byte index
+      rgb[t][k * 3] = (uint8_t)(c * 37);
+      rgb[t][k * 3 + 1] = (uint8_t)(c >> 8);
+      rgb[t][k * 3 + 2] = (uint8_t)(k % 3 == 0 && y == 0 ? 1 : 0);
+    }
+    slices[t] = rgb[t];
+  }
+  Splat4DWriteOptions write = {.frame_refs = true};
+  bool ok = true;
+  for (uint32_t order = SPLAT_ORDER_FIRST_SEEN; ok && order <= SPLAT_ORDER_COOCCURRENCE;
+       ++order) {
+    Splat4DEncodeOptions encode = {.order = (SplatPaletteOrder)order};
+    Splat4DVideo video;
+    FILE *batch = tmpfile(), *streamed = tmpfile();
+    ok = batch && streamed &&
+         stack_to_video_with_options(slices, 1, FRAMES, W, H, &encode, &video);
+    if (ok) {
+      video.header.flags |= SPLAT_COMPRESSION_RUN_LENGTH << SPLAT_FLAG_COMPRESSION_SHIFT;
+      ok = ((video.header.flags & SPLAT_FLAG_SORTED) != 0) == (order != SPLAT_ORDER_FIRST_SEEN);
+      uint64_t *used = calloc(video.header.pSize, sizeof(uint64_t));
+      ok = ok && used;
+      for (uint64_t k = 0; ok && k < (uint64_t)W * H * FRAMES; ++k)
+        used[splat4d_index_get(&video.index, k)]++;
+      for (uint32_t j = 1; ok && order == SPLAT_ORDER_FREQUENCY && j < video.header.pSize; ++j)
+        ok = used[j] <= used[j - 1];
+      free(used);
+      uint8_t **rec = NULL;
+      uint32_t ns = 0;
+      ok = ok && write_splat4DVideoWithOptions(batch, &video, &write) &&
+           video_to_slices(&video, &rec, &ns, NULL, NULL) && ns == FRAMES;
+      for (uint32_t t = 0; ok && t < FRAMES; ++t)
+        ok = memcmp(rec[t], rgb[t], W * H * 3) == 0;
+      free_video_slices(rec, ns);
+      free_splat4DVideo(&video);
+    }
+    Splat4DStreamEncoder enc;
+    ok = ok && splat4d_encoder_open(&enc, streamed, W, H, 1, SPLAT_COMPRESSION_RUN_LENGTH,
+                                    &encode, &write);
+    for (uint32_t t = 0; ok && t < FRAMES; ++t)
+      ok = splat4d_encoder_push_slice(&enc, rgb[t]);
+    ok = ok && splat4d_encoder_finish(&enc, NULL);
+    size_t blen = 0, slen = 0;
+    uint8_t *b = ok ? slurp_file(batch, &blen) : NULL;
+    uint8_t *st = b ? slurp_file(streamed, &slen) : NULL;
+    ok = st && blen == slen && memcmp(b, st, blen) == 0;
+    free(b);
+    free(st);
+    if (batch)
+      fclose(batch);
+    if (streamed)
+      fclose(streamed);
+  }
+  return ok;
+}
+
+// The co-occurrence chain follows the strongest pairs: on a 1 x 8 strip
+// a b c d d c b a with d the most used, the chain runs d c b a.
+static bool test_cooccurrence_chain_follows_neighbors(void) {
+  uint8_t strip[] = {0, 1, 2, 3, 3, 2, 1, 0};
+  Splat4DIndex index = {.u8 = strip, .width = 1};
+  SplatMomentSums sums[4] = {{.n = 2}, {.n = 2}, {.n = 2}, {.n = 3}};
+  uint32_t new_of[4];
+  return splat_palette_order(SPLAT_ORDER_COOCCURRENCE, sums, 4, 8, 1, 1, 1, whole_index_rows,
+                             &index, new_of) &&
+         new_of[3] == 0 && new_of[2] == 1 && new_of[1] == 2 && new_of[0] == 3;
+}
+
+// A stream that ends part-way through a frame is rejected.
+static bool test_stream_encoder_rejects_partial_frame(void) {
+  uint8_t rgb[4 * 4 * 3] = {0};
+  FILE *fp = tmpfile();
+  Splat4DStreamEncoder enc;
+  bool ok = fp && splat4d_encoder_open(&enc, fp, 4, 4, 2, SPLAT_COMPRESSION_NONE, NULL, NULL) &&
+            splat4d_encoder_push_slice(&enc, rgb) && !splat4d_encoder_finish(&enc, NULL) &&
+            enc.spool == NULL;
+  if (fp)
+    fclose(fp);
+  return ok;
+}
+
+// Encode the same stack with one worker and with four; the palette and index
+// must match exactly, exact or quantized.
+static bool test_parallel_histogram_matches_serial(void) {
+  enum { W = 512, H = 256, FRAMES = 4 };
+  uint8_t *rgb[FRAMES] = {0};
+  bool ok = true;
+  for (uint32_t f = 0; f < FRAMES; ++f) {
+    rgb[f] = malloc((size_t)W * H * 3);
+    ok = ok && rgb[f];
+    for (uint32_t k = 0; ok && k < W * H; ++k) {
+      // Runs of 2 pixels over 70001 colors: wide index, map growth, run cache.
+      uint32_t c = ((k / 2 + f * 32768u) * 7919u) % 70001u;
+      rgb[f][k * 3] = (uint8_t)(c >> 16);
+      rgb[f][k * 3 + 1] = (uint8_t)(c >> 8);
+      rgb[f][k * 3 + 2] = (uint8_t)c;
+    }
+  }
+  for (uint32_t max_colors = 0; ok && max_colors <= 64; max_colors += 64) {
+    Splat4DVideo serial, parallel;
+    splat4d_set_threads(1);
+    ok = frames_to_video_quantized((const uint8_t *const *)rgb, FRAMES, W, H, max_colors,
+                                   &serial);
+    splat4d_set_threads(4);
+    if (ok && !frames_to_video_quantized((const uint8_t *const *)rgb, FRAMES, W, H, max_colors,
+                                         &parallel)) {
+      free_splat4DVideo(&serial);
+      ok = false;
+    }
+    splat4d_set_threads(0);
+    if (!ok)
+      break;
+    uint64_t total = (uint64_t)W * H * FRAMES;
+    ok = serial.header.pSize == parallel.header.pSize &&
+         serial.index.width == parallel.index.width &&
+         (max_colors ? serial.header.pSize <= 64 : serial.index.width == 4) &&
+         memcmp(serial.palette.palette, parallel.palette.palette,
+                serial.header.pSize * sizeof(Splat4D)) == 0 &&
+         memcmp(serial.index.data, parallel.index.data,
+                (size_t)(total * serial.index.width)) == 0 &&
+         serial.footer.checksum == parallel.footer.checksum;
+    free_splat4DVideo(&serial);
+    free_splat4DVideo(&parallel);
+  }
+  for (uint32_t f = 0; f < FRAMES; ++f)
+    free(rgb[f]);
+  return ok;
+}
+
+// 4x2 frames, 5 of them, with a per-frame pattern so frames are distinguishable.
+#define CHUNK_TEST_W 4
+#define CHUNK_TEST_H 2
+#define CHUNK_TEST_FRAMES 5
+#define CHUNK_TEST_TOTAL (CHUNK_TEST_W * CHUNK_TEST_H * CHUNK_TEST_FRAMES)
+
+static void make_chunk_test_indices(uint64_t indices[CHUNK_TEST_TOTAL]) {
+  for (uint64_t k = 0; k < CHUNK_TEST_TOTAL; ++k)
+    indices[k] = (k / (CHUNK_TEST_W * CHUNK_TEST_H) + k) % 2;
+}
+
+// Write the chunk-test clip with `codec`, chunked every `chunk_frames` frames
+// (0 = monolithic), and return the file rewound; *crc gets the footer CRC.
+static FILE *write_chunk_test_clip(uint32_t codec, uint32_t chunk_frames, uint32_t *crc) {
+  Splat4D palette[2];
+  uint64_t indices[CHUNK_TEST_TOTAL];
+  make_palette(palette);
+  make_chunk_test_indices(indices);
+  uint32_t flags = SPLAT_FLAG_PRECISION_FLOAT32 | (codec << SPLAT_FLAG_COMPRESSION_SHIFT);
+  Splat4DHeader header =
+      create_splat4DHeader(CHUNK_TEST_W, CHUNK_TEST_H, 1, CHUNK_TEST_FRAMES, 2, flags);
+  Splat4DVideo video = create_splat4DVideo(header, palette, indices);
+  Splat4DWriteOptions opts = {.chunk_frames = chunk_frames};
+  FILE *fp = tmpfile();
+  if (fp && !write_splat4DVideoWithOptions(fp, &video, &opts)) {
+    fclose(fp);
+    return NULL;
+  }
+  if (crc)
+    *crc = video.footer.checksum;
+  if (fp)
+    rewind(fp);
+  return fp;
+}
+
+static bool test_probe_accepts_chunked_layout(void) {
+  uint32_t crc = 0;
+  FILE *fp = write_chunk_test_clip(SPLAT_COMPRESSION_RUN_LENGTH, 2, &crc);
+  if (!fp)
+    return false;
+  Splat4DProbe p;
+  bool ok = probe_splat4DFile(fp, &p) && p.header.version[2] == SPLAT_LAYOUT_CHUNKED &&
+            p.footer.checksum == crc && p.total_indices == CHUNK_TEST_TOTAL &&
+            p.footer.idxoffset > p.index_offset &&
+            p.footer.idxoffset < p.index_offset + p.index_bytes;
+  fclose(fp);
+  return ok;
+}
+
+static bool test_chunked_index_round_trips_every_codec(void) {
+  uint64_t indices[CHUNK_TEST_TOTAL];
+  make_chunk_test_indices(indices);
+  Splat4DIndex expect = create_splat4DIndex(indices);
+  for (uint32_t codec = 0; codec < 16; codec++) {
+    if (!splat_compression_available(codec))
+      continue;
+    uint32_t mono_crc = 0, chunk_crc = 0;
+    FILE *mono = write_chunk_test_clip(codec, 0, &mono_crc);
+    FILE *fp = write_chunk_test_clip(codec, 2, &chunk_crc); // 3 chunks, the last short
+    if (mono)
+      fclose(mono);
+    if (!fp)
+      return false;
+    Splat4DVideo loaded;
+    bool ok = read_splat4DVideo(fp, &loaded);
+    fclose(fp);
+    if (!ok)
+      return false;
+    // The layout is recorded in the header, so the CRCs differ only through it.
+    ok = loaded.header.version[2] == SPLAT_LAYOUT_CHUNKED &&
+         indices_equal(&expect, &loaded.index, CHUNK_TEST_TOTAL) &&
+         loaded.footer.checksum == chunk_crc && chunk_crc != mono_crc;
+    free_splat4DVideo(&loaded);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+static bool test_read_frame_matches_full_decode(void) {
+  uint64_t indices[CHUNK_TEST_TOTAL];
+  make_chunk_test_indices(indices);
+  const uint64_t frame_entries = CHUNK_TEST_W * CHUNK_TEST_H;
+  // Uncompressed, monolithic RLE, and RLE chunked every 1 and every 2 frames.
+  const uint32_t codecs[4] = {SPLAT_COMPRESSION_NONE, SPLAT_COMPRESSION_RUN_LENGTH,
+                              SPLAT_COMPRESSION_RUN_LENGTH, SPLAT_COMPRESSION_RUN_LENGTH};
+  const uint32_t chunking[4] = {0, 0, 1, 2};
+  for (int l = 0; l < 4; ++l) {
+    FILE *fp = write_chunk_test_clip(codecs[l], chunking[l], NULL);
+    if (!fp)
+      return false;
+    bool ok = true;
+    for (uint32_t t = 0; t < CHUNK_TEST_FRAMES && ok; ++t) {
+      Splat4DHeader header;
+      Splat4DPalette palette;
+      Splat4DIndex frame;
+      ok = read_splat4DFrame(fp, t, &header, t == 3 ? &palette : NULL, &frame);
+      if (!ok)
+        break;
+      Splat4DIndex expect = create_splat4DIndex(indices + t * frame_entries);
+      ok = header.frames == CHUNK_TEST_FRAMES && frame.width == 1 &&
+           indices_equal(&expect, &frame, frame_entries);
+      if (t == 3) {
+        ok = ok && palette.palette && palette.palette[1].r == 0.8f;
+        free(palette.palette);
+      }
+      free(frame.data);
+    }
+    fclose(fp);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+// A mostly static w x h x depth clip: a fixed pattern with a small box that
+// moves from frame to frame. 300 colors, so entries are two bytes wide.
+#define DELTA_TEST_W 40
+#define DELTA_TEST_H 30
+#define DELTA_TEST_DEPTH 3
+#define DELTA_TEST_COLORS 300
+
+// Frame t shows the box at position scene[t], or at t when scene is NULL, so a
+// scene that repeats a position repeats the whole frame.
+static FILE *write_scene_test_clip(uint32_t frames, const uint32_t *scene, uint32_t codec,
+                                   const Splat4DWriteOptions *opts, Splat4DIndex *expect) {
+  uint64_t plane = DELTA_TEST_W * DELTA_TEST_H, total = plane * DELTA_TEST_DEPTH * frames;
+  Splat4D *palette = calloc(DELTA_TEST_COLORS, sizeof(Splat4D));
+  Splat4DIndex idx;
+  if (!palette || !splat4d_index_alloc(&idx, total, 2)) {
+    free(palette);
+    return NULL;
+  }
+  for (uint32_t j = 0; j < DELTA_TEST_COLORS; ++j) // distinct RGB8 colors
+    palette[j] = create_splat4D(0, 1, 0, 1, 0, 1, 0, 1, (float)(j & 255) / 255.0f,
+                                (float)(j >> 8) / 255.0f, 0.5f, 1.0f);
+  for (uint64_t k = 0; k < total; ++k) {
+    uint64_t x = k % DELTA_TEST_W, y = k / DELTA_TEST_W % DELTA_TEST_H;
+    uint64_t z = k / plane % DELTA_TEST_DEPTH, t = k / plane / DELTA_TEST_DEPTH;
+    if (scene)
+      t = scene[t];
+    bool box = x >= 3 * t && x < 3 * t + 5 && y >= 10 && y < 14;
+    splat4d_index_set(&idx, k, box ? 299 - z : (x * 7 + y * 3 + z) % DELTA_TEST_COLORS);
+  }
+  uint32_t flags = SPLAT_FLAG_PRECISION_FLOAT32 |
+                   (SPLAT_INDEX_WIDTH_16 << SPLAT_FLAG_INDEX_WIDTH_SHIFT) |
+                   (codec << SPLAT_FLAG_COMPRESSION_SHIFT);
+  Splat4DHeader header = create_splat4DHeader(DELTA_TEST_W, DELTA_TEST_H, DELTA_TEST_DEPTH,
+                                              frames, DELTA_TEST_COLORS, flags);
+  Splat4DVideo video = create_splat4DVideoWithIndex(header, palette, idx);
+  FILE *fp = tmpfile();
+  bool ok = fp && write_splat4DVideoWithOptions(fp, &video, opts);
+  free(palette);
+  if (ok && expect)
+    *expect = idx;
+  else
+    free(idx.data);
+  if (fp && !ok) {
+    fclose(fp);
+    return NULL;
+  }
+  if (fp)
+    rewind(fp);
+  return fp;
+}
+
+static FILE *write_delta_test_clip(uint32_t frames, uint32_t codec,
+                                   const Splat4DWriteOptions *opts, Splat4DIndex *expect) {
+  return write_scene_test_clip(frames, NULL, codec, opts, expect);
+}
+
+// The delta transform round-trips through every codec and layout, whole and
+// frame by frame, for a clip and for a single volume.
+static bool test_delta_index_round_trips(void) {
+  Splat4DWriteOptions layouts[4] = {{.temporal_delta = true},
+                                    {.temporal_delta = true, .chunk_frames = 1},
+                                    {.temporal_delta = true, .chunk_frames = 2},
+                                    {.temporal_delta = true, .chunk_bytes = 1000}};
+  const uint64_t frame_entries = DELTA_TEST_W * DELTA_TEST_H * DELTA_TEST_DEPTH;
+  for (uint32_t codec = 1; codec < 16; codec++) {
+    if (!splat_compression_available(codec))
+      continue;
+    for (uint32_t frames = 1; frames <= 5; frames += 4) {
+      for (int l = 0; l < 4; ++l) {
+        Splat4DIndex expect;
+        FILE *fp = write_delta_test_clip(frames, codec, &layouts[l], &expect);
+        if (!fp)
+          return false;
+        Splat4DVideo loaded;
+        bool ok = read_splat4DVideo(fp, &loaded);
+        if (ok) {
+          ok = loaded.header.version[3] == SPLAT_TRANSFORM_DELTA &&
+               indices_equal(&expect, &loaded.index, frame_entries * frames);
+          free_splat4DVideo(&loaded);
+        }
+        for (uint32_t t = 0; ok && t < frames; ++t) {
+          Splat4DHeader header;
+          Splat4DIndex frame;
+          ok = read_splat4DFrame(fp, t, &header, NULL, &frame);
+          if (ok) {
+            Splat4DIndex part = {.u8 = expect.u8 + t * frame_entries * 2, .width = 2};
+            ok = indices_equal(&part, &frame, frame_entries);
+            free(frame.data);
+          }
+        }
+        fclose(fp);
+        free(expect.data);
+        if (!ok)
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+// On a mostly static clip the transform shrinks an RLE index; without
+// compression it is not applied, and unknown transforms are rejected.
+static bool test_delta_index_shrinks_static_clip(void) {
+  Splat4DWriteOptions plain = {0}, delta = {.temporal_delta = true};
+  FILE *a = write_delta_test_clip(5, SPLAT_COMPRESSION_RUN_LENGTH, &plain, NULL);
+  FILE *b = write_delta_test_clip(5, SPLAT_COMPRESSION_RUN_LENGTH, &delta, NULL);
+  FILE *c = write_delta_test_clip(5, SPLAT_COMPRESSION_NONE, &delta, NULL);
+  Splat4DProbe pa, pb, pc;
+  bool ok = a && b && c && probe_splat4DFile(a, &pa) && probe_splat4DFile(b, &pb) &&
+            probe_splat4DFile(c, &pc) && pb.index_bytes * 4 < pa.index_bytes &&
+            pc.header.version[3] == SPLAT_TRANSFORM_NONE;
+  // version[3] is the eighth header byte.
+  Splat4DVideo v;
+  ok = ok && fseek(b, 7, SEEK_SET) == 0 && fputc(4, b) != EOF && fflush(b) == 0 &&
+       fseek(b, 0, SEEK_SET) == 0 && !read_splat4DVideo(b, &v);
+  if (a)
+    fclose(a);
+  if (b)
+    fclose(b);
+  if (c)
+    fclose(c);
+  return ok;
+}
+
+// A held frame, a cut back to an earlier shot and a final hold: three of the
+// seven frames are new.
+#define REPEAT_TEST_FRAMES 7
+static const uint32_t REPEAT_TEST_SCENE[REPEAT_TEST_FRAMES] = {0, 0, 4, 0, 4, 8, 8};
+
+// Repeated frames are stored once and referenced through the frame table, on
+// every codec and layout and together with the delta transform; whole and
+// frame-by-frame reads see every frame.
+static bool test_frame_refs_round_trip(void) {
+  Splat4DWriteOptions layouts[5] = {{.frame_refs = true},
+                                    {.frame_refs = true, .chunk_frames = 1},
+                                    {.frame_refs = true, .chunk_frames = 2},
+                                    {.frame_refs = true, .chunk_bytes = 1000},
+                                    {.frame_refs = true, .temporal_delta = true}};
+  const uint64_t frame_entries = DELTA_TEST_W * DELTA_TEST_H * DELTA_TEST_DEPTH;
+  for (uint32_t codec = 1; codec < 16; codec++) {
+    if (!splat_compression_available(codec))
+      continue;
+    for (int l = 0; l < 5; ++l) {
+      Splat4DIndex expect;
+      FILE *fp = write_scene_test_clip(REPEAT_TEST_FRAMES, REPEAT_TEST_SCENE, codec, &layouts[l],
+                                       &expect);
+      if (!fp)
+        return false;
+      uint8_t want = SPLAT_TRANSFORM_FRAME_REFS | (l == 4 ? SPLAT_TRANSFORM_DELTA : 0);
+      Splat4DVideo loaded;
+      bool ok = read_splat4DVideo(fp, &loaded);
+      if (ok) {
+        ok = loaded.header.version[3] == want && loaded.header.frames == REPEAT_TEST_FRAMES &&
+             indices_equal(&expect, &loaded.index, frame_entries * REPEAT_TEST_FRAMES);
+        free_splat4DVideo(&loaded);
+      }
+      for (uint32_t t = 0; ok && t < REPEAT_TEST_FRAMES; ++t) {
+        Splat4DHeader header;
+        Splat4DIndex frame;
+        ok = read_splat4DFrame(fp, t, &header, NULL, &frame);
+        if (ok) {
+          Splat4DIndex part = {.u8 = expect.u8 + t * frame_entries * 2, .width = 2};
+          ok = indices_equal(&part, &frame, frame_entries);
+          free(frame.data);
+        }
+      }
+      fclose(fp);
+      free(expect.data);
+      if (!ok)
+        return false;
+    }
+  }
+  return true;
+}
+
+// References shrink the index of a clip with repeats; a clip without repeats
+// or without compression gets no frame table, and a damaged table is rejected.
+static bool test_frame_refs_shrink_and_validate(void) {
+  Splat4DWriteOptions plain = {0}, refs = {.frame_refs = true};
+  uint32_t codec = SPLAT_COMPRESSION_RUN_LENGTH;
+  FILE *a = write_scene_test_clip(REPEAT_TEST_FRAMES, REPEAT_TEST_SCENE, codec, &plain, NULL);
+  FILE *b = write_scene_test_clip(REPEAT_TEST_FRAMES, REPEAT_TEST_SCENE, codec, &refs, NULL);
+  FILE *c = write_scene_test_clip(REPEAT_TEST_FRAMES, REPEAT_TEST_SCENE, SPLAT_COMPRESSION_NONE,
+                                  &refs, NULL);
+  FILE *d = write_delta_test_clip(5, codec, &refs, NULL);
+  Splat4DProbe pa, pb, pc, pd;
+  bool ok = a && b && c && d && probe_splat4DFile(a, &pa) && probe_splat4DFile(b, &pb) &&
+            probe_splat4DFile(c, &pc) && probe_splat4DFile(d, &pd) &&
+            pb.index_bytes * 2 < pa.index_bytes && pb.index_offset == pa.index_offset + 8 + 4 * 7 &&
+            pc.header.version[3] == SPLAT_TRANSFORM_NONE &&
+            pd.header.version[3] == SPLAT_TRANSFORM_NONE;
+  // The table sits just before the index; slot 2 for frame 1 skips slot 1 and
+  // breaks first-appearance order.
+  uint8_t slot[4] = {2, 0, 0, 0};
+  Splat4DVideo v;
+  ok = ok && fseek(b, (long)(pb.index_offset - 4 * 7 + 4), SEEK_SET) == 0 &&
+       fwrite(slot, 1, 4, b) == 4 && fflush(b) == 0 && fseek(b, 0, SEEK_SET) == 0 &&
+       !read_splat4DVideo(b, &v);
+  if (a)
+    fclose(a);
+  if (b)
+    fclose(b);
+  if (c)
+    fclose(c);
+  if (d)
+    fclose(d);
+  return ok;
+}
+
+// Streaming a clip with repeated frames writes the same references as the
+// batch writer, and video_to_shared_slices() shares the pixels of a repeat.
+static bool test_frame_refs_stream_and_slices(void) {
+  enum { W = 16, H = 8, DEPTH = 2, FRAMES = 4, NSLICES = DEPTH * FRAMES };
+  static uint8_t rgb[NSLICES][W * H * 3];
+  const uint8_t *slices[NSLICES];
+  for (uint32_t s = 0; s < NSLICES; ++s) {
+    uint32_t shot = s / DEPTH == 2 ? 1 : 0; // frames 0, 1 and 3 match
+    for (uint32_t k = 0; k < W * H * 3; ++k)
+      rgb[s][k] = (uint8_t)(k * 13 + (s % DEPTH) * 50 + shot * 101);
+    slices[s] = rgb[s];
+  }
+  Splat4DWriteOptions write = {.frame_refs = true};
+  Splat4DVideo video;
+  FILE *batch = tmpfile(), *streamed = tmpfile();
+  bool ok = batch && streamed &&
+            stack_to_video_with_options(slices, DEPTH, FRAMES, W, H, NULL, &video);
+  if (ok) {
+    video.header.flags |= SPLAT_COMPRESSION_RUN_LENGTH << SPLAT_FLAG_COMPRESSION_SHIFT;
+    uint8_t **rec = NULL;
+    uint32_t ns = 0;
+    ok = write_splat4DVideoWithOptions(batch, &video, &write) &&
+         video_to_shared_slices(&video, &rec, &ns, NULL, NULL) && ns == NSLICES &&
+         rec[0] == rec[2] && rec[1] == rec[7] && rec[0] != rec[4] && rec[1] != rec[0];
+    for (uint32_t s = 0; ok && s < NSLICES; ++s)
+      ok = memcmp(rec[s], rgb[s], W * H * 3) == 0;
+    free_shared_video_slices(rec);
+    free_splat4DVideo(&video);
+  }
+  Splat4DStreamEncoder enc;
+  ok = ok && splat4d_encoder_open(&enc, streamed, W, H, DEPTH, SPLAT_COMPRESSION_RUN_LENGTH,
+                                  NULL, &write);
+  for (uint32_t t = 0; ok && t < FRAMES; ++t)
+    ok = splat4d_encoder_push_frame(&enc, slices + t * DEPTH);
+  ok = ok && splat4d_encoder_finish(&enc, NULL);
+  size_t blen = 0, slen = 0;
+  uint8_t *b = ok ? slurp_file(batch, &blen) : NULL;
+  uint8_t *st = b ? slurp_file(streamed, &slen) : NULL;
+  ok = st && blen == slen && memcmp(b, st, blen) == 0 && b[7] == SPLAT_TRANSFORM_FRAME_REFS;
+  free(b);
+  free(st);
+  if (batch)
+    fclose(batch);
+  if (streamed)
+    fclose(streamed);
+  return ok;
+}
+
+// Checks each streamed slice against the whole-file decode, in order.
+typedef struct {
+  uint8_t **expect;
+  uint32_t calls, stop_after; // stop_after 0 = never stop
+  bool mismatch;
+} SliceCheck;
+
+static bool check_streamed_slice(void *ctx, uint32_t t, uint32_t z, const uint8_t *rgb,
+                                 const Splat4DHeader *header) {
+  SliceCheck *c = ctx;
+  uint32_t s = t * header->depth + z;
+  if (s != c->calls || memcmp(rgb, c->expect[s], (size_t)header->width * header->height * 3))
+    c->mismatch = true;
+  c->calls++;
+  return !c->mismatch && c->calls != c->stop_after;
+}
+
+// splat4d_decode_each_slice() hands out the same slices as video_to_slices()
+// on every codec and layout, with the delta transform (whose zero runs cross
+// frame boundaries) and with frame references.
+static bool test_decode_each_slice_matches_whole_decode(void) {
+  Splat4DWriteOptions layouts[6] = {{0},
+                                    {.chunk_frames = 2},
+                                    {.chunk_bytes = 1000},
+                                    {.temporal_delta = true},
+                                    {.temporal_delta = true, .chunk_frames = 2},
+                                    {.temporal_delta = true, .frame_refs = true}};
+  for (uint32_t codec = 0; codec < 16; codec++) {
+    if (codec && !splat_compression_available(codec))
+      continue;
+    for (int l = 0; l < 6; ++l) {
+      FILE *fp = write_scene_test_clip(REPEAT_TEST_FRAMES, REPEAT_TEST_SCENE, codec, &layouts[l],
+                                       NULL);
+      if (!fp)
+        return false;
+      Splat4DVideo v;
+      uint8_t **slices = NULL;
+      uint32_t ns = 0;
+      bool ok = read_splat4DVideo(fp, &v);
+      if (ok) {
+        ok = video_to_slices(&v, &slices, &ns, NULL, NULL);
+        free_splat4DVideo(&v);
+      }
+      SliceCheck c = {.expect = slices};
+      Splat4DHeader h;
+      ok = ok && splat4d_decode_each_slice(fp, NULL, check_streamed_slice, &c, &h) &&
+           !c.mismatch && c.calls == ns && h.frames == REPEAT_TEST_FRAMES;
+      free_video_slices(slices, ns);
+      fclose(fp);
+      if (!ok)
+        return false;
+    }
+  }
+  return true;
+}
+
+// A bad checksum fails the streaming decode unless verification is off, and a
+// callback that returns false stops it.
+static bool test_decode_each_slice_verifies_and_stops(void) {
+  FILE *fp = write_delta_test_clip(5, SPLAT_COMPRESSION_RUN_LENGTH, &(Splat4DWriteOptions){0},
+                                   NULL);
+  Splat4DVideo v;
+  uint8_t **slices = NULL;
+  uint32_t ns = 0;
+  bool ok = fp && read_splat4DVideo(fp, &v);
+  if (ok) {
+    ok = video_to_slices(&v, &slices, &ns, NULL, NULL);
+    free_splat4DVideo(&v);
+  }
+  SliceCheck stop = {.expect = slices, .stop_after = 2};
+  ok = ok && !splat4d_decode_each_slice(fp, NULL, check_streamed_slice, &stop, NULL) &&
+       stop.calls == 2 && !stop.mismatch;
+  // The checksum follows the footer's 8-byte index offset.
+  Splat4DReadOptions trust = {.verify = SPLAT_READ_VERIFY_NONE};
+  SliceCheck full = {.expect = slices}, trusted = {.expect = slices};
+  ok = ok && fseek(fp, 8 - (long)SPLAT_FOOTER_DISK_BYTES, SEEK_END) == 0 &&
+       fputc(0xA5, fp) != EOF && fflush(fp) == 0 &&
+       !splat4d_decode_each_slice(fp, NULL, check_streamed_slice, &full, NULL) &&
+       splat4d_decode_each_slice(fp, &trust, check_streamed_slice, &trusted, NULL) &&
+       trusted.calls == ns && !trusted.mismatch;
+  free_video_slices(slices, ns);
+  if (fp)
+    fclose(fp);
+  return ok;
+}
+
+// The streaming decode range-checks and gathers 64-bit index entries, stored
+// raw, compressed, chunked or delta coded.
+static bool test_decode_each_slice_wide_index(void) {
+  enum { W = 23, H = 9, FRAMES = 4 };
+  Splat4DWriteOptions layouts[3] = {{0}, {.chunk_frames = 1}, {.temporal_delta = true}};
+  uint32_t codecs[2] = {SPLAT_COMPRESSION_NONE, SPLAT_COMPRESSION_RUN_LENGTH};
+  bool ok = true;
+  for (int c = 0; ok && c < 2; ++c) {
+    for (int l = 0; ok && l < 3; ++l) {
+      if (codecs[c] == SPLAT_COMPRESSION_NONE && l)
+        continue; // the chunked and delta layouts need a codec
+      Splat4DVideo v = make_wide_index_video(W, H, FRAMES);
+      v.header.flags |= codecs[c] << SPLAT_FLAG_COMPRESSION_SHIFT;
+      uint8_t **slices = NULL;
+      uint32_t ns = 0;
+      FILE *fp = tmpfile();
+      ok = fp && v.palette.palette && write_splat4DVideoWithOptions(fp, &v, &layouts[l]) &&
+           video_to_slices(&v, &slices, &ns, NULL, NULL);
+      for (uint32_t t = 0; ok && t < FRAMES; ++t)
+        ok = wide_index_frame_matches(slices[t], W * H, t);
+      SliceCheck check = {.expect = slices};
+      ok = ok && splat4d_decode_each_slice(fp, NULL, check_streamed_slice, &check, NULL) &&
+           !check.mismatch && check.calls == FRAMES;
+      free_video_slices(slices, ns);
+      free_splat4DVideo(&v);
+      if (fp)
+        fclose(fp);
+    }
+  }
+  return ok;
+}
+
+// P5, P6 and P7 headers parse to size, channels, maxval and the pixel offset;
+// headers that are malformed, out of range or cut short are rejected.
+static bool test_pnm_parse_header(void) {
+  static const struct {
+    const char *text;
+    uint32_t w, h, channels, maxval;
+  } good[] = {
+      {"P6\n3 2\n255\n", 3, 2, 3, 255},
+      {"P5 # gray\n4\t1\n# max\n65535\n", 4, 1, 1, 65535},
+      {"P7\nWIDTH 2\nHEIGHT 5\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", 2, 5, 4, 255},
+      {"P7\nWIDTH 1\nHEIGHT 1\nDEPTH 2\nMAXVAL 15\nTUPLTYPE GRAYSCALE_ALPHA\nENDHDR\n", 1, 1, 2,
+       15},
+      {"P7\nWIDTH 6\nHEIGHT 1\nDEPTH 3\nMAXVAL 1023\nENDHDR\n", 6, 1, 3, 1023},
+  };
+  static const char *const bad[] = {
+      "P3\n1 1\n255\n",
+      "P6\n0 1\n255\n",
+      "P6\n1 1\n65536\n",
+      "P6\n1 1\n255",
+      "P6\n1 1\n25",
+      "P6\n1 x\n255\n",
+      "P6\n99999999999 1\n255\n",
+      "P7\nWIDTH 1\nHEIGHT 1\nDEPTH 3\nMAXVAL 255\nTUPLTYPE GRAYSCALE\nENDHDR\n",
+      "P7\nWIDTH 1\nHEIGHT 1\nDEPTH 5\nMAXVAL 255\nENDHDR\n",
+      "P7\nWIDTH 1\nHEIGHT 1\nDEPTH 3\nMAXVAL 255\nTUPLTYPE CMYK\nENDHDR\n",
+      "P7\nWIDTH 1\nHEIGHT 1\nDEPTH 3\nMAXVAL 255\n",
+  };
+  PnmHeader hd;
+  for (size_t i = 0; i < ARRAY_SIZE(good); ++i) {
+    size_t n = strlen(good[i].text);
+    if (!pnm_parse_header((const uint8_t *)good[i].text, n, &hd) || hd.w != good[i].w ||
+        hd.h != good[i].h || hd.channels != good[i].channels || hd.maxval != good[i].maxval ||
+        hd.header_bytes != n)
+      return false;
+  }
+  for (size_t i = 0; i < ARRAY_SIZE(bad); ++i)
+    if (pnm_parse_header((const uint8_t *)bad[i], strlen(bad[i]), &hd))
+      return false;
+  return true;
+}
+
+// A tmpfile holding `header` followed by n bytes of `data`, rewound.
+static FILE *pnm_test_file(const char *header, const void *data, size_t n) {
+  FILE *fp = tmpfile();
+  if (fp && (fputs(header, fp) < 0 || fwrite(data, 1, n, fp) != n || fseek(fp, 0, SEEK_SET))) {
+    fclose(fp);
+    fp = NULL;
+  }
+  return fp;
+}
+
+// Read one frame of a test file through `r` into rgb.
+static bool pnm_test_read(PnmReader *r, const char *header, const void *data, size_t n,
+                          uint8_t *rgb, PnmHeader *hd) {
+  FILE *fp = pnm_test_file(header, data, n);
+  if (!fp)
+    return false;
+  if (!pnm_read_header(r, fp, "test", hd)) {
+    fclose(fp);
+    return false;
+  }
+  return pnm_read_rgb(r, fp, "test", hd, rgb);
+}
+
+// One reader and one RGB slot serve frames of every layout in turn: gray is
+// expanded, alpha dropped, 16-bit big-endian and odd maxvals rescaled, and a
+// header longer than the first read still parses.
+static bool test_pnm_read_rgb_reuses_slot(void) {
+  static const uint8_t rgb6[6] = {1, 2, 3, 250, 251, 252};
+  static const uint8_t gray[2] = {0, 200};
+  static const uint8_t rgba[8] = {10, 20, 30, 99, 40, 50, 60, 0};
+  static const uint8_t ga16[8] = {0x80, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00};
+  static const uint8_t rgb15[6] = {15, 0, 7, 8, 1, 14};
+  static char long_header[6000];
+  memcpy(long_header, "P6\n#", 4);
+  memset(long_header + 4, 'c', 5000);
+  strcpy(long_header + 5004, "\n2 1\n255\n");
+  PnmReader r = {.head = NULL};
+  PnmHeader hd;
+  uint8_t out[6];
+  bool ok = pnm_test_read(&r, "P6\n2 1\n255\n", rgb6, 6, out, &hd) && memcmp(out, rgb6, 6) == 0;
+  ok = ok && pnm_test_read(&r, "P5\n2 1\n255\n", gray, 2, out, &hd) &&
+       memcmp(out, (uint8_t[6]){0, 0, 0, 200, 200, 200}, 6) == 0;
+  ok = ok && pnm_test_read(&r, "P7\nWIDTH 2\nHEIGHT 1\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\n"
+                               "ENDHDR\n", rgba, 8, out, &hd) &&
+       memcmp(out, (uint8_t[6]){10, 20, 30, 40, 50, 60}, 6) == 0;
+  ok = ok && pnm_test_read(&r, "P7\nWIDTH 2\nHEIGHT 1\nDEPTH 2\nMAXVAL 65535\n"
+                               "TUPLTYPE GRAYSCALE_ALPHA\nENDHDR\n", ga16, 8, out, &hd) &&
+       memcmp(out, (uint8_t[6]){128, 128, 128, 255, 255, 255}, 6) == 0;
+  ok = ok && pnm_test_read(&r, "P6\n2 1\n15\n", rgb15, 6, out, &hd) &&
+       memcmp(out, (uint8_t[6]){255, 0, 119, 136, 17, 238}, 6) == 0;
+  ok = ok && pnm_test_read(&r, long_header, rgb6, 6, out, &hd) && memcmp(out, rgb6, 6) == 0 &&
+       hd.header_bytes == strlen(long_header) && r.head_cap > PNM_HEADER_BUFFER_BYTES;
+  // Short pixel data and a header cut off by the end of the file both fail.
+  ok = ok && !pnm_test_read(&r, "P6\n2 1\n255\n", rgb6, 5, out, &hd) &&
+       !pnm_test_read(&r, "P6\n2 1\n", "", 0, out, &hd);
+  pnm_reader_free(&r);
+  return ok;
+}
+
+// Raw RGB24 input needs --size and is sniffed for the Y4M signature first, so
+// frames shorter than the signature must still come out whole and in order.
+static bool test_pipe_reader_raw_rgb24(void) {
+  uint8_t bytes[30], frame[30];
+  for (uint32_t k = 0; k < sizeof bytes; ++k)
+    bytes[k] = (uint8_t)(k * 11 + 1);
+  bool ok = true;
+  static const uint32_t sizes[][2] = {{1, 2}, {5, 2}}; // 6 and 30 bytes per frame
+  for (size_t c = 0; ok && c < ARRAY_SIZE(sizes); ++c) {
+    size_t n = (size_t)sizes[c][0] * sizes[c][1] * 3;
+    FILE *fp = tmpfile();
+    PipeReader p = {.fp = NULL};
+    ok = fp && fwrite(bytes, 1, sizeof bytes, fp) == sizeof bytes && fseek(fp, 0, SEEK_SET) == 0 &&
+         !pipe_reader_open(&p, fp, 0, 0) && fseek(fp, 0, SEEK_SET) == 0 &&
+         pipe_reader_open(&p, fp, sizes[c][0], sizes[c][1]) && !p.y4m;
+    for (size_t f = 0; ok && f < sizeof bytes / n; ++f)
+      ok = pipe_reader_next(&p, frame) == 1 && memcmp(frame, bytes + f * n, n) == 0;
+    ok = ok && pipe_reader_next(&p, frame) == 0;
+    pipe_reader_close(&p);
+    if (fp)
+      fclose(fp);
+  }
+  // A stream that stops inside a frame is truncated, not finished.
+  FILE *fp = tmpfile();
+  PipeReader p = {.fp = NULL};
+  ok = ok && fp && fwrite(bytes, 1, 10, fp) == 10 && fseek(fp, 0, SEEK_SET) == 0 &&
+       pipe_reader_open(&p, fp, 2, 1) && pipe_reader_next(&p, frame) == 1 &&
+       pipe_reader_next(&p, frame) == -1;
+  pipe_reader_close(&p);
+  if (fp)
+    fclose(fp);
+  return ok;
+}
+
+// BT.601 limited-range YCbCr to RGB in floating point, for checking the
+// integer conversion.
+static int y4m_reference_channel(uint8_t y, uint8_t cb, uint8_t cr, int channel) {
+  double c = 1.164 * (y - 16), d = cb - 128, e = cr - 128;
+  double v = channel == 0   ? c + 1.596 * e
+             : channel == 1 ? c - 0.392 * d - 0.813 * e
+                            : c + 2.017 * d;
+  return v < 0 ? 0 : v > 255 ? 255 : (int)(v + 0.5);
+}
+
+// Each 8-bit Y4M chroma layout, including odd sizes and Cmono's single plane,
+// decodes with every pixel taking its own chroma sample.
+static bool test_pipe_reader_y4m_layouts(void) {
+  static const struct {
+    const char *tag;
+    uint32_t sx, sy;
+    bool mono;
+  } layouts[] = {{"C420jpeg", 1, 1, false}, {"C422", 1, 0, false}, {"C444", 0, 0, false},
+                 {"Cmono", 0, 0, true},     {"", 1, 1, false}};
+  enum { W = 5, H = 3, FRAMES = 2 };
+  for (size_t l = 0; l < ARRAY_SIZE(layouts); ++l) {
+    uint32_t cw = (W + (1u << layouts[l].sx) - 1) >> layouts[l].sx;
+    uint32_t ch = (H + (1u << layouts[l].sy) - 1) >> layouts[l].sy;
+    size_t chroma = layouts[l].mono ? 0 : (size_t)cw * ch;
+    uint8_t planes[FRAMES][W * H * 3];
+    FILE *fp = tmpfile();
+    bool ok = fp && fprintf(fp, "YUV4MPEG2 W%u H%u F30:1 Ip%s%s\n", W, H,
+                            layouts[l].tag[0] ? " " : "", layouts[l].tag) > 0;
+    for (uint32_t t = 0; ok && t < FRAMES; ++t) {
+      for (size_t k = 0; k < W * H + 2 * chroma; ++k)
+        planes[t][k] = (uint8_t)(k < W * H ? 16 + (k * 37 + t * 50) % 220 : 60 + k * 29 % 140);
+      ok = fputs("FRAME\n", fp) >= 0 &&
+           fwrite(planes[t], 1, W * H + 2 * chroma, fp) == W * H + 2 * chroma;
+    }
+    PipeReader p = {.fp = NULL};
+    ok = ok && fseek(fp, 0, SEEK_SET) == 0 && pipe_reader_open(&p, fp, 0, 0) && p.y4m &&
+         p.w == W && p.h == H && p.mono == layouts[l].mono;
+    uint8_t rgb[W * H * 3];
+    for (uint32_t t = 0; ok && t < FRAMES; ++t) {
+      ok = pipe_reader_next(&p, rgb) == 1;
+      for (uint32_t y = 0; ok && y < H; ++y) {
+        for (uint32_t x = 0; ok && x < W; ++x) {
+          size_t c = (size_t)(y >> layouts[l].sy) * cw + (x >> layouts[l].sx);
+          uint8_t cb = chroma ? planes[t][W * H + c] : 128;
+          uint8_t cr = chroma ? planes[t][W * H + chroma + c] : 128;
+          for (int k = 0; ok && k < 3; ++k)
+            ok = abs(rgb[(y * W + x) * 3 + k] -
+                     y4m_reference_channel(planes[t][y * W + x], cb, cr, k)) <= 2;
+        }
+      }
+    }
+    ok = ok && pipe_reader_next(&p, rgb) == 0;
+    pipe_reader_close(&p);
+    if (fp)
+      fclose(fp);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+// decode-video --y4m output reads back through the Y4M input path within two
+// levels per channel, and raw RGB24 output reads back exactly.
+static bool test_pipe_writer_round_trips(void) {
+  enum { W = 16, H = 16, FRAMES = 3 };
+  static uint8_t rgb[FRAMES][W * H * 3];
+  for (uint32_t t = 0; t < FRAMES; ++t)
+    for (uint32_t k = 0; k < W * H * 3; ++k)
+      rgb[t][k] = (uint8_t)(k * 53 + t * 97 + (k % 3) * 17);
+  Splat4DHeader header = create_splat4DHeader(W, H, 1, FRAMES, 1, SPLAT_FLAG_PRECISION_FLOAT32);
+  for (int y4m = 0; y4m < 2; ++y4m) {
+    FILE *fp = tmpfile();
+    PipeWriter pw = {.fp = fp, .y4m = y4m};
+    bool ok = fp != NULL;
+    for (uint32_t t = 0; ok && t < FRAMES; ++t)
+      ok = write_pipe_frame(&pw, t, 0, rgb[t], &header);
+    free(pw.planes);
+    PipeReader p = {.fp = NULL};
+    ok = ok && pw.written == FRAMES && fseek(fp, 0, SEEK_SET) == 0 &&
+         pipe_reader_open(&p, fp, W, H) && p.y4m == y4m;
+    uint8_t back[W * H * 3];
+    for (uint32_t t = 0; ok && t < FRAMES; ++t) {
+      ok = pipe_reader_next(&p, back) == 1;
+      for (uint32_t k = 0; ok && k < W * H * 3; ++k)
+        ok = abs(back[k] - rgb[t][k]) <= (y4m ? 2 : 0);
+    }
+    ok = ok && pipe_reader_next(&p, back) == 0;
+    pipe_reader_close(&p);
+    if (fp)
+      fclose(fp);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+static bool test_read_frame_rejects_bad_requests(void) {
+  FILE *fp = write_chunk_test_clip(SPLAT_COMPRESSION_RUN_LENGTH, 2, NULL);
+  if (!fp)
+    return false;
+  Splat4DHeader header;
+  Splat4DIndex frame;
+  bool ok = !read_splat4DFrame(fp, CHUNK_TEST_FRAMES, &header, NULL, &frame) &&
+            frame.data == NULL;
+  // Clobber the chunk table tag, which sits right behind the last chunk.
+  Splat4DFooter footer;
+  ok = ok && fseek(fp, -(long)SPLAT_FOOTER_DISK_BYTES, SEEK_END) == 0 &&
+       read_splat4DFooter(fp, &footer) && fseek(fp, (long)footer.idxoffset, SEEK_SET) == 0 &&
+       fputc('X', fp) != EOF && fflush(fp) == 0;
+  ok = ok && !read_splat4DFrame(fp, 0, &header, NULL, &frame) && frame.data == NULL;
+  Splat4DVideo v;
+  ok = ok && fseek(fp, 0, SEEK_SET) == 0 && !read_splat4DVideo(fp, &v);
+  fclose(fp);
+  // A file shorter than a header and a footer.
+  FILE *cut = tmpfile();
+  Splat4DHeader small = create_splat4DHeader(2, 2, 1, 1, 2, SPLAT_FLAG_PRECISION_FLOAT32);
+  ok = ok && cut && write_splat4DHeader(cut, &small) && fflush(cut) == 0 &&
+       !read_splat4DFrame(cut, 0, &header, NULL, &frame) && frame.data == NULL;
+  if (cut)
+    fclose(cut);
+  return ok;
+}
+
+static bool count_task_hit(void *ctx, uint64_t task) {
+  ((uint8_t *)ctx)[task]++; // each task owns its slot
+  return true;
+}
+
+static bool fail_task_seven(void *ctx, uint64_t task) { return task != 7; }
+
+static bool test_parallel_for_runs_every_task_once(void) {
+  uint8_t hits[100] = {0};
+  splat4d_set_threads(4);
+  bool ok = splat_parallel_for(100, count_task_hit, hits) &&
+            !splat_parallel_for(100, fail_task_seven, NULL) &&
+            splat_parallel_for(0, fail_task_seven, NULL);
+  splat4d_set_threads(0);
+  for (int k = 0; k < 100; ++k)
+    ok = ok && hits[k] == 1;
+  return ok && splat4d_thread_count() >= 1;
+}
+
+// Write an RLE-compressed 64x64x8 clip split into chunk_bytes blocks with
+// `threads` workers and return the file's bytes.
+static uint8_t *write_block_chunked_clip(unsigned threads, size_t chunk_bytes, long *len) {
+  enum { W = 64, H = 64, F = 8, TOTAL = W * H * F };
+  Splat4D palette[2];
+  make_palette(palette);
+  uint64_t *indices = malloc(TOTAL * sizeof(uint64_t));
+  if (!indices)
+    return NULL;
+  for (uint64_t k = 0; k < TOTAL; ++k)
+    indices[k] = (k / 7 + k / W) % 2;
+  uint32_t flags = SPLAT_FLAG_PRECISION_FLOAT32 |
+                   (SPLAT_COMPRESSION_RUN_LENGTH << SPLAT_FLAG_COMPRESSION_SHIFT);
+  Splat4DVideo video = create_splat4DVideo(create_splat4DHeader(W, H, 1, F, 2, flags), palette,
+                                           indices);
+  Splat4DWriteOptions opts = {.chunk_bytes = chunk_bytes};
+  splat4d_set_threads(threads);
+  FILE *fp = tmpfile();
+  uint8_t *bytes = NULL;
+  if (fp && write_splat4DVideoWithOptions(fp, &video, &opts) && (*len = ftell(fp)) > 0 &&
+      (bytes = malloc((size_t)*len)) && fseek(fp, 0, SEEK_SET) == 0 &&
+      fread(bytes, 1, (size_t)*len, fp) != (size_t)*len) {
+    free(bytes);
+    bytes = NULL;
+  }
+  splat4d_set_threads(0);
+  if (fp)
+    fclose(fp);
+  free(indices);
+  return bytes;
+}
+
+static bool test_block_chunked_output_ignores_thread_count(void) {
+  long serial_len = 0, parallel_len = 0, whole_len = 0;
+  uint8_t *serial = write_block_chunked_clip(1, 1000, &serial_len);
+  uint8_t *parallel = write_block_chunked_clip(4, 1000, &parallel_len);
+  uint8_t *whole = write_block_chunked_clip(4, 1u << 20, &whole_len);
+  bool ok = serial && parallel && whole && serial_len == parallel_len &&
+            memcmp(serial, parallel, (size_t)serial_len) == 0 &&
+            serial[6] == SPLAT_LAYOUT_CHUNKED && whole[6] == SPLAT_LAYOUT_MONOLITHIC;
+
+  // Read the blocks back on several workers and compare with the serial read.
+  FILE *fp = ok ? tmpfile() : NULL;
+  Splat4DVideo a = {0}, b = {0};
+  ok = fp && fwrite(parallel, 1, (size_t)parallel_len, fp) == (size_t)parallel_len &&
+       fseek(fp, 0, SEEK_SET) == 0 && read_splat4DVideo(fp, &a);
+  splat4d_set_threads(4);
+  ok = ok && fseek(fp, 0, SEEK_SET) == 0 && read_splat4DVideo(fp, &b) &&
+       indices_equal(&a.index, &b.index, header_total_indices(&a.header)) &&
+       splat4d_index_get(&a.index, 0) == 0 && splat4d_index_get(&a.index, 7) == 1;
+  splat4d_set_threads(0);
+  if (a.index.data)
+    free_splat4DVideo(&a);
+  if (b.index.data)
+    free_splat4DVideo(&b);
+  if (fp)
+    fclose(fp);
+  free(serial);
+  free(parallel);
+  free(whole);
+  return ok;
+}
+
+static bool test_fused_writer_checksum_matches_reference(void) {
+  uint64_t indices[CHUNK_TEST_TOTAL];
+  Splat4D palette[2];
+  make_chunk_test_indices(indices);
+  make_palette(palette);
+  for (uint32_t codec = 0; codec < 16; codec++) {
+    if (!splat_compression_available(codec))
+      continue;
+    // Storage at 8 bytes (packed on the way out) and at the header's 1 byte.
+    for (int narrow = 0; narrow < 2; ++narrow) {
+      for (uint32_t chunk_frames = 0; chunk_frames <= 2; chunk_frames += 2) {
+        uint32_t flags = SPLAT_FLAG_PRECISION_FLOAT32 | (codec << SPLAT_FLAG_COMPRESSION_SHIFT);
+        Splat4DHeader header =
+            create_splat4DHeader(CHUNK_TEST_W, CHUNK_TEST_H, 1, CHUNK_TEST_FRAMES, 2, flags);
+        Splat4DIndex idx = create_splat4DIndex(indices);
+        if (narrow && !splat4d_index_alloc(&idx, CHUNK_TEST_TOTAL, 1))
+          return false;
+        for (uint64_t k = 0; narrow && k < CHUNK_TEST_TOTAL; ++k)
+          splat4d_index_set(&idx, k, indices[k]);
+        Splat4DVideo video = create_splat4DVideoWithIndex(header, palette, idx);
+        Splat4DWriteOptions opts = {.chunk_frames = chunk_frames};
+        FILE *fp = tmpfile();
+        Splat4DVideo loaded;
+        // The caller's header is left as given; the file's header carries the
+        // layout, and the checksum covers the file's header.
+        bool ok = fp && write_splat4DVideoWithOptions(fp, &video, &opts) &&
+                  video.header.version[2] == SPLAT_LAYOUT_MONOLITHIC &&
+                  fseek(fp, 0, SEEK_SET) == 0 && read_splat4DVideo(fp, &loaded);
+        if (ok) {
+          ok = loaded.footer.checksum == video.footer.checksum &&
+               compute_video_checksum(&loaded) == loaded.footer.checksum;
+          free_splat4DVideo(&loaded);
+        }
+        if (fp)
+          fclose(fp);
+        if (narrow)
+          free(idx.data);
+        if (!ok)
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+typedef struct {
+  uint8_t *data;
+  size_t len, cap;
+} GrowBuf;
+
+static bool grow_buf_append(const uint8_t *chunk, size_t n, void *ctx) {
+  GrowBuf *b = ctx;
+  if (b->len + n > b->cap) {
+    size_t cap = (b->len + n) * 2;
+    uint8_t *p = realloc(b->data, cap);
+    if (!p)
+      return false;
+    b->data = p;
+    b->cap = cap;
+  }
+  memcpy(b->data + b->len, chunk, n);
+  b->len += n;
+  return true;
+}
+
+// Runs, a ramp and pseudo-random noise, larger than the codec staging buffer.
+#define STREAM_TEST_BYTES 200003
+static void make_stream_test_payload(uint8_t *p) {
+  uint32_t x = 12345;
+  for (size_t k = 0; k < STREAM_TEST_BYTES; ++k) {
+    x = x * 1103515245u + 12345u;
+    p[k] = k % 3000 < 1000 ? (uint8_t)(k / 700) : k % 3000 < 2000 ? (uint8_t)k : (uint8_t)(x >> 24);
+  }
+}
+
+// Feed in[0..n) to a decoder in `piece`-byte chunks.
+static bool stream_decode(uint32_t codec, const uint8_t *in, size_t n, size_t piece, uint8_t *out,
+                          size_t expected) {
+  SplatDecoder dec;
+  bool ok = splat_decoder_begin(&dec, codec, out, expected);
+  for (size_t off = 0; ok && off < n; off += piece)
+    ok = splat_decoder_consume(in + off, n - off < piece ? n - off : piece, &dec);
+  ok = ok && splat_decoder_finish(&dec);
+  splat_decoder_end(&dec);
+  return ok;
+}
+
+static bool test_streaming_codecs_match_whole_buffer(void) {
+  uint8_t *payload = malloc(STREAM_TEST_BYTES), *back = malloc(STREAM_TEST_BYTES);
+  bool ok = payload && back;
+  if (ok)
+    make_stream_test_payload(payload);
+  for (uint32_t codec = 0; ok && codec < 16; codec++) {
+    if (!splat_codec_streams(codec))
+      continue;
+    // Streamed output in odd-sized pushes decodes with the whole-buffer backend.
+    GrowBuf streamed = {0};
+    SplatEncoder enc;
+    ok = splat_encoder_begin(&enc, codec, STREAM_TEST_BYTES, grow_buf_append, &streamed);
+    for (size_t off = 0; ok && off < STREAM_TEST_BYTES; off += 7777)
+      ok = splat_encoder_consume(payload + off,
+                                 STREAM_TEST_BYTES - off < 7777 ? STREAM_TEST_BYTES - off : 7777,
+                                 &enc);
+    ok = ok && splat_encoder_finish(&enc);
+    splat_encoder_end(&enc);
+    ok = ok && splat_decompress(codec, streamed.data, streamed.len, back, STREAM_TEST_BYTES) &&
+         memcmp(back, payload, STREAM_TEST_BYTES) == 0;
+
+    // ...and whole-buffer output decodes with the streaming decoder.
+    size_t whole_len = 0;
+    uint8_t *whole = ok ? splat_compress(codec, payload, STREAM_TEST_BYTES, &whole_len) : NULL;
+    ok = whole && (memset(back, 0, STREAM_TEST_BYTES),
+                   stream_decode(codec, whole, whole_len, 1000, back, STREAM_TEST_BYTES)) &&
+         memcmp(back, payload, STREAM_TEST_BYTES) == 0;
+    if (ok && codec == SPLAT_COMPRESSION_RUN_LENGTH)
+      ok = whole_len == streamed.len && memcmp(whole, streamed.data, whole_len) == 0;
+    free(whole);
+    free(streamed.data);
+  }
+  free(payload);
+  free(back);
+  return ok;
+}
+
+static bool test_streaming_decoder_rejects_bad_input(void) {
+  uint8_t *payload = malloc(STREAM_TEST_BYTES), *back = malloc(STREAM_TEST_BYTES + 1);
+  uint8_t *padded = malloc(STREAM_TEST_BYTES * 2 + 1024);
+  bool ok = payload && back && padded;
+  if (ok)
+    make_stream_test_payload(payload);
+  for (uint32_t codec = 0; ok && codec < 16; codec++) {
+    if (!splat_codec_streams(codec))
+      continue;
+    size_t len = 0;
+    uint8_t *comp = splat_compress(codec, payload, STREAM_TEST_BYTES, &len);
+    ok = comp && len + 1 <= STREAM_TEST_BYTES * 2 + 1024;
+    if (ok) {
+      memcpy(padded, comp, len);
+      padded[len] = 1;
+      ok = !stream_decode(codec, comp, len - 1, 4096, back, STREAM_TEST_BYTES) &&
+           !stream_decode(codec, padded, len + 1, 4096, back, STREAM_TEST_BYTES) &&
+           !stream_decode(codec, comp, len, 4096, back, STREAM_TEST_BYTES - 1) &&
+           !stream_decode(codec, comp, len, 4096, back, STREAM_TEST_BYTES + 1);
+    }
+    free(comp);
+  }
+  free(payload);
+  free(back);
+  free(padded);
+  return ok;
+}
+
 static test_case TESTS[] = {
     {"header_total_indices_checked", test_header_total_indices_checked},
     {"create_splat4D", test_create_splat4D},
     {"create_splat4D_zero_values", test_create_splat4D_zero_values},
     {"crc32_known_value", test_crc32_known_value},
+    {"crc32_kernels_agree", test_crc32_kernels_agree},
+    {"crc32_combine_matches_concatenation", test_crc32_combine_matches_concatenation},
+    {"parallel_checksum_matches_serial", test_parallel_checksum_matches_serial},
     {"checksum_matches_footer", test_compute_video_checksum_matches_footer},
     {"idxoffset_helpers_agree", test_idxoffset_helpers_agree},
     {"idxoffset_forward_handles_large_palette", test_idxoffset_forward_handles_large_palette},
@@ -1610,8 +3508,61 @@ static test_case TESTS[] = {
     {"quantize_passthrough_within_budget", test_quantize_passthrough_within_budget},
     {"volume_round_trip", test_volume_round_trip},
     {"volume_populates_mu_z", test_volume_populates_mu_z},
+    {"splat_statistics_from_pixel_positions", test_splat_statistics_from_pixel_positions},
     {"golden_conformance_vector", test_golden_conformance_vector},
     {"golden_vector_reads_back", test_golden_vector_reads_back},
+    {"mapped_file_exposes_index_in_place", test_mapped_file_exposes_index_in_place},
+    {"mapped_file_deferred_verify_detects_corruption",
+     test_mapped_file_deferred_verify_detects_corruption},
+    {"mapped_file_rejects_compressed_index", test_mapped_file_rejects_compressed_index},
+    {"index_rewiden_preserves_values", test_index_rewiden_preserves_values},
+    {"reader_keeps_header_index_width", test_reader_keeps_header_index_width},
+    {"encoder_widens_index_with_palette", test_encoder_widens_index_with_palette},
+    {"colormap_grows_from_small_hint", test_colormap_grows_from_small_hint},
+    {"colormap_switches_to_direct_table", test_colormap_switches_to_direct_table},
+    {"colormap_hashed_only_stays_hashed", test_colormap_hashed_only_stays_hashed},
+    {"median_cut_is_reentrant", test_median_cut_is_reentrant},
+    {"quantizers_separate_clusters", test_quantizers_separate_clusters},
+    {"encode_options_select_quantizer", test_encode_options_select_quantizer},
+    {"kmeans_tree_matches_linear_scan", test_kmeans_tree_matches_linear_scan},
+    {"kmeans_refine_lowers_error", test_kmeans_refine_lowers_error},
+    {"stream_encoder_matches_batch", test_stream_encoder_matches_batch},
+    {"palette_order_round_trips", test_palette_order_round_trips},
+    {"cooccurrence_chain_follows_neighbors", test_cooccurrence_chain_follows_neighbors},
+    {"delta_index_round_trips", test_delta_index_round_trips},
+    {"delta_index_shrinks_static_clip", test_delta_index_shrinks_static_clip},
+    {"frame_refs_round_trip", test_frame_refs_round_trip},
+    {"frame_refs_shrink_and_validate", test_frame_refs_shrink_and_validate},
+    {"frame_refs_stream_and_slices", test_frame_refs_stream_and_slices},
+    {"decode_each_slice_matches_whole_decode", test_decode_each_slice_matches_whole_decode},
+    {"decode_each_slice_verifies_and_stops", test_decode_each_slice_verifies_and_stops},
+    {"decode_each_slice_wide_index", test_decode_each_slice_wide_index},
+    {"pnm_parse_header", test_pnm_parse_header},
+    {"pnm_read_rgb_reuses_slot", test_pnm_read_rgb_reuses_slot},
+    {"pipe_reader_raw_rgb24", test_pipe_reader_raw_rgb24},
+    {"pipe_reader_y4m_layouts", test_pipe_reader_y4m_layouts},
+    {"pipe_writer_round_trips", test_pipe_writer_round_trips},
+    {"stream_encoder_rejects_partial_frame", test_stream_encoder_rejects_partial_frame},
+    {"parallel_histogram_matches_serial", test_parallel_histogram_matches_serial},
+    {"chunked_index_round_trips_every_codec", test_chunked_index_round_trips_every_codec},
+    {"read_frame_matches_full_decode", test_read_frame_matches_full_decode},
+    {"read_frame_rejects_bad_requests", test_read_frame_rejects_bad_requests},
+    {"read_verify_modes", test_read_verify_modes},
+    {"deferred_read_verifies_intact_file", test_deferred_read_verifies_intact_file},
+    {"probe_reads_header_and_footer", test_probe_reads_header_and_footer},
+    {"probe_accepts_chunked_layout", test_probe_accepts_chunked_layout},
+    {"parallel_for_runs_every_task_once", test_parallel_for_runs_every_task_once},
+    {"block_chunked_output_ignores_thread_count",
+     test_block_chunked_output_ignores_thread_count},
+    {"fused_writer_checksum_matches_reference", test_fused_writer_checksum_matches_reference},
+    {"streaming_codecs_match_whole_buffer", test_streaming_codecs_match_whole_buffer},
+    {"streaming_decoder_rejects_bad_input", test_streaming_decoder_rejects_bad_input},
+    {"rgb_gather_matches_scalar", test_rgb_gather_matches_scalar},
+    {"rgb_decode_rejects_out_of_range_index", test_rgb_decode_rejects_out_of_range_index},
+    {"wide_index_decodes", test_wide_index_decodes},
+    {"slice_block_is_contiguous", test_slice_block_is_contiguous},
+    {"index_below_checks_every_width", test_index_below_checks_every_width},
+    {"parallel_slice_decode_matches_serial", test_parallel_slice_decode_matches_serial},
     {"palette_entry_disk_bytes_by_shape", test_palette_entry_disk_bytes_by_shape},
     {"shape_isotropic_collapses_sigmas", test_shape_isotropic_collapses_sigmas},
     {"shape_axis_aligned_round_trip", test_shape_axis_aligned_round_trip},